@@ -0,0 +1,226 @@
+/*
+ *  JsonRpc-Cpp - JSON-RPC implementation.
+ *  Copyright (C) 2008-2011 Sebastien Vincent <sebastien.vincent@cppextrem.com>
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**
+ * \file bench-alloc.cpp
+ * \brief Handler::Process allocation benchmark.
+ *
+ * Count heap allocations made by Handler::Process once warmed up, for
+ * requests, notifications, batched calls and error responses. The
+ * "growth" column is the number of blocks still allocated after the
+ * measured loop, it must be 0 as nothing is kept from a request to another.
+ * The ".wire" runs go down to the serialized response like the transports
+ * do, protocol errors then come from the pre-serialized buffers.
+ * \author Sebastien Vincent
+ */
+
+#include <cstdio>
+#include <cstdlib>
+
+#include "jsonrpc.h"
+
+#include "bench-common.h"
+#include "bench-malloc.h"
+
+/**
+ * \class BenchRpc
+ * \brief RPC methods used by the benchmark.
+ */
+class BenchRpc
+{
+  public:
+    /**
+     * \brief Reply with success.
+     * \param root JSON-RPC request
+     * \param response JSON-RPC response
+     * \return true
+     */
+    bool Print(const Json::Value& root, Json::Value& response)
+    {
+      response["jsonrpc"] = "2.0";
+      response["id"] = root["id"];
+      response["result"] = "success";
+      return true;
+    }
+
+    /**
+     * \brief Notification that does nothing.
+     * \param root JSON-RPC request
+     * \param response JSON-RPC response
+     * \return true
+     */
+    bool Notify(const Json::Value& root, Json::Value& response)
+    {
+      (void)root;
+      response = Json::Value::null;
+      return true;
+    }
+};
+
+/**
+ * \brief Process a message as the transports do.
+ * \param handler handler to use
+ * \param reader JSON reader
+ * \param writer JSON writer
+ * \param msg JSON-RPC message
+ * \param out serialized response (empty if none)
+ */
+static void bench_wire(Json::Rpc::Handler& handler, Json::Reader& reader,
+    Json::FastWriter& writer, const std::string& msg, std::string& out)
+{
+  Json::Value root;
+  Json::Value response;
+
+  if(handler.Parse(reader, msg, root, out))
+  {
+    handler.Process(root, response, out);
+  }
+
+  if(out.empty() && response != Json::Value::null)
+  {
+    out = writer.write(response);
+  }
+}
+
+/**
+ * \brief Measure one kind of message.
+ * \param handler handler to use
+ * \param name name of the benchmark
+ * \param msg JSON-RPC message
+ * \param iterations number of messages to process
+ * \param wire true to serialize the response as the transports do
+ */
+static void bench_run(Json::Rpc::Handler& handler, const char* name,
+    const std::string& msg, unsigned long iterations, bool wire)
+{
+  Json::Reader reader;
+  Json::FastWriter writer;
+  std::string out;
+  unsigned long allocs = 0;
+  unsigned long frees = 0;
+  unsigned long bytes = 0;
+  uint64_t start = 0;
+  uint64_t ns = 0;
+
+  /* warm up */
+  for(unsigned long i = 0 ; i < 100 ; i++)
+  {
+    Json::Value response;
+
+    if(wire)
+    {
+      bench_wire(handler, reader, writer, msg, out);
+      continue;
+    }
+    handler.Process(msg, response);
+  }
+
+  allocs = g_allocs;
+  frees = g_frees;
+  bytes = g_bytes;
+  start = bench_now();
+
+  for(unsigned long i = 0 ; i < iterations ; i++)
+  {
+    Json::Value response;
+
+    if(wire)
+    {
+      bench_wire(handler, reader, writer, msg, out);
+      continue;
+    }
+    handler.Process(msg, response);
+  }
+
+  ns = bench_now() - start;
+  allocs = g_allocs - allocs;
+  frees = g_frees - frees;
+  bytes = g_bytes - bytes;
+
+  bench_report(name, 0, iterations, ns);
+  printf("%-32s %10s %12.1f allocs/op %10.1f bytes/op %6ld growth\n", name,
+      "", (double)allocs / (double)iterations,
+      (double)bytes / (double)iterations, (long)(allocs - frees));
+}
+
+/**
+ * \brief Entry point of the program.
+ * \param argc number of argument
+ * \param argv array of arguments
+ * \return EXIT_SUCCESS or EXIT_FAILURE
+ */
+int main(int argc, char** argv)
+{
+  Json::Rpc::Handler handler;
+  BenchRpc obj;
+  unsigned long iterations = 100000;
+  std::string batch = "[";
+
+  if(argc > 1)
+  {
+    iterations = strtoul(argv[1], NULL, 10);
+  }
+
+  handler.AddMethod(new Json::Rpc::RpcMethod<BenchRpc>(obj, &BenchRpc::Print,
+        std::string("print")));
+  handler.AddMethod(new Json::Rpc::RpcMethod<BenchRpc>(obj, &BenchRpc::Notify,
+        std::string("notify")));
+
+  for(int i = 0 ; i < 10 ; i++)
+  {
+    batch += i ? "," : "";
+    batch += "{\"jsonrpc\":\"2.0\",\"method\":\"print\",\"id\":1}";
+  }
+  batch += "]";
+
+  bench_run(handler, "handler.alloc.request",
+      "{\"jsonrpc\":\"2.0\",\"method\":\"print\",\"id\":1}", iterations,
+      false);
+  bench_run(handler, "handler.alloc.notification",
+      "{\"jsonrpc\":\"2.0\",\"method\":\"notify\"}", iterations, false);
+  bench_run(handler, "handler.alloc.batch10", batch, iterations / 10, false);
+  bench_run(handler, "handler.alloc.notfound",
+      "{\"jsonrpc\":\"2.0\",\"method\":\"unknown\",\"id\":1}", iterations,
+      false);
+  bench_run(handler, "handler.alloc.invalid",
+      "{\"jsonrpc\":\"1.0\",\"method\":\"print\",\"id\":1}", iterations,
+      false);
+  bench_run(handler, "handler.alloc.parseerror",
+      "{\"jsonrpc\":\"2.0\",\"method\":", iterations, false);
+  bench_run(handler, "handler.alloc.describe",
+      "{\"jsonrpc\":\"2.0\",\"method\":\"system.describe\",\"id\":1}",
+      iterations, false);
+
+  bench_run(handler, "handler.alloc.request.wire",
+      "{\"jsonrpc\":\"2.0\",\"method\":\"print\",\"id\":1}", iterations,
+      true);
+  bench_run(handler, "handler.alloc.notfound.wire",
+      "{\"jsonrpc\":\"2.0\",\"method\":\"unknown\",\"id\":1}", iterations,
+      true);
+  bench_run(handler, "handler.alloc.invalid.wire",
+      "{\"jsonrpc\":\"1.0\",\"method\":\"print\",\"id\":1}", iterations,
+      true);
+  bench_run(handler, "handler.alloc.parseerror.wire",
+      "{\"jsonrpc\":\"2.0\",\"method\":", iterations, true);
+  bench_run(handler, "handler.alloc.describe.wire",
+      "{\"jsonrpc\":\"2.0\",\"method\":\"system.describe\",\"id\":1}",
+      iterations, true);
+
+  return EXIT_SUCCESS;
+}
+
@@ -0,0 +1,237 @@
+/*
+ *  JsonRpc-Cpp - JSON-RPC implementation.
+ *  Copyright (C) 2008-2011 Sebastien Vincent <sebastien.vincent@cppextrem.com>
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**
+ * \file bench-asyncclient.cpp
+ * \brief AsyncClient pipelining benchmark.
+ *
+ * One AsyncClient calls a TcpServer on loopback keeping at most "depth"
+ * calls outstanding, a new call is sent as soon as a response comes. Depth
+ * 1 is the request/response lockstep of TcpClient. The time is reported
+ * per call, with the number of calls per second.
+ * \author Sebastien Vincent
+ */
+
+#include <cstdio>
+#include <cstdlib>
+
+#include "jsonrpc.h"
+
+#include "bench-common.h"
+
+/**
+ * \class BenchRpc
+ * \brief RPC methods used by the benchmark.
+ */
+class BenchRpc
+{
+  public:
+    /**
+     * \brief Reply with success.
+     * \param root JSON-RPC request
+     * \param response JSON-RPC response
+     * \return true
+     */
+    bool Print(const Json::Value& root, Json::Value& response)
+    {
+      response["jsonrpc"] = "2.0";
+      response["id"] = root["id"];
+      response["result"] = "success";
+      return true;
+    }
+};
+
+/**
+ * \class BenchCallback
+ * \brief Count the responses and limit the outstanding calls.
+ */
+class BenchCallback : public Json::Rpc::AsyncCallback
+{
+  public:
+    /**
+     * \brief Constructor.
+     */
+    BenchCallback()
+    {
+      m_done = 0;
+      m_errors = 0;
+    }
+
+    /**
+     * \brief Count a response.
+     * \param response JSON-RPC response
+     */
+    virtual void Done(Json::Value& response)
+    {
+      m_mutex.Lock();
+      m_done++;
+      if(response.isMember("error"))
+      {
+        m_errors++;
+      }
+      m_cond.Signal();
+      m_mutex.Unlock();
+    }
+
+    /**
+     * \brief Wait until at most a number of calls are outstanding.
+     * \param sent number of calls sent
+     * \param outstanding number of outstanding calls to wait for
+     */
+    void WaitOutstanding(unsigned long sent, unsigned long outstanding)
+    {
+      m_mutex.Lock();
+      while(sent - m_done > outstanding)
+      {
+        m_cond.Wait(m_mutex);
+      }
+      m_mutex.Unlock();
+    }
+
+    /**
+     * \brief Get the number of error responses.
+     * \return number of errors
+     */
+    unsigned long GetErrors()
+    {
+      unsigned long ret = 0;
+
+      m_mutex.Lock();
+      ret = m_errors;
+      m_mutex.Unlock();
+
+      return ret;
+    }
+
+  private:
+    /**
+     * \brief Number of responses.
+     */
+    unsigned long m_done;
+
+    /**
+     * \brief Number of error responses.
+     */
+    unsigned long m_errors;
+
+    /**
+     * \brief Mutex to protect the counters.
+     */
+    system_util::Mutex m_mutex;
+
+    /**
+     * \brief Condition signaled for each response.
+     */
+    system_util::Condition m_cond;
+};
+
+/**
+ * \brief Run the benchmark for one pipelining depth.
+ * \param depth maximum number of outstanding calls
+ * \param iterations number of calls
+ * \param port TCP port to use
+ * \return true if success, false otherwise
+ */
+static bool bench_run(unsigned long depth, unsigned long iterations,
+    uint16_t port)
+{
+  Json::Rpc::ReactorGroup server(std::string("127.0.0.1"), port,
+      networking::TCP, 1, Json::Rpc::BACKEND_EPOLL);
+  Json::Rpc::AsyncClient client(std::string("127.0.0.1"), port);
+  BenchCallback callback;
+  BenchRpc obj;
+  unsigned long sent = 0;
+  uint64_t ns = 0;
+  bool ret = true;
+
+  server.AddMethod(new Json::Rpc::RpcMethod<BenchRpc>(obj, &BenchRpc::Print,
+        std::string("print")));
+
+  if(!server.Start() || !client.Connect())
+  {
+    fprintf(stderr, "Cannot start server or client on port %u\n", port);
+    server.Stop();
+    return false;
+  }
+
+  ns = bench_now();
+  while(sent < iterations)
+  {
+    callback.WaitOutstanding(sent, depth - 1);
+
+    if(!client.Call("print", Json::Value::null, callback))
+    {
+      ret = false;
+      break;
+    }
+    sent++;
+  }
+  callback.WaitOutstanding(sent, 0);
+  ns = bench_now() - ns;
+
+  ret = ret && callback.GetErrors() == 0;
+
+  if(ret)
+  {
+    bench_report("asyncclient.call", depth, iterations, ns);
+    printf("%-32s %10lu %12.0f calls/s\n", "asyncclient.call", depth,
+        (double)iterations * 1000000000.0 / (double)ns);
+  }
+
+  client.Close();
+  server.Stop();
+  return ret;
+}
+
+/**
+ * \brief Entry point of the program.
+ * \param argc number of argument
+ * \param argv array of arguments
+ * \return EXIT_SUCCESS or EXIT_FAILURE
+ */
+int main(int argc, char** argv)
+{
+  static const unsigned long depths[] = {1, 16, 256};
+  unsigned long iterations = 100000;
+  uint16_t port = 8086;
+
+  if(argc > 1)
+  {
+    iterations = strtoul(argv[1], NULL, 10);
+  }
+
+  if(argc > 2)
+  {
+    port = (uint16_t)atoi(argv[2]);
+  }
+
+  networking::init();
+
+  for(size_t d = 0 ; d < sizeof(depths) / sizeof(depths[0]) ; d++)
+  {
+    if(!bench_run(depths[d], iterations, port))
+    {
+      networking::cleanup();
+      return EXIT_FAILURE;
+    }
+  }
+
+  networking::cleanup();
+  return EXIT_SUCCESS;
+}
+
@@ -0,0 +1,137 @@
+/*
+ *  JsonRpc-Cpp - JSON-RPC implementation.
+ *  Copyright (C) 2008-2011 Sebastien Vincent <sebastien.vincent@cppextrem.com>
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**
+ * \file bench-common.h
+ * \brief Helpers shared by the benchmarks.
+ * \author Sebastien Vincent
+ */
+
+#ifndef BENCH_COMMON_H
+#define BENCH_COMMON_H
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#include <time.h>
+#include <stdint.h>
+
+/**
+ * \var g_bench_json
+ * \brief If the results are printed as JSON lines rather than as a table.
+ */
+static bool g_bench_json = false;
+
+/**
+ * \brief Get a monotonic timestamp.
+ * \return time in nanoseconds
+ */
+static inline uint64_t bench_now()
+{
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+/**
+ * \brief Print one benchmark result line.
+ * \param name name of the benchmark
+ * \param param parameter of the run (number of methods, connections, ...)
+ * \param iterations number of operations measured
+ * \param ns total time in nanoseconds
+ */
+static inline void bench_report(const char* name, unsigned long param,
+    unsigned long iterations, uint64_t ns)
+{
+  double nsPerOp = iterations ? (double)ns / (double)iterations : 0.0;
+
+  if(g_bench_json)
+  {
+    printf("{\"name\":\"%s\",\"param\":%lu,\"ops\":%lu,"
+        "\"ns_per_op\":%.1f}\n", name, param, iterations, nsPerOp);
+    return;
+  }
+
+  printf("%-32s %10lu %12lu ops %12.1f ns/op\n", name, param, iterations,
+      nsPerOp);
+}
+
+/**
+ * \brief Print one benchmark result line with the heap usage.
+ * \param name name of the benchmark
+ * \param param parameter of the run (number of elements, bytes, ...)
+ * \param iterations number of operations measured
+ * \param ns total time in nanoseconds
+ * \param allocs number of allocations made by the operations
+ * \param bytes number of bytes allocated by the operations
+ */
+static inline void bench_report_allocs(const char* name, unsigned long param,
+    unsigned long iterations, uint64_t ns, unsigned long allocs,
+    unsigned long bytes)
+{
+  double count = iterations ? (double)iterations : 1.0;
+
+  if(g_bench_json)
+  {
+    printf("{\"name\":\"%s\",\"param\":%lu,\"ops\":%lu,"
+        "\"ns_per_op\":%.1f,\"allocs_per_op\":%.2f,"
+        "\"bytes_per_op\":%.1f}\n", name, param, iterations,
+        (double)ns / count, (double)allocs / count, (double)bytes / count);
+    return;
+  }
+
+  printf("%-32s %10lu %12lu ops %12.1f ns/op %10.2f allocs/op "
+      "%12.1f bytes/op\n", name, param, iterations, (double)ns / count,
+      (double)allocs / count, (double)bytes / count);
+}
+
+/**
+ * \brief Parse the common command line of the benchmarks:
+ * "[--json] [iterations]".
+ * \param argc number of argument
+ * \param argv array of arguments
+ * \param iterations number of iterations, unchanged if not given
+ * \return true if success, false if an argument is unknown
+ */
+static inline bool bench_parse_args(int argc, char** argv,
+    unsigned long* iterations)
+{
+  for(int i = 1 ; i < argc ; i++)
+  {
+    if(strcmp(argv[i], "--json") == 0)
+    {
+      g_bench_json = true;
+    }
+    else if(argv[i][0] >= '0' && argv[i][0] <= '9')
+    {
+      *iterations = strtoul(argv[i], NULL, 10);
+    }
+    else
+    {
+      fprintf(stderr, "Usage: %s [--json] [iterations]\n", argv[0]);
+      return false;
+    }
+  }
+
+  return true;
+}
+
+#endif /* BENCH_COMMON_H */
+
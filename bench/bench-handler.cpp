@@ -0,0 +1,116 @@
+/*
+ *  JsonRpc-Cpp - JSON-RPC implementation.
+ *  Copyright (C) 2008-2011 Sebastien Vincent <sebastien.vincent@cppextrem.com>
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**
+ * \file bench-handler.cpp
+ * \brief Handler method lookup benchmark.
+ *
+ * Dispatch a small request to a method while the number of registered
+ * methods grows from 10 to 10000. The cost per call should stay flat.
+ * \author Sebastien Vincent
+ */
+
+#include <cstdio>
+#include <cstdlib>
+
+#include "jsonrpc.h"
+
+#include "bench-common.h"
+
+/**
+ * \class BenchRpc
+ * \brief RPC methods used by the benchmark.
+ */
+class BenchRpc
+{
+  public:
+    /**
+     * \brief Reply with an empty result.
+     * \param root JSON-RPC request
+     * \param response JSON-RPC response
+     * \return true
+     */
+    bool Nop(const Json::Value& root, Json::Value& response)
+    {
+      response["jsonrpc"] = "2.0";
+      response["id"] = root["id"];
+      response["result"] = Json::Value::null;
+      return true;
+    }
+};
+
+/**
+ * \brief Entry point of the program.
+ * \param argc number of argument
+ * \param argv array of arguments
+ * \return EXIT_SUCCESS or EXIT_FAILURE
+ */
+int main(int argc, char** argv)
+{
+  static const unsigned long counts[] = {10, 100, 1000, 10000};
+  unsigned long iterations = 200000;
+  BenchRpc obj;
+
+  if(!bench_parse_args(argc, argv, &iterations))
+  {
+    return EXIT_FAILURE;
+  }
+
+  for(size_t c = 0 ; c < sizeof(counts) / sizeof(counts[0]) ; c++)
+  {
+    Json::Rpc::Handler handler;
+    Json::Value response;
+    char name[64];
+    std::string first;
+    std::string last;
+    uint64_t start = 0;
+
+    for(unsigned long i = 0 ; i < counts[c] ; i++)
+    {
+      snprintf(name, sizeof(name), "bench.method%lu", i);
+      handler.AddMethod(new Json::Rpc::RpcMethod<BenchRpc>(obj,
+            &BenchRpc::Nop, std::string(name)));
+    }
+
+    first = "{\"jsonrpc\":\"2.0\",\"id\":1,\"method\":\"bench.method0\"}";
+    snprintf(name, sizeof(name), "bench.method%lu", counts[c] - 1);
+    last = std::string("{\"jsonrpc\":\"2.0\",\"id\":1,\"method\":\"") +
+      name + "\"}";
+
+    /* first registered method was the best case of the linear lookup */
+    start = bench_now();
+    for(unsigned long i = 0 ; i < iterations ; i++)
+    {
+      handler.Process(first, response);
+    }
+    bench_report("handler.lookup.first", counts[c], iterations,
+        bench_now() - start);
+
+    /* last registered method was the worst case */
+    start = bench_now();
+    for(unsigned long i = 0 ; i < iterations ; i++)
+    {
+      handler.Process(last, response);
+    }
+    bench_report("handler.lookup.last", counts[c], iterations,
+        bench_now() - start);
+  }
+
+  return EXIT_SUCCESS;
+}
+
@@ -0,0 +1,209 @@
+/*
+ *  JsonRpc-Cpp - JSON-RPC implementation.
+ *  Copyright (C) 2008-2011 Sebastien Vincent <sebastien.vincent@cppextrem.com>
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**
+ * \file bench-httpserver.cpp
+ * \brief HttpServer against TcpServer RAW benchmark.
+ *
+ * One connection on loopback sends "depth" pipelined calls at once and
+ * waits for all the responses, with the TcpServer in RAW format then with
+ * the HttpServer (HTTP/1.1 keep-alive POST). The time is reported per
+ * call, it includes the client side framing.
+ * \author Sebastien Vincent
+ */
+
+#include <cstdio>
+#include <cstdlib>
+
+#include "jsonrpc.h"
+#include "http.h"
+
+#include "bench-common.h"
+
+/**
+ * \class BenchRpc
+ * \brief RPC methods used by the benchmark.
+ */
+class BenchRpc
+{
+  public:
+    /**
+     * \brief Reply with success.
+     * \param root JSON-RPC request
+     * \param response JSON-RPC response
+     * \return true
+     */
+    bool Print(const Json::Value& root, Json::Value& response)
+    {
+      response["jsonrpc"] = "2.0";
+      response["id"] = root["id"];
+      response["result"] = "success";
+      return true;
+    }
+};
+
+/**
+ * \brief Run the benchmark for one server and pipeline depth.
+ * \param server TcpServer or HttpServer, not bound yet
+ * \param depth number of calls sent at once
+ * \param iterations number of calls to measure
+ * \param port TCP port to use
+ * \return true if success, false otherwise
+ */
+static bool bench_run(Json::Rpc::TcpServer& server, unsigned long depth,
+    unsigned long iterations, uint16_t port)
+{
+  const std::string call = "{\"jsonrpc\":\"2.0\",\"method\":\"print\",\"id\":1}";
+  enum Json::Rpc::EncapsulatedFormat format = server.GetEncapsulatedFormat();
+  Json::Rpc::Framer framer(format);
+  std::string batch;
+  BenchRpc obj;
+  unsigned long done = 0;
+  uint64_t start = 0;
+  bool ret = true;
+  int sock = -1;
+
+  server.AddMethod(new Json::Rpc::RpcMethod<BenchRpc>(obj, &BenchRpc::Print,
+        std::string("print")));
+
+  if(!server.Bind() || !server.Listen())
+  {
+    fprintf(stderr, "Cannot listen on port %u\n", port);
+    return false;
+  }
+
+  sock = networking::connect(networking::TCP, "127.0.0.1", port, NULL, NULL);
+
+  if(sock == -1)
+  {
+    fprintf(stderr, "Cannot connect\n");
+    server.Close();
+    return false;
+  }
+
+  server.WaitMessage(1000);
+
+  for(unsigned long i = 0 ; i < depth ; i++)
+  {
+    if(format == Json::Rpc::HTTP_POST)
+    {
+      batch += http::encodeRequestHeader("127.0.0.1", call.length());
+    }
+    batch += call;
+  }
+
+  start = bench_now();
+  while(ret && done < iterations)
+  {
+    unsigned long pending = depth;
+
+    if(::send(sock, batch.data(), batch.length(), 0) != (ssize_t)batch.length())
+    {
+      ret = false;
+      break;
+    }
+
+    /* the server answers in WaitMessage(), the client reads right after */
+    while(pending > 0)
+    {
+      const char* data = NULL;
+      size_t size = 0;
+      ssize_t nb = 0;
+
+      server.WaitMessage(1000);
+
+      while((nb = ::recv(sock, framer.Prepare(4096), 4096, MSG_DONTWAIT)) > 0)
+      {
+        framer.Commit(nb);
+      }
+
+      while(pending > 0 && framer.Next(data, size) == 1)
+      {
+        pending--;
+      }
+
+      if(nb == 0)
+      {
+        fprintf(stderr, "Connection closed by the server\n");
+        ret = false;
+        break;
+      }
+    }
+
+    done += depth;
+  }
+
+  bench_report(format == Json::Rpc::HTTP_POST ? "httpserver.pipeline.http" :
+      "httpserver.pipeline.raw", depth, done, bench_now() - start);
+
+  ::close(sock);
+  server.Close();
+
+  return ret;
+}
+
+/**
+ * \brief Entry point of the program.
+ * \param argc number of argument
+ * \param argv array of arguments
+ * \return EXIT_SUCCESS or EXIT_FAILURE
+ */
+int main(int argc, char** argv)
+{
+  static const unsigned long depths[] = {1, 8, 64};
+  unsigned long iterations = 20000;
+  uint16_t port = 8089;
+
+  if(argc > 1)
+  {
+    iterations = strtoul(argv[1], NULL, 10);
+  }
+
+  if(argc > 2)
+  {
+    port = (uint16_t)atoi(argv[2]);
+  }
+
+  networking::init();
+
+  for(size_t d = 0 ; d < sizeof(depths) / sizeof(depths[0]) ; d++)
+  {
+    bool ret = false;
+
+    /* listen socket is only closed by the server destructor */
+    {
+      Json::Rpc::TcpServer tcpServer(std::string("127.0.0.1"), port);
+      ret = bench_run(tcpServer, depths[d], iterations, port);
+    }
+
+    if(ret)
+    {
+      Json::Rpc::HttpServer httpServer(std::string("127.0.0.1"), port);
+      ret = bench_run(httpServer, depths[d], iterations, port);
+    }
+
+    if(!ret)
+    {
+      networking::cleanup();
+      return EXIT_FAILURE;
+    }
+  }
+
+  networking::cleanup();
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,123 @@
+/*
+ *  JsonRpc-Cpp - JSON-RPC implementation.
+ *  Copyright (C) 2008-2011 Sebastien Vincent <sebastien.vincent@cppextrem.com>
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+/**
+ * \file bench-malloc.h
+ * \brief Heap allocation counters of the benchmarks.
+ *
+ * It replaces the allocation functions of the program, so it is included
+ * by one file of a single-threaded benchmark only.
+ * \author Sebastien Vincent
+ */
+
+#ifndef BENCH_MALLOC_H
+#define BENCH_MALLOC_H
+
+#include <cstdlib>
+#include <new>
+
+/**
+ * \var g_allocs
+ * \brief Number of allocations since the start of the program.
+ */
+static unsigned long g_allocs = 0;
+
+/**
+ * \var g_frees
+ * \brief Number of deallocations since the start of the program.
+ */
+static unsigned long g_frees = 0;
+
+/**
+ * \var g_bytes
+ * \brief Number of bytes allocated since the start of the program.
+ */
+static unsigned long g_bytes = 0;
+
+#ifdef __GLIBC__
+/* count malloc() as jsoncpp duplicates strings with it, operator new
+ * relies on malloc() too
+ */
+extern "C"
+{
+  extern void* __libc_malloc(size_t size);
+  extern void* __libc_calloc(size_t nmemb, size_t size);
+  extern void* __libc_realloc(void* ptr, size_t size);
+  extern void __libc_free(void* ptr);
+
+  void* malloc(size_t size)
+  {
+    g_allocs++;
+    g_bytes += size;
+    return __libc_malloc(size);
+  }
+
+  void* calloc(size_t nmemb, size_t size)
+  {
+    g_allocs++;
+    g_bytes += nmemb * size;
+    return __libc_calloc(nmemb, size);
+  }
+
+  void* realloc(void* ptr, size_t size)
+  {
+    if(!ptr)
+    {
+      g_allocs++;
+    }
+    g_bytes += size;
+    return __libc_realloc(ptr, size);
+  }
+
+  void free(void* ptr)
+  {
+    if(ptr)
+    {
+      g_frees++;
+    }
+    __libc_free(ptr);
+  }
+}
+#else
+void* operator new(size_t size) throw(std::bad_alloc)
+{
+  void* ptr = std::malloc(size ? size : 1);
+
+  if(!ptr)
+  {
+    throw std::bad_alloc();
+  }
+
+  g_allocs++;
+  g_bytes += size;
+  return ptr;
+}
+
+void operator delete(void* ptr) throw()
+{
+  if(ptr)
+  {
+    g_frees++;
+  }
+  std::free(ptr);
+}
+#endif
+
+#endif /* BENCH_MALLOC_H */
+
@@ -0,0 +1,507 @@
+/*
+ *  JsonRpc-Cpp - JSON-RPC implementation.
+ *  Copyright (C) 2008-2011 Sebastien Vincent <sebastien.vincent@cppextrem.com>
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+/**
+ * \file bench-process.cpp
+ * \brief Handler::Process, netstring and GetString benchmark suite.
+ *
+ * Measure the time, heap allocations and allocated bytes of one operation
+ * for single requests, notifications, batches of 10 to 1000 calls, error
+ * responses and small or 100 KB parameters. The "param" column is the
+ * number of batch elements or the payload size in bytes.
+ * With "--json" each result is printed as a JSON object on its own line,
+ * to be compared from a release to another.
+ * \author Sebastien Vincent
+ */
+
+#include <cstdio>
+#include <cstdlib>
+
+#include "jsonrpc.h"
+#include "netstring.h"
+
+#include "bench-common.h"
+#include "bench-malloc.h"
+
+/**
+ * \var BENCH_SMALL_SIZE
+ * \brief Size of the small payloads.
+ */
+static const size_t BENCH_SMALL_SIZE = 16;
+
+/**
+ * \var BENCH_BIG_SIZE
+ * \brief Size of the big payloads.
+ */
+static const size_t BENCH_BIG_SIZE = 100 * 1024;
+
+/**
+ * \class BenchRpc
+ * \brief RPC methods used by the benchmark.
+ */
+class BenchRpc
+{
+  public:
+    /**
+     * \brief Reply with success.
+     * \param root JSON-RPC request
+     * \param response JSON-RPC response
+     * \return true
+     */
+    bool Print(const Json::Value& root, Json::Value& response)
+    {
+      response["jsonrpc"] = "2.0";
+      response["id"] = root["id"];
+      response["result"] = "success";
+      return true;
+    }
+
+    /**
+     * \brief Reply with the parameters.
+     * \param root JSON-RPC request
+     * \param response JSON-RPC response
+     * \return true
+     */
+    bool Echo(const Json::Value& root, Json::Value& response)
+    {
+      response["jsonrpc"] = "2.0";
+      response["id"] = root["id"];
+      response["result"] = root["params"];
+      return true;
+    }
+
+    /**
+     * \brief Notification that does nothing.
+     * \param root JSON-RPC request
+     * \param response JSON-RPC response
+     * \return true
+     */
+    bool Notify(const Json::Value& root, Json::Value& response)
+    {
+      (void)root;
+      response = Json::Value::null;
+      return true;
+    }
+
+    /**
+     * \brief Method that fails.
+     * \param root JSON-RPC request
+     * \param response JSON-RPC response
+     * \return false
+     */
+    bool Fail(const Json::Value& root, Json::Value& response)
+    {
+      (void)root;
+      (void)response;
+      return false;
+    }
+};
+
+/**
+ * \class BenchCase
+ * \brief Operation measured by bench_run().
+ */
+class BenchCase
+{
+  public:
+    /**
+     * \brief Destructor.
+     */
+    virtual ~BenchCase()
+    {
+    }
+
+    /**
+     * \brief Do the operation once.
+     */
+    virtual void Run() = 0;
+};
+
+/**
+ * \class ProcessCase
+ * \brief Handler::Process() of a message.
+ */
+class ProcessCase : public BenchCase
+{
+  public:
+    /**
+     * \brief Constructor.
+     * \param handler handler to use
+     * \param msg JSON-RPC message
+     */
+    ProcessCase(Json::Rpc::Handler& handler, const std::string& msg)
+      : m_handler(handler), m_msg(msg)
+    {
+    }
+
+    /**
+     * \brief Process the message.
+     */
+    virtual void Run()
+    {
+      Json::Value response;
+
+      m_handler.Process(m_msg, response);
+    }
+
+  private:
+    /**
+     * \brief Handler.
+     */
+    Json::Rpc::Handler& m_handler;
+
+    /**
+     * \brief JSON-RPC message.
+     */
+    const std::string& m_msg;
+};
+
+/**
+ * \class GetStringCase
+ * \brief Handler::GetString() of a response.
+ */
+class GetStringCase : public BenchCase
+{
+  public:
+    /**
+     * \brief Constructor.
+     * \param handler handler to use
+     * \param value JSON value to serialize
+     */
+    GetStringCase(Json::Rpc::Handler& handler, const Json::Value& value)
+      : m_handler(handler), m_value(value)
+    {
+    }
+
+    /**
+     * \brief Serialize the value.
+     */
+    virtual void Run()
+    {
+      m_handler.GetString(m_value);
+    }
+
+  private:
+    /**
+     * \brief Handler.
+     */
+    Json::Rpc::Handler& m_handler;
+
+    /**
+     * \brief JSON value.
+     */
+    const Json::Value& m_value;
+};
+
+/**
+ * \class EncodeCase
+ * \brief netstring::encode() of a payload.
+ */
+class EncodeCase : public BenchCase
+{
+  public:
+    /**
+     * \brief Constructor.
+     * \param payload payload to encode
+     */
+    EncodeCase(const std::string& payload) : m_payload(payload)
+    {
+    }
+
+    /**
+     * \brief Encode the payload.
+     */
+    virtual void Run()
+    {
+      netstring::encode(m_payload);
+    }
+
+  private:
+    /**
+     * \brief Payload.
+     */
+    const std::string& m_payload;
+};
+
+/**
+ * \class DecodeCase
+ * \brief netstring::decode() of a netstring.
+ */
+class DecodeCase : public BenchCase
+{
+  public:
+    /**
+     * \brief Constructor.
+     * \param netstr netstring to decode
+     */
+    DecodeCase(const std::string& netstr) : m_netstr(netstr)
+    {
+    }
+
+    /**
+     * \brief Decode the netstring.
+     */
+    virtual void Run()
+    {
+      netstring::decode(m_netstr);
+    }
+
+  private:
+    /**
+     * \brief Netstring.
+     */
+    const std::string& m_netstr;
+};
+
+/**
+ * \class DecoderCase
+ * \brief netstring::Decoder of a stream, as the transports receive it.
+ */
+class DecoderCase : public BenchCase
+{
+  public:
+    /**
+     * \brief Constructor.
+     * \param netstr netstring received
+     */
+    DecoderCase(const std::string& netstr) : m_netstr(netstr)
+    {
+    }
+
+    /**
+     * \brief Append the netstring and get its payload.
+     */
+    virtual void Run()
+    {
+      const char* data = NULL;
+      size_t size = 0;
+
+      m_decoder.Feed(m_netstr.data(), m_netstr.length());
+      m_decoder.Next(data, size);
+    }
+
+  private:
+    /**
+     * \brief Netstring.
+     */
+    const std::string& m_netstr;
+
+    /**
+     * \brief Decoder, its buffer is reused.
+     */
+    netstring::Decoder m_decoder;
+};
+
+/**
+ * \brief Measure an operation.
+ * \param name name of the benchmark
+ * \param param parameter of the run
+ * \param iterations number of operations to measure
+ * \param op operation
+ */
+static void bench_run(const char* name, unsigned long param,
+    unsigned long iterations, BenchCase& op)
+{
+  unsigned long allocs = 0;
+  unsigned long bytes = 0;
+  uint64_t start = 0;
+  uint64_t ns = 0;
+
+  if(iterations == 0)
+  {
+    iterations = 1;
+  }
+
+  /* warm up, the buffers reused from a call to another are allocated */
+  for(unsigned long i = 0 ; i < 100 && i < iterations ; i++)
+  {
+    op.Run();
+  }
+
+  allocs = g_allocs;
+  bytes = g_bytes;
+  start = bench_now();
+
+  for(unsigned long i = 0 ; i < iterations ; i++)
+  {
+    op.Run();
+  }
+
+  ns = bench_now() - start;
+  bench_report_allocs(name, param, iterations, ns, g_allocs - allocs,
+      g_bytes - bytes);
+}
+
+/**
+ * \brief Build a request.
+ * \param method name of the method
+ * \param id id of the request ("" for a notification)
+ * \param params serialized parameters ("" if none)
+ * \return serialized request
+ */
+static std::string bench_request(const std::string& method,
+    const std::string& id, const std::string& params)
+{
+  std::string ret = "{\"jsonrpc\":\"2.0\",\"method\":\"" + method + "\"";
+
+  if(!id.empty())
+  {
+    ret += ",\"id\":" + id;
+  }
+
+  if(!params.empty())
+  {
+    ret += ",\"params\":" + params;
+  }
+
+  return ret + "}";
+}
+
+/**
+ * \brief Build a batch of requests.
+ * \param size number of requests
+ * \return serialized batch
+ */
+static std::string bench_batch(size_t size)
+{
+  std::string ret = "[";
+
+  for(size_t i = 0 ; i < size ; i++)
+  {
+    ret += i ? "," : "";
+    ret += bench_request("print", "1", "");
+  }
+
+  return ret + "]";
+}
+
+/**
+ * \brief Entry point of the program.
+ * \param argc number of argument
+ * \param argv array of arguments
+ * \return EXIT_SUCCESS or EXIT_FAILURE
+ */
+int main(int argc, char** argv)
+{
+  static const size_t batches[] = {10, 100, 1000};
+  static const size_t sizes[] = {BENCH_SMALL_SIZE, BENCH_BIG_SIZE};
+  Json::Rpc::Handler handler;
+  BenchRpc obj;
+  unsigned long iterations = 100000;
+  std::string msg;
+
+  if(!bench_parse_args(argc, argv, &iterations))
+  {
+    return EXIT_FAILURE;
+  }
+
+  handler.AddMethod(new Json::Rpc::RpcMethod<BenchRpc>(obj, &BenchRpc::Print,
+        std::string("print")));
+  handler.AddMethod(new Json::Rpc::RpcMethod<BenchRpc>(obj, &BenchRpc::Echo,
+        std::string("echo")));
+  handler.AddMethod(new Json::Rpc::RpcMethod<BenchRpc>(obj, &BenchRpc::Notify,
+        std::string("notify")));
+  handler.AddMethod(new Json::Rpc::RpcMethod<BenchRpc>(obj, &BenchRpc::Fail,
+        std::string("fail")));
+
+  msg = bench_request("print", "1", "");
+  {
+    ProcessCase op(handler, msg);
+    bench_run("handler.process.request", 0, iterations, op);
+  }
+
+  msg = bench_request("notify", "", "");
+  {
+    ProcessCase op(handler, msg);
+    bench_run("handler.process.notification", 0, iterations, op);
+  }
+
+  for(size_t i = 0 ; i < sizeof(batches) / sizeof(batches[0]) ; i++)
+  {
+    msg = bench_batch(batches[i]);
+    ProcessCase op(handler, msg);
+    bench_run("handler.process.batch", batches[i], iterations / batches[i],
+        op);
+  }
+
+  /* error paths */
+  msg = bench_request("unknown", "1", "");
+  {
+    ProcessCase op(handler, msg);
+    bench_run("handler.process.notfound", 0, iterations, op);
+  }
+
+  msg = bench_request("fail", "1", "");
+  {
+    ProcessCase op(handler, msg);
+    bench_run("handler.process.failed", 0, iterations, op);
+  }
+
+  msg = "{\"jsonrpc\":\"1.0\",\"method\":\"print\",\"id\":1}";
+  {
+    ProcessCase op(handler, msg);
+    bench_run("handler.process.invalid", 0, iterations, op);
+  }
+
+  msg = "{\"jsonrpc\":\"2.0\",\"method\":";
+  {
+    ProcessCase op(handler, msg);
+    bench_run("handler.process.parseerror", 0, iterations, op);
+  }
+
+  /* small and big payloads, big ones run less */
+  for(size_t i = 0 ; i < sizeof(sizes) / sizeof(sizes[0]) ; i++)
+  {
+    unsigned long count = sizes[i] > BENCH_SMALL_SIZE ? iterations / 100 :
+      iterations;
+    std::string payload(sizes[i], 'a');
+    std::string netstr = netstring::encode(payload);
+    Json::Value response;
+
+    msg = bench_request("echo", "1", "[\"" + payload + "\"]");
+    handler.Process(msg, response);
+
+    {
+      ProcessCase op(handler, msg);
+      bench_run("handler.process.params", sizes[i], count, op);
+    }
+
+    {
+      GetStringCase op(handler, response);
+      bench_run("handler.getstring", sizes[i], count, op);
+    }
+
+    {
+      EncodeCase op(payload);
+      bench_run("netstring.encode", sizes[i], count, op);
+    }
+
+    {
+      DecodeCase op(netstr);
+      bench_run("netstring.decode", sizes[i], count, op);
+    }
+
+    {
+      DecoderCase op(netstr);
+      bench_run("netstring.decoder", sizes[i], count, op);
+    }
+  }
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,230 @@
+/*
+ *  JsonRpc-Cpp - JSON-RPC implementation.
+ *  Copyright (C) 2008-2011 Sebastien Vincent <sebastien.vincent@cppextrem.com>
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**
+ * \file bench-reactorgroup.cpp
+ * \brief ReactorGroup scaling benchmark.
+ *
+ * Run a TCP ReactorGroup with 1 to 16 reactor threads and as many client
+ * threads, each client doing request/response round trips on its own
+ * connection. The time is reported per request for the whole group.
+ * \author Sebastien Vincent
+ */
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+#include "jsonrpc.h"
+
+#include "bench-common.h"
+
+/**
+ * \var CLIENTS
+ * \brief Number of client threads.
+ */
+static const unsigned long CLIENTS = 16;
+
+/**
+ * \class BenchRpc
+ * \brief RPC methods used by the benchmark.
+ */
+class BenchRpc
+{
+  public:
+    /**
+     * \brief Reply with success.
+     * \param root JSON-RPC request
+     * \param response JSON-RPC response
+     * \return true
+     */
+    bool Print(const Json::Value& root, Json::Value& response)
+    {
+      response["jsonrpc"] = "2.0";
+      response["id"] = root["id"];
+      response["result"] = "success";
+      return true;
+    }
+};
+
+/**
+ * \class BenchClient
+ * \brief Client thread doing round trips.
+ */
+class BenchClient
+{
+  public:
+    /**
+     * \brief Constructor.
+     * \param port server port
+     * \param iterations number of round trips
+     */
+    BenchClient(uint16_t port, unsigned long iterations)
+    {
+      m_port = port;
+      m_iterations = iterations;
+      m_success = false;
+    }
+
+    /**
+     * \brief Thread entry point.
+     * \param arg unused
+     * \return NULL
+     */
+    void* Run(void* arg)
+    {
+      const std::string msg = "{\"jsonrpc\":\"2.0\",\"method\":\"print\",\"id\":1}";
+      char buf[1024];
+      int sock = networking::connect(networking::TCP, "127.0.0.1", m_port,
+          NULL, NULL);
+
+      (void)arg;
+
+      if(sock == -1)
+      {
+        return NULL;
+      }
+
+      for(unsigned long i = 0 ; i < m_iterations ; i++)
+      {
+        /* response is small enough to come in one segment */
+        if(::send(sock, msg.c_str(), msg.length(), 0) != (ssize_t)msg.length() ||
+            ::recv(sock, buf, sizeof(buf), 0) <= 0)
+        {
+          ::close(sock);
+          return NULL;
+        }
+      }
+
+      ::close(sock);
+      m_success = true;
+      return NULL;
+    }
+
+    /**
+     * \brief Server port.
+     */
+    uint16_t m_port;
+
+    /**
+     * \brief Number of round trips.
+     */
+    unsigned long m_iterations;
+
+    /**
+     * \brief If all round trips succeeded.
+     */
+    bool m_success;
+};
+
+/**
+ * \brief Run the benchmark for one number of reactors.
+ * \param reactors number of reactor threads
+ * \param iterations number of round trips per client
+ * \param port TCP port to use
+ * \return true if success, false otherwise
+ */
+static bool bench_run(unsigned long reactors, unsigned long iterations,
+    uint16_t port)
+{
+  Json::Rpc::ReactorGroup group(std::string("127.0.0.1"), port,
+      networking::TCP, reactors, Json::Rpc::BACKEND_EPOLL);
+  std::vector<BenchClient*> clients;
+  std::vector<system_util::Thread*> threads;
+  BenchRpc obj;
+  uint64_t start = 0;
+  bool ret = true;
+
+  group.AddMethod(new Json::Rpc::RpcMethod<BenchRpc>(obj, &BenchRpc::Print,
+        std::string("print")));
+
+  if(!group.Start())
+  {
+    fprintf(stderr, "Cannot start %lu reactors on port %u\n", reactors, port);
+    return false;
+  }
+
+  start = bench_now();
+  for(unsigned long i = 0 ; i < CLIENTS ; i++)
+  {
+    BenchClient* client = new BenchClient(port, iterations);
+    system_util::Thread* th = new system_util::Thread(
+        new system_util::ThreadArgImpl<BenchClient>(*client, &BenchClient::Run,
+          NULL));
+
+    clients.push_back(client);
+    threads.push_back(th);
+    th->Start(false);
+  }
+
+  for(unsigned long i = 0 ; i < CLIENTS ; i++)
+  {
+    threads[i]->Join();
+    ret = ret && clients[i]->m_success;
+    delete threads[i];
+    delete clients[i];
+  }
+
+  if(ret)
+  {
+    bench_report("reactorgroup.tcp.roundtrip", reactors, CLIENTS * iterations,
+        bench_now() - start);
+  }
+
+  group.Stop();
+  return ret;
+}
+
+/**
+ * \brief Entry point of the program.
+ * \param argc number of argument
+ * \param argv array of arguments
+ * \return EXIT_SUCCESS or EXIT_FAILURE
+ */
+int main(int argc, char** argv)
+{
+  static const unsigned long counts[] = {1, 2, 4, 8, 16};
+  unsigned long iterations = 5000;
+  uint16_t port = 8086;
+
+  if(argc > 1)
+  {
+    iterations = strtoul(argv[1], NULL, 10);
+  }
+
+  if(argc > 2)
+  {
+    port = (uint16_t)atoi(argv[2]);
+  }
+
+  networking::init();
+
+  for(size_t c = 0 ; c < sizeof(counts) / sizeof(counts[0]) ; c++)
+  {
+    if(!bench_run(counts[c], iterations, port))
+    {
+      networking::cleanup();
+      return EXIT_FAILURE;
+    }
+  }
+
+  networking::cleanup();
+  return EXIT_SUCCESS;
+}
+
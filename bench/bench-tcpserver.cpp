@@ -0,0 +1,185 @@
+/*
+ *  JsonRpc-Cpp - JSON-RPC implementation.
+ *  Copyright (C) 2008-2011 Sebastien Vincent <sebastien.vincent@cppextrem.com>
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**
+ * \file bench-tcpserver.cpp
+ * \brief TcpServer wakeup cost benchmark.
+ *
+ * Open N idle connections on loopback, then measure the cost of
+ * TcpServer::WaitMessage when a single connection sends a notification,
+ * for both poll and epoll backends.
+ * \author Sebastien Vincent
+ */
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+#include <sys/resource.h>
+
+#include "jsonrpc.h"
+
+#include "bench-common.h"
+
+/**
+ * \class BenchRpc
+ * \brief RPC methods used by the benchmark.
+ */
+class BenchRpc
+{
+  public:
+    /**
+     * \brief Notification that does nothing.
+     * \param root JSON-RPC request
+     * \param response JSON-RPC response
+     * \return true
+     */
+    bool Notify(const Json::Value& root, Json::Value& response)
+    {
+      (void)root;
+      response = Json::Value::null;
+      return true;
+    }
+};
+
+/**
+ * \brief Run the benchmark for one backend and number of connections.
+ * \param backend backend to use
+ * \param connections number of idle connections
+ * \param iterations number of wakeups to measure
+ * \param port TCP port to use
+ * \return true if success, false otherwise
+ */
+static bool bench_run(enum Json::Rpc::EventBackend backend,
+    unsigned long connections, unsigned long iterations, uint16_t port)
+{
+  const std::string msg = "{\"jsonrpc\":\"2.0\",\"method\":\"notify\"}";
+  Json::Rpc::TcpServer server(std::string("127.0.0.1"), port, backend);
+  std::vector<int> clients;
+  BenchRpc obj;
+  uint64_t start = 0;
+  bool ret = true;
+
+  server.AddMethod(new Json::Rpc::RpcMethod<BenchRpc>(obj, &BenchRpc::Notify,
+        std::string("notify")));
+
+  if(!server.Bind() || !server.Listen())
+  {
+    fprintf(stderr, "Cannot listen on port %u\n", port);
+    return false;
+  }
+
+  /* one connection at a time as listen backlog is small */
+  for(unsigned long i = 0 ; i < connections ; i++)
+  {
+    int sock = networking::connect(networking::TCP, "127.0.0.1", port, NULL,
+        NULL);
+
+    if(sock == -1)
+    {
+      fprintf(stderr, "Cannot connect client %lu\n", i);
+      ret = false;
+      break;
+    }
+
+    clients.push_back(sock);
+    server.WaitMessage(1000);
+  }
+
+  if(ret && server.GetClients().size() == connections)
+  {
+    start = bench_now();
+    for(unsigned long i = 0 ; i < iterations ; i++)
+    {
+      /* only one connection is active, all the others are idle */
+      if(::send(clients[i % 2 ? 0 : clients.size() - 1], msg.c_str(),
+            msg.length(), 0) != (ssize_t)msg.length())
+      {
+        ret = false;
+        break;
+      }
+      server.WaitMessage(1000);
+    }
+    bench_report(backend == Json::Rpc::BACKEND_EPOLL ?
+        "tcpserver.wakeup.epoll" : "tcpserver.wakeup.poll",
+        connections, iterations, bench_now() - start);
+  }
+
+  for(size_t i = 0 ; i < clients.size() ; i++)
+  {
+    ::close(clients[i]);
+  }
+  server.Close();
+
+  return ret;
+}
+
+/**
+ * \brief Entry point of the program.
+ * \param argc number of argument
+ * \param argv array of arguments
+ * \return EXIT_SUCCESS or EXIT_FAILURE
+ */
+int main(int argc, char** argv)
+{
+  static const unsigned long counts[] = {100, 1000, 10000};
+  unsigned long iterations = 2000;
+  uint16_t port = 8086;
+  struct rlimit limit;
+
+  if(argc > 1)
+  {
+    iterations = strtoul(argv[1], NULL, 10);
+  }
+
+  if(argc > 2)
+  {
+    port = (uint16_t)atoi(argv[2]);
+  }
+
+  /* each connection needs two descriptors (client and server side) */
+  getrlimit(RLIMIT_NOFILE, &limit);
+  limit.rlim_cur = limit.rlim_max;
+  setrlimit(RLIMIT_NOFILE, &limit);
+
+  networking::init();
+
+  for(size_t c = 0 ; c < sizeof(counts) / sizeof(counts[0]) ; c++)
+  {
+    unsigned long connections = counts[c];
+
+    if(connections * 2 + 16 > limit.rlim_cur)
+    {
+      connections = (limit.rlim_cur - 16) / 2;
+      fprintf(stderr, "Descriptor limit: use %lu connections instead of %lu\n",
+          connections, counts[c]);
+    }
+
+    if(!bench_run(Json::Rpc::BACKEND_POLL, connections, iterations, port) ||
+        !bench_run(Json::Rpc::BACKEND_EPOLL, connections, iterations, port))
+    {
+      networking::cleanup();
+      return EXIT_FAILURE;
+    }
+  }
+
+  networking::cleanup();
+  return EXIT_SUCCESS;
+}
+
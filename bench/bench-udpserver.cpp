@@ -0,0 +1,208 @@
+/*
+ *  JsonRpc-Cpp - JSON-RPC implementation.
+ *  Copyright (C) 2008-2011 Sebastien Vincent <sebastien.vincent@cppextrem.com>
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**
+ * \file bench-udpserver.cpp
+ * \brief UdpServer datagram throughput benchmark.
+ *
+ * A client sends bursts of datagrams on loopback and the server processes
+ * them with one recvfrom()/sendto() per datagram or with batches of
+ * recvmmsg()/sendmmsg(). The cost is reported per datagram, for
+ * notifications and for requests (with a response).
+ * \author Sebastien Vincent
+ */
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#include "jsonrpc.h"
+
+#include "bench-common.h"
+
+/**
+ * \var BURST
+ * \brief Number of datagrams sent by the client before the server reads.
+ */
+static const unsigned long BURST = 64;
+
+/**
+ * \class BenchRpc
+ * \brief RPC methods used by the benchmark.
+ */
+class BenchRpc
+{
+  public:
+    /**
+     * \brief Constructor.
+     */
+    BenchRpc()
+    {
+      m_count = 0;
+    }
+
+    /**
+     * \brief Count the calls and reply if the request has an id.
+     * \param root JSON-RPC request
+     * \param response JSON-RPC response
+     * \return true
+     */
+    bool Count(const Json::Value& root, Json::Value& response)
+    {
+      m_count++;
+
+      if(root.isMember("id"))
+      {
+        response["jsonrpc"] = "2.0";
+        response["id"] = root["id"];
+        response["result"] = "success";
+      }
+      else
+      {
+        response = Json::Value::null;
+      }
+      return true;
+    }
+
+    /**
+     * \brief Number of calls.
+     */
+    unsigned long m_count;
+};
+
+/**
+ * \brief Run the benchmark for one batch size.
+ * \param batch batch size of the server
+ * \param reply true to send requests, false to send notifications
+ * \param iterations number of datagrams to measure
+ * \param port UDP port to use
+ * \return true if success, false otherwise
+ */
+static bool bench_run(unsigned long batch, bool reply,
+    unsigned long iterations, uint16_t port)
+{
+  const std::string msg = reply ?
+    "{\"jsonrpc\":\"2.0\",\"method\":\"count\",\"id\":1}" :
+    "{\"jsonrpc\":\"2.0\",\"method\":\"count\"}";
+  Json::Rpc::UdpServer server(std::string("127.0.0.1"), port);
+  struct sockaddr_storage addr;
+  socklen_t addrlen = sizeof(addr);
+  char buf[1500];
+  BenchRpc obj;
+  uint64_t start = 0;
+  unsigned long sent = 0;
+  int sock = -1;
+  bool ret = true;
+
+  server.AddMethod(new Json::Rpc::RpcMethod<BenchRpc>(obj, &BenchRpc::Count,
+        std::string("count")));
+
+  if(!server.Bind() || !server.SetBatchSize(batch))
+  {
+    fprintf(stderr, "Cannot bind port %u with batch %lu\n", port, batch);
+    return false;
+  }
+
+  sock = networking::connect(networking::UDP, "127.0.0.1", port, &addr,
+      &addrlen);
+
+  if(sock == -1)
+  {
+    fprintf(stderr, "Cannot create client\n");
+    server.Close();
+    return false;
+  }
+
+  start = bench_now();
+  while(ret && sent < iterations)
+  {
+    unsigned long burst = iterations - sent < BURST ? iterations - sent : BURST;
+
+    for(unsigned long i = 0 ; i < burst ; i++)
+    {
+      if(::sendto(sock, msg.c_str(), msg.length(), 0,
+            (struct sockaddr*)&addr, addrlen) != (ssize_t)msg.length())
+      {
+        ret = false;
+        break;
+      }
+    }
+
+    sent += burst;
+
+    while(ret && obj.m_count < sent)
+    {
+      ret = server.Recv(server.GetSocket());
+    }
+
+    for(unsigned long i = 0 ; ret && reply && i < burst ; i++)
+    {
+      ret = ::recv(sock, buf, sizeof(buf), 0) > 0;
+    }
+  }
+
+  if(ret)
+  {
+    bench_report(reply ? "udpserver.request" : "udpserver.notify", batch,
+        iterations, bench_now() - start);
+  }
+
+  ::close(sock);
+  server.Close();
+
+  return ret;
+}
+
+/**
+ * \brief Entry point of the program.
+ * \param argc number of argument
+ * \param argv array of arguments
+ * \return EXIT_SUCCESS or EXIT_FAILURE
+ */
+int main(int argc, char** argv)
+{
+  static const unsigned long batches[] = {1, 8, 64};
+  unsigned long iterations = 200000;
+  uint16_t port = 8086;
+
+  if(argc > 1)
+  {
+    iterations = strtoul(argv[1], NULL, 10);
+  }
+
+  if(argc > 2)
+  {
+    port = (uint16_t)atoi(argv[2]);
+  }
+
+  networking::init();
+
+  for(size_t b = 0 ; b < sizeof(batches) / sizeof(batches[0]) ; b++)
+  {
+    if(!bench_run(batches[b], false, iterations, port) ||
+        !bench_run(batches[b], true, iterations, port))
+    {
+      networking::cleanup();
+      return EXIT_FAILURE;
+    }
+  }
+
+  networking::cleanup();
+  return EXIT_SUCCESS;
+}
+
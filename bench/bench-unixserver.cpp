@@ -0,0 +1,233 @@
+/*
+ *  JsonRpc-Cpp - JSON-RPC implementation.
+ *  Copyright (C) 2008-2011 Sebastien Vincent <sebastien.vincent@cppextrem.com>
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+/**
+ * \file bench-unixserver.cpp
+ * \brief Unix domain socket against loopback TCP latency benchmark.
+ *
+ * A server process answers a client process call by call (no pipelining)
+ * over loopback TCP, a Unix stream socket, a Unix seqpacket socket and an
+ * abstract Unix socket. The mean time of a call is reported, then the
+ * median and the 99th percentile, for a small and a 4 KB parameter.
+ * \author Sebastien Vincent
+ */
+
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+#include <algorithm>
+
+#include <sys/wait.h>
+
+#include "jsonrpc.h"
+
+#include "bench-common.h"
+
+/**
+ * \class BenchRpc
+ * \brief RPC methods used by the benchmark.
+ */
+class BenchRpc
+{
+  public:
+    /**
+     * \brief Reply with success.
+     * \param root JSON-RPC request
+     * \param response JSON-RPC response
+     * \return true
+     */
+    bool Print(const Json::Value& root, Json::Value& response)
+    {
+      response["jsonrpc"] = "2.0";
+      response["id"] = root["id"];
+      response["result"] = "success";
+      return true;
+    }
+};
+
+/**
+ * \brief Serve one connection then exit (server process).
+ * \param server bound server
+ */
+static void bench_serve(Json::Rpc::TcpServer& server)
+{
+  /* wait for the client then until it disconnects */
+  for(int i = 0 ; i < 50 && server.GetClients().size() == 0 ; i++)
+  {
+    server.WaitMessage(100);
+  }
+
+  while(server.GetClients().size() > 0)
+  {
+    server.WaitMessage(1000);
+  }
+
+  /* the parent removes the socket file */
+  _exit(EXIT_SUCCESS);
+}
+
+/**
+ * \brief Run the benchmark for one transport and parameter size.
+ * \param name name of the benchmark
+ * \param server server, not bound yet
+ * \param client client of this server
+ * \param size size of the parameter
+ * \param iterations number of calls
+ * \return true if success, false otherwise
+ */
+static bool bench_run(const char* name, Json::Rpc::TcpServer& server,
+    Json::Rpc::TcpClient& client, unsigned long size,
+    unsigned long iterations)
+{
+  Json::FastWriter writer;
+  Json::Value request;
+  std::vector<uint64_t> times;
+  std::string msg;
+  std::string response;
+  BenchRpc obj;
+  uint64_t total = 0;
+  bool ret = true;
+  pid_t pid = -1;
+
+  server.AddMethod(new Json::Rpc::RpcMethod<BenchRpc>(obj, &BenchRpc::Print,
+        std::string("print")));
+
+  if(!server.Bind() || !server.Listen())
+  {
+    fprintf(stderr, "%s: cannot listen\n", name);
+    return false;
+  }
+
+  pid = fork();
+
+  if(pid == -1)
+  {
+    return false;
+  }
+  else if(pid == 0)
+  {
+    bench_serve(server);
+  }
+
+  request["jsonrpc"] = "2.0";
+  request["method"] = "print";
+  request["id"] = 1;
+  request["params"] = std::string(size, 'a');
+  msg = writer.write(request);
+  times.reserve(iterations);
+
+  if(!client.Connect())
+  {
+    fprintf(stderr, "%s: cannot connect\n", name);
+    ret = false;
+  }
+
+  for(unsigned long i = 0 ; ret && i < iterations ; i++)
+  {
+    uint64_t start = bench_now();
+
+    if(client.Send(msg) == -1 || client.Recv(response) <= 0)
+    {
+      ret = false;
+      break;
+    }
+
+    times.push_back(bench_now() - start);
+    total += times.back();
+  }
+
+  client.Close();
+  waitpid(pid, NULL, 0);
+
+  if(ret)
+  {
+    std::sort(times.begin(), times.end());
+    bench_report(name, size, iterations, total);
+    printf("%-32s %10lu %12llu p50 ns %10llu p99 ns\n", name, size,
+        (unsigned long long)times[times.size() / 2],
+        (unsigned long long)times[times.size() * 99 / 100]);
+  }
+
+  return ret;
+}
+
+/**
+ * \brief Entry point of the program.
+ * \param argc number of argument
+ * \param argv array of arguments
+ * \return EXIT_SUCCESS or EXIT_FAILURE
+ */
+int main(int argc, char** argv)
+{
+  static const unsigned long sizes[] = {16, 4096};
+  const std::string path = "/tmp/bench-unixserver.sock";
+  const std::string abstractPath = "@bench-unixserver";
+  unsigned long iterations = 20000;
+  uint16_t port = 8086;
+  bool ret = true;
+
+  if(argc > 1)
+  {
+    iterations = strtoul(argv[1], NULL, 10);
+  }
+
+  if(argc > 2)
+  {
+    port = (uint16_t)atoi(argv[2]);
+  }
+
+  networking::init();
+
+  for(size_t s = 0 ; ret && s < sizeof(sizes) / sizeof(sizes[0]) ; s++)
+  {
+    /* servers are destroyed between the runs to free the addresses */
+    {
+      Json::Rpc::TcpServer server(std::string("127.0.0.1"), port);
+      Json::Rpc::TcpClient client(std::string("127.0.0.1"), port);
+
+      ret = ret && bench_run("unixserver.call.tcp", server, client, sizes[s],
+          iterations);
+    }
+
+    {
+      Json::Rpc::UnixServer server(path);
+      Json::Rpc::UnixClient client(path);
+
+      ret = ret && bench_run("unixserver.call.stream", server, client,
+          sizes[s], iterations);
+    }
+
+    {
+      Json::Rpc::UnixServer server(path, networking::UNIX_SEQPACKET);
+      Json::Rpc::UnixClient client(path, networking::UNIX_SEQPACKET);
+
+      ret = ret && bench_run("unixserver.call.seqpacket", server, client,
+          sizes[s], iterations);
+    }
+
+    {
+      Json::Rpc::UnixServer server(abstractPath);
+      Json::Rpc::UnixClient client(abstractPath);
+
+      ret = ret && bench_run("unixserver.call.abstract", server, client,
+          sizes[s], iterations);
+    }
+  }
+
+  networking::cleanup();
+  return ret ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,328 @@
+/*
+ *  JsonRpc-Cpp - JSON-RPC implementation.
+ *  Copyright (C) 2008-2011 Sebastien Vincent <sebastien.vincent@cppextrem.com>
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**
+ * \file bench-uring.cpp
+ * \brief TcpServer backends throughput benchmark.
+ *
+ * Clients on loopback send batches of pipelined requests, the server runs
+ * its WaitMessage() loop in another thread. For each backend (poll, epoll,
+ * io_uring) it reports the time per request (the inverse of the request
+ * rate) and the CPU time used by the server thread per request.
+ * \author Sebastien Vincent
+ */
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+#include <time.h>
+
+#include "jsonrpc.h"
+
+#include "bench-common.h"
+
+/**
+ * \class BenchRpc
+ * \brief RPC methods used by the benchmark.
+ */
+class BenchRpc
+{
+  public:
+    /**
+     * \brief Reply with the parameters.
+     * \param root JSON-RPC request
+     * \param response JSON-RPC response
+     * \return true
+     */
+    bool Echo(const Json::Value& root, Json::Value& response)
+    {
+      response["jsonrpc"] = "2.0";
+      response["id"] = root["id"];
+      response["result"] = root["params"];
+      return true;
+    }
+};
+
+/**
+ * \class BenchLoop
+ * \brief Run a server in another thread and measure its CPU time.
+ */
+class BenchLoop
+{
+  public:
+    /**
+     * \brief Constructor.
+     * \param server server
+     */
+    BenchLoop(Json::Rpc::TcpServer& server) : m_server(server)
+    {
+      m_stop = false;
+      m_cpu = 0;
+    }
+
+    /**
+     * \brief Wait for messages until Stop().
+     * \param arg unused
+     * \return NULL
+     */
+    void* Run(void* arg)
+    {
+      struct timespec ts;
+
+      (void)arg;
+
+      m_mutex.Lock();
+      while(!m_stop)
+      {
+        m_mutex.Unlock();
+        m_server.WaitMessage(10);
+        m_mutex.Lock();
+      }
+      m_mutex.Unlock();
+
+      clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+      m_cpu = (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+      return NULL;
+    }
+
+    /**
+     * \brief Stop Run().
+     */
+    void Stop()
+    {
+      m_mutex.Lock();
+      m_stop = true;
+      m_mutex.Unlock();
+    }
+
+    /**
+     * \brief Get the CPU time used by Run(), once it has returned.
+     * \return time in nanoseconds
+     */
+    uint64_t GetCpuTime() const
+    {
+      return m_cpu;
+    }
+
+  private:
+    /**
+     * \brief Server.
+     */
+    Json::Rpc::TcpServer& m_server;
+
+    /**
+     * \brief If Run() has to stop.
+     */
+    bool m_stop;
+
+    /**
+     * \brief CPU time of the thread.
+     */
+    uint64_t m_cpu;
+
+    /**
+     * \brief Mutex to protect m_stop.
+     */
+    system_util::Mutex m_mutex;
+};
+
+/**
+ * \brief Receive the responses to a batch (one per line).
+ * \param sock client socket
+ * \param count number of responses
+ * \return true if success, false otherwise
+ */
+static bool bench_recv(int sock, unsigned long count)
+{
+  char buf[65536];
+
+  while(count > 0)
+  {
+    ssize_t nb = ::recv(sock, buf, sizeof(buf), 0);
+
+    if(nb <= 0)
+    {
+      return false;
+    }
+
+    for(ssize_t i = 0 ; i < nb ; i++)
+    {
+      if(buf[i] == '\n')
+      {
+        count--;
+      }
+    }
+  }
+
+  return true;
+}
+
+/**
+ * \brief Run the benchmark for one backend and number of connections.
+ * \param backend backend to use
+ * \param connections number of connections
+ * \param depth number of requests in flight on each connection
+ * \param iterations number of requests to measure
+ * \param port TCP port to use
+ * \return true if success, false otherwise
+ */
+static bool bench_run(enum Json::Rpc::EventBackend backend,
+    unsigned long connections, unsigned long depth, unsigned long iterations,
+    uint16_t port)
+{
+  static const char* names[] = {"tcpserver.rps.poll", "tcpserver.rps.epoll",
+    "tcpserver.rps.io_uring"};
+  static const char* cpuNames[] = {"tcpserver.cpu.poll",
+    "tcpserver.cpu.epoll", "tcpserver.cpu.io_uring"};
+  const std::string request =
+    "{\"jsonrpc\":\"2.0\",\"method\":\"echo\",\"id\":1,\"params\":\"x\"}\n";
+  Json::Rpc::TcpServer server(std::string("127.0.0.1"), port, backend);
+  BenchLoop loop(server);
+  system_util::Thread thread(new system_util::ThreadArgImpl<BenchLoop>(loop,
+        &BenchLoop::Run, NULL));
+  std::vector<int> clients;
+  std::string batch;
+  unsigned long rounds = iterations / (connections * depth);
+  BenchRpc obj;
+  uint64_t start = 0;
+  uint64_t elapsed = 0;
+  bool ret = true;
+
+  if(server.GetBackend() != backend)
+  {
+    fprintf(stderr, "Backend %d not supported, skipped\n", (int)backend);
+    return true;
+  }
+
+  server.AddMethod(new Json::Rpc::RpcMethod<BenchRpc>(obj, &BenchRpc::Echo,
+        std::string("echo")));
+
+  if(!server.Bind() || !server.Listen() || !thread.Start(false))
+  {
+    fprintf(stderr, "Cannot listen on port %u\n", port);
+    return false;
+  }
+
+  for(unsigned long i = 0 ; i < depth ; i++)
+  {
+    batch += request;
+  }
+
+  for(unsigned long i = 0 ; i < connections ; i++)
+  {
+    int sock = networking::connect(networking::TCP, "127.0.0.1", port, NULL,
+        NULL);
+
+    if(sock == -1)
+    {
+      fprintf(stderr, "Cannot connect client %lu\n", i);
+      ret = false;
+      break;
+    }
+
+    clients.push_back(sock);
+  }
+
+  start = bench_now();
+  for(unsigned long r = 0 ; ret && r < rounds ; r++)
+  {
+    /* every connection has a batch in flight before the first is read */
+    for(size_t i = 0 ; ret && i < clients.size() ; i++)
+    {
+      ret = ::send(clients[i], batch.data(), batch.length(), 0) ==
+        (ssize_t)batch.length();
+    }
+
+    for(size_t i = 0 ; ret && i < clients.size() ; i++)
+    {
+      ret = bench_recv(clients[i], depth);
+    }
+  }
+  elapsed = bench_now() - start;
+
+  for(size_t i = 0 ; i < clients.size() ; i++)
+  {
+    ::close(clients[i]);
+  }
+
+  loop.Stop();
+  thread.Join();
+  server.Close();
+
+  if(ret)
+  {
+    unsigned long requests = rounds * connections * depth;
+
+    bench_report(names[backend], connections, requests, elapsed);
+    bench_report(cpuNames[backend], connections, requests,
+        loop.GetCpuTime());
+  }
+
+  return ret;
+}
+
+/**
+ * \brief Entry point of the program.
+ * \param argc number of argument
+ * \param argv array of arguments
+ * \return EXIT_SUCCESS or EXIT_FAILURE
+ */
+int main(int argc, char** argv)
+{
+  static const unsigned long counts[] = {1, 16, 64};
+  static const enum Json::Rpc::EventBackend backends[] = {
+    Json::Rpc::BACKEND_POLL, Json::Rpc::BACKEND_EPOLL,
+    Json::Rpc::BACKEND_IO_URING};
+  unsigned long iterations = 64000;
+  unsigned long depth = 16;
+  uint16_t port = 8086;
+
+  if(argc > 1)
+  {
+    iterations = strtoul(argv[1], NULL, 10);
+  }
+
+  if(argc > 2)
+  {
+    depth = strtoul(argv[2], NULL, 10);
+  }
+
+  if(argc > 3)
+  {
+    port = (uint16_t)atoi(argv[3]);
+  }
+
+  networking::init();
+
+  for(size_t c = 0 ; c < sizeof(counts) / sizeof(counts[0]) ; c++)
+  {
+    for(size_t b = 0 ; b < sizeof(backends) / sizeof(backends[0]) ; b++)
+    {
+      if(!bench_run(backends[b], counts[c], depth, iterations, port))
+      {
+        networking::cleanup();
+        return EXIT_FAILURE;
+      }
+    }
+  }
+
+  networking::cleanup();
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,286 @@
+/*
+ *  JsonRpc-Cpp - JSON-RPC implementation.
+ *  Copyright (C) 2008-2011 Sebastien Vincent <sebastien.vincent@cppextrem.com>
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**
+ * \file http.h
+ * \brief Minimal HTTP/1.1 message framing (RFC 7230).
+ * \author Sebastien Vincent
+ */
+
+#ifndef HTTP_H
+#define HTTP_H
+
+#include <string>
+#include <vector>
+
+/**
+ * \namespace http
+ * \brief HTTP related functions.
+ * \see http://tools.ietf.org/html/rfc7230
+ */
+namespace http
+{
+  /**
+   * \class HttpException
+   * \brief HTTP related exception.
+   */
+  class HttpException : public std::exception
+  {
+    public:
+      /**
+       * \brief Constructor.
+       * \param msg error message
+       */
+      HttpException(const std::string& msg = "") throw();
+
+      /**
+       * \brief Destructor.
+       */
+      virtual ~HttpException() throw();
+
+      /**
+       * \brief Get the exception message.
+       * \return message C-string
+       */
+      virtual const char* what() const throw();
+
+    private:
+      /**
+       * Exception message.
+       */
+      std::string m_msg;
+  };
+
+  /**
+   * \var MAX_HEADER_SIZE
+   * \brief Size of a buffer big enough for any header produced by
+   * encodeResponseHeader().
+   */
+  static const size_t MAX_HEADER_SIZE = 160;
+
+  /**
+   * \brief Encode the status line and headers of a response.
+   *
+   * The body has to be sent right after, there is no trailer. Content-Length
+   * is omitted for 1xx and 204 statuses which have no body.
+   * \param status status code (100, 200, 204, 400 or 500)
+   * \param len length of the body
+   * \param keepAlive false to add "Connection: close"
+   * \param header buffer of at least MAX_HEADER_SIZE bytes
+   * \return length of the header (without the terminating NULL)
+   */
+  size_t encodeResponseHeader(int status, size_t len, bool keepAlive,
+      char* header);
+
+  /**
+   * \brief Encode the request line and headers of a JSON-RPC POST request.
+   * \param host value of the Host header
+   * \param len length of the body
+   * \return header, the body has to be sent right after
+   */
+  std::string encodeRequestHeader(const std::string& host, size_t len);
+
+  /**
+   * \class Decoder
+   * \brief Incremental HTTP/1.1 message decoder for stream transports.
+   *
+   * Bytes are appended in any chunks with Prepare()/Commit() or Feed() and
+   * Next() gives the bodies of the completed messages (requests or
+   * responses), several messages can be pipelined. The headers are
+   * searched once as the bytes come, only Content-Length,
+   * Transfer-Encoding, Connection and Expect are interpreted. A chunked
+   * body is reassembled in place so Next() does not copy it either.
+   */
+  class Decoder
+  {
+    public:
+      /**
+       * \brief Constructor.
+       * \param maxSize maximum body size (0 means unlimited)
+       */
+      Decoder(size_t maxSize = 0);
+
+      /**
+       * \brief Destructor.
+       */
+      ~Decoder();
+
+      /**
+       * \brief Set the maximum body size.
+       * \param maxSize maximum body size (0 means unlimited)
+       */
+      void SetMaxSize(size_t maxSize);
+
+      /**
+       * \brief Get the maximum body size.
+       * \return maximum body size (0 means unlimited)
+       */
+      size_t GetMaxSize() const;
+
+      /**
+       * \brief Get a buffer to write received data to.
+       * \param size number of bytes that will be written at most
+       * \return buffer of at least size bytes, valid until next call
+       * \note It invalidates the bodies returned by Next().
+       */
+      char* Prepare(size_t size);
+
+      /**
+       * \brief Append data written in the buffer returned by Prepare().
+       * \param size number of bytes written
+       */
+      void Commit(size_t size);
+
+      /**
+       * \brief Append data.
+       * \param data data to append
+       * \param size size of data
+       * \note It invalidates the bodies returned by Next().
+       */
+      void Feed(const char* data, size_t size);
+
+      /**
+       * \brief Get the body of the next complete message.
+       * \param data if a message is complete, pointer to its body in the
+       * decoder buffer, valid until next Prepare(), Feed() or Reset()
+       * \param size if a message is complete, size of the body
+       * \return true if a message is complete, false if more data is needed
+       * \throw HttpException if the stream is not valid HTTP or a message is
+       * too big, the decoder has then to be Reset()
+       */
+      bool Next(const char*& data, size_t& size) throw(http::HttpException);
+
+      /**
+       * \brief Get if the connection stays open after the last message
+       * returned by Next().
+       * \return true for HTTP/1.1 without "Connection: close" or HTTP/1.0
+       * with "Connection: keep-alive", false otherwise
+       */
+      bool IsKeepAlive() const;
+
+      /**
+       * \brief Get if the peer waits for "100 Continue" before sending the
+       * body of the current message.
+       * \return true once per message sent with "Expect: 100-continue"
+       * whose body is not received yet, false otherwise
+       */
+      bool TakeContinue();
+
+      /**
+       * \brief Get the size of the data not consumed yet.
+       * \return number of bytes
+       */
+      size_t GetBufferedSize() const;
+
+      /**
+       * \brief Discard all buffered data and decoding state.
+       */
+      void Reset();
+
+    private:
+      /**
+       * \enum State
+       * \brief Part of the message being decoded.
+       */
+      enum State
+      {
+        HEADERS, /**< Start line and headers. */
+        BODY, /**< Body of known length. */
+        CHUNK_SIZE, /**< Size line of a chunk. */
+        CHUNK_DATA, /**< Data of a chunk and its CRLF. */
+        TRAILERS /**< Trailer headers after the last chunk. */
+      };
+
+      /**
+       * \brief Parse the start line and headers of a message.
+       * \param end position of the empty line ending them
+       * \throw HttpException if the headers are not valid
+       */
+      void ParseHeaders(size_t end) throw(http::HttpException);
+
+      /**
+       * \brief Find the end of a line.
+       * \param from position to search from
+       * \return position of the CRLF or m_end if not received yet
+       */
+      size_t FindLineEnd(size_t from) const;
+
+      /**
+       * \brief Move the unconsumed data at the beginning of the buffer.
+       */
+      void Compact();
+
+      /**
+       * \brief Maximum body size.
+       */
+      size_t m_maxSize;
+
+      /**
+       * \brief Received data, valid from m_begin to m_end.
+       */
+      std::vector<char> m_buffer;
+
+      /**
+       * \brief Start of the current message in m_buffer.
+       */
+      size_t m_begin;
+
+      /**
+       * \brief End of received data in m_buffer.
+       */
+      size_t m_end;
+
+      /**
+       * \brief Position of the next byte to parse.
+       */
+      size_t m_scan;
+
+      /**
+       * \brief Start of the body of the current message.
+       */
+      size_t m_body;
+
+      /**
+       * \brief End of the body reassembled so far (chunked body only).
+       */
+      size_t m_bodyEnd;
+
+      /**
+       * \brief Body length (Content-Length) or size left of the current
+       * chunk.
+       */
+      size_t m_length;
+
+      /**
+       * \brief Part of the message being decoded.
+       */
+      enum State m_state;
+
+      /**
+       * \brief If the connection stays open after the current message.
+       */
+      bool m_keepAlive;
+
+      /**
+       * \brief If "100 Continue" has to be sent for the current message.
+       */
+      bool m_continue;
+  };
+} /* namespace http */
+
+#endif /* HTTP_H */
@@ -45,14 +45,25 @@ static const char JSONRPC_CPP_VERSION_STRING[] = "0.5.0";
 /* include all headers from JsonRpc-Cpp lib */
 #include "jsonrpc_common.h"
 #include "jsonrpc_handler.h"
+#include "jsonrpc_stats.h"
+#include "jsonrpc_metrics.h"
+#include "jsonrpc_framer.h"
 #include "jsonrpc_server.h"
 #include "jsonrpc_udpserver.h"
 #include "jsonrpc_tcpserver.h"
+#include "jsonrpc_httpserver.h"
+#include "jsonrpc_unixserver.h"
+#include "jsonrpc_shmserver.h"
+#include "jsonrpc_reactorgroup.h"
 #include "jsonrpc_client.h"
 #include "jsonrpc_udpclient.h"
 #include "jsonrpc_tcpclient.h"
+#include "jsonrpc_unixclient.h"
+#include "jsonrpc_shmclient.h"
+#include "jsonrpc_asyncclient.h"
+#include "jsonrpc_clientpool.h"
 
-#ifdef CURL_ENABLED_H
+#ifdef CURL_ENABLED
 #include "jsonrpc_httpclient.h"
 #endif
 
@@ -0,0 +1,315 @@
+/*
+ *  JsonRpc-Cpp - JSON-RPC implementation.
+ *  Copyright (C) 2008-2011 Sebastien Vincent <sebastien.vincent@cppextrem.com>
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**
+ * \file jsonrpc_asyncclient.h
+ * \brief JSON-RPC asynchronous TCP client.
+ * \author Sebastien Vincent
+ */
+
+#ifndef JSONRPC_ASYNCCLIENT_H
+#define JSONRPC_ASYNCCLIENT_H
+
+#include <map>
+
+#include <json/json.h>
+
+#include "jsonrpc_common.h"
+#include "jsonrpc_tcpclient.h"
+
+#include "system.h"
+
+namespace Json
+{
+  namespace Rpc
+  {
+    /**
+     * \var CONNECTION_CLOSED
+     * \brief Error code given to the calls still pending when the
+     * connection is closed (implementation-defined server error range).
+     */
+    static const int CONNECTION_CLOSED = -32000;
+
+    /**
+     * \class AsyncCallback
+     * \brief Receive the response of an asynchronous call.
+     */
+    class AsyncCallback
+    {
+      public:
+        /**
+         * \brief Destructor.
+         */
+        virtual ~AsyncCallback();
+
+        /**
+         * \brief Called once with the response of the call.
+         * \param response JSON-RPC response (result or error), it can be
+         * swapped to keep it without a copy
+         * \note It is called by the reader thread of AsyncClient, it should
+         * not block and it must not call AsyncClient::Close().
+         */
+        virtual void Done(Json::Value& response) = 0;
+    };
+
+    /**
+     * \class AsyncResult
+     * \brief Future to wait for the response of an asynchronous call.
+     */
+    class AsyncResult : public AsyncCallback
+    {
+      public:
+        /**
+         * \brief Constructor.
+         */
+        AsyncResult();
+
+        /**
+         * \brief Destructor.
+         */
+        virtual ~AsyncResult();
+
+        /**
+         * \brief Store the response and wake up Wait().
+         * \param response JSON-RPC response
+         */
+        virtual void Done(Json::Value& response);
+
+        /**
+         * \brief Wait for the response.
+         * \return JSON-RPC response (result or error)
+         */
+        const Json::Value& Wait();
+
+        /**
+         * \brief Get if the response has come.
+         * \return true if the response has come, false otherwise
+         */
+        bool IsReady();
+
+        /**
+         * \brief Forget the response to use the object for another call.
+         */
+        void Reset();
+
+      private:
+        /**
+         * \brief Copy constructor (private because of "resource" class).
+         * \param obj object to copy
+         */
+        AsyncResult(const AsyncResult& obj);
+
+        /**
+         * \brief Operator copy assignment (private because of "resource"
+         * class).
+         * \param obj object to copy
+         * \return copied object reference
+         */
+        AsyncResult& operator=(const AsyncResult& obj);
+
+        /**
+         * \brief If the response has come.
+         */
+        bool m_ready;
+
+        /**
+         * \brief JSON-RPC response.
+         */
+        Json::Value m_response;
+
+        /**
+         * \brief Mutex to protect m_ready and m_response.
+         */
+        system_util::Mutex m_mutex;
+
+        /**
+         * \brief Condition signaled when the response comes.
+         */
+        system_util::Condition m_cond;
+    };
+
+    /**
+     * \class AsyncClient
+     * \brief JSON-RPC TCP client with pipelined asynchronous calls.
+     *
+     * Calls are sent without waiting for the previous responses, each one
+     * with an id chosen by the client. A reader thread receives the
+     * responses, in any order, and gives each one to the callback of its
+     * call.
+     *
+     * \code
+     * AsyncResult result;
+     *
+     * client.Call("print", Json::Value::null, result);
+     * std::cout << result.Wait() << std::endl;
+     * \endcode
+     * \note Call() and Notify() can be used by several threads at the same
+     * time.
+     */
+    class AsyncClient
+    {
+      public:
+        /**
+         * \brief Constructor.
+         * \param address remote network address or FQDN
+         * \param port remote port
+         */
+        AsyncClient(const std::string& address, uint16_t port);
+
+        /**
+         * \brief Destructor, closes the connection.
+         */
+        virtual ~AsyncClient();
+
+        /**
+         * \brief Set the encapsulated format (default is RAW).
+         * \param format encapsulated format
+         * \note It has to be called before Connect().
+         */
+        void SetEncapsulatedFormat(enum EncapsulatedFormat format);
+
+        /**
+         * \brief Connect to the server and start the reader thread.
+         * \return true if success, false otherwise
+         */
+        bool Connect();
+
+        /**
+         * \brief Stop the reader thread and close the connection.
+         *
+         * The callbacks of the pending calls receive an error response with
+         * the CONNECTION_CLOSED code.
+         * \warning It must not be called while another thread is in Call()
+         * or Notify().
+         */
+        void Close();
+
+        /**
+         * \brief Send a request.
+         * \param method name of the method
+         * \param params parameters (Json::Value::null if none)
+         * \param callback receives the response, it must be valid until
+         * then
+         * \return true if the request has been sent, false otherwise (the
+         * callback will not be called)
+         */
+        bool Call(const std::string& method, const Json::Value& params,
+            AsyncCallback& callback);
+
+        /**
+         * \brief Send a notification (no response).
+         * \param method name of the method
+         * \param params parameters (Json::Value::null if none)
+         * \return true if the notification has been sent, false otherwise
+         */
+        bool Notify(const std::string& method, const Json::Value& params);
+
+        /**
+         * \brief Get the number of calls waiting for their response.
+         * \return number of calls
+         */
+        size_t GetPendingCount();
+
+        /**
+         * \brief Get if calls can be sent.
+         * \return true if connected, false if not connected or if the
+         * connection has been closed by the server
+         */
+        bool IsConnected();
+
+      private:
+        /**
+         * \brief Copy constructor (private because of "resource" class).
+         * \param obj object to copy
+         */
+        AsyncClient(const AsyncClient& obj);
+
+        /**
+         * \brief Operator copy assignment (private because of "resource"
+         * class).
+         * \param obj object to copy
+         * \return copied object reference
+         */
+        AsyncClient& operator=(const AsyncClient& obj);
+
+        /**
+         * \brief Serialize and send a message.
+         * \param msg JSON-RPC request or notification
+         * \return true if success, false otherwise (the connection is then
+         * marked closed)
+         */
+        bool Send(const Json::Value& msg);
+
+        /**
+         * \brief Reader thread, dispatch the responses to the callbacks.
+         * \param arg unused
+         * \return NULL
+         */
+        void* Run(void* arg);
+
+        /**
+         * \brief Give an error response to all the pending calls and
+         * refuse new calls.
+         */
+        void FailPending();
+
+        /**
+         * \brief Connection to the server.
+         */
+        TcpClient m_client;
+
+        /**
+         * \brief Reader thread (NULL if not connected).
+         */
+        system_util::Thread* m_reader;
+
+        /**
+         * \brief If calls can be sent.
+         */
+        bool m_connected;
+
+        /**
+         * \brief Id of the next call.
+         */
+        Json::Value::UInt m_nextId;
+
+        /**
+         * \brief Pending calls indexed by id.
+         */
+        std::map<Json::Value::UInt, AsyncCallback*> m_pending;
+
+        /**
+         * \brief Mutex to protect m_connected, m_nextId and m_pending.
+         */
+        system_util::Mutex m_mutex;
+
+        /**
+         * \brief JSON writer (protected by m_sendMutex).
+         */
+        Json::FastWriter m_writer;
+
+        /**
+         * \brief Mutex to send one message at a time.
+         */
+        system_util::Mutex m_sendMutex;
+    };
+  } /* namespace Rpc */
+} /* namespace Json */
+
+#endif /* JSONRPC_ASYNCCLIENT_H */
+
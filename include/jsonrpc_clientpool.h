@@ -0,0 +1,256 @@
+/*
+ *  JsonRpc-Cpp - JSON-RPC implementation.
+ *  Copyright (C) 2008-2011 Sebastien Vincent <sebastien.vincent@cppextrem.com>
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**
+ * \file jsonrpc_clientpool.h
+ * \brief JSON-RPC TCP connection pool.
+ * \author Sebastien Vincent
+ */
+
+#ifndef JSONRPC_CLIENTPOOL_H
+#define JSONRPC_CLIENTPOOL_H
+
+#include <vector>
+
+#include <json/json.h>
+
+#include "jsonrpc_common.h"
+#include "jsonrpc_asyncclient.h"
+
+#include "system.h"
+
+namespace Json
+{
+  namespace Rpc
+  {
+    /**
+     * \class ClientPool
+     * \brief Pool of warm connections to one server.
+     *
+     * Each call goes on the connection with the fewest calls waiting for
+     * their response (connections are AsyncClient so they are pipelined).
+     * A maintenance thread replaces the connections closed by the server or
+     * broken, a call which finds no usable connection reconnects one itself
+     * (a "miss").
+     * \note Call() and Notify() can be used by several threads at the same
+     * time.
+     */
+    class ClientPool
+    {
+      public:
+        /**
+         * \brief Constructor.
+         * \param address remote network address or FQDN
+         * \param port remote port
+         * \param size number of connections
+         */
+        ClientPool(const std::string& address, uint16_t port, size_t size);
+
+        /**
+         * \brief Destructor, stops the pool.
+         */
+        virtual ~ClientPool();
+
+        /**
+         * \brief Set the encapsulated format (default is RAW).
+         * \param format encapsulated format
+         * \note It has to be called before Start().
+         */
+        void SetEncapsulatedFormat(enum EncapsulatedFormat format);
+
+        /**
+         * \brief Open the connections and start the maintenance thread.
+         * \return true if at least one connection is open, false otherwise
+         */
+        bool Start();
+
+        /**
+         * \brief Stop the maintenance thread and close the connections.
+         *
+         * The calls waiting for a connection return false, the calls being
+         * sent are waited for.
+         */
+        void Stop();
+
+        /**
+         * \brief Send a request on the least loaded connection.
+         * \param method name of the method
+         * \param params parameters (Json::Value::null if none)
+         * \param callback receives the response, it must be valid until
+         * then
+         * \return true if the request has been sent, false otherwise (the
+         * callback will not be called)
+         */
+        bool Call(const std::string& method, const Json::Value& params,
+            AsyncCallback& callback);
+
+        /**
+         * \brief Send a request and wait for its response.
+         * \param method name of the method
+         * \param params parameters (Json::Value::null if none)
+         * \param response JSON-RPC response (result or error)
+         * \return true if a response has been received, false otherwise
+         */
+        bool Call(const std::string& method, const Json::Value& params,
+            Json::Value& response);
+
+        /**
+         * \brief Send a notification on the least loaded connection.
+         * \param method name of the method
+         * \param params parameters (Json::Value::null if none)
+         * \return true if the notification has been sent, false otherwise
+         */
+        bool Notify(const std::string& method, const Json::Value& params);
+
+        /**
+         * \brief Get the number of connections.
+         * \return number of connections
+         */
+        size_t GetSize() const;
+
+        /**
+         * \brief Get the number of calls which found a connection open.
+         * \return number of hits
+         */
+        uint64_t GetHitCount();
+
+        /**
+         * \brief Get the number of calls which had to reconnect or to wait
+         * for a reconnection.
+         * \return number of misses
+         */
+        uint64_t GetMissCount();
+
+        /**
+         * \brief Get the total time spent by the calls to get a connection.
+         * \return time in microseconds
+         */
+        uint64_t GetWaitTime();
+
+        /**
+         * \brief Get the number of connections replaced.
+         * \return number of reconnections (successful or not)
+         */
+        uint64_t GetReconnectCount();
+
+      private:
+        /**
+         * \brief Copy constructor (private because of "resource" class).
+         * \param obj object to copy
+         */
+        ClientPool(const ClientPool& obj);
+
+        /**
+         * \brief Operator copy assignment (private because of "resource"
+         * class).
+         * \param obj object to copy
+         * \return copied object reference
+         */
+        ClientPool& operator=(const ClientPool& obj);
+
+        /**
+         * \struct Connection
+         * \brief Connection of the pool.
+         */
+        struct Connection
+        {
+          AsyncClient* client; /**< Connection to the server. */
+          size_t users; /**< Number of threads sending on it. */
+          bool reconnecting; /**< If it is being replaced. */
+        };
+
+        /**
+         * \brief Get the least loaded open connection, reconnect one if
+         * there is none.
+         * \return connection or NULL if no connection can be opened or if
+         * the pool is stopped
+         * \note Release() has to be called after use.
+         */
+        Connection* Acquire();
+
+        /**
+         * \brief Give back a connection got from Acquire().
+         * \param conn connection
+         */
+        void Release(Connection* conn);
+
+        /**
+         * \brief Replace a connection (not used by any thread).
+         * \param conn connection marked as reconnecting
+         * \return true if the new connection is open, false otherwise
+         */
+        bool Reconnect(Connection* conn);
+
+        /**
+         * \brief Maintenance thread, replaces the broken connections.
+         * \param arg unused
+         * \return NULL
+         */
+        void* Run(void* arg);
+
+        /**
+         * \brief Connections.
+         */
+        std::vector<Connection> m_connections;
+
+        /**
+         * \brief Maintenance thread (NULL if not started).
+         */
+        system_util::Thread* m_maintenance;
+
+        /**
+         * \brief If the maintenance thread has to stop.
+         */
+        bool m_stop;
+
+        /**
+         * \brief Number of calls which found a connection open.
+         */
+        uint64_t m_hits;
+
+        /**
+         * \brief Number of calls which had to reconnect.
+         */
+        uint64_t m_misses;
+
+        /**
+         * \brief Time spent by the calls to get a connection (microseconds).
+         */
+        uint64_t m_waitTime;
+
+        /**
+         * \brief Number of reconnections.
+         */
+        uint64_t m_reconnects;
+
+        /**
+         * \brief Mutex to protect the connections state, m_stop and the
+         * counters.
+         */
+        system_util::Mutex m_mutex;
+
+        /**
+         * \brief Condition signaled when a reconnection ends.
+         */
+        system_util::Condition m_cond;
+    };
+  } /* namespace Rpc */
+} /* namespace Json */
+
+#endif /* JSONRPC_CLIENTPOOL_H */
+
@@ -49,13 +49,24 @@ namespace Json
     enum EncapsulatedFormat
     {
       RAW, /**< Raw format. */
-      NETSTRING /**< Encapsulate the message with NetString (see http://cr.yp.to/proto/netstrings.txt). */
+      NETSTRING, /**< Encapsulate the message with NetString (see http://cr.yp.to/proto/netstrings.txt). */
+      HTTP_POST /**< Encapsulate the message in HTTP/1.1 POST requests and their responses (see HttpServer). */
 #if 0
-      HTTP_POST, /**< Encapsulate the message in HTTP POST. */
       HTTP_GET, /**< Encapsulate the message in HTTP POST. */
 #endif
     };
 
+    /**
+     * \enum EventBackend
+     * \brief Readiness notification mechanism of connection-oriented servers.
+     */
+    enum EventBackend
+    {
+      BACKEND_POLL, /**< poll(), available everywhere. */
+      BACKEND_EPOLL, /**< epoll (Linux only), cost does not depend on the number of idle connections. */
+      BACKEND_IO_URING /**< io_uring (Linux 6.0 or later), completion-based, about one system call per WaitMessage() however many messages are received and sent. */
+    };
+
     /**
      * \enum ErrorCode
      * \brief JSON-RPC error codes.
@@ -0,0 +1,248 @@
+/*
+ *  JsonRpc-Cpp - JSON-RPC implementation.
+ *  Copyright (C) 2008-2011 Sebastien Vincent <sebastien.vincent@cppextrem.com>
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**
+ * \file jsonrpc_framer.h
+ * \brief Extract JSON-RPC messages from a byte stream.
+ * \author Sebastien Vincent
+ */
+
+#ifndef JSONRPC_FRAMER_H
+#define JSONRPC_FRAMER_H
+
+#include <string>
+#include <vector>
+
+#include "jsonrpc_common.h"
+
+#include "netstring.h"
+#include "http.h"
+
+namespace Json
+{
+  namespace Rpc
+  {
+    /**
+     * \class Framer
+     * \brief Reassemble JSON-RPC messages received on a stream socket.
+     *
+     * Data is appended as it comes from the network (whatever the read
+     * boundaries are) and Next() extracts the complete messages one by one,
+     * the incomplete tail stays buffered for the next read.
+     *
+     * With RAW format a message is a JSON object or array, its end is found
+     * by counting braces and brackets outside of JSON strings. With NETSTRING
+     * format a message is the payload of a netstring (see
+     * netstring::Decoder). With HTTP_POST format a message is the body of an
+     * HTTP/1.1 request or response (see http::Decoder).
+     *
+     * \code
+     * char* buf = framer.Prepare(4096);
+     * ssize_t nb = recv(fd, buf, 4096, 0);
+     * framer.Commit(nb);
+     *
+     * while(framer.Next(msg) == 1)
+     * {
+     *   // process msg
+     * }
+     * \endcode
+     */
+    class Framer
+    {
+      public:
+        /**
+         * \brief Constructor.
+         * \param format encapsulated format
+         */
+        Framer(enum EncapsulatedFormat format = RAW);
+
+        /**
+         * \brief Destructor.
+         */
+        ~Framer();
+
+        /**
+         * \brief Set the encapsulated format.
+         * \param format encapsulated format
+         * \note Buffered data is dropped.
+         */
+        void SetEncapsulatedFormat(enum EncapsulatedFormat format);
+
+        /**
+         * \brief Get the encapsulated format.
+         * \return encapsulated format
+         */
+        enum EncapsulatedFormat GetEncapsulatedFormat() const;
+
+        /**
+         * \brief Set the maximum size of a message.
+         * \param size maximum size in bytes (0 means unlimited)
+         * \note Default is 16 MB.
+         */
+        void SetMaxMessageSize(size_t size);
+
+        /**
+         * \brief Get the maximum size of a message.
+         * \return maximum size in bytes (0 means unlimited)
+         */
+        size_t GetMaxMessageSize() const;
+
+        /**
+         * \brief Get room at the end of the buffer to receive data.
+         * \param size number of bytes needed
+         * \return pointer where at least size bytes can be written
+         * \note Pointer is valid until next call to a non-const method. It
+         * invalidates the messages returned by Next(const char*&, size_t&).
+         */
+        char* Prepare(size_t size);
+
+        /**
+         * \brief Validate data written after a call to Prepare().
+         * \param size number of bytes written
+         */
+        void Commit(size_t size);
+
+        /**
+         * \brief Append data.
+         * \param data data
+         * \param size size of data
+         */
+        void Feed(const char* data, size_t size);
+
+        /**
+         * \brief Extract the next complete message.
+         * \param msg message if any
+         * \return 1 if a message has been extracted, 0 if more data is needed,
+         * -1 if the stream is invalid (bad netstring or HTTP message, or
+         * message too big)
+         */
+        int Next(std::string& msg);
+
+        /**
+         * \brief Extract the next complete message without copying it.
+         * \param data pointer to the message in the buffer, valid until next
+         * call to Prepare(), Feed() or Reset()
+         * \param size size of the message
+         * \return 1 if a message has been extracted, 0 if more data is needed,
+         * -1 if the stream is invalid (bad netstring or HTTP message, or
+         * message too big)
+         */
+        int Next(const char*& data, size_t& size);
+
+        /**
+         * \brief Get if the connection stays open after the last message
+         * extracted (HTTP_POST).
+         * \return true if the connection is kept alive (always true with the
+         * other formats), false otherwise
+         */
+        bool IsKeepAlive() const;
+
+        /**
+         * \brief Get if the peer waits for "100 Continue" before sending the
+         * message being received (HTTP_POST).
+         * \return true once per message, false otherwise
+         */
+        bool TakeContinue();
+
+        /**
+         * \brief Get the number of buffered bytes not yet extracted.
+         * \return number of bytes
+         */
+        size_t GetBufferedSize() const;
+
+        /**
+         * \brief Drop all buffered data.
+         */
+        void Reset();
+
+      private:
+        /**
+         * \brief Extract next RAW message.
+         * \param data pointer to the message if any
+         * \param size size of the message if any
+         * \return same as Next()
+         */
+        int NextRaw(const char*& data, size_t& size);
+
+        /**
+         * \brief Mark bytes as consumed.
+         * \param size number of bytes
+         */
+        void Consume(size_t size);
+
+        /**
+         * \brief Encapsulated format.
+         */
+        enum EncapsulatedFormat m_format;
+
+        /**
+         * \brief Maximum size of a message (0 means unlimited).
+         */
+        size_t m_maxSize;
+
+        /**
+         * \brief Netstring decoder, it has its own buffer (NETSTRING only).
+         */
+        netstring::Decoder m_decoder;
+
+        /**
+         * \brief HTTP decoder, it has its own buffer (HTTP_POST only).
+         */
+        http::Decoder m_http;
+
+        /**
+         * \brief Buffer (RAW only).
+         */
+        std::vector<char> m_buffer;
+
+        /**
+         * \brief Offset of the first byte not yet extracted.
+         */
+        size_t m_begin;
+
+        /**
+         * \brief Offset of the end of received data.
+         */
+        size_t m_end;
+
+        /**
+         * \brief Offset of the next byte to scan (RAW), so that data is
+         * scanned only once whatever the number of reads.
+         */
+        size_t m_scan;
+
+        /**
+         * \brief Current nesting level of braces and brackets (RAW).
+         */
+        size_t m_depth;
+
+        /**
+         * \brief Scanner is inside a JSON string (RAW).
+         */
+        bool m_inString;
+
+        /**
+         * \brief Previous character was a backslash in a JSON string (RAW).
+         */
+        bool m_escape;
+    };
+  } /* namespace Rpc */
+} /* namespace Json */
+
+#endif /* JSONRPC_FRAMER_H */
+
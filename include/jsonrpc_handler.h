@@ -29,15 +29,29 @@
 
 #include <string>
 #include <list>
+#include <vector>
 
 #include <json/json.h>
 
 #include "jsonrpc_common.h"
+#include "jsonrpc_stats.h"
+
+#include "system.h"
 
 namespace Json 
 {
   namespace Rpc
   {
+    /**
+     * \enum ExecutionHint
+     * \brief Where a method is executed when the server has a worker pool.
+     */
+    enum ExecutionHint
+    {
+      EXECUTE_POOLED, /**< Run by a worker thread (default). */
+      EXECUTE_INLINE /**< Run directly by the I/O thread (trivial methods). */
+    };
+
     /**
      * \class CallbackMethod
      * \brief Abstract callback-style method.
@@ -72,6 +86,12 @@ namespace Json
          * \return description
          */
         virtual Json::Value GetDescription() const = 0;
+
+        /**
+         * \brief Get where the method should be executed.
+         * \return EXECUTE_POOLED by default
+         */
+        virtual enum ExecutionHint GetExecutionHint() const;
     };
 
     /**
@@ -110,6 +130,7 @@ namespace Json
           m_name = name;
           m_method = method;
           m_description = description;
+          m_hint = EXECUTE_POOLED;
         }
 
         /**
@@ -143,6 +164,26 @@ namespace Json
           return m_description;
         }
 
+        /**
+         * \brief Get where the method should be executed.
+         * \return execution hint
+         */
+        virtual enum ExecutionHint GetExecutionHint() const
+        {
+          return m_hint;
+        }
+
+        /**
+         * \brief Set where the method should be executed.
+         * \param hint EXECUTE_INLINE for methods cheaper than a handoff to
+         * a worker thread
+         * \note Must be set before the method is added to a Handler.
+         */
+        void SetExecutionHint(enum ExecutionHint hint)
+        {
+          m_hint = hint;
+        }
+
       private:
         /**
          * \brief Copy constructor (private to avoid copy).
@@ -182,6 +223,11 @@ namespace Json
          * \brief JSON-formated description of the RPC method.
          */
         Json::Value m_description;
+
+        /**
+         * \brief Where the method should be executed.
+         */
+        enum ExecutionHint m_hint;
     };
 
     /**
@@ -237,12 +283,16 @@ namespace Json
          * handler.AddMethod(new RpcMethod<MyClass>(...));
          * </code>
          * \warning The "method" parameter MUST be dynamically allocated.
+         * \warning The name returned by method->GetName() is cached here, it
+         * MUST NOT change while the method is registered.
          */
         void AddMethod(CallbackMethod* method);
 
         /**
          * \brief Remote a RPC method.
          * \param name name of the RPC method
+         * \note If several methods share the same name, the first one
+         * registered is removed.
          */
         void DeleteMethod(const std::string& name);
 
@@ -268,6 +318,156 @@ namespace Json
          */
         bool Process(const char* msg, Json::Value& response);
 
+        /**
+         * \brief Parse a JSON-RPC message.
+         * \param msg JSON-RPC message as std::string
+         * \param root parsed message
+         * \param response JSON-RPC parse error response if parsing failed
+         * \return true if msg is valid JSON, false otherwise
+         */
+        bool Parse(const std::string& msg, Json::Value& root,
+            Json::Value& response);
+
+        /**
+         * \brief Parse a JSON-RPC message with a caller-provided reader.
+         *
+         * Unlike the other Parse(), it does not use the Handler reader so
+         * several threads sharing the Handler can parse at the same time,
+         * each with its own reader.
+         * \param reader JSON reader
+         * \param msg JSON-RPC message as std::string
+         * \param root parsed message
+         * \param response JSON-RPC parse error response if parsing failed
+         * \return true if msg is valid JSON, false otherwise
+         */
+        bool Parse(Json::Reader& reader, const std::string& msg,
+            Json::Value& root, Json::Value& response) const;
+
+        /**
+         * \brief Parse a JSON-RPC message, a parse error is returned already
+         * serialized.
+         * \param reader JSON reader
+         * \param msg JSON-RPC message as std::string
+         * \param root parsed message
+         * \param error serialized parse error response if parsing failed,
+         * empty otherwise (its storage is reused)
+         * \return true if msg is valid JSON, false otherwise
+         */
+        bool Parse(Json::Reader& reader, const std::string& msg,
+            Json::Value& root, std::string& error) const;
+
+        /**
+         * \brief Parse a JSON-RPC message straight from a receive buffer, a
+         * parse error is returned already serialized.
+         * \param reader JSON reader
+         * \param msg JSON-RPC message (not NULL-terminated)
+         * \param size size of msg
+         * \param root parsed message
+         * \param error serialized parse error response if parsing failed,
+         * empty otherwise (its storage is reused)
+         * \return true if msg is valid JSON, false otherwise
+         */
+        bool Parse(Json::Reader& reader, const char* msg, size_t size,
+            Json::Value& root, std::string& error) const;
+
+        /**
+         * \brief Process a parsed JSON-RPC message.
+         * \param root JSON-RPC message (request, notification or batched call)
+         * \param response JSON-RPC response (could be Json::Value::null)
+         * \return true if the request has been correctly processed, false
+         * otherwise
+         * \note This method can be called by several threads at the same
+         * time as long as no method is added or deleted meanwhile.
+         */
+        bool Process(const Json::Value& root, Json::Value& response);
+
+        /**
+         * \brief Process a parsed JSON-RPC message, protocol errors and
+         * system.describe of a single request are returned already
+         * serialized.
+         *
+         * Invalid request is copied from a buffer serialized once, method
+         * not found and system.describe from templates where only the id is
+         * spliced, no Json::Value is built for them.
+         * \param root JSON-RPC message (request, notification or batched call)
+         * \param response JSON-RPC response (could be Json::Value::null),
+         * not set if serialized is not empty
+         * \param serialized serialized response, empty if the request
+         * has been given to a method or is a batched call (its storage is
+         * reused)
+         * \return true if the request has been correctly processed, false
+         * otherwise
+         * \note Same thread-safety as Process(const Json::Value&, Json::Value&).
+         */
+        bool Process(const Json::Value& root, Json::Value& response,
+            std::string& serialized);
+
+        /**
+         * \brief Get a pre-serialized error response with a null id.
+         * \param code PARSING_ERROR or INVALID_REQUEST
+         * \return serialized error response (empty for the other codes)
+         */
+        const std::string& GetErrorString(enum ErrorCode code) const;
+
+        /**
+         * \brief Execute the elements of big enough batched calls in
+         * parallel.
+         *
+         * The thread calling Process() runs elements too, the pool threads
+         * help it. Responses keep the order of the requests.
+         * \param threads number of threads of the pool (0 disables parallel
+         * execution, default)
+         * \param maxConcurrency maximum number of elements of one batch
+         * executed at the same time, calling thread included (0 means
+         * threads + 1)
+         * \param threshold minimum number of elements for a batch to be
+         * executed in parallel, smaller ones stay sequential
+         * \return true if success, false otherwise
+         * \warning Methods are then called from several threads at the same
+         * time. Call it before the Handler is used.
+         * \note POSIX only.
+         */
+        bool SetBatchPool(size_t threads, size_t maxConcurrency,
+            size_t threshold);
+
+        /**
+         * \brief Get where a parsed JSON-RPC message should be executed.
+         * \param root JSON-RPC message (request, notification or batched call)
+         * \return EXECUTE_INLINE if all the methods called are flagged inline
+         * or unknown, EXECUTE_POOLED otherwise
+         */
+        enum ExecutionHint GetExecutionHint(const Json::Value& root) const;
+
+        /**
+         * \brief Record for each method the number of calls, the number of
+         * errors and a histogram of the durations.
+         *
+         * Each thread records in its own counters, read only by GetStats(),
+         * so processing takes no lock. It costs two clock reads per call.
+         * \param method also add the system.stats RPC method
+         * \warning Call it before the Handler is used.
+         */
+        void EnableStats(bool method = true);
+
+        /**
+         * \brief Get the statistics of the registered methods.
+         *
+         * A call made meanwhile may be counted in calls and not yet in the
+         * histogram, or the reverse.
+         * \param stats filled with one element per method (in registration
+         * order), empty if statistics are not enabled
+         * \note Same thread-safety as Process(const Json::Value&, Json::Value&).
+         */
+        void GetStats(std::vector<MethodStats>& stats);
+
+        /**
+         * \brief RPC method that get the statistics of all the RPC methods.
+         * \param msg request
+         * \param response response
+         * \return true if processed correctly, false otherwise
+         */
+        bool SystemStats(const Json::Value& msg, Json::Value& response);
+
         /**
          * \brief RPC method that get all the RPC methods and their description.
          * \param msg request
@@ -280,6 +480,7 @@ namespace Json
          * \brief Get a std::string representation of Json::Value.
          * \param value JSON message
          * \return string representation
+         * \note It can be called from several threads at the same time.
          */
         std::string GetString(Json::Value value);
 
@@ -290,6 +491,16 @@ namespace Json
           */
         Handler(const Handler& obj);
 
+        /**
+         * \brief Fill an error response in place.
+         * \param response response to fill
+         * \param id id of the request (Json::Value::null if unknown)
+         * \param code error code
+         * \param message error message (static string, it is not copied)
+         */
+        static void SetError(Json::Value& response, const Json::Value& id,
+            enum ErrorCode code, const char* message);
+
         /**
          * \brief Operator copy assignment (redefined because of "resource"
          * class).
@@ -304,21 +515,320 @@ namespace Json
         Json::Reader m_reader;
 
         /**
-         * \brief JSON writer.
+         * \brief JSON writer (constructor and UpdateDescribe() only, after
+         * construction it is protected by m_describeMutex).
          */
         Json::FastWriter m_writer;
 
         /**
-         * \brief List of RPC methods.
+         * \brief Serialized PARSING_ERROR response.
+         */
+        std::string m_parseError;
+
+        /**
+         * \brief Serialized INVALID_REQUEST response.
+         */
+        std::string m_invalidRequest;
+
+        /**
+         * \brief Serialized METHOD_NOT_FOUND response up to the id value.
+         */
+        std::string m_notFoundPrefix;
+
+        /**
+         * \brief Serialized METHOD_NOT_FOUND response after the id value.
+         */
+        std::string m_notFoundSuffix;
+
+        /**
+         * \struct MethodEntry
+         * \brief Registered RPC method.
+         */
+        struct MethodEntry
+        {
+          CallbackMethod* method; /**< The method (owned by Handler). */
+          std::string name; /**< Name of the method, cached at AddMethod time. */
+          size_t hash; /**< Hash of the name. */
+          enum ExecutionHint hint; /**< Execution hint, cached at AddMethod time. */
+          size_t stats; /**< Index of the counters of the method. */
+        };
+
+        /**
+         * \enum SlotState
+         * \brief State of a MethodSlot.
+         */
+        enum SlotState
+        {
+          SLOT_EMPTY, /**< Never used, ends a probe sequence. */
+          SLOT_USED, /**< Points to a registered method. */
+          SLOT_DELETED /**< Tombstone left by DeleteMethod. */
+        };
+
+        /**
+         * \struct MethodSlot
+         * \brief Entry of the open addressing method table.
+         */
+        struct MethodSlot
+        {
+          std::list<MethodEntry>::iterator entry; /**< Method if SLOT_USED. */
+          size_t hash; /**< Copy of entry->hash to skip most string compares. */
+          enum SlotState state; /**< State of the slot. */
+        };
+
+        /**
+         * \brief List of RPC methods (in registration order).
+         */
+        std::list<MethodEntry> m_methods;
+
+        /**
+         * \brief Open addressing (linear probing) index of m_methods keyed
+         * by method name. Size is always zero or a power of two.
+         */
+        std::vector<MethodSlot> m_slots;
+
+        /**
+         * \brief Number of tombstones in m_slots.
+         */
+        size_t m_tombstones;
+
+        /**
+         * \struct BatchContext
+         * \brief Batched call shared by the threads executing it.
          */
-        std::list<CallbackMethod*> m_methods;
+        struct BatchContext
+        {
+          const Json::Value* root; /**< The batched call. */
+          std::vector<Json::Value> results; /**< Response of each element. */
+          Json::Value::ArrayIndex next; /**< Next element to execute. */
+          size_t running; /**< Number of pool threads executing elements. */
+          size_t refs; /**< Number of references (caller and queued tasks). */
+          bool closed; /**< If the caller stopped waiting for new helpers. */
+          system_util::Mutex mutex; /**< Mutex to protect the fields above. */
+          system_util::Condition done; /**< Signaled when running reaches 0. */
+        };
+
+        /**
+         * \brief Generation of the method registry, incremented by
+         * AddMethod() and DeleteMethod().
+         */
+        unsigned long m_generation;
+
+        /**
+         * \brief Generation of the registry described by the cache.
+         */
+        unsigned long m_describeGeneration;
 
         /**
-         * \brief Find CallbackMethod by name.
-         * \param name name of the CallbackMethod
-         * \return a CallbackMethod pointer if found, 0 otherwise
+         * \brief system.describe method.
          */
-        CallbackMethod* Lookup(const std::string& name) const;
+        CallbackMethod* m_describeMethod;
+
+        /**
+         * \brief Cached system.describe result.
+         */
+        Json::Value m_describe;
+
+        /**
+         * \brief Cached system.describe response serialized up to the id
+         * value.
+         */
+        std::string m_describePrefix;
+
+        /**
+         * \brief Cached system.describe response serialized after the id
+         * value.
+         */
+        std::string m_describeSuffix;
+
+        /**
+         * \brief Mutex to protect the system.describe cache.
+         */
+        system_util::Mutex m_describeMutex;
+
+        /**
+         * \brief Rebuild the system.describe cache if the registry changed.
+         * \note m_describeMutex has to be locked.
+         */
+        void UpdateDescribe();
+
+        /**
+         * \struct MethodCounters
+         * \brief Statistics of a method recorded by one thread, written
+         * with system_util::counterAdd().
+         */
+        struct MethodCounters
+        {
+          uint64_t calls; /**< Number of calls. */
+          uint64_t errors; /**< Number of calls which failed. */
+          uint64_t total; /**< Sum of the durations in nanoseconds. */
+          uint64_t buckets[LATENCY_BUCKETS]; /**< LatencyHistogram buckets. */
+        };
+
+        /**
+         * \struct StatsShard
+         * \brief Counters of one thread.
+         */
+        struct StatsShard
+        {
+          std::vector<MethodCounters*> methods; /**< Indexed by MethodEntry::stats (NULL until the method is called). */
+        };
+
+        /**
+         * \brief If statistics are recorded.
+         */
+        bool m_stats;
+
+        /**
+         * \brief Number of counters indexes given to methods.
+         */
+        size_t m_statsCount;
+
+        /**
+         * \brief system.stats method (NULL if not added).
+         */
+        CallbackMethod* m_statsMethod;
+
+        /**
+         * \brief StatsShard of the calling thread.
+         */
+        system_util::ThreadLocal m_statsShard;
+
+        /**
+         * \brief Shards of all the threads which have called a method.
+         */
+        std::vector<StatsShard*> m_statsShards;
+
+        /**
+         * \brief Mutex to protect m_statsShards and the growth of the
+         * shards.
+         */
+        system_util::Mutex m_statsMutex;
+
+        /**
+         * \brief Call a method, recording its statistics if enabled.
+         * \param entry method
+         * \param root JSON-RPC request
+         * \param response JSON-RPC response
+         * \return value returned by the method
+         */
+        bool Call(const MethodEntry& entry, const Json::Value& root,
+            Json::Value& response);
+
+        /**
+         * \brief Record a call in the shard of the calling thread.
+         * \param index index of the counters of the method
+         * \param ns duration in nanoseconds
+         * \param error if the call failed
+         */
+        void Record(size_t index, uint64_t ns, bool error);
+
+        /**
+         * \brief Create the shard of the calling thread or the counters of
+         * a method in it.
+         * \param index index of the counters of the method
+         * \return shard of the calling thread
+         */
+        StatsShard* AddCounters(size_t index);
+
+        /**
+         * \brief Threads executing batched calls (NULL if disabled).
+         */
+        system_util::ThreadPool* m_batchPool;
+
+        /**
+         * \brief Maximum number of elements of one batch executed at the
+         * same time.
+         */
+        size_t m_batchConcurrency;
+
+        /**
+         * \brief Minimum number of elements of a parallel batch.
+         */
+        size_t m_batchThreshold;
+
+        /**
+         * \brief Execute a batched call with the batch pool.
+         * \param root JSON-RPC batched call
+         * \param response array of responses (unchanged if all elements
+         * are notifications)
+         */
+        void ProcessBatch(const Json::Value& root, Json::Value& response);
+
+        /**
+         * \brief Execute batch elements until there is none left.
+         * \param ctx batched call
+         */
+        void RunBatchElements(BatchContext* ctx);
+
+        /**
+         * \brief Pool task helping to execute a batched call.
+         * \param arg BatchContext
+         * \return NULL
+         */
+        void* RunBatch(void* arg);
+
+        /**
+         * \brief Release a reference on a batched call, the last one frees it.
+         * \param ctx batched call
+         */
+        static void ReleaseBatch(BatchContext* ctx);
+
+        /**
+         * \brief Hash a method name (FNV-1a).
+         * \param name method name
+         * \return hash value
+         */
+        static size_t Hash(const std::string& name);
+
+        /**
+         * \brief Find the slot of a method.
+         * \param name name of the method
+         * \param hash hash of the name
+         * \return index of the slot if found, m_slots.size() otherwise
+         */
+        size_t FindSlot(const std::string& name, size_t hash) const;
+
+        /**
+         * \brief Insert a method in m_slots.
+         * \param entry position of the method in m_methods
+         * \note Methods with the same name stay ordered as they were
+         * registered, so the first one registered is found first.
+         */
+        void InsertSlot(std::list<MethodEntry>::iterator entry);
+
+        /**
+         * \brief Rebuild m_slots from m_methods.
+         * \param size new size of the table (power of two)
+         */
+        void Rehash(size_t size);
+
+        /**
+         * \brief Find a method by name.
+         * \param name name of the method
+         * \return the method if found, 0 otherwise
+         */
+        const MethodEntry* Lookup(const std::string& name) const;
+
+        /**
+         * \brief Get where a single JSON-RPC request should be executed.
+         * \param root JSON-RPC request
+         * \return execution hint
+         */
+        enum ExecutionHint GetRequestHint(const Json::Value& root) const;
+
+        /**
+         * \brief Check if the message is a valid JSON-RPC request.
+         * \param root message to check validity
+         * \return true if the message is valid, false otherwise
+         */
+        static bool IsValid(const Json::Value& root);
+
+        /**
+         * \brief Append the serialization of a request id.
+         * \param out string to append to
+         * \param id id (null, number, string or boolean)
+         */
+        static void AppendId(std::string& out, const Json::Value& id);
 
         /**
          * \brief Check if the message is a valid JSON object one.
@@ -337,7 +847,7 @@ namespace Json
          * \note In case msg is a notification, response is equal to
          * Json::Value::null and the return value is true.
          */
-        bool Process(const Json::Value& root, Json::Value& response);
+        bool ProcessRequest(const Json::Value& root, Json::Value& response);
     };
   } /* namespace Rpc */
 } /* namespace Json */
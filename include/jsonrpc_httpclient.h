@@ -26,6 +26,9 @@
 #define JSONRPC_HTTPCLIENT_H 
 
 #include <iostream>
+#include <list>
+#include <vector>
+
 #include <curl/curl.h>
 
 #include "jsonrpc_client.h"
@@ -35,6 +38,130 @@ namespace Json
 {
   namespace Rpc
   {
+    class HttpClient;
+
+    /**
+     * \class HttpTransfer
+     * \brief Completion slot of a request sent by HttpClient::SendAsync().
+     *
+     * It receives the response of its own request only, so several
+     * requests can be in flight at the same time without sharing the
+     * receive list of HttpClient.
+     */
+    class HttpTransfer
+    {
+      public:
+        /**
+         * \brief Constructor.
+         */
+        HttpTransfer();
+
+        /**
+         * \brief Destructor.
+         */
+        virtual ~HttpTransfer();
+
+        /**
+         * \brief Wait for the end of the transfer.
+         * \param data response body is put in this reference
+         * \return length of the response or -1 if the transfer failed
+         */
+        ssize_t Wait(std::string& data);
+
+        /**
+         * \brief Get if the transfer has ended.
+         * \return true if the transfer has ended, false otherwise
+         */
+        bool IsReady();
+
+        /**
+         * \brief Get the libcurl result of the transfer.
+         * \return CURLE_OK if the response has been received, libcurl error
+         * code otherwise
+         * \note Only meaningful once the transfer has ended.
+         */
+        CURLcode GetError();
+
+        /**
+         * \brief Get the HTTP status code of the response.
+         * \return HTTP status code (0 if no response)
+         * \note Only meaningful once the transfer has ended.
+         */
+        long GetStatus();
+
+        /**
+         * \brief Forget the response to use the object for another request.
+         * \warning It must not be called while the transfer is in flight.
+         */
+        void Reset();
+
+      private:
+        friend class HttpClient;
+
+        /**
+         * \brief Copy constructor (private because of "resource" class).
+         * \param obj object to copy
+         */
+        HttpTransfer(const HttpTransfer& obj);
+
+        /**
+         * \brief Operator copy assignment (private because of "resource"
+         * class).
+         * \param obj object to copy
+         * \return copied object reference
+         */
+        HttpTransfer& operator=(const HttpTransfer& obj);
+
+        /**
+         * \brief Store the end of the transfer and wake up Wait().
+         * \param error libcurl result
+         * \param status HTTP status code
+         */
+        void Done(CURLcode error, long status);
+
+        /**
+         * \brief Request body, kept until the end of the transfer because
+         * libcurl does not copy it.
+         */
+        std::string m_request;
+
+        /**
+         * \brief Response body, its capacity is kept by Reset() for the
+         * next request.
+         */
+        std::string m_response;
+
+        /**
+         * \brief Easy handle of the transfer in flight.
+         */
+        CURL* m_handle;
+
+        /**
+         * \brief If the transfer has ended.
+         */
+        bool m_ready;
+
+        /**
+         * \brief libcurl result.
+         */
+        CURLcode m_error;
+
+        /**
+         * \brief HTTP status code.
+         */
+        long m_status;
+
+        /**
+         * \brief Mutex to protect m_ready, m_error and m_status.
+         */
+        system_util::Mutex m_mutex;
+
+        /**
+         * \brief Condition signaled at the end of the transfer.
+         */
+        system_util::Condition m_cond;
+    };
+
     /**
      *\class HttpClient
      * \brief JSON-RPC Http client.
@@ -99,6 +226,7 @@ namespace Json
          * \brief Receives next string from server, will wait for data.
          * \param data data received is put in this reference
          * \return length of string
+         * \note The thread sleeps until a response is stored.
          */
         ssize_t WaitRecv(std::string& data);
 
@@ -107,10 +235,20 @@ namespace Json
          * timeout seconds.
          * \param data data received is put in this reference
          * \param timeout timeout for receive operation
-         * \return length of string
+         * \return length of string or 0 if the timeout expired
          */
         ssize_t WaitRecv(std::string& data, unsigned int timeout);
 
+        /**
+         * \brief Receives next string from server, will wait for data for max
+         * timeout milliseconds.
+         * \param data data received is put in this reference
+         * \param timeout timeout for receive operation in milliseconds
+         * (monotonic clock)
+         * \return length of string or 0 if the timeout expired
+         */
+        ssize_t WaitRecvMs(std::string& data, unsigned long timeout);
+
         /**
          * \brief Sets the size of the receive string list.
          *
@@ -133,6 +271,42 @@ namespace Json
          */
         ssize_t Send(const std::string& data);
 
+        /**
+         * \brief Send data without waiting for the response.
+         *
+         * Requests sent with this method are performed concurrently by a
+         * transfer thread (started by the first call) with libcurl multi
+         * interface. Connections are kept alive and reused by the next
+         * requests.
+         * \param data data to send
+         * \param transfer receives the response, it must be valid until the
+         * end of the transfer
+         * \return true if the request is queued, false otherwise
+         */
+        bool SendAsync(const std::string& data, HttpTransfer& transfer);
+
+        /**
+         * \brief Set the maximum number of connections opened to the server
+         * by the concurrent requests (default is 8), next requests wait for
+         * a free connection.
+         * \param max number of connections (0 == unlimited)
+         * \note It has to be called before the first SendAsync().
+         */
+        void SetMaxConnections(long max);
+
+        /**
+         * \brief Get the maximum number of connections opened by the
+         * concurrent requests.
+         * \return number of connections (0 == unlimited)
+         */
+        long GetMaxConnections() const;
+
+        /**
+         * \brief Get the number of concurrent requests not yet ended.
+         * \return number of requests
+         */
+        size_t GetPendingCount();
+
         /**
          * \brief Connect to the remote machine.
          * \return true if success, false otherwise
@@ -158,7 +332,8 @@ namespace Json
          * \brief Receive data from the network.
          *
          * This is a static function that is the callback when receiving data
-         * from the network. It calls Recv providing it with 'this'.
+         * from the network. It appends the data to the body of the current
+         * response.
          * \param buffer Non-null terminated data that it received back
          * \param size size_t count of how many nmemb make up buffer
          * \param nmemb size_t multiply by size to get full size of buffer
@@ -169,20 +344,73 @@ namespace Json
                                  void*f);
 
         /**
-         * \brief Stores the last received json string from the server
-         * This allows the last json string that the server sent
-         * to the static callback to be stored within the class.
-         * The next json string from the server will overwrite this.
-         * \param data the string represention of the received json
+         * \brief Stores a complete response received from the server in the
+         * receive list.
+         * \param data the string represention of the received json, it is
+         * swapped with an empty recycled buffer
          * \note Any server errors will also be stored here.
          */
-        void StoreRecv(const std::string& data);
+        void StoreRecv(std::string& data);
+
+        /**
+         * \brief Receive data of a concurrent request.
+         * \param buffer Non-null terminated data that it received back
+         * \param size size_t count of how many nmemb make up buffer
+         * \param nmemb size_t multiply by size to get full size of buffer
+         * \param f pointer to the HttpTransfer of the request
+         * \return the size of the data received
+         */
+        static size_t StaticTransferRecv(void* buffer, size_t size,
+            size_t nmemb, void* f);
+
+        /**
+         * \brief Pop the first string of the receive list.
+         * \param data string is put in this reference
+         * \return length of string or 0 if the list is empty
+         * \note m_mutex must be locked by the caller.
+         */
+        ssize_t PopRecv(std::string& data);
+
+        /**
+         * \brief Move the first string of the receive list to the free
+         * buffers (or drop it if there are enough).
+         * \note m_mutex must be locked by the caller.
+         */
+        void RecycleFront();
 
         /**
          * \brief Initializes the class instance
          */
         void Initialize();
 
+        /**
+         * \brief Get an easy handle ready for a concurrent request.
+         * \param transfer request
+         * \return handle or NULL if error
+         * \note Handles are recycled so that they keep their settings.
+         */
+        CURL* PrepareHandle(HttpTransfer* transfer);
+
+        /**
+         * \brief End a concurrent request.
+         * \param transfer request
+         * \param error libcurl result
+         * \param status HTTP status code
+         */
+        void Finish(HttpTransfer* transfer, CURLcode error, long status);
+
+        /**
+         * \brief Transfer thread, drives the concurrent requests.
+         * \param arg unused
+         * \return NULL
+         */
+        void* Run(void* arg);
+
+        /**
+         * \brief Wake up the transfer thread.
+         */
+        void Wakeup();
+
         /**
          * \brief CURL handle.
          */
@@ -204,9 +432,72 @@ namespace Json
         int m_lastReceivedListSize;
 
         /**
-         * \brief Mutex to protected m_lastReceivedList.
+         * \brief Buffers given back by Recv() (or dropped from
+         * m_lastReceivedList), reused for the next responses.
+         */
+        std::list<std::string> m_freeBuffers;
+
+        /**
+         * \brief Body of the response being received by Send().
+         */
+        std::string m_body;
+
+        /**
+         * \brief Mutex to protected m_lastReceivedList and m_freeBuffers.
          */
         system_util::Mutex m_mutex;
+
+        /**
+         * \brief Condition signaled when a string is stored in
+         * m_lastReceivedList.
+         */
+        system_util::Condition m_recvCond;
+
+        /**
+         * \brief CURL multi handle of the concurrent requests (used only by
+         * the transfer thread).
+         */
+        CURLM* m_multiHandle;
+
+        /**
+         * \brief Easy handles created for the concurrent requests.
+         */
+        std::vector<CURL*> m_handles;
+
+        /**
+         * \brief Easy handles not used by a concurrent request.
+         */
+        std::vector<CURL*> m_freeHandles;
+
+        /**
+         * \brief Concurrent requests not yet given to m_multiHandle.
+         */
+        std::list<HttpTransfer*> m_queue;
+
+        /**
+         * \brief Number of concurrent requests not yet ended.
+         */
+        size_t m_pending;
+
+        /**
+         * \brief Maximum number of connections of the concurrent requests.
+         */
+        long m_maxConnections;
+
+        /**
+         * \brief Transfer thread (NULL if not started).
+         */
+        system_util::Thread* m_transferThread;
+
+        /**
+         * \brief If the transfer thread has to stop.
+         */
+        bool m_stop;
+
+        /**
+         * \brief Mutex to protect m_queue, m_pending and m_stop.
+         */
+        system_util::Mutex m_queueMutex;
     };
   } /* namespace Rpc */
 } /* namespace Json */
@@ -0,0 +1,94 @@
+/*
+ *  JsonRpc-Cpp - JSON-RPC implementation.
+ *  Copyright (C) 2008-2011 Sebastien Vincent <sebastien.vincent@cppextrem.com>
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**
+ * \file jsonrpc_httpserver.h
+ * \brief JSON-RPC HTTP server.
+ * \author Sebastien Vincent
+ */
+
+#ifndef JSONRPC_HTTPSERVER_H
+#define JSONRPC_HTTPSERVER_H
+
+#include "jsonrpc_common.h"
+#include "jsonrpc_tcpserver.h"
+
+namespace Json
+{
+  namespace Rpc
+  {
+    /**
+     * \class HttpServer
+     * \brief JSON-RPC server over HTTP/1.1 POST.
+     *
+     * It is a TcpServer with the HTTP_POST format: connections are kept
+     * alive, requests can be pipelined and their bodies can be chunked,
+     * responses are sent in order with a Content-Length (204 No Content for
+     * notifications). A connection is closed after the response to a
+     * request with "Connection: close" (or an HTTP/1.0 request without
+     * "Connection: keep-alive") and after a 400 Bad Request sent for an
+     * invalid stream.
+     * \note The request target and the other headers are ignored, the
+     * worker pool is not used since responses have to be in order.
+     */
+    class HttpServer : public TcpServer
+    {
+      public:
+        /**
+         * \brief Constructor.
+         * \param address network address or FQDN to bind
+         * \param port local port to bind
+         * \param backend readiness notification mechanism
+         */
+        HttpServer(const std::string& address, uint16_t port,
+            enum EventBackend backend = BACKEND_POLL);
+
+        /**
+         * \brief Constructor with a Handler shared with other servers.
+         * \param address network address or FQDN to bind
+         * \param port local port to bind
+         * \param handler JSON-RPC handler, it must outlive the server
+         * \param backend readiness notification mechanism
+         */
+        HttpServer(const std::string& address, uint16_t port,
+            Handler& handler, enum EventBackend backend = BACKEND_POLL);
+
+        /**
+         * \brief Destructor.
+         */
+        virtual ~HttpServer();
+
+      private:
+        /**
+         * \brief Copy constructor (private because of "resource" class).
+         * \param obj object to copy
+         */
+        HttpServer(const HttpServer& obj);
+
+        /**
+         * \brief Operator copy assignment (private because of "resource"
+         * class).
+         * \param obj object to copy
+         * \return copied object reference
+         */
+        HttpServer& operator=(const HttpServer& obj);
+    };
+  } /* namespace Rpc */
+} /* namespace Json */
+
+#endif /* JSONRPC_HTTPSERVER_H */
@@ -0,0 +1,228 @@
+/*
+ *  JsonRpc-Cpp - JSON-RPC implementation.
+ *  Copyright (C) 2008-2011 Sebastien Vincent <sebastien.vincent@cppextrem.com>
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+/**
+ * \file jsonrpc_metrics.h
+ * \brief Server metrics in Prometheus text format.
+ * \author Sebastien Vincent
+ */
+
+#ifndef JSONRPC_METRICS_H
+#define JSONRPC_METRICS_H
+
+#include <string>
+#include <vector>
+
+#include <json/json.h>
+
+#include "jsonrpc_handler.h"
+
+#include "system.h"
+
+namespace Json
+{
+  namespace Rpc
+  {
+    /**
+     * \enum Metric
+     * \brief Metric updated by a server.
+     */
+    enum Metric
+    {
+      METRIC_ACCEPTED, /**< Connections accepted (counter). */
+      METRIC_CLOSED, /**< Connections closed (counter). */
+      METRIC_RECEIVED_BYTES, /**< Bytes received (counter). */
+      METRIC_SENT_BYTES, /**< Bytes sent (counter). */
+      METRIC_MESSAGES, /**< Messages framed (counter). */
+      METRIC_PARSE_ERRORS, /**< Messages which are not valid JSON (counter). */
+      METRIC_FRAMING_ERRORS, /**< Invalid netstring or HTTP framing, or message too big (counter). */
+      METRIC_OUTPUT_QUEUE, /**< Bytes of responses waiting to be sent (gauge). */
+      METRIC_JOB_QUEUE, /**< Requests waiting for a worker thread (gauge). */
+      METRIC_COUNT /**< Number of metrics. */
+    };
+
+    /**
+     * \class Metrics
+     * \brief Registry of the metrics of one or several servers.
+     *
+     * Servers registered with Server::SetMetrics() update their transport
+     * metrics, the registry also gets the per-method statistics of their
+     * Handler (see Handler::EnableStats()). Render() writes everything in
+     * the Prometheus text exposition format, each metric labelled with the
+     * name given to its server.
+     *
+     * \code
+     * Metrics metrics;
+     *
+     * tcpServer.SetMetrics(metrics, "tcp", true);
+     * udpServer.SetMetrics(metrics, "udp");
+     * \endcode
+     * \note Each thread updates its own counters, Add() takes no lock
+     * except the first time a thread updates a server.
+     */
+    class Metrics
+    {
+      public:
+        /**
+         * \brief Constructor.
+         */
+        Metrics();
+
+        /**
+         * \brief Destructor.
+         */
+        virtual ~Metrics();
+
+        /**
+         * \brief Register a server.
+         * \param name value of the "server" label, servers with the same
+         * name share their metrics
+         * \param handler handler of the server, its statistics are enabled
+         * (methods of a handler shared by several servers are labelled with
+         * the first one)
+         * \return index of the server given to Add()
+         * \warning Call it before the server and the handler are used.
+         */
+        size_t AddServer(const std::string& name, Handler& handler);
+
+        /**
+         * \brief Add the system.metrics RPC method to a handler, it returns
+         * Render() as a string.
+         * \param handler handler
+         */
+        void AddMethod(Handler& handler);
+
+        /**
+         * \brief Update a metric.
+         * \param server index returned by AddServer()
+         * \param metric metric
+         * \param value value to add (negative to decrease a gauge)
+         */
+        void Add(size_t server, enum Metric metric, int64_t value);
+
+        /**
+         * \brief Get the current value of a metric.
+         * \param server index returned by AddServer()
+         * \param metric metric
+         * \return sum of the updates of all the threads
+         */
+        int64_t Get(size_t server, enum Metric metric);
+
+        /**
+         * \brief Write all the metrics in Prometheus text format.
+         * \param out string to append to
+         */
+        void Render(std::string& out);
+
+        /**
+         * \brief RPC method that get the metrics in Prometheus text format.
+         * \param msg request
+         * \param response response
+         * \return true
+         */
+        bool SystemMetrics(const Json::Value& msg, Json::Value& response);
+
+      private:
+        /**
+         * \brief Copy constructor (private because of "resource" class).
+         * \param obj object to copy
+         */
+        Metrics(const Metrics& obj);
+
+        /**
+         * \brief Operator copy assignment (private because of "resource"
+         * class).
+         * \param obj object to copy
+         * \return copied object reference
+         */
+        Metrics& operator=(const Metrics& obj);
+
+        /**
+         * \struct Shard
+         * \brief Values updated by one thread.
+         */
+        struct Shard
+        {
+          std::vector<uint64_t> values; /**< Indexed by server * METRIC_COUNT + metric, written with system_util::counterAdd(). */
+        };
+
+        /**
+         * \struct HandlerEntry
+         * \brief Handler of a registered server.
+         */
+        struct HandlerEntry
+        {
+          Handler* handler; /**< The handler. */
+          size_t server; /**< First server which uses it. */
+        };
+
+        /**
+         * \brief Create the shard of the calling thread or make it big
+         * enough for all the servers.
+         * \return shard of the calling thread
+         */
+        Shard* AddShard();
+
+        /**
+         * \brief Append a label value, escaped.
+         * \param out string to append to
+         * \param value value
+         */
+        static void AppendLabel(std::string& out, const std::string& value);
+
+        /**
+         * \brief Append the method metrics of a handler.
+         * \param out string to append to
+         * \param server value of the "server" label
+         * \param stats statistics of the handler methods
+         * \param metric which metric (0 calls, 1 errors, 2 duration)
+         */
+        static void RenderMethods(std::string& out, const std::string& server,
+            const std::vector<MethodStats>& stats, int metric);
+
+        /**
+         * \brief Names of the servers.
+         */
+        std::vector<std::string> m_servers;
+
+        /**
+         * \brief Handlers of the servers.
+         */
+        std::vector<HandlerEntry> m_handlers;
+
+        /**
+         * \brief Shard of the calling thread.
+         */
+        system_util::ThreadLocal m_shard;
+
+        /**
+         * \brief Shards of all the threads which have updated a metric.
+         */
+        std::vector<Shard*> m_shards;
+
+        /**
+         * \brief Mutex to protect m_shards and the growth of the shards.
+         */
+        system_util::Mutex m_mutex;
+    };
+  } /* namespace Rpc */
+} /* namespace Json */
+
+#endif /* JSONRPC_METRICS_H */
+
@@ -0,0 +1,182 @@
+/*
+ *  JsonRpc-Cpp - JSON-RPC implementation.
+ *  Copyright (C) 2008-2011 Sebastien Vincent <sebastien.vincent@cppextrem.com>
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**
+ * \file jsonrpc_reactorgroup.h
+ * \brief JSON-RPC multi-reactor server.
+ * \author Sebastien Vincent
+ */
+
+#ifndef JSONRPC_REACTORGROUP_H
+#define JSONRPC_REACTORGROUP_H
+
+#include <vector>
+
+#include "jsonrpc_common.h"
+#include "jsonrpc_handler.h"
+#include "jsonrpc_server.h"
+
+#include "networking.h"
+#include "system.h"
+
+namespace Json
+{
+  namespace Rpc
+  {
+    /**
+     * \class ReactorGroup
+     * \brief Several servers bound on the same address and port with
+     * SO_REUSEPORT, each one driven by its own thread.
+     *
+     * The kernel spreads the connections (TCP) or datagrams (UDP) between
+     * the sockets. All the servers share the same Handler, so a method is
+     * added once for all of them.
+     * \warning Methods are called from several threads at the same time,
+     * and methods must not be added or deleted while the group is started.
+     * \note SO_REUSEPORT is needed (Linux 3.9 or later, BSD).
+     */
+    class ReactorGroup
+    {
+      public:
+        /**
+         * \brief Constructor.
+         * \param address network address or FQDN to bind
+         * \param port local port to bind
+         * \param protocol transport protocol (TcpServer or UdpServer)
+         * \param reactors number of servers and threads
+         * \param backend readiness notification mechanism (TCP only)
+         */
+        ReactorGroup(const std::string& address, uint16_t port,
+            enum networking::TransportProtocol protocol, size_t reactors,
+            enum EventBackend backend = BACKEND_POLL);
+
+        /**
+         * \brief Destructor, stops the reactors.
+         */
+        virtual ~ReactorGroup();
+
+        /**
+         * \brief Bind all the servers and start one thread per server.
+         * \return true if success, false otherwise (already started or a
+         * server still bound)
+         * \note It can be called again after Stop().
+         */
+        bool Start();
+
+        /**
+         * \brief Stop the threads and close all the servers, listen
+         * sockets included.
+         * \note It returns after at most about 100 ms, the time for each
+         * thread to come back from WaitMessage().
+         */
+        void Stop();
+
+        /**
+         * \brief Set the encapsulated format of all the servers.
+         * \param format encapsulated format
+         */
+        void SetEncapsulatedFormat(enum EncapsulatedFormat format);
+
+        /**
+         * \brief Add a RPC method to the shared handler.
+         * \param method RPC method
+         */
+        void AddMethod(CallbackMethod* method);
+
+        /**
+         * \brief Delete a RPC method from the shared handler.
+         * \param method RPC method name
+         */
+        void DeleteMethod(const std::string& method);
+
+        /**
+         * \brief Get the number of reactors.
+         * \return number of servers and threads
+         */
+        size_t GetReactorCount() const;
+
+        /**
+         * \brief Get a server, for instance to configure it before Start().
+         * \param index index of the server (less than GetReactorCount())
+         * \return server (TcpServer or UdpServer according to protocol)
+         */
+        Server* GetServer(size_t index) const;
+
+      private:
+        /**
+         * \brief Copy constructor (private because of "resource" class).
+         * \param obj object to copy
+         */
+        ReactorGroup(const ReactorGroup& obj);
+
+        /**
+         * \brief Operator copy assignment (private because of "resource"
+         * class).
+         * \param obj object to copy
+         * \return copied object reference
+         */
+        ReactorGroup& operator=(const ReactorGroup& obj);
+
+        /**
+         * \brief Event loop of a reactor thread.
+         * \param arg server driven by the thread
+         * \return NULL
+         */
+        void* Run(void* arg);
+
+        /**
+         * \brief Get if the reactors have to stop.
+         * \return true if Stop() has been called, false otherwise
+         */
+        bool IsStopped();
+
+        /**
+         * \brief Transport protocol of the servers.
+         */
+        enum networking::TransportProtocol m_protocol;
+
+        /**
+         * \brief Handler shared by all the servers.
+         */
+        Handler m_handler;
+
+        /**
+         * \brief Servers.
+         */
+        std::vector<Server*> m_servers;
+
+        /**
+         * \brief Threads, one per server (empty if not started).
+         */
+        std::vector<system_util::Thread*> m_threads;
+
+        /**
+         * \brief If the reactors have to stop.
+         */
+        bool m_stop;
+
+        /**
+         * \brief Mutex to protect m_stop.
+         */
+        system_util::Mutex m_mutex;
+    };
+  } /* namespace Rpc */
+} /* namespace Json */
+
+#endif /* JSONRPC_REACTORGROUP_H */
+
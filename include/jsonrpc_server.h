@@ -27,6 +27,7 @@
 
 #include "jsonrpc_common.h"
 #include "jsonrpc_handler.h"
+#include "jsonrpc_metrics.h"
 
 #include "networking.h"
 
@@ -48,6 +49,14 @@ namespace Json
          */
         Server(const std::string& address, uint16_t port);
 
+        /**
+         * \brief Constructor with a Handler shared with other servers.
+         * \param address network address or FQDN to bind
+         * \param port local port to bind
+         * \param handler JSON-RPC handler, it must outlive the server
+         */
+        Server(const std::string& address, uint16_t port, Handler& handler);
+
         /**
          * \brief Destructor.
          */
@@ -96,7 +105,22 @@ namespace Json
          * \brief Bind the socket.
          * \return true if success, false otherwise
          */
-        bool Bind();
+        virtual bool Bind();
+
+        /**
+         * \brief Allow other sockets to bind the same address and port
+         * (SO_REUSEPORT), the kernel spreads connections and datagrams
+         * between them.
+         * \param reuse true to enable, false to disable (default)
+         * \note It has to be set before Bind().
+         */
+        void SetReusePort(bool reuse);
+
+        /**
+         * \brief Get if the socket is bound with SO_REUSEPORT.
+         * \return true if enabled, false otherwise
+         */
+        bool GetReusePort() const;
 
         /**
          * \brief Receive data from the network and process it.
@@ -126,6 +150,16 @@ namespace Json
          */
         void DeleteMethod(const std::string& method);
 
+        /**
+         * \brief Update metrics of a registry.
+         * \param metrics registry, it must outlive the server
+         * \param name value of the "server" label of the metrics
+         * \param method also add the system.metrics RPC method
+         * \warning Call it before the server is used.
+         */
+        void SetMetrics(Metrics& metrics, const std::string& name,
+            bool method = false);
+
       protected:
         /**
          * \brief Copy constructor (private because of "resource" class).
@@ -152,9 +186,36 @@ namespace Json
         enum networking::TransportProtocol m_protocol;
 
         /**
-         * \brief JSON-RPC handler.
+         * \brief JSON-RPC handler (*m_handler or a shared one).
          */
-        Handler m_jsonHandler;
+        Handler& m_jsonHandler;
+
+        /**
+         * \brief JSON reader of this server.
+         */
+        Json::Reader m_reader;
+
+        /**
+         * \brief JSON writer of this server.
+         */
+        Json::FastWriter m_writer;
+
+        /**
+         * \brief Update a metric if a registry is set.
+         * \param metric metric
+         * \param value value to add (negative to decrease a gauge)
+         */
+        void Count(enum Metric metric, int64_t value);
+
+        /**
+         * \brief Metrics registry (NULL if none).
+         */
+        Metrics* m_metrics;
+
+        /**
+         * \brief Index of the server in m_metrics.
+         */
+        size_t m_metricsServer;
 
       private:
         /**
@@ -171,6 +232,17 @@ namespace Json
          * \brief Encapsulated format.
          */
         enum EncapsulatedFormat m_format;
+
+        /**
+         * \brief If socket is bound with SO_REUSEPORT.
+         */
+        bool m_reusePort;
+
+        /**
+         * \brief JSON-RPC handler owned by the server (NULL if it uses a
+         * shared one).
+         */
+        Handler* m_handler;
     };
   } /* namespace Rpc */
 } /* namespace Json */
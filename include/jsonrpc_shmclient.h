@@ -0,0 +1,139 @@
+/*
+ *  JsonRpc-Cpp - JSON-RPC implementation.
+ *  Copyright (C) 2008-2011 Sebastien Vincent <sebastien.vincent@cppextrem.com>
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**
+ * \file jsonrpc_shmclient.h
+ * \brief JSON-RPC shared-memory client.
+ * \author Sebastien Vincent
+ */
+
+#ifndef JSONRPC_SHMCLIENT_H
+#define JSONRPC_SHMCLIENT_H
+
+#include "jsonrpc_client.h"
+#include "jsonrpc_framer.h"
+
+#include "shm.h"
+
+namespace Json
+{
+  namespace Rpc
+  {
+    /**
+     * \class ShmClient
+     * \brief JSON-RPC client of a ShmServer.
+     *
+     * Connect() creates the shared segment and passes it to the server,
+     * messages are then written to and read from its rings. A side which
+     * waits spins for a while before sleeping (see shm::getSpinCount()),
+     * so a quick response is received without system call.
+     * \note It is only available on Linux. HTTP_POST format is not
+     * supported.
+     */
+    class ShmClient : public Client
+    {
+      public:
+        /**
+         * \brief Constructor.
+         * \param path path of the server socket
+         * \param ringSize size of each ring of the shared segment
+         */
+        ShmClient(const std::string& path,
+            size_t ringSize = shm::DEFAULT_RING_SIZE);
+
+        /**
+         * \brief Destructor.
+         */
+        virtual ~ShmClient();
+
+        /**
+         * \brief Connect to the server and pass it the shared segment.
+         * \return true if success, false otherwise
+         */
+        virtual bool Connect();
+
+        /**
+         * \brief Receive a message.
+         * \param data if a message is received it will put in this reference
+         * \return size of the message, 0 if the server has gone or -1 if
+         * error
+         * \note This method will blocked until a whole message comes.
+         */
+        virtual ssize_t Recv(std::string& data);
+
+        /**
+         * \brief Close the connection and release the shared segment.
+         */
+        virtual void Close();
+
+        /**
+         * \brief Send data.
+         * \param data data to send
+         * \return number of bytes sent (with the netstring header and
+         * trailer if any) or -1 if error
+         * \note This method will blocked while the ring is full.
+         */
+        ssize_t Send(const std::string& data);
+
+        /**
+         * \brief Get the path of the server socket.
+         * \return path
+         */
+        std::string GetPath() const;
+
+      private:
+        /**
+         * \brief Copy constructor (private because of "resource" class).
+         * \param obj object to copy
+         */
+        ShmClient(const ShmClient& obj);
+
+        /**
+         * \brief Operator copy assignment (private because of "resource"
+         * class).
+         * \param obj object to copy
+         * \return copied object reference
+         */
+        ShmClient& operator=(const ShmClient& obj);
+
+        /**
+         * \brief Wait for data or room in the rings.
+         * \param room true to wait for room, false to wait for data
+         * \return true if ready, false if the server has gone
+         */
+        bool Wait(bool room);
+
+        /**
+         * \brief Rings shared with the server.
+         */
+        shm::Channel m_channel;
+
+        /**
+         * \brief Size of each ring.
+         */
+        size_t m_ringSize;
+
+        /**
+         * \brief Receive buffer.
+         */
+        Framer m_framer;
+    };
+  } /* namespace Rpc */
+} /* namespace Json */
+
+#endif /* JSONRPC_SHMCLIENT_H */
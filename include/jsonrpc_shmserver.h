@@ -0,0 +1,207 @@
+/*
+ *  JsonRpc-Cpp - JSON-RPC implementation.
+ *  Copyright (C) 2008-2011 Sebastien Vincent <sebastien.vincent@cppextrem.com>
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**
+ * \file jsonrpc_shmserver.h
+ * \brief JSON-RPC shared-memory server.
+ * \author Sebastien Vincent
+ */
+
+#ifndef JSONRPC_SHMSERVER_H
+#define JSONRPC_SHMSERVER_H
+
+#include <list>
+#include <map>
+#include <vector>
+
+#include <poll.h>
+
+#include "jsonrpc_common.h"
+#include "jsonrpc_server.h"
+#include "jsonrpc_framer.h"
+
+#include "shm.h"
+
+namespace Json
+{
+  namespace Rpc
+  {
+    /**
+     * \class ShmServer
+     * \brief JSON-RPC server for clients on the same host which exchange
+     * the messages in shared memory.
+     *
+     * A client connects to a Unix domain socket and passes a shared segment
+     * with two rings (see shm::Channel), the socket is then only used to
+     * detect that the client has gone. Messages are framed in the rings
+     * like on a stream socket (RAW or NETSTRING). The server only wakes up
+     * when a client writes its event, which a client only does if the
+     * server sleeps: while requests keep coming, there is no system call.
+     *
+     * Requests are processed in the thread of WaitMessage(), a client is
+     * served until its ring is empty. Responses which do not fit in the
+     * ring wait in the server until the client reads, requests are not
+     * read meanwhile.
+     * \note It is only available on Linux. HTTP_POST format is not
+     * supported.
+     */
+    class ShmServer : public Server
+    {
+      public:
+        /**
+         * \brief Constructor.
+         * \param path path of the Unix socket ('@' prefix for an abstract
+         * name)
+         */
+        ShmServer(const std::string& path);
+
+        /**
+         * \brief Constructor with a Handler shared with other servers.
+         * \param path path of the Unix socket ('@' prefix for an abstract
+         * name)
+         * \param handler JSON-RPC handler, it must outlive the server
+         */
+        ShmServer(const std::string& path, Handler& handler);
+
+        /**
+         * \brief Destructor, closes the connections and removes the socket
+         * file.
+         */
+        virtual ~ShmServer();
+
+        /**
+         * \brief Listen incoming connections.
+         * \return true if success, false otherwise
+         */
+        bool Listen() const;
+
+        /**
+         * \brief Accept a new client and receive its shared segment.
+         * \return true if success, false otherwise
+         */
+        bool Accept();
+
+        /**
+         * \brief Wait for clients, messages and room in the rings.
+         * \param ms millisecond to wait (0 means infinite)
+         */
+        virtual void WaitMessage(uint32_t ms);
+
+        /**
+         * \brief Process the messages of a client until its ring is empty.
+         * \param fd socket descriptor of the client
+         * \return true if success, false if the client has been dropped
+         */
+        virtual bool Recv(int fd);
+
+        /**
+         * \brief Close listen socket and all client connections.
+         */
+        virtual void Close();
+
+        /**
+         * \brief Get the list of clients.
+         * \return list of client socket descriptors
+         */
+        const std::list<int> GetClients() const;
+
+        /**
+         * \brief Get the path of the socket.
+         * \return path
+         */
+        std::string GetPath() const;
+
+      private:
+        /**
+         * \brief Copy constructor (private because of "resource" class).
+         * \param obj object to copy
+         */
+        ShmServer(const ShmServer& obj);
+
+        /**
+         * \brief Operator copy assignment (private because of "resource"
+         * class).
+         * \param obj object to copy
+         * \return copied object reference
+         */
+        ShmServer& operator=(const ShmServer& obj);
+
+        /**
+         * \struct Connection
+         * \brief Client connection.
+         */
+        struct Connection
+        {
+          shm::Channel channel; /**< Rings shared with the client. */
+          Framer framer; /**< Requests read from the ring. */
+          std::string output; /**< Responses which did not fit in the ring. */
+          size_t outputOffset; /**< Bytes of output already written. */
+        };
+
+        /**
+         * \brief Write a response or queue it if the ring is full.
+         * \param conn connection
+         * \param data JSON-RPC response
+         */
+        void SendResponse(Connection* conn, const std::string& data);
+
+        /**
+         * \brief Write the queued responses.
+         * \param conn connection
+         * \return true if all are written, false otherwise
+         */
+        bool Flush(Connection* conn);
+
+        /**
+         * \brief Process the complete messages read from the ring.
+         * \param conn connection
+         * \return true if success, false if the message stream is invalid
+         */
+        bool ProcessMessages(Connection* conn);
+
+        /**
+         * \brief Close a client connection.
+         * \param fd socket descriptor of the client
+         */
+        void RemoveClient(int fd);
+
+        /**
+         * \brief Connections indexed by socket descriptor.
+         */
+        std::map<int, Connection*> m_connections;
+
+        /**
+         * \brief Descriptors to poll: listen socket, then socket and event
+         * of each client.
+         */
+        std::vector<struct pollfd> m_pollfds;
+
+        /**
+         * \brief Clients to remove at the end of WaitMessage().
+         */
+        std::list<int> m_purge;
+
+        /**
+         * \brief Response already serialized by the handler.
+         */
+        std::string m_serialized;
+    };
+  } /* namespace Rpc */
+} /* namespace Json */
+
+#endif /* JSONRPC_SHMSERVER_H */
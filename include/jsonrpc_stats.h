@@ -0,0 +1,177 @@
+/*
+ *  JsonRpc-Cpp - JSON-RPC implementation.
+ *  Copyright (C) 2008-2011 Sebastien Vincent <sebastien.vincent@cppextrem.com>
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+/**
+ * \file jsonrpc_stats.h
+ * \brief JSON-RPC method statistics.
+ * \author Sebastien Vincent
+ */
+
+#ifndef JSONRPC_STATS_H
+#define JSONRPC_STATS_H
+
+#include <cstddef>
+
+#include <stdint.h>
+
+#include <string>
+
+namespace Json
+{
+  namespace Rpc
+  {
+    /**
+     * \var LATENCY_SUB_BUCKETS
+     * \brief Number of buckets of a LatencyHistogram for each power of two,
+     * a value is known within 1/8 (12.5%).
+     */
+    static const size_t LATENCY_SUB_BUCKETS = 8;
+
+    /**
+     * \var LATENCY_MAX_EXPONENT
+     * \brief Values of a LatencyHistogram from 2^LATENCY_MAX_EXPONENT
+     * nanoseconds (about 18 minutes) go in the last bucket.
+     */
+    static const size_t LATENCY_MAX_EXPONENT = 40;
+
+    /**
+     * \var LATENCY_BUCKETS
+     * \brief Number of buckets of a LatencyHistogram: values up to
+     * LATENCY_SUB_BUCKETS have their own bucket, then each power of two is
+     * split into LATENCY_SUB_BUCKETS.
+     */
+    static const size_t LATENCY_BUCKETS = (LATENCY_MAX_EXPONENT - 2) *
+      LATENCY_SUB_BUCKETS;
+
+    /**
+     * \class LatencyHistogram
+     * \brief Log-linear histogram of durations in nanoseconds.
+     *
+     * The bucket of a value is computed with a few shifts, buckets are
+     * precise for small values and grow with them, so the relative error
+     * of a percentile stays under 12.5% from nanoseconds to minutes.
+     */
+    class LatencyHistogram
+    {
+      public:
+        /**
+         * \brief Constructor, the histogram is empty.
+         */
+        LatencyHistogram();
+
+        /**
+         * \brief Get the bucket of a value.
+         * \param ns duration in nanoseconds
+         * \return bucket index (lower than LATENCY_BUCKETS)
+         */
+        static size_t GetBucket(uint64_t ns);
+
+        /**
+         * \brief Get the biggest value of a bucket.
+         * \param bucket bucket index
+         * \return duration in nanoseconds
+         */
+        static uint64_t GetUpperBound(size_t bucket);
+
+        /**
+         * \brief Add a value.
+         * \param ns duration in nanoseconds
+         */
+        void Add(uint64_t ns);
+
+        /**
+         * \brief Add values already sorted in a bucket, their sum has to be
+         * given to AddTotal().
+         * \param bucket bucket index
+         * \param count number of values
+         */
+        void Add(size_t bucket, uint64_t count);
+
+        /**
+         * \brief Add to the sum of the values.
+         * \param ns duration in nanoseconds
+         */
+        void AddTotal(uint64_t ns);
+
+        /**
+         * \brief Add the values of another histogram.
+         * \param histogram histogram
+         */
+        void Merge(const LatencyHistogram& histogram);
+
+        /**
+         * \brief Get the number of values in a bucket.
+         * \param bucket bucket index
+         * \return number of values
+         */
+        uint64_t GetBucketCount(size_t bucket) const;
+
+        /**
+         * \brief Get the number of values.
+         * \return number of values
+         */
+        uint64_t GetCount() const;
+
+        /**
+         * \brief Get the sum of the values.
+         * \return duration in nanoseconds
+         */
+        uint64_t GetTotal() const;
+
+        /**
+         * \brief Get a percentile.
+         * \param percent percentage of values lower or equal (0 to 100)
+         * \return upper bound of the bucket of the percentile in
+         * nanoseconds, 0 if the histogram is empty
+         */
+        uint64_t GetPercentile(double percent) const;
+
+      private:
+        /**
+         * \brief Number of values of each bucket.
+         */
+        uint64_t m_buckets[LATENCY_BUCKETS];
+
+        /**
+         * \brief Number of values.
+         */
+        uint64_t m_count;
+
+        /**
+         * \brief Sum of the values.
+         */
+        uint64_t m_total;
+    };
+
+    /**
+     * \struct MethodStats
+     * \brief Statistics of one RPC method.
+     */
+    struct MethodStats
+    {
+      std::string name; /**< Name of the method. */
+      uint64_t calls; /**< Number of calls. */
+      uint64_t errors; /**< Number of calls which failed or answered an error. */
+      LatencyHistogram latency; /**< Duration of the calls. */
+    };
+  } /* namespace Rpc */
+} /* namespace Json */
+
+#endif /* JSONRPC_STATS_H */
+
@@ -28,6 +28,7 @@
 #include <iostream>
 
 #include "jsonrpc_client.h"
+#include "jsonrpc_framer.h"
 
 namespace Json
 {
@@ -53,17 +54,27 @@ namespace Json
         virtual ~TcpClient();
 
         /**
-         * \brief Receive data from the network.
-         * \param data if data is received it will put in this reference
-         * \return number of bytes received or -1 if error
-         * \note This method will blocked until data comes.
+         * \brief Receive a message from the network.
+         * \param data if a message is received it will put in this reference
+         * \return size of the message, 0 if connection is closed or -1 if
+         * error
+         * \note This method will blocked until a whole message comes. When
+         * several messages come in the same segment, the next ones are kept
+         * for the next calls.
          */
         virtual ssize_t Recv(std::string& data);
 
+        /**
+         * \brief Close socket and drop the data not yet received.
+         */
+        virtual void Close();
+
         /**
          * \brief Send data.
          * \param data data to send
-         * \return number of bytes sent or -1 if error
+         * \return number of bytes sent (with the netstring header and
+         * trailer if any) or -1 if error
+         * \note All the data is sent, payload is not copied.
          */
         ssize_t Send(const std::string& data);
 
@@ -82,6 +93,10 @@ namespace Json
          */
         TcpClient& operator=(const TcpClient& obj);
 
+        /**
+         * \brief Receive buffer.
+         */
+        Framer m_framer;
     };
   } /* namespace Rpc */
 } /* namespace Json */
@@ -26,9 +26,17 @@
 #define JSONRPC_TCPSERVER_H
 
 #include <list>
+#include <set>
+#include <vector>
+
+#include <poll.h>
 
 #include "jsonrpc_common.h"
 #include "jsonrpc_server.h"
+#include "jsonrpc_framer.h"
+
+#include "system.h"
+#include "uring.h"
 
 namespace Json
 {
@@ -45,8 +53,23 @@ namespace Json
          * \brief Constructor.
          * \param address network address or FQDN to bind
          * \param port local port to bind
+         * \param backend readiness notification mechanism
+         * \note If BACKEND_IO_URING is not supported by the system,
+         * BACKEND_EPOLL is tried, and if BACKEND_EPOLL is not supported
+         * BACKEND_POLL is used instead (see GetBackend()).
+         */
+        TcpServer(const std::string& address, uint16_t port,
+            enum EventBackend backend = BACKEND_POLL);
+
+        /**
+         * \brief Constructor with a Handler shared with other servers.
+         * \param address network address or FQDN to bind
+         * \param port local port to bind
+         * \param handler JSON-RPC handler, it must outlive the server
+         * \param backend readiness notification mechanism
          */
-        TcpServer(const std::string& address, uint16_t port);
+        TcpServer(const std::string& address, uint16_t port, Handler& handler,
+            enum EventBackend backend = BACKEND_POLL);
 
         /**
          * \brief Destructor.
@@ -55,9 +78,13 @@ namespace Json
 
         /**
          * \brief Receive data from the network and process it.
+         *
+         * Data is appended to the receive buffer of the connection and all
+         * the complete messages it contains are processed, an incomplete
+         * message waits for the next call.
          * \param fd socket descriptor to receive data
-         * \return true if message has been correctly received, processed and
-         * response sent, false otherwise (mainly send/recv error)
+         * \return true if messages have been correctly received, processed and
+         * responses sent, false otherwise (mainly send/recv error)
          * \note This method will blocked until data comes.
          */
         virtual bool Recv(int fd);
@@ -66,15 +93,19 @@ namespace Json
          * \brief Send data.
          * \param fd file descriptor of the client TCP socket
          * \param data data to send
-         * \return number of bytes sent or -1 if error
+         * \return number of bytes sent or queued (with the netstring or HTTP
+         * header and trailer if any) or -1 if error
+         * \note Client sockets are non-blocking, what the socket cannot take
+         * is queued and sent by WaitMessage(). With BACKEND_IO_URING, all of
+         * it is queued and handed to the kernel by the next WaitMessage().
          */
         virtual ssize_t Send(int fd, const std::string& data);
 
         /**
          * \brief Wait message.
          *
-         * This function do a select() on the socket and Process() immediately 
-         * the JSON-RPC message.
+         * This function do a poll() (or epoll_wait(), or io_uring_enter())
+         * on the sockets and Process() immediately the JSON-RPC messages.
          * \param ms millisecond to wait (0 means infinite)
          */
         virtual void WaitMessage(uint32_t ms);
@@ -84,6 +115,82 @@ namespace Json
          */
         bool Listen() const;
 
+        /**
+         * \brief Set the maximum size of a received message.
+         *
+         * A connection which sends a bigger message is closed.
+         * \param size maximum size in bytes (0 means unlimited)
+         * \note Default is 16 MB.
+         */
+        void SetMaxMessageSize(size_t size);
+
+        /**
+         * \brief Get the maximum size of a received message.
+         * \return maximum size in bytes (0 means unlimited)
+         */
+        size_t GetMaxMessageSize() const;
+
+        /**
+         * \brief Set the output queue watermarks of the connections.
+         *
+         * When the responses waiting to be sent to a client reach the high
+         * watermark, the server stops reading and processing its requests
+         * until the client has read enough of them to go down to the low
+         * watermark. A slow client thus only holds about high bytes of
+         * memory and does not delay the other clients.
+         * \param low low watermark in bytes
+         * \param high high watermark in bytes (0 means unlimited)
+         * \return true if success, false if low is greater than high
+         * \note Default is 256 KB and 1 MB.
+         */
+        bool SetWatermarks(size_t low, size_t high);
+
+        /**
+         * \brief Get the low watermark of the output queues.
+         * \return low watermark in bytes
+         */
+        size_t GetLowWatermark() const;
+
+        /**
+         * \brief Get the high watermark of the output queues.
+         * \return high watermark in bytes (0 means unlimited)
+         */
+        size_t GetHighWatermark() const;
+
+        /**
+         * \brief Get the number of bytes waiting to be sent to a client.
+         * \param fd client socket
+         * \return number of bytes in the output queue
+         */
+        size_t GetOutputQueueSize(int fd) const;
+
+        /**
+         * \brief Execute the RPC methods in a pool of worker threads.
+         *
+         * The thread calling WaitMessage() still receives and parses the
+         * requests, then hands them to the workers unless all the methods
+         * called are flagged EXECUTE_INLINE (see RpcMethod::SetExecutionHint).
+         * Responses are sent back by the thread calling WaitMessage().
+         * \param threads number of worker threads (0 disables the pool)
+         * \param queueDepth maximum number of requests waiting for a worker,
+         * when it is reached the requests are executed by the thread calling
+         * WaitMessage() until a worker is available (0 means unlimited)
+         * \return true if success, false otherwise
+         * \note Responses to pipelined requests may be sent in a different
+         * order than the requests. HTTP_POST requests are always executed
+         * inline since HTTP responses have to be in order.
+         * \warning Pooled methods are called from several threads at the
+         * same time, and methods must not be added or deleted while the
+         * server is running.
+         */
+        bool SetWorkerPool(size_t threads, size_t queueDepth);
+
+        /**
+         * \brief Get the readiness notification mechanism in use.
+         * \return backend
+         */
+        enum EventBackend GetBackend() const;
+
         /**
          * \brief Accept a new client socket.
          * \return -1 if error, 0 otherwise
@@ -117,14 +224,283 @@ namespace Json
         TcpServer& operator=(const TcpServer& obj);
 
         /**
-         * \brief List of client sockets.
+         * \struct Connection
+         * \brief State of a client connection.
          */
-        std::list<int> m_clients;
+        struct Connection
+        {
+          size_t index; /**< Position of the socket in m_clients. */
+          uint64_t id; /**< Unique identifier, descriptors are reused. */
+          Framer framer; /**< Receive buffer. */
+          std::string output; /**< Output queue, bytes not sent yet. */
+          size_t outputOffset; /**< Bytes of output already sent. */
+          bool reading; /**< If requests are read (below watermarks). */
+          bool closing; /**< If it is closed once the output queue is sent (HTTP_POST). */
+          short events; /**< Events registered in poll() or epoll. */
+          int fd; /**< Client socket. */
+          std::string inflight; /**< Bytes given to a send in flight (BACKEND_IO_URING only). */
+          size_t inflightOffset; /**< Bytes of inflight already sent. */
+          bool sending; /**< If a send is in flight. */
+          bool receiving; /**< If a multishot receive is in flight. */
+          bool cancelling; /**< If the cancellation of the receive is in flight. */
+          unsigned int pendingOps; /**< io_uring requests not completed, the connection is deleted after them. */
+          size_t queued; /**< Queued size last added to METRIC_OUTPUT_QUEUE. */
+        };
+
+        /**
+         * \struct Job
+         * \brief Request executed by the worker pool.
+         */
+        struct Job
+        {
+          int fd; /**< Client socket. */
+          uint64_t id; /**< Identifier of the connection. */
+          Json::Value request; /**< Parsed request. */
+          std::string response; /**< Serialized response. */
+        };
+
+        /**
+         * \brief Execute a request (called by the worker threads).
+         * \param arg Job pointer
+         * \return NULL
+         */
+        void* ProcessJob(void* arg);
+
+        /**
+         * \brief Send the responses produced by the worker threads.
+         */
+        void SendCompleted();
+
+        /**
+         * \brief Stop the worker pool and send the last responses.
+         */
+        void StopWorkerPool();
+
+        /**
+         * \brief Get the state of a client connection.
+         * \param fd client socket
+         * \return connection or NULL if fd is not a client socket
+         */
+        Connection* GetConnection(int fd) const;
+
+        /**
+         * \brief Encode and send a response, what the socket cannot take is
+         * appended to the output queue of the connection.
+         * \param fd client socket
+         * \param data response
+         * \param status HTTP status code (HTTP_POST only), an empty 200
+         * response is sent as 204
+         * \return true if success, false otherwise (connection is purged)
+         */
+        bool SendResponse(int fd, const std::string& data, int status = 200);
+
+        /**
+         * \brief Send the output queue of a connection (socket is writable)
+         * and resume reading below the low watermark.
+         * \param fd client socket
+         * \return true if success, false otherwise (connection is purged)
+         */
+        bool Flush(int fd);
+
+        /**
+         * \brief Process the complete messages received on a connection.
+         * \param fd client socket
+         * \param conn connection
+         * \return true if success, false otherwise
+         * \note It stops when the output queue reaches the high watermark,
+         * remaining messages are processed by Flush().
+         */
+        bool ProcessMessages(int fd, Connection* conn);
+
+        /**
+         * \brief Register the events to wait for a connection, according to
+         * its output queue and reading state.
+         * \param fd client socket
+         * \param conn connection
+         */
+        void UpdateEvents(int fd, Connection* conn);
+
+        /**
+         * \brief Initialize the members, called by the constructors.
+         * \param backend readiness notification mechanism
+         */
+        void Init(enum EventBackend backend);
+
+        /**
+         * \brief Register a new client socket.
+         * \param fd client socket
+         */
+        void AddClient(int fd);
+
+        /**
+         * \brief Unregister and close a client socket.
+         * \param fd client socket
+         */
+        void RemoveClient(int fd);
+
+        /**
+         * \brief Wait and dispatch events with poll().
+         * \param ms millisecond to wait (0 means infinite)
+         */
+        void WaitPoll(uint32_t ms);
+
+        /**
+         * \brief Wait and dispatch events with epoll_wait().
+         * \param ms millisecond to wait (0 means infinite)
+         */
+        void WaitEpoll(uint32_t ms);
+
+        /**
+         * \brief Submit the io_uring requests queued and dispatch the
+         * completions.
+         * \param ms millisecond to wait (0 means infinite)
+         */
+        void WaitUring(uint32_t ms);
+
+        /**
+         * \brief Handle the completion of a multishot receive.
+         * \param conn connection
+         * \param completion completion
+         */
+        void CompleteRecv(Connection* conn,
+            const uring::Completion& completion);
+
+        /**
+         * \brief Handle the completion of a send.
+         * \param conn connection
+         * \param res bytes sent or negative errno
+         */
+        void CompleteSend(Connection* conn, int res);
+
+        /**
+         * \brief Give the output queue of a connection to a send unless one
+         * is in flight (BACKEND_IO_URING only).
+         * \param conn connection
+         */
+        void SubmitSend(Connection* conn);
+
+        /**
+         * \brief Get the number of bytes waiting to be sent on a
+         * connection, in the output queue or in flight.
+         * \param conn connection
+         * \return number of bytes
+         */
+        size_t GetQueuedSize(const Connection* conn) const;
+
+        /**
+         * \brief Give the change of the queued size of a connection to
+         * METRIC_OUTPUT_QUEUE.
+         * \param conn connection
+         * \param closed if the connection is closed (its queue is dropped)
+         */
+        void CountQueued(Connection* conn, bool closed = false);
+
+        /**
+         * \brief Cancel the multishot accept and wait for its end
+         * (BACKEND_IO_URING only).
+         *
+         * The request holds a reference on the listen socket, without it
+         * the port stays in use after the server is destroyed, until the
+         * kernel has torn down the ring. The other completions are
+         * dispatched meanwhile and the clients accepted are closed.
+         */
+        void StopAccept();
+
+        /**
+         * \brief Readiness notification mechanism.
+         */
+        enum EventBackend m_backend;
+
+        /**
+         * \brief epoll descriptor (BACKEND_EPOLL only).
+         */
+        int m_epoll;
+
+        /**
+         * \brief io_uring instance (NULL unless BACKEND_IO_URING).
+         */
+        uring::Ring* m_uring;
+
+        /**
+         * \brief If StopAccept() waits for the end of the multishot accept.
+         */
+        bool m_acceptStopping;
+
+        /**
+         * \brief Removed connections with io_uring requests not completed
+         * yet, their socket is shut down but not closed.
+         */
+        std::set<Connection*> m_orphans;
+
+        /**
+         * \brief Client sockets.
+         */
+        std::vector<int> m_clients;
+
+        /**
+         * \brief Client connections indexed by socket descriptor (NULL if not
+         * a client).
+         */
+        std::vector<Connection*> m_connections;
+
+        /**
+         * \brief Maximum size of a received message.
+         */
+        size_t m_maxMessageSize;
+
+        /**
+         * \brief Output queue size under which reading resumes.
+         */
+        size_t m_lowWatermark;
+
+        /**
+         * \brief Output queue size at which reading stops (0 means
+         * unlimited).
+         */
+        size_t m_highWatermark;
+
+        /**
+         * \brief Identifier of the next accepted connection.
+         */
+        uint64_t m_nextConnectionId;
+
+        /**
+         * \brief Worker threads (NULL if methods are executed inline).
+         */
+        system_util::ThreadPool* m_pool;
+
+        /**
+         * \brief Pipe used by the workers to wake up WaitMessage() (a pair
+         * of loopback UDP sockets on Windows).
+         */
+        int m_wakeup[2];
+
+        /**
+         * \brief Responses produced by the workers, not sent yet.
+         */
+        std::list<Job*> m_completed;
+
+        /**
+         * \brief Mutex to protect m_completed.
+         */
+        system_util::Mutex m_completedMutex;
+
+        /**
+         * \brief poll() descriptors (BACKEND_POLL only), the listen socket,
+         * the wake up pipe then m_clients in the same order.
+         */
+        std::vector<struct pollfd> m_pollfds;
 
         /**
          * \brief List of disconnected sockets to be purged.
          */
         std::list<int> m_purge;
+
+        /**
+         * \brief Response of the last message when already serialized by
+         * the handler (its storage is reused).
+         */
+        std::string m_serialized;
     };
   } /* namespace Rpc */
 } /* namespace Json */
@@ -46,6 +46,14 @@ namespace Json
          */
         UdpServer(const std::string& address, uint16_t port);
 
+        /**
+         * \brief Constructor with a Handler shared with other servers.
+         * \param address network address or FQDN to bind
+         * \param port local port to bind
+         * \param handler JSON-RPC handler, it must outlive the server
+         */
+        UdpServer(const std::string& address, uint16_t port, Handler& handler);
+
         /**
          * \brief Destructor.
          */
@@ -79,7 +87,53 @@ namespace Json
          */
         virtual void WaitMessage(uint32_t ms);
 
+        /**
+         * \brief Set the maximum number of datagrams processed per wakeup.
+         *
+         * With a size greater than 1, Recv() reads up to size datagrams with
+         * one recvmmsg() call, processes them and sends all the responses
+         * with one sendmmsg() call. Buffers are allocated once here and
+         * reused for every batch.
+         * \param size maximum number of datagrams (0 or 1 means one datagram
+         * per call, with recvfrom() and sendto())
+         * \return true if success, false otherwise (batched mode not
+         * supported by the system)
+         * \note Batched mode is only available on Linux.
+         */
+        bool SetBatchSize(size_t size);
+
+        /**
+         * \brief Get the maximum number of datagrams processed per wakeup.
+         * \return maximum number of datagrams
+         */
+        size_t GetBatchSize() const;
+
       private:
+        /**
+         * \struct BatchRing
+         * \brief Preallocated buffers for batched mode (defined in the
+         * source file because it uses system-specific types).
+         */
+        struct BatchRing;
+
+        /**
+         * \brief Receive and process a batch of datagrams.
+         * \param fd file descriptor on which receive
+         * \return true if at least one datagram has been received and all
+         * responses sent, false otherwise
+         */
+        bool RecvBatch(int fd);
+
+        /**
+         * \brief Process a received message.
+         * \param buf message received
+         * \param len size of the message
+         * \param rep response (empty if none) encoded in the encapsulated
+         * format
+         * \return true if message has been processed, false otherwise
+         * (invalid encapsulation)
+         */
+        bool ProcessDatagram(const char* buf, size_t len, std::string& rep);
         /**
          * \brief Copy constructor (private because of "resource" class).
          * \param obj object to copy
@@ -94,6 +148,16 @@ namespace Json
          */
         UdpServer& operator=(const UdpServer& obj);
 
+        /**
+         * \brief Buffers for batched mode (NULL if disabled).
+         */
+        BatchRing* m_batch;
+
+        /**
+         * \brief Last received message, kept to reuse its storage.
+         */
+        std::string m_message;
+
     };
   } /* namespace Rpc */
 } /* namespace Json */
@@ -0,0 +1,77 @@
+/*
+ *  JsonRpc-Cpp - JSON-RPC implementation.
+ *  Copyright (C) 2008-2011 Sebastien Vincent <sebastien.vincent@cppextrem.com>
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+/**
+ * \file jsonrpc_unixclient.h
+ * \brief JSON-RPC Unix domain socket client.
+ * \author Sebastien Vincent
+ */
+
+#ifndef JSONRPC_UNIXCLIENT_H
+#define JSONRPC_UNIXCLIENT_H
+
+#include "jsonrpc_tcpclient.h"
+
+namespace Json
+{
+  namespace Rpc
+  {
+    /**
+     * \class UnixClient
+     * \brief JSON-RPC client on a Unix domain socket (see UnixServer).
+     *
+     * It is a TcpClient connected to a path instead of an address and a
+     * port. A path starting with '@' is a name in the Linux abstract
+     * namespace.
+     * \note With UNIX_SEQPACKET, a message is sent in records of at most
+     * networking::MAX_RECORD_SIZE bytes.
+     */
+    class UnixClient : public TcpClient
+    {
+      public:
+        /**
+         * \brief Constructor.
+         * \param path path of the server socket
+         * \param protocol UNIX_STREAM or UNIX_SEQPACKET
+         */
+        UnixClient(const std::string& path,
+            enum networking::TransportProtocol protocol = networking::UNIX_STREAM);
+
+        /**
+         * \brief Destructor.
+         */
+        virtual ~UnixClient();
+
+      private:
+        /**
+         * \brief Copy constructor (private because of "resource" class).
+         * \param obj object to copy
+         */
+        UnixClient(const UnixClient& obj);
+
+        /**
+         * \brief Operator copy assignment (private because of "resource"
+         * class).
+         * \param obj object to copy
+         * \return copied object reference
+         */
+        UnixClient& operator=(const UnixClient& obj);
+    };
+  } /* namespace Rpc */
+} /* namespace Json */
+
+#endif /* JSONRPC_UNIXCLIENT_H */
@@ -0,0 +1,120 @@
+/*
+ *  JsonRpc-Cpp - JSON-RPC implementation.
+ *  Copyright (C) 2008-2011 Sebastien Vincent <sebastien.vincent@cppextrem.com>
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+/**
+ * \file jsonrpc_unixserver.h
+ * \brief JSON-RPC Unix domain socket server.
+ * \author Sebastien Vincent
+ */
+
+#ifndef JSONRPC_UNIXSERVER_H
+#define JSONRPC_UNIXSERVER_H
+
+#include "jsonrpc_common.h"
+#include "jsonrpc_tcpserver.h"
+
+namespace Json
+{
+  namespace Rpc
+  {
+    /**
+     * \class UnixServer
+     * \brief JSON-RPC server on a Unix domain socket, for clients on the
+     * same host.
+     *
+     * It is a TcpServer bound to a path instead of an address and a port,
+     * so it has the same event loop, encapsulated formats, output queues
+     * and worker pool. A path starting with '@' is a name in the Linux
+     * abstract namespace (no file is created).
+     *
+     * With UNIX_SEQPACKET, messages are sent in records of at most
+     * networking::MAX_RECORD_SIZE bytes in both directions and reassembled
+     * by the framing like on a stream. BACKEND_IO_URING is replaced by
+     * BACKEND_EPOLL since records are read at once.
+     */
+    class UnixServer : public TcpServer
+    {
+      public:
+        /**
+         * \brief Constructor.
+         * \param path path of the socket
+         * \param protocol UNIX_STREAM or UNIX_SEQPACKET
+         * \param backend readiness notification mechanism
+         */
+        UnixServer(const std::string& path,
+            enum networking::TransportProtocol protocol = networking::UNIX_STREAM,
+            enum EventBackend backend = BACKEND_POLL);
+
+        /**
+         * \brief Constructor with a Handler shared with other servers.
+         * \param path path of the socket
+         * \param handler JSON-RPC handler, it must outlive the server
+         * \param protocol UNIX_STREAM or UNIX_SEQPACKET
+         * \param backend readiness notification mechanism
+         */
+        UnixServer(const std::string& path, Handler& handler,
+            enum networking::TransportProtocol protocol = networking::UNIX_STREAM,
+            enum EventBackend backend = BACKEND_POLL);
+
+        /**
+         * \brief Destructor, removes the socket file.
+         */
+        virtual ~UnixServer();
+
+        /**
+         * \brief Bind the socket, a stale socket file is replaced.
+         * \return true if success, false otherwise
+         */
+        virtual bool Bind();
+
+        /**
+         * \brief Close listen socket and all client sockets, and remove the
+         * socket file created by Bind().
+         */
+        virtual void Close();
+
+        /**
+         * \brief Get the path of the socket.
+         * \return path
+         */
+        std::string GetPath() const;
+
+      private:
+        /**
+         * \brief Copy constructor (private because of "resource" class).
+         * \param obj object to copy
+         */
+        UnixServer(const UnixServer& obj);
+
+        /**
+         * \brief Operator copy assignment (private because of "resource"
+         * class).
+         * \param obj object to copy
+         * \return copied object reference
+         */
+        UnixServer& operator=(const UnixServer& obj);
+
+        /**
+         * \brief If Bind() has created the socket file, it is removed by
+         * Close().
+         */
+        bool m_created;
+    };
+  } /* namespace Rpc */
+} /* namespace Json */
+
+#endif /* JSONRPC_UNIXSERVER_H */
@@ -26,6 +26,7 @@
 #define NETSTRING_H 
 
 #include <string>
+#include <vector>
 
 /**
  * \namespace netstring
@@ -65,13 +66,35 @@ namespace netstring
       std::string m_msg;
   };
 
+  /**
+   * \var MAX_HEADER_SIZE
+   * \brief Size of a buffer big enough for any netstring header.
+   */
+  static const size_t MAX_HEADER_SIZE = 32;
+
+  /**
+   * \var TRAILER
+   * \brief Netstring trailer.
+   */
+  static const char TRAILER = ',';
+
   /**
    * \brief Encode a string into netstring.
    * \param str string to encode
    * \return encoded netstring
+   * \note It copies str, to send a big payload prefer encodeHeader() and
+   * a gather write of header, payload and TRAILER.
    */
   std::string encode(const std::string& str);
 
+  /**
+   * \brief Encode the header of a netstring ("[len]:").
+   * \param len length of the payload
+   * \param header buffer of at least MAX_HEADER_SIZE bytes
+   * \return length of the header (without the terminating NULL)
+   */
+  size_t encodeHeader(size_t len, char* header);
+
   /**
    * \brief Decode a netstring into string.
    * \param netstr netstring
@@ -79,6 +102,129 @@ namespace netstring
    * \throw NetstringException if netstr is not a valid netstring
    */
   std::string decode(const std::string& netstr) throw(netstring::NetstringException);
+
+  /**
+   * \class Decoder
+   * \brief Incremental netstring decoder for stream transports.
+   *
+   * Bytes are appended in any chunks with Prepare()/Commit() or Feed() and
+   * Next() gives the payloads of the completed netstrings, without copying
+   * them. The length prefix is parsed once as the bytes come so an
+   * oversized length is rejected before the payload is received.
+   */
+  class Decoder
+  {
+    public:
+      /**
+       * \brief Constructor.
+       * \param maxSize maximum payload size (0 means unlimited)
+       */
+      Decoder(size_t maxSize = 0);
+
+      /**
+       * \brief Destructor.
+       */
+      ~Decoder();
+
+      /**
+       * \brief Set the maximum payload size.
+       * \param maxSize maximum payload size (0 means unlimited)
+       */
+      void SetMaxSize(size_t maxSize);
+
+      /**
+       * \brief Get the maximum payload size.
+       * \return maximum payload size (0 means unlimited)
+       */
+      size_t GetMaxSize() const;
+
+      /**
+       * \brief Get a buffer to write received data to.
+       * \param size number of bytes that will be written at most
+       * \return buffer of at least size bytes, valid until next call
+       * \note It invalidates the payloads returned by Next().
+       */
+      char* Prepare(size_t size);
+
+      /**
+       * \brief Append data written in the buffer returned by Prepare().
+       * \param size number of bytes written
+       */
+      void Commit(size_t size);
+
+      /**
+       * \brief Append data.
+       * \param data data to append
+       * \param size size of data
+       * \note It invalidates the payloads returned by Next().
+       */
+      void Feed(const char* data, size_t size);
+
+      /**
+       * \brief Get the payload of the next complete netstring.
+       * \param data if a netstring is complete, pointer to its payload in
+       * the decoder buffer, valid until next Prepare(), Feed() or Reset()
+       * \param size if a netstring is complete, size of the payload
+       * \return true if a netstring is complete, false if more data is
+       * needed
+       * \throw NetstringException if the stream is not a valid netstring
+       * sequence or a length is too big, the decoder has then to be Reset()
+       */
+      bool Next(const char*& data, size_t& size) throw(netstring::NetstringException);
+
+      /**
+       * \brief Get the size of the data not consumed yet.
+       * \return number of bytes
+       */
+      size_t GetBufferedSize() const;
+
+      /**
+       * \brief Discard all buffered data and decoding state.
+       */
+      void Reset();
+
+    private:
+      /**
+       * \brief Maximum payload size.
+       */
+      size_t m_maxSize;
+
+      /**
+       * \brief Received data, valid from m_begin to m_end.
+       */
+      std::vector<char> m_buffer;
+
+      /**
+       * \brief Start of the current netstring in m_buffer.
+       */
+      size_t m_begin;
+
+      /**
+       * \brief End of received data in m_buffer.
+       */
+      size_t m_end;
+
+      /**
+       * \brief Position of the next byte to parse, the payload start once
+       * the length is known.
+       */
+      size_t m_scan;
+
+      /**
+       * \brief Length of the current netstring (digits parsed so far).
+       */
+      size_t m_length;
+
+      /**
+       * \brief Number of digits of the length parsed so far.
+       */
+      size_t m_digits;
+
+      /**
+       * \brief If the length prefix of the current netstring is complete.
+       */
+      bool m_hasLength;
+  };
 } /* namespace netstring */
 
 #endif /* NETSTRING_H */
@@ -88,9 +88,21 @@ namespace networking
   enum TransportProtocol
   {
     UDP = IPPROTO_UDP, /**< UDP protocol. */
-    TCP = IPPROTO_TCP /**< TCP protocol. */
+    TCP = IPPROTO_TCP, /**< TCP protocol. */
+    UNIX_STREAM = 0x100, /**< Unix domain stream socket (same host only). */
+    UNIX_SEQPACKET = 0x101 /**< Unix domain sequenced-packet socket (same host only). */
   };
 
+  /**
+   * \brief Get if a transport protocol uses Unix domain sockets.
+   * \param protocol transport protocol
+   * \return true for UNIX_STREAM and UNIX_SEQPACKET, false otherwise
+   */
+  inline bool isUnix(enum TransportProtocol protocol)
+  {
+    return protocol == UNIX_STREAM || protocol == UNIX_SEQPACKET;
+  }
+
   /**
    * \brief Initialize networking.
    * \return true if network is correctly initialized, false otherwise
@@ -108,6 +120,9 @@ namespace networking
 
   /**
    * \brief Connect to remote machine.
+   *
+   * With a Unix domain protocol, address is the path of the socket (a
+   * leading '@' means the Linux abstract namespace) and port is ignored.
    * \param protocol transport protocol used
    * \param address remote address
    * \param port remote port
@@ -121,16 +136,64 @@ namespace networking
 
   /**
    * \brief Bind on a local address.
+   *
+   * With a Unix domain protocol, address is the path of the socket (a
+   * leading '@' means the Linux abstract namespace), port is ignored and a
+   * stale socket file left at path is removed.
    * \param protocol transport protocol used
    * \param address local address
    * \param port local port
    * \param sockaddr if function succeed, sockaddr 
    * representation of address/port
    * \param addrlen if function succeed, length of sockaddr
+   * \param reusePort set SO_REUSEPORT so that several sockets can bind the
+   * same address and port (fails if not supported by the system or with a
+   * Unix domain protocol)
    * \return socket descriptor if success, -1 otherwise
    */
   int bind(enum TransportProtocol protocol, const std::string& address,
-      uint16_t port, struct sockaddr_storage* sockaddr, socklen_t* addrlen);
+      uint16_t port, struct sockaddr_storage* sockaddr, socklen_t* addrlen,
+      bool reusePort = false);
+
+  /**
+   * \var MAX_SEND_PARTS
+   * \brief Maximum number of parts given to sendv().
+   */
+  static const size_t MAX_SEND_PARTS = 8;
+
+  /**
+   * \var MAX_RECORD_SIZE
+   * \brief Maximum size of a write on a UNIX_SEQPACKET socket, a record has
+   * to fit in the socket send buffer. Bigger messages are sent in several
+   * records, the receiver reassembles them like a stream.
+   */
+  static const size_t MAX_RECORD_SIZE = 64 * 1024;
+
+  /**
+   * \brief Send several buffers as one (gather write) on a connected
+   * socket, without copying them in a single buffer.
+   * \param sock socket descriptor
+   * \param parts buffers to send in order
+   * \param sizes size of each buffer
+   * \param count number of buffers (at most MAX_SEND_PARTS)
+   * \return true if all the bytes have been sent, false otherwise
+   * \note On POSIX systems it uses sendmsg() and loops on partial writes.
+   */
+  bool sendv(int sock, const char* const* parts, const size_t* sizes,
+      size_t count);
+
+  /**
+   * \brief Send as much as possible of several buffers (gather write) on a
+   * non-blocking connected socket.
+   * \param sock socket descriptor
+   * \param parts buffers to send in order
+   * \param sizes size of each buffer
+   * \param count number of buffers (at most MAX_SEND_PARTS)
+   * \return number of bytes sent (0 if the socket cannot take more for the
+   * moment) or -1 if error
+   */
+  ssize_t trySendv(int sock, const char* const* parts, const size_t* sizes,
+      size_t count);
 } /* namespace networking */
 
 #endif /* NETWORKING_H */
@@ -0,0 +1,282 @@
+/*
+ *  JsonRpc-Cpp - JSON-RPC implementation.
+ *  Copyright (C) 2008-2011 Sebastien Vincent <sebastien.vincent@cppextrem.com>
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+/**
+ * \file shm.h
+ * \brief Shared-memory ring buffers between two processes.
+ * \author Sebastien Vincent
+ */
+
+#ifndef SHM_H
+#define SHM_H
+
+#include <string>
+
+#include <stdint.h>
+
+/**
+ * \namespace shm
+ * \brief Shared-memory channel related classes.
+ */
+namespace shm
+{
+  /**
+   * \var DEFAULT_RING_SIZE
+   * \brief Default size of each ring of a channel.
+   */
+  static const size_t DEFAULT_RING_SIZE = 256 * 1024;
+
+  /**
+   * \var SPIN_COUNT
+   * \brief Number of times the rings are checked before sleeping, an
+   * answer which comes within a few microseconds costs no system call.
+   */
+  static const unsigned int SPIN_COUNT = 4096;
+
+  /**
+   * \brief Get the number of times the rings are checked before sleeping
+   * on this host.
+   * \return SPIN_COUNT, or 0 with a single CPU where the peer cannot run
+   * while this side spins
+   */
+  unsigned int getSpinCount();
+
+  /**
+   * \var CACHE_LINE_SIZE
+   * \brief Alignment of the shared indexes so that the two processes do
+   * not write the same cache line.
+   */
+  static const size_t CACHE_LINE_SIZE = 64;
+
+  /**
+   * \struct SharedIndex
+   * \brief Index shared between the processes, alone in its cache line.
+   */
+  struct SharedIndex
+  {
+    volatile uint32_t value; /**< Value. */
+    char pad[CACHE_LINE_SIZE - sizeof(uint32_t)]; /**< Padding. */
+  };
+
+  /**
+   * \struct SegmentHeader
+   * \brief Beginning of the shared segment, the data of the two rings
+   * follow.
+   *
+   * Ring 0 carries the bytes from the client to the server, ring 1 from
+   * the server to the client. Indexes are free-running byte counters (the
+   * position is the counter modulo the ring size), the head is only
+   * written by the producer and the tail by the consumer. The sleeping
+   * flag i belongs to the consumer of ring i.
+   */
+  struct SegmentHeader
+  {
+    uint32_t magic; /**< SEGMENT_MAGIC. */
+    uint32_t ringSize; /**< Size of each ring (power of two). */
+    char pad[CACHE_LINE_SIZE - 2 * sizeof(uint32_t)]; /**< Padding. */
+    SharedIndex heads[2]; /**< Bytes written in each ring. */
+    SharedIndex tails[2]; /**< Bytes read from each ring. */
+    SharedIndex sleeping[2]; /**< If the consumer waits for its event. */
+  };
+
+  /**
+   * \class Channel
+   * \brief One side of a pair of single-producer single-consumer rings in
+   * a shared segment.
+   *
+   * The client creates the segment (memfd) and two eventfd, then passes
+   * them to the server on a Unix socket. Each side writes to one ring and
+   * reads from the other without system call and without lock. A side
+   * which has nothing to do sets its sleeping flag and waits on its
+   * eventfd, the other side only writes the eventfd when it finds the flag
+   * set after changing a ring.
+   * \note It is only available on Linux, Create() and Receive() fail
+   * elsewhere.
+   */
+  class Channel
+  {
+    public:
+      /**
+       * \brief Constructor.
+       */
+      Channel();
+
+      /**
+       * \brief Destructor, unmaps the segment and closes the descriptors.
+       */
+      ~Channel();
+
+      /**
+       * \brief Create the segment and the events (client side).
+       * \param ringSize size of each ring, rounded up to a power of two
+       * \return true if success, false otherwise
+       */
+      bool Create(size_t ringSize);
+
+      /**
+       * \brief Pass the segment and the events to the server.
+       * \param sock connected Unix socket
+       * \return true if success, false otherwise
+       */
+      bool Send(int sock) const;
+
+      /**
+       * \brief Receive the segment and the events from a client (server
+       * side).
+       * \param sock connected Unix socket
+       * \return true if success, false if nothing valid has been received
+       */
+      bool Receive(int sock);
+
+      /**
+       * \brief Unmap the segment and close the descriptors.
+       */
+      void Close();
+
+      /**
+       * \brief Get if the channel is usable.
+       * \return true if created or received, false otherwise
+       */
+      bool IsOpen() const;
+
+      /**
+       * \brief Write to the outgoing ring and wake up the peer if it
+       * sleeps.
+       * \param data data
+       * \param size size of data
+       * \return number of bytes written (less than size if the ring is
+       * full)
+       */
+      size_t Write(const char* data, size_t size);
+
+      /**
+       * \brief Read from the incoming ring and wake up the peer if it
+       * sleeps (it may wait for room).
+       * \param data buffer
+       * \param size size of the buffer
+       * \return number of bytes read (0 if the ring is empty)
+       */
+      size_t Read(char* data, size_t size);
+
+      /**
+       * \brief Get the number of bytes that can be read.
+       * \return number of bytes
+       */
+      size_t GetReadable() const;
+
+      /**
+       * \brief Get the number of bytes that can be written.
+       * \return number of bytes
+       */
+      size_t GetWritable() const;
+
+      /**
+       * \brief Set the sleeping flag of this side.
+       *
+       * Once it is set, the rings have to be checked again before waiting
+       * on GetEvent(): what the peer did before it saw the flag does not
+       * wake up.
+       * \param sleeping true before waiting, false after
+       */
+      void SetSleeping(bool sleeping);
+
+      /**
+       * \brief Consume the wake up notifications of this side.
+       */
+      void ClearEvent();
+
+      /**
+       * \brief Get the event written by the peer to wake up this side.
+       * \return eventfd descriptor (non-blocking)
+       */
+      int GetEvent() const;
+
+    private:
+      /**
+       * \brief Copy constructor (private because of "resource" class).
+       * \param obj object to copy
+       */
+      Channel(const Channel& obj);
+
+      /**
+       * \brief Operator copy assignment (private because of "resource"
+       * class).
+       * \param obj object to copy
+       * \return copied object reference
+       */
+      Channel& operator=(const Channel& obj);
+
+      /**
+       * \brief Map the segment and set the ring pointers.
+       * \param server true for the server side
+       * \return true if success, false otherwise
+       */
+      bool Map(bool server);
+
+      /**
+       * \brief Wake up the peer if it sleeps.
+       */
+      void Notify();
+
+      /**
+       * \brief Segment descriptor (memfd).
+       */
+      int m_segment;
+
+      /**
+       * \brief Events written to wake up the consumer of each ring.
+       */
+      int m_events[2];
+
+      /**
+       * \brief Mapped segment.
+       */
+      SegmentHeader* m_header;
+
+      /**
+       * \brief Size of the mapped segment.
+       */
+      size_t m_size;
+
+      /**
+       * \brief Ring written by this side (0 client, 1 server).
+       */
+      int m_out;
+
+      /**
+       * \brief Ring read by this side.
+       */
+      int m_in;
+
+      /**
+       * \brief Size of each ring minus one (ring sizes are powers of two).
+       */
+      uint32_t m_mask;
+
+      /**
+       * \brief Data of the outgoing ring.
+       */
+      char* m_outData;
+
+      /**
+       * \brief Data of the incoming ring.
+       */
+      char* m_inData;
+  };
+} /* namespace shm */
+
+#endif /* SHM_H */
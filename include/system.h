@@ -35,6 +35,13 @@
 
 #endif
 
+#include <cstddef>
+
+#include <stdint.h>
+
+#include <deque>
+#include <vector>
+
 /**
  * \namespace system_util
  * \brief System related class (thread, ...).
@@ -47,6 +54,57 @@ namespace system_util
    */
   void msleep(unsigned long ms);
 
+  /**
+   * \brief Get the time of a clock not affected by system time changes.
+   * \return time in microseconds since an unspecified point
+   */
+  uint64_t monotonicTime();
+
+  /**
+   * \brief Get the time of a clock not affected by system time changes,
+   * with the best resolution available.
+   * \return time in nanoseconds since an unspecified point
+   */
+  uint64_t monotonicTimeNs();
+
+  /**
+   * \brief Add to a counter written by a single thread and read by others.
+   *
+   * No read-modify-write instruction is needed as the caller is the only
+   * writer, the store is only made indivisible so that counterRead() never
+   * sees half of it.
+   * \param counter counter
+   * \param value value to add
+   */
+  inline void counterAdd(volatile uint64_t* counter, uint64_t value)
+  {
+#if defined(__GNUC__)
+    __atomic_store_n(counter, *counter + value, __ATOMIC_RELAXED);
+#elif defined(_WIN32)
+    InterlockedExchange64((volatile LONGLONG*)counter,
+        (LONGLONG)(*counter + value));
+#else
+    *counter += value;
+#endif
+  }
+
+  /**
+   * \brief Read a counter updated with counterAdd() by another thread.
+   * \param counter counter
+   * \return value of the counter
+   */
+  inline uint64_t counterRead(const volatile uint64_t* counter)
+  {
+#if defined(__GNUC__)
+    return __atomic_load_n(counter, __ATOMIC_RELAXED);
+#elif defined(_WIN32)
+    return (uint64_t)InterlockedCompareExchange64(
+        (volatile LONGLONG*)counter, 0, 0);
+#else
+    return *counter;
+#endif
+  }
+
   /**
    * \class ThreadArg
    * \brief Abstract class to represent thread argument.
@@ -273,6 +331,297 @@ namespace system_util
 #else
       pthread_mutex_t m_mutex;
 #endif
+
+      friend class Condition;
+  };
+
+  /**
+   * \class ThreadLocal
+   * \brief Pointer with a different value in each thread.
+   *
+   * Values are not freed when a thread exits, the owner of the
+   * ThreadLocal has to keep track of them.
+   */
+  class ThreadLocal
+  {
+    public:
+      /**
+       * \brief Constructor, the value is NULL in all threads.
+       */
+      ThreadLocal();
+
+      /**
+       * \brief Destructor.
+       */
+      ~ThreadLocal();
+
+      /**
+       * \brief Get the value of the calling thread.
+       * \return value (NULL if not set)
+       */
+      void* Get() const;
+
+      /**
+       * \brief Set the value of the calling thread.
+       * \param value value
+       * \return true if success, false if error
+       */
+      bool Set(void* value);
+
+    private:
+      /**
+       * \brief Copy constructor (private because of "resource" class).
+       * \param obj object to copy
+       */
+      ThreadLocal(const ThreadLocal& obj);
+
+      /**
+       * \brief Operator copy assignment (private because of "resource"
+       * class).
+       * \param obj object to copy
+       * \return copied object reference
+       */
+      ThreadLocal& operator=(const ThreadLocal& obj);
+
+      /**
+       * \brief The key.
+       */
+#ifdef _WIN32
+      DWORD m_key;
+#else
+      pthread_key_t m_key;
+#endif
+  };
+
+  /**
+   * \class Condition
+   * \brief Condition variable implementation.
+   */
+  class Condition
+  {
+    public:
+      /**
+       * \brief Constructor.
+       */
+      Condition();
+
+      /**
+       * \brief Destructor.
+       */
+      ~Condition();
+
+      /**
+       * \brief Wait until the condition is signaled.
+       * \param mutex mutex locked by the caller, it is unlocked during the
+       * wait and locked again before returning
+       * \return true if success, false if error
+       * \warning Spurious wakeups can occur, always check the predicate
+       * in a loop.
+       */
+      bool Wait(Mutex& mutex);
+
+      /**
+       * \brief Wait until the condition is signaled or a timeout expires.
+       * \param mutex mutex locked by the caller, it is unlocked during the
+       * wait and locked again before returning
+       * \param ms maximum time to wait in milliseconds (measured on the
+       * monotonic clock, so wall clock changes do not affect it)
+       * \return true if woken up, false if the timeout expired or error
+       * \warning Spurious wakeups can occur, always check the predicate
+       * in a loop.
+       */
+      bool TimedWait(Mutex& mutex, unsigned long ms);
+
+      /**
+       * \brief Wake up one waiting thread.
+       * \return true if success, false if error
+       */
+      bool Signal();
+
+      /**
+       * \brief Wake up all waiting threads.
+       * \return true if success, false if error
+       */
+      bool Broadcast();
+
+    private:
+      /**
+       * \brief Copy constructor (private because of "resource" class).
+       * \param obj object to copy
+       */
+      Condition(const Condition& obj);
+
+      /**
+       * \brief Operator copy assignment (private because of "resource"
+       * class).
+       * \param obj object to copy
+       * \return copied object reference
+       */
+      Condition& operator=(const Condition& obj);
+
+#ifdef _WIN32
+      /**
+       * \brief Protect the waiters state.
+       */
+      CRITICAL_SECTION m_lock;
+
+      /**
+       * \brief Manual-reset event set while waiters are released.
+       */
+      HANDLE m_event;
+
+      /**
+       * \brief Number of waiting threads.
+       */
+      unsigned long m_waiters;
+
+      /**
+       * \brief Number of waiting threads still to release.
+       */
+      unsigned long m_release;
+
+      /**
+       * \brief Incremented by each Signal() or Broadcast(), a thread is
+       * only released by a call made after it started to wait.
+       */
+      unsigned long m_generation;
+#else
+      /**
+       * \brief The condition variable.
+       */
+      pthread_cond_t m_cond;
+#endif
+  };
+
+  /**
+   * \class ThreadPool
+   * \brief Fixed set of threads that execute ThreadArg tasks from a bounded
+   * queue.
+   *
+   * \code
+   * ThreadPool pool(4, 1024);
+   * pool.Start();
+   * pool.Push(new ThreadArgImpl<MyClass>(instanceOfMyClass, &MyClass::Method, arg));
+   * \endcode
+   */
+  class ThreadPool
+  {
+    public:
+      /**
+       * \brief Constructor.
+       * \param threads number of threads
+       * \param queueDepth maximum number of pending tasks (0 means unlimited)
+       */
+      ThreadPool(size_t threads, size_t queueDepth);
+
+      /**
+       * \brief Destructor.
+       *
+       * Pending tasks are executed before the threads exit.
+       */
+      ~ThreadPool();
+
+      /**
+       * \brief Start the threads.
+       * \return true if success, false otherwise
+       */
+      bool Start();
+
+      /**
+       * \brief Execute the pending tasks then stop the threads.
+       */
+      void Stop();
+
+      /**
+       * \brief Queue a task.
+       * \param task task to execute (MUST be dynamically allocated, it is
+       * deleted once executed)
+       * \param wait if queue is full, wait for a free place (true) or
+       * return immediately (false)
+       * \return true if task is queued, false if queue is full or pool is
+       * stopped (task is not deleted in that case)
+       */
+      bool Push(ThreadArg* task, bool wait = true);
+
+      /**
+       * \brief Get the number of threads.
+       * \return number of threads
+       */
+      size_t GetThreadCount() const;
+
+      /**
+       * \brief Get the maximum number of pending tasks.
+       * \return queue depth (0 means unlimited)
+       */
+      size_t GetQueueDepth() const;
+
+      /**
+       * \brief Get the number of pending tasks.
+       * \return number of tasks not yet executed
+       */
+      size_t GetPendingCount();
+
+    private:
+      /**
+       * \brief Copy constructor (private because of "resource" class).
+       * \param obj object to copy
+       */
+      ThreadPool(const ThreadPool& obj);
+
+      /**
+       * \brief Operator copy assignment (private because of "resource"
+       * class).
+       * \param obj object to copy
+       * \return copied object reference
+       */
+      ThreadPool& operator=(const ThreadPool& obj);
+
+      /**
+       * \brief Main loop of the threads.
+       * \param arg not used
+       * \return NULL
+       */
+      void* Run(void* arg);
+
+      /**
+       * \brief Number of threads.
+       */
+      size_t m_threadCount;
+
+      /**
+       * \brief Maximum number of pending tasks.
+       */
+      size_t m_queueDepth;
+
+      /**
+       * \brief Threads.
+       */
+      std::vector<Thread*> m_threads;
+
+      /**
+       * \brief Pending tasks.
+       */
+      std::deque<ThreadArg*> m_tasks;
+
+      /**
+       * \brief Mutex to protect m_tasks and m_stop.
+       */
+      Mutex m_mutex;
+
+      /**
+       * \brief Signaled when a task is queued or pool is stopped.
+       */
+      Condition m_notEmpty;
+
+      /**
+       * \brief Signaled when a task is dequeued.
+       */
+      Condition m_notFull;
+
+      /**
+       * \brief If threads have to exit.
+       */
+      bool m_stop;
   };
 } /* namespace System */
 
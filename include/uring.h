@@ -0,0 +1,322 @@
+/*
+ *  JsonRpc-Cpp - JSON-RPC implementation.
+ *  Copyright (C) 2008-2011 Sebastien Vincent <sebastien.vincent@cppextrem.com>
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**
+ * \file uring.h
+ * \brief Minimal io_uring interface (Linux).
+ * \author Sebastien Vincent
+ */
+
+#ifndef URING_H
+#define URING_H
+
+#include <cstddef>
+
+#include <stdint.h>
+
+/**
+ * \namespace uring
+ * \brief io_uring related classes.
+ */
+namespace uring
+{
+  /**
+   * \struct Completion
+   * \brief Result of a request.
+   */
+  struct Completion
+  {
+    uint64_t data; /**< Value given with the request. */
+    int res; /**< Result, negative errno if it has failed. */
+    bool more; /**< If a multishot request goes on after this result. */
+    int buffer; /**< Provided buffer holding the data, -1 if none. */
+  };
+
+  /**
+   * \class Ring
+   * \brief Submission and completion queues of an io_uring instance, with a
+   * ring of provided receive buffers.
+   *
+   * Requests are queued in the submission queue and only given to the
+   * kernel by Wait(), which also waits for the completions: a busy event
+   * loop makes one system call per iteration whatever the number of
+   * sockets. Requests are multishot where the kernel allows it: one accept
+   * gives all the connections, one receive gives all the data of a socket
+   * in buffers picked from the provided ring.
+   *
+   * \note It is only available on Linux 6.0 or later, Init() fails
+   * elsewhere.
+   */
+  class Ring
+  {
+    public:
+      /**
+       * \brief Constructor.
+       */
+      Ring();
+
+      /**
+       * \brief Destructor, closes the ring.
+       */
+      ~Ring();
+
+      /**
+       * \brief Create the ring and its provided buffers.
+       * \param entries size of the submission queue
+       * \param buffers number of provided buffers (power of two)
+       * \param bufferSize size of each provided buffer
+       * \return true if success, false if the kernel does not support all
+       * the requests used
+       */
+      bool Init(unsigned int entries, unsigned int buffers, size_t bufferSize);
+
+      /**
+       * \brief Close the ring, requests in flight are cancelled.
+       */
+      void Close();
+
+      /**
+       * \brief Get if the ring is usable.
+       * \return true if initialized, false otherwise
+       */
+      bool IsOpen() const;
+
+      /**
+       * \brief Queue a multishot accept.
+       * \param fd listen socket
+       * \param data value given back with each completion
+       * \return true if success, false otherwise
+       */
+      bool Accept(int fd, uint64_t data);
+
+      /**
+       * \brief Queue a multishot receive in the provided buffers.
+       * \param fd socket
+       * \param data value given back with each completion
+       * \return true if success, false otherwise
+       */
+      bool Recv(int fd, uint64_t data);
+
+      /**
+       * \brief Queue a send.
+       * \param fd socket
+       * \param buf data, it must be valid until the completion
+       * \param size size of data
+       * \param data value given back with the completion
+       * \return true if success, false otherwise
+       */
+      bool Send(int fd, const char* buf, size_t size, uint64_t data);
+
+      /**
+       * \brief Queue a multishot readiness notification (POLLIN).
+       * \param fd descriptor
+       * \param data value given back with each completion
+       * \return true if success, false otherwise
+       */
+      bool Poll(int fd, uint64_t data);
+
+      /**
+       * \brief Queue the cancellation of a request.
+       * \param target value given with the request to cancel
+       * \param data value given back with the completion
+       * \return true if success, false otherwise
+       */
+      bool Cancel(uint64_t target, uint64_t data);
+
+      /**
+       * \brief Submit the queued requests and wait for a completion.
+       * \param ms millisecond to wait (0 means infinite)
+       * \return true if success, false otherwise
+       */
+      bool Wait(uint32_t ms);
+
+      /**
+       * \brief Take the next completion.
+       * \param completion filled with the completion
+       * \return true if there was one, false otherwise
+       */
+      bool Next(Completion& completion);
+
+      /**
+       * \brief Get the data of a provided buffer.
+       * \param id buffer given by a completion
+       * \return buffer
+       */
+      const char* GetBuffer(int id) const;
+
+      /**
+       * \brief Give a provided buffer back to the kernel.
+       * \param id buffer given by a completion
+       */
+      void ReleaseBuffer(int id);
+
+      /**
+       * \brief Get the number of io_uring_enter() calls.
+       * \return number of system calls
+       */
+      uint64_t GetEnterCount() const;
+
+    private:
+      /**
+       * \brief Copy constructor (private because of "resource" class).
+       * \param obj object to copy
+       */
+      Ring(const Ring& obj);
+
+      /**
+       * \brief Operator copy assignment (private because of "resource"
+       * class).
+       * \param obj object to copy
+       * \return copied object reference
+       */
+      Ring& operator=(const Ring& obj);
+
+      /**
+       * \brief Get a free submission entry, submit the queued ones first if
+       * the queue is full.
+       * \return entry (struct io_uring_sqe) or NULL if none is free
+       */
+      void* GetEntry();
+
+      /**
+       * \brief Add the entry got from GetEntry() to the submission queue.
+       */
+      void Queue();
+
+      /**
+       * \brief Give the queued entries to the kernel and wait.
+       * \param wait number of completions to wait for
+       * \param ms millisecond to wait (0 means infinite)
+       * \return true if success, false otherwise
+       */
+      bool Enter(unsigned int wait, uint32_t ms);
+
+      /**
+       * \brief io_uring descriptor.
+       */
+      int m_fd;
+
+      /**
+       * \brief Submission queue ring mapping.
+       */
+      void* m_sqMap;
+
+      /**
+       * \brief Size of the submission queue ring mapping.
+       */
+      size_t m_sqMapSize;
+
+      /**
+       * \brief Completion queue ring mapping (same as m_sqMap if the
+       * kernel maps both at once).
+       */
+      void* m_cqMap;
+
+      /**
+       * \brief Size of the completion queue ring mapping.
+       */
+      size_t m_cqMapSize;
+
+      /**
+       * \brief Submission queue entries (struct io_uring_sqe).
+       */
+      void* m_sqes;
+
+      /**
+       * \brief Number of submission queue entries.
+       */
+      unsigned int m_sqEntries;
+
+      /**
+       * \brief Submission queue head (written by the kernel).
+       */
+      unsigned int* m_sqHead;
+
+      /**
+       * \brief Submission queue tail.
+       */
+      unsigned int* m_sqTail;
+
+      /**
+       * \brief Submission queue index array.
+       */
+      unsigned int* m_sqArray;
+
+      /**
+       * \brief Submission queue mask.
+       */
+      unsigned int m_sqMask;
+
+      /**
+       * \brief Entries queued and not given to the kernel yet.
+       */
+      unsigned int m_queued;
+
+      /**
+       * \brief Completion queue head.
+       */
+      unsigned int* m_cqHead;
+
+      /**
+       * \brief Completion queue tail (written by the kernel).
+       */
+      unsigned int* m_cqTail;
+
+      /**
+       * \brief Completion queue mask.
+       */
+      unsigned int m_cqMask;
+
+      /**
+       * \brief Completion queue entries (struct io_uring_cqe).
+       */
+      void* m_cqes;
+
+      /**
+       * \brief Provided buffer ring (struct io_uring_buf_ring).
+       */
+      void* m_bufRing;
+
+      /**
+       * \brief Size of the provided buffer ring mapping.
+       */
+      size_t m_bufRingSize;
+
+      /**
+       * \brief Provided buffers.
+       */
+      char* m_buffers;
+
+      /**
+       * \brief Number of provided buffers.
+       */
+      unsigned int m_bufferCount;
+
+      /**
+       * \brief Size of each provided buffer.
+       */
+      size_t m_bufferSize;
+
+      /**
+       * \brief Number of io_uring_enter() calls.
+       */
+      uint64_t m_enters;
+  };
+} /* namespace uring */
+
+#endif /* URING_H */
@@ -0,0 +1,609 @@
+/*
+ *  JsonRpc-Cpp - JSON-RPC implementation.
+ *  Copyright (C) 2008-2011 Sebastien Vincent <sebastien.vincent@cppextrem.com>
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**
+ * \file http.cpp
+ * \brief Minimal HTTP/1.1 message framing (RFC 7230).
+ * \author Sebastien Vincent
+ */
+
+#include "http.h"
+
+#include <cstdio>
+#include <cstring>
+#include <cctype>
+
+namespace http
+{
+  /**
+   * \var MAX_HEADERS_SIZE
+   * \brief Maximum size of the start line and headers of a message (and of
+   * the trailers of a chunked body).
+   */
+  static const size_t MAX_HEADERS_SIZE = 16 * 1024;
+
+  /**
+   * \var MAX_LINE_SIZE
+   * \brief Maximum size of a chunk size line.
+   */
+  static const size_t MAX_LINE_SIZE = 1024;
+
+  /**
+   * \var MAX_LENGTH_DIGITS
+   * \brief Maximum number of digits of a Content-Length (fits in 64-bit).
+   */
+  static const size_t MAX_LENGTH_DIGITS = 18;
+
+  /**
+   * \var MAX_CHUNK_DIGITS
+   * \brief Maximum number of hexadecimal digits of a chunk size.
+   */
+  static const size_t MAX_CHUNK_DIGITS = 15;
+
+  /**
+   * \var MAX_IDLE_BUFFER_SIZE
+   * \brief Decoder buffer bigger than this is released once it is empty.
+   */
+  static const size_t MAX_IDLE_BUFFER_SIZE = 64 * 1024;
+
+  /**
+   * \brief Compare a string with a lower case token, ignoring case.
+   * \param str string
+   * \param len length of str
+   * \param token lower case NULL-terminated token
+   * \return true if they are equal, false otherwise
+   */
+  static bool equalsToken(const char* str, size_t len, const char* token)
+  {
+    size_t i = 0;
+
+    for(i = 0 ; i < len && token[i] ; i++)
+    {
+      if(tolower((unsigned char)str[i]) != token[i])
+      {
+        return false;
+      }
+    }
+
+    return i == len && token[i] == 0;
+  }
+
+  /**
+   * \brief Search a lower case token in a string, ignoring case.
+   * \param str string
+   * \param len length of str
+   * \param token lower case NULL-terminated token
+   * \return true if token is found, false otherwise
+   */
+  static bool containsToken(const char* str, size_t len, const char* token)
+  {
+    size_t tokenLen = strlen(token);
+
+    for(size_t i = 0 ; i + tokenLen <= len ; i++)
+    {
+      if(equalsToken(str + i, tokenLen, token))
+      {
+        return true;
+      }
+    }
+
+    return false;
+  }
+
+  /**
+   * \brief Get the reason phrase of a status code.
+   * \param status status code
+   * \return reason phrase
+   */
+  static const char* reasonPhrase(int status)
+  {
+    switch(status)
+    {
+      case 100:
+        return "Continue";
+      case 200:
+        return "OK";
+      case 204:
+        return "No Content";
+      case 400:
+        return "Bad Request";
+      default:
+        return "Internal Server Error";
+    }
+  }
+
+  size_t encodeResponseHeader(int status, size_t len, bool keepAlive,
+      char* header)
+  {
+    size_t ret = sprintf(header, "HTTP/1.1 %d %s\r\n", status,
+        reasonPhrase(status));
+
+    if(status < 200)
+    {
+      /* interim response, the final one follows */
+      return ret + sprintf(header + ret, "\r\n");
+    }
+
+    if(status != 204)
+    {
+      ret += sprintf(header + ret,
+          "Content-Type: application/json\r\nContent-Length: %lu\r\n",
+          (unsigned long)len);
+    }
+
+    if(!keepAlive)
+    {
+      ret += sprintf(header + ret, "Connection: close\r\n");
+    }
+
+    return ret + sprintf(header + ret, "\r\n");
+  }
+
+  std::string encodeRequestHeader(const std::string& host, size_t len)
+  {
+    char length[32];
+    std::string ret;
+
+    sprintf(length, "%lu", (unsigned long)len);
+
+    ret.reserve(96 + host.length());
+    ret.append("POST / HTTP/1.1\r\nHost: ");
+    ret.append(host);
+    ret.append("\r\nContent-Type: application/json\r\nContent-Length: ");
+    ret.append(length);
+    ret.append("\r\n\r\n");
+
+    return ret;
+  }
+
+  Decoder::Decoder(size_t maxSize)
+  {
+    m_maxSize = maxSize;
+    Reset();
+  }
+
+  Decoder::~Decoder()
+  {
+  }
+
+  void Decoder::SetMaxSize(size_t maxSize)
+  {
+    m_maxSize = maxSize;
+  }
+
+  size_t Decoder::GetMaxSize() const
+  {
+    return m_maxSize;
+  }
+
+  char* Decoder::Prepare(size_t size)
+  {
+    if(m_begin == m_end && m_begin > 0)
+    {
+      /* everything is consumed, bodies given by Next() can go */
+      Compact();
+
+      if(m_buffer.size() > MAX_IDLE_BUFFER_SIZE)
+      {
+        std::vector<char>().swap(m_buffer);
+      }
+    }
+
+    if(m_buffer.size() - m_end < size && m_begin > 0)
+    {
+      /* move the incomplete message at the beginning of the buffer */
+      Compact();
+    }
+
+    if(m_buffer.size() - m_end < size)
+    {
+      size_t newSize = m_buffer.size() ? m_buffer.size() : 4096;
+
+      while(newSize - m_end < size)
+      {
+        newSize *= 2;
+      }
+      m_buffer.resize(newSize);
+    }
+
+    return &m_buffer[m_end];
+  }
+
+  void Decoder::Commit(size_t size)
+  {
+    m_end += size;
+  }
+
+  void Decoder::Feed(const char* data, size_t size)
+  {
+    if(size == 0)
+    {
+      return;
+    }
+
+    memcpy(Prepare(size), data, size);
+    Commit(size);
+  }
+
+  bool Decoder::Next(const char*& data, size_t& size) throw(http::HttpException)
+  {
+    char* buf = m_buffer.empty() ? NULL : &m_buffer[0];
+
+    while(true)
+    {
+      if(m_state == HEADERS)
+      {
+        size_t end = 0;
+
+        /* tolerate empty lines between pipelined messages */
+        while(m_end - m_begin >= 2 && buf[m_begin] == '\r' &&
+            buf[m_begin + 1] == '\n')
+        {
+          m_begin += 2;
+        }
+
+        if(m_scan < m_begin)
+        {
+          m_scan = m_begin;
+        }
+
+        /* empty line ending the headers, searched from where the last
+         * call stopped
+         */
+        for(end = m_scan ; end + 4 <= m_end ; end++)
+        {
+          if(buf[end] == '\r' && memcmp(buf + end, "\r\n\r\n", 4) == 0)
+          {
+            break;
+          }
+        }
+
+        if(end + 4 > m_end)
+        {
+          if(m_end - m_begin > MAX_HEADERS_SIZE)
+          {
+            throw HttpException("http: headers too big");
+          }
+
+          m_scan = m_end - m_begin > 3 ? m_end - 3 : m_begin;
+          return false;
+        }
+
+        if(end - m_begin > MAX_HEADERS_SIZE)
+        {
+          throw HttpException("http: headers too big");
+        }
+
+        ParseHeaders(end);
+        m_body = end + 4;
+        m_bodyEnd = m_body;
+        m_scan = m_body;
+      }
+
+      if(m_state == BODY)
+      {
+        if(m_end - m_body < m_length)
+        {
+          return false;
+        }
+
+        data = buf + m_body;
+        size = m_length;
+        m_begin = m_body + m_length;
+        break;
+      }
+      else if(m_state == CHUNK_SIZE)
+      {
+        size_t eol = FindLineEnd(m_scan);
+        size_t digits = 0;
+        size_t i = 0;
+
+        if(eol == m_end)
+        {
+          if(m_end - m_scan > MAX_LINE_SIZE)
+          {
+            throw HttpException("http: chunk size line too long");
+          }
+          return false;
+        }
+
+        m_length = 0;
+        for(i = m_scan ; i < eol && isxdigit((unsigned char)buf[i]) ; i++)
+        {
+          char c = tolower((unsigned char)buf[i]);
+
+          if(++digits > MAX_CHUNK_DIGITS)
+          {
+            throw HttpException("http: chunk too big");
+          }
+          m_length = m_length * 16 + (isdigit((unsigned char)c) ? c - '0' :
+              c - 'a' + 10);
+        }
+
+        /* chunk extensions are ignored */
+        if(digits == 0 || (i < eol && buf[i] != ';' && buf[i] != ' ' &&
+              buf[i] != '\t'))
+        {
+          throw HttpException("http: invalid chunk size");
+        }
+
+        /* reject before the chunk is received */
+        if(m_maxSize && m_bodyEnd - m_body + m_length > m_maxSize)
+        {
+          throw HttpException("http: body too big");
+        }
+
+        m_scan = eol + 2;
+        m_state = m_length ? CHUNK_DATA : TRAILERS;
+      }
+      else if(m_state == CHUNK_DATA)
+      {
+        if(m_end - m_scan < m_length + 2)
+        {
+          return false;
+        }
+
+        if(buf[m_scan + m_length] != '\r' || buf[m_scan + m_length + 1] != '\n')
+        {
+          throw HttpException("http: missing CRLF after chunk");
+        }
+
+        /* append the chunk to the body, over the size lines already
+         * parsed
+         */
+        memmove(buf + m_bodyEnd, buf + m_scan, m_length);
+        m_bodyEnd += m_length;
+        m_scan += m_length + 2;
+        m_state = CHUNK_SIZE;
+      }
+      else
+      {
+        size_t eol = FindLineEnd(m_scan);
+
+        if(eol == m_end)
+        {
+          if(m_end - m_scan > MAX_HEADERS_SIZE)
+          {
+            throw HttpException("http: trailers too big");
+          }
+          return false;
+        }
+
+        if(eol > m_scan)
+        {
+          /* trailer header, ignored */
+          m_scan = eol + 2;
+          continue;
+        }
+
+        data = buf + m_body;
+        size = m_bodyEnd - m_body;
+        m_begin = eol + 2;
+        break;
+      }
+    }
+
+    m_scan = m_begin;
+    m_state = HEADERS;
+    m_continue = false;
+    return true;
+  }
+
+  void Decoder::ParseHeaders(size_t end) throw(http::HttpException)
+  {
+    const char* buf = &m_buffer[0];
+    size_t eol = FindLineEnd(m_begin);
+    size_t version = 0;
+    bool chunked = false;
+
+    /* "HTTP/1.x 200 OK" or "POST / HTTP/1.x" */
+    if(eol - m_begin >= 8 && memcmp(buf + m_begin, "HTTP/", 5) == 0)
+    {
+      version = m_begin;
+    }
+    else if(eol - m_begin >= 8)
+    {
+      version = eol - 8;
+    }
+    else
+    {
+      throw HttpException("http: invalid start line");
+    }
+
+    if(memcmp(buf + version, "HTTP/1.", 7) != 0)
+    {
+      throw HttpException("http: unsupported version");
+    }
+
+    m_keepAlive = buf[version + 7] != '0';
+    m_continue = false;
+    m_length = 0;
+
+    for(size_t line = eol + 2 ; line <= end ; line = eol + 2)
+    {
+      const char* name = buf + line;
+      const char* value = NULL;
+      size_t nameLen = 0;
+      size_t valueLen = 0;
+
+      eol = FindLineEnd(line);
+
+      while(line + nameLen < eol && name[nameLen] != ':')
+      {
+        nameLen++;
+      }
+
+      if(line + nameLen == eol)
+      {
+        throw HttpException("http: invalid header");
+      }
+
+      value = name + nameLen + 1;
+      valueLen = buf + eol - value;
+
+      while(valueLen > 0 && (*value == ' ' || *value == '\t'))
+      {
+        value++;
+        valueLen--;
+      }
+
+      while(valueLen > 0 && (value[valueLen - 1] == ' ' ||
+            value[valueLen - 1] == '\t'))
+      {
+        valueLen--;
+      }
+
+      if(equalsToken(name, nameLen, "content-length"))
+      {
+        if(valueLen == 0 || valueLen > MAX_LENGTH_DIGITS)
+        {
+          throw HttpException("http: invalid Content-Length");
+        }
+
+        m_length = 0;
+        for(size_t i = 0 ; i < valueLen ; i++)
+        {
+          if(!isdigit((unsigned char)value[i]))
+          {
+            throw HttpException("http: invalid Content-Length");
+          }
+          m_length = m_length * 10 + (value[i] - '0');
+        }
+      }
+      else if(equalsToken(name, nameLen, "transfer-encoding"))
+      {
+        chunked = containsToken(value, valueLen, "chunked");
+      }
+      else if(equalsToken(name, nameLen, "connection"))
+      {
+        if(containsToken(value, valueLen, "close"))
+        {
+          m_keepAlive = false;
+        }
+        else if(containsToken(value, valueLen, "keep-alive"))
+        {
+          m_keepAlive = true;
+        }
+      }
+      else if(equalsToken(name, nameLen, "expect"))
+      {
+        m_continue = containsToken(value, valueLen, "100-continue");
+      }
+    }
+
+    if(chunked)
+    {
+      /* Transfer-Encoding overrides Content-Length */
+      m_length = 0;
+      m_state = CHUNK_SIZE;
+      return;
+    }
+
+    /* reject before the body is received */
+    if(m_maxSize && m_length > m_maxSize)
+    {
+      throw HttpException("http: body too big");
+    }
+
+    m_state = BODY;
+  }
+
+  size_t Decoder::FindLineEnd(size_t from) const
+  {
+    const char* buf = m_buffer.empty() ? NULL : &m_buffer[0];
+
+    for(size_t i = from ; i + 1 < m_end ; i++)
+    {
+      if(buf[i] == '\r' && buf[i + 1] == '\n')
+      {
+        return i;
+      }
+    }
+
+    return m_end;
+  }
+
+  void Decoder::Compact()
+  {
+    if(m_end > m_begin)
+    {
+      memmove(&m_buffer[0], &m_buffer[0] + m_begin, m_end - m_begin);
+    }
+
+    m_end -= m_begin;
+    m_scan -= m_begin;
+
+    if(m_state != HEADERS)
+    {
+      m_body -= m_begin;
+      m_bodyEnd -= m_begin;
+    }
+
+    m_begin = 0;
+  }
+
+  bool Decoder::IsKeepAlive() const
+  {
+    return m_keepAlive;
+  }
+
+  bool Decoder::TakeContinue()
+  {
+    bool ret = m_continue;
+
+    m_continue = false;
+    return ret;
+  }
+
+  size_t Decoder::GetBufferedSize() const
+  {
+    return m_end - m_begin;
+  }
+
+  void Decoder::Reset()
+  {
+    m_begin = 0;
+    m_end = 0;
+    m_scan = 0;
+    m_body = 0;
+    m_bodyEnd = 0;
+    m_length = 0;
+    m_state = HEADERS;
+    m_keepAlive = true;
+    m_continue = false;
+
+    if(m_buffer.size() > MAX_IDLE_BUFFER_SIZE)
+    {
+      std::vector<char>().swap(m_buffer);
+    }
+  }
+
+  HttpException::HttpException(const std::string& msg) throw()
+  {
+    m_msg = msg;
+  }
+
+  HttpException::~HttpException() throw()
+  {
+  }
+
+  const char* HttpException::what() const throw()
+  {
+    return m_msg.c_str();
+  }
+} /* namespace http */
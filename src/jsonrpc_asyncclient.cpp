@@ -0,0 +1,335 @@
+/*
+ *  JsonRpc-Cpp - JSON-RPC implementation.
+ *  Copyright (C) 2008-2011 Sebastien Vincent <sebastien.vincent@cppextrem.com>
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**
+ * \file jsonrpc_asyncclient.cpp
+ * \brief JSON-RPC asynchronous TCP client.
+ * \author Sebastien Vincent
+ */
+
+#include <iostream>
+
+#include "jsonrpc_asyncclient.h"
+
+namespace Json
+{
+  namespace Rpc
+  {
+    AsyncCallback::~AsyncCallback()
+    {
+    }
+
+    AsyncResult::AsyncResult()
+    {
+      m_ready = false;
+    }
+
+    AsyncResult::~AsyncResult()
+    {
+    }
+
+    void AsyncResult::Done(Json::Value& response)
+    {
+      m_mutex.Lock();
+      m_response.swap(response);
+      m_ready = true;
+      m_cond.Broadcast();
+      m_mutex.Unlock();
+    }
+
+    const Json::Value& AsyncResult::Wait()
+    {
+      m_mutex.Lock();
+      while(!m_ready)
+      {
+        m_cond.Wait(m_mutex);
+      }
+      m_mutex.Unlock();
+
+      /* not modified anymore until Reset() */
+      return m_response;
+    }
+
+    bool AsyncResult::IsReady()
+    {
+      bool ret = false;
+
+      m_mutex.Lock();
+      ret = m_ready;
+      m_mutex.Unlock();
+
+      return ret;
+    }
+
+    void AsyncResult::Reset()
+    {
+      m_mutex.Lock();
+      m_ready = false;
+      m_response = Json::Value::null;
+      m_mutex.Unlock();
+    }
+
+    AsyncClient::AsyncClient(const std::string& address, uint16_t port)
+      : m_client(address, port)
+    {
+      m_reader = NULL;
+      m_connected = false;
+      m_nextId = 0;
+    }
+
+    AsyncClient::~AsyncClient()
+    {
+      Close();
+    }
+
+    void AsyncClient::SetEncapsulatedFormat(enum EncapsulatedFormat format)
+    {
+      m_client.SetEncapsulatedFormat(format);
+    }
+
+    bool AsyncClient::Connect()
+    {
+      if(m_reader || !m_client.Connect())
+      {
+        return false;
+      }
+
+      m_mutex.Lock();
+      m_connected = true;
+      m_mutex.Unlock();
+
+      m_reader = new system_util::Thread(
+          new system_util::ThreadArgImpl<AsyncClient>(*this, &AsyncClient::Run,
+            NULL));
+
+      if(!m_reader->Start(false))
+      {
+        delete m_reader;
+        m_reader = NULL;
+        FailPending();
+        m_client.Close();
+        return false;
+      }
+
+      return true;
+    }
+
+    void AsyncClient::Close()
+    {
+      if(m_reader == NULL)
+      {
+        return;
+      }
+
+      /* wake up the reader blocked in recv() */
+#ifdef _WIN32
+      shutdown(m_client.GetSocket(), SD_BOTH);
+#else
+      shutdown(m_client.GetSocket(), SHUT_RDWR);
+#endif
+
+      m_reader->Join();
+      delete m_reader;
+      m_reader = NULL;
+
+      m_client.Close();
+    }
+
+    bool AsyncClient::Call(const std::string& method,
+        const Json::Value& params, AsyncCallback& callback)
+    {
+      Json::Value request(Json::objectValue);
+      Json::Value::UInt id = 0;
+
+      m_mutex.Lock();
+      if(!m_connected)
+      {
+        m_mutex.Unlock();
+        return false;
+      }
+
+      /* registered before it is sent, the response can come very fast */
+      id = m_nextId++;
+      m_pending[id] = &callback;
+      m_mutex.Unlock();
+
+      request["jsonrpc"] = Json::StaticString("2.0");
+      request["method"] = method;
+      request["id"] = id;
+
+      if(params != Json::Value::null)
+      {
+        request["params"] = params;
+      }
+
+      if(!Send(request))
+      {
+        size_t erased = 0;
+
+        m_mutex.Lock();
+        erased = m_pending.erase(id);
+        m_mutex.Unlock();
+
+        /* if the reader has already failed it, the callback is called */
+        return erased == 0;
+      }
+
+      return true;
+    }
+
+    bool AsyncClient::Notify(const std::string& method,
+        const Json::Value& params)
+    {
+      Json::Value notification(Json::objectValue);
+
+      m_mutex.Lock();
+      if(!m_connected)
+      {
+        m_mutex.Unlock();
+        return false;
+      }
+      m_mutex.Unlock();
+
+      notification["jsonrpc"] = Json::StaticString("2.0");
+      notification["method"] = method;
+
+      if(params != Json::Value::null)
+      {
+        notification["params"] = params;
+      }
+
+      return Send(notification);
+    }
+
+    size_t AsyncClient::GetPendingCount()
+    {
+      size_t ret = 0;
+
+      m_mutex.Lock();
+      ret = m_pending.size();
+      m_mutex.Unlock();
+
+      return ret;
+    }
+
+    bool AsyncClient::IsConnected()
+    {
+      bool ret = false;
+
+      m_mutex.Lock();
+      ret = m_connected;
+      m_mutex.Unlock();
+
+      return ret;
+    }
+
+    bool AsyncClient::Send(const Json::Value& msg)
+    {
+      bool ret = false;
+
+      m_sendMutex.Lock();
+      ret = (m_client.Send(m_writer.write(msg)) != -1);
+      m_sendMutex.Unlock();
+
+      if(!ret)
+      {
+        /* broken connection, the reader ends and fails the pending calls */
+        m_mutex.Lock();
+        m_connected = false;
+        m_mutex.Unlock();
+
+#ifdef _WIN32
+        shutdown(m_client.GetSocket(), SD_BOTH);
+#else
+        shutdown(m_client.GetSocket(), SHUT_RDWR);
+#endif
+      }
+
+      return ret;
+    }
+
+    void* AsyncClient::Run(void* arg)
+    {
+      Json::Reader reader;
+      std::string msg;
+
+      (void)arg;
+
+      /* until the server or Close() ends the connection */
+      while(m_client.Recv(msg) > 0)
+      {
+        Json::Value response;
+        AsyncCallback* callback = NULL;
+        std::map<Json::Value::UInt, AsyncCallback*>::iterator it;
+
+        if(!reader.parse(msg.data(), msg.data() + msg.length(), response) ||
+            !response.isObject() || !response["id"].isUInt())
+        {
+          /* parse error or invalid request reported by the server, there
+           * is no id to find the call
+           */
+          std::cerr << "Uncorrelated response: " << msg << std::endl;
+          continue;
+        }
+
+        m_mutex.Lock();
+        it = m_pending.find(response["id"].asUInt());
+        if(it != m_pending.end())
+        {
+          callback = it->second;
+          m_pending.erase(it);
+        }
+        m_mutex.Unlock();
+
+        if(callback == NULL)
+        {
+          std::cerr << "Response to an unknown call: " << msg << std::endl;
+          continue;
+        }
+
+        callback->Done(response);
+      }
+
+      FailPending();
+      return NULL;
+    }
+
+    void AsyncClient::FailPending()
+    {
+      std::map<Json::Value::UInt, AsyncCallback*> pending;
+
+      m_mutex.Lock();
+      m_connected = false;
+      pending.swap(m_pending);
+      m_mutex.Unlock();
+
+      for(std::map<Json::Value::UInt, AsyncCallback*>::iterator it =
+          pending.begin() ; it != pending.end() ; it++)
+      {
+        Json::Value response(Json::objectValue);
+
+        response["jsonrpc"] = Json::StaticString("2.0");
+        response["id"] = it->first;
+        response["error"]["code"] = CONNECTION_CLOSED;
+        response["error"]["message"] = Json::StaticString("Connection closed.");
+        it->second->Done(response);
+      }
+    }
+  } /* namespace Rpc */
+} /* namespace Json */
+
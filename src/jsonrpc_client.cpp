@@ -32,6 +32,12 @@ namespace Json
   {
     Client::Client()
     {
+      /* ~Client() closes m_sock if it is set */
+      m_sock = -1;
+      m_port = 0;
+      SetEncapsulatedFormat(Json::Rpc::RAW);
+      memset(&m_sockaddr, 0x00, sizeof(struct sockaddr_storage));
+      m_sockaddrlen = 0;
     }
 
     Client::Client(const std::string& address, uint16_t port)
@@ -0,0 +1,423 @@
+/*
+ *  JsonRpc-Cpp - JSON-RPC implementation.
+ *  Copyright (C) 2008-2011 Sebastien Vincent <sebastien.vincent@cppextrem.com>
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**
+ * \file jsonrpc_clientpool.cpp
+ * \brief JSON-RPC TCP connection pool.
+ * \author Sebastien Vincent
+ */
+
+#include "jsonrpc_clientpool.h"
+
+namespace Json
+{
+  namespace Rpc
+  {
+    /**
+     * \var MAINTENANCE_INTERVAL_MS
+     * \brief Time between two checks of the connections.
+     */
+    static const unsigned long MAINTENANCE_INTERVAL_MS = 100;
+
+    /**
+     * \var MAX_SEND_ATTEMPTS
+     * \brief Number of connections tried by a call, a broken connection is
+     * only detected when sending on it.
+     */
+    static const int MAX_SEND_ATTEMPTS = 2;
+
+    ClientPool::ClientPool(const std::string& address, uint16_t port,
+        size_t size)
+    {
+      m_maintenance = NULL;
+      m_stop = true;
+      m_hits = 0;
+      m_misses = 0;
+      m_waitTime = 0;
+      m_reconnects = 0;
+
+      m_connections.resize(size);
+
+      for(size_t i = 0 ; i < size ; i++)
+      {
+        m_connections[i].client = new AsyncClient(address, port);
+        m_connections[i].users = 0;
+        m_connections[i].reconnecting = false;
+      }
+    }
+
+    ClientPool::~ClientPool()
+    {
+      Stop();
+
+      for(size_t i = 0 ; i < m_connections.size() ; i++)
+      {
+        delete m_connections[i].client;
+      }
+    }
+
+    void ClientPool::SetEncapsulatedFormat(enum EncapsulatedFormat format)
+    {
+      for(size_t i = 0 ; i < m_connections.size() ; i++)
+      {
+        m_connections[i].client->SetEncapsulatedFormat(format);
+      }
+    }
+
+    bool ClientPool::Start()
+    {
+      size_t connected = 0;
+
+      if(m_maintenance)
+      {
+        return false;
+      }
+
+      for(size_t i = 0 ; i < m_connections.size() ; i++)
+      {
+        if(m_connections[i].client->Connect())
+        {
+          connected++;
+        }
+      }
+
+      m_mutex.Lock();
+      m_stop = false;
+      m_mutex.Unlock();
+
+      m_maintenance = new system_util::Thread(
+          new system_util::ThreadArgImpl<ClientPool>(*this, &ClientPool::Run,
+            NULL));
+
+      if(!m_maintenance->Start(false))
+      {
+        delete m_maintenance;
+        m_maintenance = NULL;
+        Stop();
+        return false;
+      }
+
+      return connected > 0;
+    }
+
+    void ClientPool::Stop()
+    {
+      m_mutex.Lock();
+      m_stop = true;
+      m_cond.Broadcast();
+      m_mutex.Unlock();
+
+      if(m_maintenance)
+      {
+        m_maintenance->Join();
+        delete m_maintenance;
+        m_maintenance = NULL;
+      }
+
+      /* the calls in progress end before their connection is closed */
+      m_mutex.Lock();
+      for(size_t i = 0 ; i < m_connections.size() ; i++)
+      {
+        while(m_connections[i].users > 0 || m_connections[i].reconnecting)
+        {
+          m_cond.Wait(m_mutex);
+        }
+      }
+      m_mutex.Unlock();
+
+      for(size_t i = 0 ; i < m_connections.size() ; i++)
+      {
+        m_connections[i].client->Close();
+      }
+    }
+
+    bool ClientPool::Call(const std::string& method,
+        const Json::Value& params, AsyncCallback& callback)
+    {
+      for(int i = 0 ; i < MAX_SEND_ATTEMPTS ; i++)
+      {
+        Connection* conn = Acquire();
+        bool ret = false;
+
+        if(conn == NULL)
+        {
+          return false;
+        }
+
+        ret = conn->client->Call(method, params, callback);
+        Release(conn);
+
+        if(ret)
+        {
+          return true;
+        }
+      }
+
+      return false;
+    }
+
+    bool ClientPool::Call(const std::string& method,
+        const Json::Value& params, Json::Value& response)
+    {
+      AsyncResult result;
+
+      if(!Call(method, params, result))
+      {
+        return false;
+      }
+
+      response = result.Wait();
+
+      /* error given by AsyncClient, not by the server */
+      return !(response.isMember("error") &&
+          response["error"]["code"] == CONNECTION_CLOSED);
+    }
+
+    bool ClientPool::Notify(const std::string& method,
+        const Json::Value& params)
+    {
+      for(int i = 0 ; i < MAX_SEND_ATTEMPTS ; i++)
+      {
+        Connection* conn = Acquire();
+        bool ret = false;
+
+        if(conn == NULL)
+        {
+          return false;
+        }
+
+        ret = conn->client->Notify(method, params);
+        Release(conn);
+
+        if(ret)
+        {
+          return true;
+        }
+      }
+
+      return false;
+    }
+
+    size_t ClientPool::GetSize() const
+    {
+      return m_connections.size();
+    }
+
+    uint64_t ClientPool::GetHitCount()
+    {
+      uint64_t ret = 0;
+
+      m_mutex.Lock();
+      ret = m_hits;
+      m_mutex.Unlock();
+
+      return ret;
+    }
+
+    uint64_t ClientPool::GetMissCount()
+    {
+      uint64_t ret = 0;
+
+      m_mutex.Lock();
+      ret = m_misses;
+      m_mutex.Unlock();
+
+      return ret;
+    }
+
+    uint64_t ClientPool::GetWaitTime()
+    {
+      uint64_t ret = 0;
+
+      m_mutex.Lock();
+      ret = m_waitTime;
+      m_mutex.Unlock();
+
+      return ret;
+    }
+
+    uint64_t ClientPool::GetReconnectCount()
+    {
+      uint64_t ret = 0;
+
+      m_mutex.Lock();
+      ret = m_reconnects;
+      m_mutex.Unlock();
+
+      return ret;
+    }
+
+    ClientPool::Connection* ClientPool::Acquire()
+    {
+      uint64_t start = system_util::monotonicTime();
+      Connection* ret = NULL;
+      bool miss = false;
+
+      m_mutex.Lock();
+      while(!m_stop)
+      {
+        Connection* broken = NULL;
+        size_t load = 0;
+        bool busy = false;
+
+        for(size_t i = 0 ; i < m_connections.size() ; i++)
+        {
+          Connection* conn = &m_connections[i];
+
+          if(conn->reconnecting)
+          {
+            busy = true;
+          }
+          else if(conn->client->IsConnected())
+          {
+            /* calls being sent are not pending yet */
+            size_t connLoad = conn->client->GetPendingCount() + conn->users;
+
+            if(ret == NULL || connLoad < load)
+            {
+              ret = conn;
+              load = connLoad;
+            }
+          }
+          else if(conn->users > 0)
+          {
+            /* a thread is failing on it, it will be released soon */
+            busy = true;
+          }
+          else if(broken == NULL)
+          {
+            broken = conn;
+          }
+        }
+
+        if(ret)
+        {
+          ret->users++;
+          break;
+        }
+
+        miss = true;
+
+        if(broken)
+        {
+          /* pay the connection now rather than wait for the maintenance */
+          bool connected = false;
+
+          broken->reconnecting = true;
+          m_mutex.Unlock();
+          connected = Reconnect(broken);
+          m_mutex.Lock();
+          broken->reconnecting = false;
+          m_reconnects++;
+          m_cond.Broadcast();
+
+          if(connected)
+          {
+            continue;
+          }
+
+          if(!busy)
+          {
+            break;
+          }
+
+          /* another connection may come back */
+          m_cond.Wait(m_mutex);
+        }
+        else if(busy)
+        {
+          m_cond.Wait(m_mutex);
+        }
+        else
+        {
+          /* empty pool */
+          break;
+        }
+      }
+
+      if(miss)
+      {
+        m_misses++;
+      }
+      else if(ret)
+      {
+        m_hits++;
+      }
+      m_waitTime += system_util::monotonicTime() - start;
+      m_mutex.Unlock();
+
+      return ret;
+    }
+
+    void ClientPool::Release(Connection* conn)
+    {
+      m_mutex.Lock();
+      conn->users--;
+
+      if(conn->users == 0 && (m_stop || !conn->client->IsConnected()))
+      {
+        /* can be reconnected by a waiting call, or closed by Stop() */
+        m_cond.Broadcast();
+      }
+      m_mutex.Unlock();
+    }
+
+    bool ClientPool::Reconnect(Connection* conn)
+    {
+      /* reader thread has ended, Close() only releases the socket */
+      conn->client->Close();
+      return conn->client->Connect();
+    }
+
+    void* ClientPool::Run(void* arg)
+    {
+      (void)arg;
+
+      m_mutex.Lock();
+      while(!m_stop)
+      {
+        for(size_t i = 0 ; !m_stop && i < m_connections.size() ; i++)
+        {
+          Connection* conn = &m_connections[i];
+
+          if(conn->reconnecting || conn->users > 0 ||
+              conn->client->IsConnected())
+          {
+            continue;
+          }
+
+          conn->reconnecting = true;
+          m_mutex.Unlock();
+          Reconnect(conn);
+          m_mutex.Lock();
+          conn->reconnecting = false;
+          m_reconnects++;
+          m_cond.Broadcast();
+        }
+
+        m_mutex.Unlock();
+        system_util::msleep(MAINTENANCE_INTERVAL_MS);
+        m_mutex.Lock();
+      }
+      m_mutex.Unlock();
+
+      return NULL;
+    }
+  } /* namespace Rpc */
+} /* namespace Json */
+
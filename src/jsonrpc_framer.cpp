@@ -0,0 +1,338 @@
+/*
+ *  JsonRpc-Cpp - JSON-RPC implementation.
+ *  Copyright (C) 2008-2011 Sebastien Vincent <sebastien.vincent@cppextrem.com>
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**
+ * \file jsonrpc_framer.cpp
+ * \brief Extract JSON-RPC messages from a byte stream.
+ * \author Sebastien Vincent
+ */
+
+#include <cstring>
+#include <cctype>
+
+#include "jsonrpc_framer.h"
+
+namespace Json
+{
+  namespace Rpc
+  {
+    /**
+     * \var DEFAULT_MAX_MESSAGE_SIZE
+     * \brief Default maximum size of a message.
+     */
+    static const size_t DEFAULT_MAX_MESSAGE_SIZE = 16 * 1024 * 1024;
+
+    /**
+     * \var MAX_IDLE_BUFFER_SIZE
+     * \brief Buffer bigger than this is released once it is empty.
+     */
+    static const size_t MAX_IDLE_BUFFER_SIZE = 64 * 1024;
+
+    Framer::Framer(enum EncapsulatedFormat format)
+    {
+      m_maxSize = DEFAULT_MAX_MESSAGE_SIZE;
+      m_decoder.SetMaxSize(m_maxSize);
+      m_http.SetMaxSize(m_maxSize);
+      m_begin = 0;
+      m_end = 0;
+      SetEncapsulatedFormat(format);
+    }
+
+    Framer::~Framer()
+    {
+    }
+
+    void Framer::SetEncapsulatedFormat(enum EncapsulatedFormat format)
+    {
+      m_format = format;
+      Reset();
+    }
+
+    enum EncapsulatedFormat Framer::GetEncapsulatedFormat() const
+    {
+      return m_format;
+    }
+
+    void Framer::SetMaxMessageSize(size_t size)
+    {
+      m_maxSize = size;
+      m_decoder.SetMaxSize(size);
+      m_http.SetMaxSize(size);
+    }
+
+    size_t Framer::GetMaxMessageSize() const
+    {
+      return m_maxSize;
+    }
+
+    char* Framer::Prepare(size_t size)
+    {
+      if(m_format == NETSTRING)
+      {
+        return m_decoder.Prepare(size);
+      }
+      else if(m_format == HTTP_POST)
+      {
+        return m_http.Prepare(size);
+      }
+
+      if(m_begin == m_end && m_begin > 0)
+      {
+        /* everything is consumed, messages given by Next() can go */
+        Reset();
+      }
+
+      if(m_buffer.size() - m_end < size && m_begin > 0)
+      {
+        /* move the incomplete message at the beginning of the buffer */
+        memmove(&m_buffer[0], &m_buffer[m_begin], m_end - m_begin);
+        m_end -= m_begin;
+        m_scan -= m_begin;
+        m_begin = 0;
+      }
+
+      if(m_buffer.size() - m_end < size)
+      {
+        size_t newSize = m_buffer.size() ? m_buffer.size() : 4096;
+
+        while(newSize - m_end < size)
+        {
+          newSize *= 2;
+        }
+        m_buffer.resize(newSize);
+      }
+
+      return &m_buffer[m_end];
+    }
+
+    void Framer::Commit(size_t size)
+    {
+      if(m_format == NETSTRING)
+      {
+        m_decoder.Commit(size);
+        return;
+      }
+      else if(m_format == HTTP_POST)
+      {
+        m_http.Commit(size);
+        return;
+      }
+
+      m_end += size;
+    }
+
+    void Framer::Feed(const char* data, size_t size)
+    {
+      if(size == 0)
+      {
+        return;
+      }
+
+      memcpy(Prepare(size), data, size);
+      Commit(size);
+    }
+
+    int Framer::Next(std::string& msg)
+    {
+      const char* data = NULL;
+      size_t size = 0;
+      int ret = Next(data, size);
+
+      if(ret == 1)
+      {
+        msg.assign(data, size);
+      }
+
+      return ret;
+    }
+
+    int Framer::Next(const char*& data, size_t& size)
+    {
+      if(m_format == NETSTRING)
+      {
+        try
+        {
+          return m_decoder.Next(data, size) ? 1 : 0;
+        }
+        catch(const netstring::NetstringException& e)
+        {
+          return -1;
+        }
+      }
+      else if(m_format == HTTP_POST)
+      {
+        try
+        {
+          return m_http.Next(data, size) ? 1 : 0;
+        }
+        catch(const http::HttpException& e)
+        {
+          return -1;
+        }
+      }
+
+      return NextRaw(data, size);
+    }
+
+    size_t Framer::GetBufferedSize() const
+    {
+      if(m_format == NETSTRING)
+      {
+        return m_decoder.GetBufferedSize();
+      }
+      else if(m_format == HTTP_POST)
+      {
+        return m_http.GetBufferedSize();
+      }
+
+      return m_end - m_begin;
+    }
+
+    bool Framer::IsKeepAlive() const
+    {
+      return m_format != HTTP_POST || m_http.IsKeepAlive();
+    }
+
+    bool Framer::TakeContinue()
+    {
+      return m_format == HTTP_POST && m_http.TakeContinue();
+    }
+
+    void Framer::Reset()
+    {
+      m_decoder.Reset();
+      m_http.Reset();
+
+      m_begin = 0;
+      m_end = 0;
+      m_scan = 0;
+      m_depth = 0;
+      m_inString = false;
+      m_escape = false;
+
+      if(m_buffer.size() > MAX_IDLE_BUFFER_SIZE)
+      {
+        std::vector<char>().swap(m_buffer);
+      }
+    }
+
+    void Framer::Consume(size_t size)
+    {
+      m_begin += size;
+
+      /* buffer is rewound by the next Prepare(), the message extracted
+       * is still there
+       */
+      if(m_scan < m_begin)
+      {
+        m_scan = m_begin;
+      }
+    }
+
+    int Framer::NextRaw(const char*& data, size_t& size)
+    {
+      const char* buf = m_buffer.empty() ? NULL : &m_buffer[0];
+
+      /* skip whitespaces between messages */
+      if(m_scan == m_begin)
+      {
+        size_t i = m_begin;
+
+        while(i < m_end && isspace((unsigned char)buf[i]))
+        {
+          i++;
+        }
+        Consume(i - m_begin);
+      }
+
+      if(m_begin == m_end)
+      {
+        return 0;
+      }
+
+      if(m_scan == m_begin && buf[m_begin] != '{' && buf[m_begin] != '[')
+      {
+        /* not a JSON object or array, pass it as is to get a parse error
+         * response, up to the next thing that looks like a message
+         */
+        size_t i = m_begin + 1;
+
+        while(i < m_end && buf[i] != '{' && buf[i] != '[')
+        {
+          i++;
+        }
+
+        data = buf + m_begin;
+        size = i - m_begin;
+        Consume(size);
+        return 1;
+      }
+
+      for( ; m_scan < m_end ; m_scan++)
+      {
+        char c = buf[m_scan];
+
+        if(m_inString)
+        {
+          if(m_escape)
+          {
+            m_escape = false;
+          }
+          else if(c == '\\')
+          {
+            m_escape = true;
+          }
+          else if(c == '"')
+          {
+            m_inString = false;
+          }
+        }
+        else if(c == '"')
+        {
+          m_inString = true;
+        }
+        else if(c == '{' || c == '[')
+        {
+          m_depth++;
+        }
+        else if((c == '}' || c == ']') && --m_depth == 0)
+        {
+          size_t len = m_scan + 1 - m_begin;
+
+          if(m_maxSize && len > m_maxSize)
+          {
+            return -1;
+          }
+
+          data = buf + m_begin;
+          size = len;
+          Consume(len);
+          return 1;
+        }
+      }
+
+      if(m_maxSize && m_end - m_begin > m_maxSize)
+      {
+        return -1;
+      }
+
+      return 0;
+    }
+  } /* namespace Rpc */
+} /* namespace Json */
+
@@ -28,131 +28,471 @@ namespace Json
 {
   namespace Rpc
   {
+    /**
+     * \brief Append a string value quoted by the writer itself, with the
+     * same escapes as the other responses and without truncation at an
+     * embedded NUL.
+     * \param out string to append to
+     * \param value string value
+     */
+    static void appendQuoted(std::string& out, const Json::Value& value)
+    {
+      Json::FastWriter writer;
+      std::string str = writer.write(value);
+
+      /* FastWriter ends with a line feed */
+      if(!str.empty() && str[str.length() - 1] == '\n')
+      {
+        str.erase(str.length() - 1);
+      }
+      out.append(str);
+    }
+
     CallbackMethod::~CallbackMethod()
     {
     }
 
+    enum ExecutionHint CallbackMethod::GetExecutionHint() const
+    {
+      return EXECUTE_POOLED;
+    }
+
     Handler::Handler()
     {
       /* add a RPC method that list the actual RPC methods contained in 
        * the Handler 
        */
       Json::Value root;
+      Json::Value error;
+      std::string notFound;
+      size_t pos = 0;
+
+      m_tombstones = 0;
+      m_generation = 0;
+      m_describeGeneration = 0;
+      m_batchPool = NULL;
+      m_batchConcurrency = 0;
+      m_batchThreshold = 0;
+      m_stats = false;
+      m_statsCount = 0;
+      m_statsMethod = NULL;
+
+      /* serialize once the error responses which do not depend on the
+       * request, with the writer used for the other responses
+       */
+      SetError(error, Json::Value::null, PARSING_ERROR, "Parse error.");
+      m_parseError = m_writer.write(error);
+
+      error = Json::Value::null;
+      SetError(error, Json::Value::null, INVALID_REQUEST,
+          "Invalid JSON-RPC request.");
+      m_invalidRequest = m_writer.write(error);
+
+      /* method not found template is split around the id */
+      error = Json::Value::null;
+      SetError(error, Json::Value::null, METHOD_NOT_FOUND, "Method not found.");
+      notFound = m_writer.write(error);
+      pos = notFound.find("\"id\":null") + 5;
+      m_notFoundPrefix = notFound.substr(0, pos);
+      m_notFoundSuffix = notFound.substr(pos + 4);
 
       root["description"] = "List the RPC methods available";
       root["parameters"] = Json::Value::null;
       root["returns"] = 
         "Object that contains description of all methods registered";
 
-      AddMethod(new RpcMethod<Handler>(*this, &Handler::SystemDescribe,
-            std::string("system.describe"), root));
+      RpcMethod<Handler>* describe = new RpcMethod<Handler>(*this,
+          &Handler::SystemDescribe, std::string("system.describe"), root);
+      describe->SetExecutionHint(EXECUTE_INLINE);
+      m_describeMethod = describe;
+      AddMethod(describe);
     }
 
     Handler::~Handler()
     {
+      if(m_batchPool)
+      {
+        m_batchPool->Stop();
+        delete m_batchPool;
+      }
+
       /* delete all objects from the list */
-      for(std::list<CallbackMethod*>::const_iterator it = m_methods.begin() ; it != m_methods.end() ; it++)
+      for(std::list<MethodEntry>::const_iterator it = m_methods.begin() ; it != m_methods.end() ; it++)
       {
-        delete (*it);
+        delete (*it).method;
       }
       m_methods.clear();
+      m_slots.clear();
+
+      for(size_t i = 0 ; i < m_statsShards.size() ; i++)
+      {
+        for(size_t j = 0 ; j < m_statsShards[i]->methods.size() ; j++)
+        {
+          delete m_statsShards[i]->methods[j];
+        }
+        delete m_statsShards[i];
+      }
     }
 
     void Handler::AddMethod(CallbackMethod* method)
     {
-      m_methods.push_back(method);
+      MethodEntry entry;
+      std::list<MethodEntry>::iterator it;
+
+      entry.method = method;
+      entry.name = method->GetName();
+      entry.hash = Hash(entry.name);
+      entry.hint = method->GetExecutionHint();
+      entry.stats = m_statsCount++;
+      it = m_methods.insert(m_methods.end(), entry);
+      m_generation++;
+
+      /* keep the load factor (tombstones included) under 1/2 */
+      if((m_methods.size() + m_tombstones) * 2 > m_slots.size())
+      {
+        size_t size = m_slots.size() ? m_slots.size() : 16;
+
+        while(m_methods.size() * 2 > size)
+        {
+          size *= 2;
+        }
+
+        /* also indexes the new method */
+        Rehash(size);
+      }
+      else
+      {
+        InsertSlot(it);
+      }
     }
 
     void Handler::DeleteMethod(const std::string& name)
     {
-      /* do not delete system defined method */
-      if(name == "system.describe")
+      size_t i = 0;
+
+      /* do not delete system defined methods */
+      if(name == "system.describe" || (m_statsMethod && name == "system.stats"))
       {
         return;
       }
 
-      for(std::list<CallbackMethod*>::iterator it = m_methods.begin() ; it != m_methods.end() ; it++)
+      i = FindSlot(name, Hash(name));
+
+      if(i == m_slots.size())
       {
-        if((*it)->GetName() == name)
-        {
-          delete (*it);
-          m_methods.erase(it);
-          break;
-        }
+        return;
       }
+
+      delete m_slots[i].entry->method;
+      m_methods.erase(m_slots[i].entry);
+      m_slots[i].state = SLOT_DELETED;
+      m_tombstones++;
+      m_generation++;
     }
 
-    bool Handler::SystemDescribe(const Json::Value& msg, Json::Value& response)
+    void Handler::UpdateDescribe()
     {
       Json::Value methods;
+      Json::Value response;
+      std::string str;
+      size_t pos = 0;
+
+      if(m_describeGeneration == m_generation)
+      {
+        return;
+      }
+
+      for(std::list<MethodEntry>::const_iterator it = m_methods.begin() ; it != m_methods.end() ; it++)
+      {
+        methods[(*it).name] = (*it).method->GetDescription();
+      }
+
+      response["jsonrpc"] = "2.0";
+      response["id"] = Json::Value::null;
+      response["result"] = methods;
+      m_describe.swap(methods);
+
+      /* "id" is the first key written so the first match is the id */
+      str = m_writer.write(response);
+      pos = str.find("\"id\":null") + 5;
+      m_describePrefix = str.substr(0, pos);
+      m_describeSuffix = str.substr(pos + 4);
+
+      m_describeGeneration = m_generation;
+    }
+
+    bool Handler::SystemDescribe(const Json::Value& msg, Json::Value& response)
+    {
       response["jsonrpc"] = "2.0";
       response["id"] = msg["id"];
 
-      for(std::list<CallbackMethod*>::iterator it = m_methods.begin() ; it != m_methods.end() ; it++)
+      m_describeMutex.Lock();
+      UpdateDescribe();
+      response["result"] = m_describe;
+      m_describeMutex.Unlock();
+      return true;
+    }
+
+    void Handler::EnableStats(bool method)
+    {
+      Json::Value root;
+
+      m_stats = true;
+
+      if(!method || m_statsMethod)
       {
-        methods[(*it)->GetName()] = (*it)->GetDescription();
+        return;
       }
-      
-      response["result"] = methods;
+
+      root["description"] = "Get the statistics of the RPC methods";
+      root["parameters"] = Json::Value::null;
+      root["returns"] =
+        "Object that contains calls, errors and latency of all methods registered";
+
+      RpcMethod<Handler>* stats = new RpcMethod<Handler>(*this,
+          &Handler::SystemStats, std::string("system.stats"), root);
+      stats->SetExecutionHint(EXECUTE_INLINE);
+      m_statsMethod = stats;
+      AddMethod(stats);
+    }
+
+    void Handler::GetStats(std::vector<MethodStats>& stats)
+    {
+      size_t i = 0;
+
+      stats.clear();
+
+      if(!m_stats)
+      {
+        return;
+      }
+
+      stats.resize(m_methods.size());
+
+      m_statsMutex.Lock();
+      for(std::list<MethodEntry>::const_iterator it = m_methods.begin() ; it != m_methods.end() ; it++, i++)
+      {
+        MethodStats& method = stats[i];
+
+        method.name = (*it).name;
+        method.calls = 0;
+        method.errors = 0;
+
+        for(size_t j = 0 ; j < m_statsShards.size() ; j++)
+        {
+          const StatsShard* shard = m_statsShards[j];
+          const MethodCounters* counters = NULL;
+
+          if((*it).stats >= shard->methods.size() ||
+              (counters = shard->methods[(*it).stats]) == NULL)
+          {
+            continue;
+          }
+
+          method.calls += system_util::counterRead(&counters->calls);
+          method.errors += system_util::counterRead(&counters->errors);
+          method.latency.AddTotal(system_util::counterRead(&counters->total));
+
+          for(size_t k = 0 ; k < LATENCY_BUCKETS ; k++)
+          {
+            method.latency.Add(k,
+                system_util::counterRead(&counters->buckets[k]));
+          }
+        }
+      }
+      m_statsMutex.Unlock();
+    }
+
+    bool Handler::SystemStats(const Json::Value& msg, Json::Value& response)
+    {
+      std::vector<MethodStats> stats;
+      Json::Value methods(Json::objectValue);
+
+      GetStats(stats);
+
+      for(size_t i = 0 ; i < stats.size() ; i++)
+      {
+        Json::Value& method = methods[stats[i].name];
+
+        method["calls"] = (Json::Value::LargestUInt)stats[i].calls;
+        method["errors"] = (Json::Value::LargestUInt)stats[i].errors;
+        method["total_ns"] =
+          (Json::Value::LargestUInt)stats[i].latency.GetTotal();
+        method["p50_ns"] =
+          (Json::Value::LargestUInt)stats[i].latency.GetPercentile(50.0);
+        method["p90_ns"] =
+          (Json::Value::LargestUInt)stats[i].latency.GetPercentile(90.0);
+        method["p99_ns"] =
+          (Json::Value::LargestUInt)stats[i].latency.GetPercentile(99.0);
+      }
+
+      response["jsonrpc"] = "2.0";
+      response["id"] = msg["id"];
+      response["result"].swap(methods);
       return true;
     }
 
+    bool Handler::Call(const MethodEntry& entry, const Json::Value& root,
+        Json::Value& response)
+    {
+      uint64_t start = 0;
+      bool ret = false;
+
+      if(!m_stats)
+      {
+        return entry.method->Call(root, response);
+      }
+
+      start = system_util::monotonicTimeNs();
+      ret = entry.method->Call(root, response);
+      Record(entry.stats, system_util::monotonicTimeNs() - start,
+          !ret || (response.isObject() && response.isMember("error")));
+
+      return ret;
+    }
+
+    void Handler::Record(size_t index, uint64_t ns, bool error)
+    {
+      StatsShard* shard = static_cast<StatsShard*>(m_statsShard.Get());
+      MethodCounters* counters = NULL;
+
+      /* only the first call of a method by a thread takes the lock */
+      if(shard == NULL || index >= shard->methods.size() ||
+          shard->methods[index] == NULL)
+      {
+        shard = AddCounters(index);
+      }
+
+      counters = shard->methods[index];
+      system_util::counterAdd(&counters->calls, 1);
+      system_util::counterAdd(&counters->total, ns);
+      system_util::counterAdd(
+          &counters->buckets[LatencyHistogram::GetBucket(ns)], 1);
+
+      if(error)
+      {
+        system_util::counterAdd(&counters->errors, 1);
+      }
+    }
+
+    Handler::StatsShard* Handler::AddCounters(size_t index)
+    {
+      StatsShard* shard = static_cast<StatsShard*>(m_statsShard.Get());
+
+      m_statsMutex.Lock();
+      if(shard == NULL)
+      {
+        shard = new StatsShard();
+        m_statsShards.push_back(shard);
+        m_statsShard.Set(shard);
+      }
+
+      /* GetStats() reads the vector with the mutex locked */
+      if(index >= shard->methods.size())
+      {
+        shard->methods.resize(m_statsCount, NULL);
+      }
+
+      if(shard->methods[index] == NULL)
+      {
+        shard->methods[index] = new MethodCounters();
+      }
+      m_statsMutex.Unlock();
+
+      return shard;
+    }
+
     std::string Handler::GetString(Json::Value value)
     {
-      return m_writer.write(value);
+      /* m_writer belongs to UpdateDescribe(), under m_describeMutex */
+      Json::FastWriter writer;
+
+      return writer.write(value);
     }
 
-    bool Handler::Check(const Json::Value& root, Json::Value& error)
+    void Handler::SetError(Json::Value& response, const Json::Value& id,
+        enum ErrorCode code, const char* message)
+    {
+      /* keys and messages are static strings, jsoncpp does not copy them */
+      Json::Value& error = response[Json::StaticString("error")];
+
+      response[Json::StaticString("id")] = id;
+      response[Json::StaticString("jsonrpc")] = Json::StaticString("2.0");
+      error[Json::StaticString("code")] = code;
+      error[Json::StaticString("message")] = Json::StaticString(message);
+    }
+
+    bool Handler::IsValid(const Json::Value& root)
     {
-      Json::Value err;
-      
       /* check the JSON-RPC version => 2.0 */
       if(!root.isObject() || !root.isMember("jsonrpc") ||
-          root["jsonrpc"] != "2.0") 
+          root["jsonrpc"] != Json::StaticString("2.0"))
       {
-        error["id"] = Json::Value::null;
-        error["jsonrpc"] = "2.0";
-        
-        err["code"] = INVALID_REQUEST;
-        err["message"] = "Invalid JSON-RPC request.";
-        error["error"] = err;
         return false;
       }
 
       if(root.isMember("id") && (root["id"].isArray() || root["id"].isObject()))
       {
-        error["id"] = Json::Value::null;
-        error["jsonrpc"] = "2.0";
-
-        err["code"] = INVALID_REQUEST;
-        err["message"] = "Invalid JSON-RPC request.";
-        error["error"] = err;
         return false;
       }
 
       /* extract "method" attribute */
       if(!root.isMember("method") || !root["method"].isString())
       {
-        error["id"] = Json::Value::null;
-        error["jsonrpc"] = "2.0";
+        return false;
+      }
+
+      return true;
+    }
 
-        err["code"] = INVALID_REQUEST;
-        err["message"] = "Invalid JSON-RPC request.";
-        error["error"] = err;
+    bool Handler::Check(const Json::Value& root, Json::Value& error)
+    {
+      if(!IsValid(root))
+      {
+        SetError(error, Json::Value::null, INVALID_REQUEST,
+            "Invalid JSON-RPC request.");
         return false;
       }
 
       return true;
     }
 
-    bool Handler::Process(const Json::Value& root, Json::Value& response)
+    void Handler::AppendId(std::string& out, const Json::Value& id)
+    {
+      switch(id.type())
+      {
+        case Json::nullValue:
+          out.append("null");
+          break;
+        case Json::intValue:
+          out.append(Json::valueToString(id.asLargestInt()));
+          break;
+        case Json::uintValue:
+          out.append(Json::valueToString(id.asLargestUInt()));
+          break;
+        case Json::realValue:
+          out.append(Json::valueToString(id.asDouble()));
+          break;
+        case Json::stringValue:
+          appendQuoted(out, id);
+          break;
+        case Json::booleanValue:
+          out.append(id.asBool() ? "true" : "false");
+          break;
+        default:
+          /* rejected by IsValid() */
+          out.append("null");
+          break;
+      }
+    }
+
+    bool Handler::ProcessRequest(const Json::Value& root, Json::Value& response)
     {
-      Json::Value error;
       std::string method;
 
-      if(!Check(root, error))
+      /* error response is built directly in response */
+      if(!Check(root, response))
       {
-        response = error;
         return false;
       }
 
@@ -160,46 +500,251 @@ namespace Json
       
       if(method != "")
       {
-        CallbackMethod* rpc = Lookup(method);
+        const MethodEntry* rpc = Lookup(method);
         if(rpc)
         {
-          return rpc->Call(root, response);
+          return Call(*rpc, root, response);
         }
       }
       
       /* forge an error response */
-      response["id"] = root.isMember("id") ? root["id"] : Json::Value::null;
-      response["jsonrpc"] = "2.0";
+      SetError(response, root.isMember("id") ? root["id"] : Json::Value::null,
+          METHOD_NOT_FOUND, "Method not found.");
+      return false;
+    }
 
-      error["code"] = METHOD_NOT_FOUND;
-      error["message"] = "Method not found.";
-      response["error"] = error;
+    bool Handler::Parse(const std::string& msg, Json::Value& root,
+        Json::Value& response)
+    {
+      return Parse(m_reader, msg, root, response);
+    }
 
-      return false;
+    bool Handler::Parse(Json::Reader& reader, const std::string& msg,
+        Json::Value& root, std::string& error) const
+    {
+      return Parse(reader, msg.data(), msg.length(), root, error);
     }
 
-    bool Handler::Process(const std::string& msg, Json::Value& response)
+    bool Handler::Parse(Json::Reader& reader, const char* msg, size_t size,
+        Json::Value& root, std::string& error) const
     {
-      Json::Value root;
-      Json::Value error;
-      bool parsing = false;
+      error.clear();
 
-      /* parsing */
-      parsing = m_reader.parse(msg, root);
-      
-      if(!parsing)
+      if(!reader.parse(msg, msg + size, root))
       {
         /* request or batched call is not in JSON format */
-        response["id"] = Json::Value::null;
-        response["jsonrpc"] = "2.0";
-        
-        error["code"] = PARSING_ERROR;
-        error["message"] = "Parse error.";
-        response["error"] = error; 
+        error.append(m_parseError);
         return false;
       }
-      
-      if(root.isArray())
+
+      return true;
+    }
+
+    const std::string& Handler::GetErrorString(enum ErrorCode code) const
+    {
+      static const std::string empty;
+
+      switch(code)
+      {
+        case PARSING_ERROR:
+          return m_parseError;
+        case INVALID_REQUEST:
+          return m_invalidRequest;
+        default:
+          return empty;
+      }
+    }
+
+    bool Handler::Parse(Json::Reader& reader, const std::string& msg,
+        Json::Value& root, Json::Value& response) const
+    {
+      /* parsing (from the message buffer, the std::string overload copies
+       * it in the reader)
+       */
+      if(!reader.parse(msg.data(), msg.data() + msg.length(), root))
+      {
+        /* request or batched call is not in JSON format */
+        SetError(response, Json::Value::null, PARSING_ERROR, "Parse error.");
+        return false;
+      }
+
+      return true;
+    }
+
+    bool Handler::SetBatchPool(size_t threads, size_t maxConcurrency,
+        size_t threshold)
+    {
+      if(m_batchPool)
+      {
+        m_batchPool->Stop();
+        delete m_batchPool;
+        m_batchPool = NULL;
+      }
+
+      if(threads == 0)
+      {
+        return true;
+      }
+
+      /* helpers are not queued when all threads are busy, no need for a
+       * deep queue
+       */
+      m_batchPool = new system_util::ThreadPool(threads, threads);
+
+      if(!m_batchPool->Start())
+      {
+        delete m_batchPool;
+        m_batchPool = NULL;
+        return false;
+      }
+
+      m_batchConcurrency = maxConcurrency ? maxConcurrency : threads + 1;
+      m_batchThreshold = threshold;
+      return true;
+    }
+
+    void Handler::ProcessBatch(const Json::Value& root, Json::Value& response)
+    {
+      BatchContext* ctx = new BatchContext();
+      Json::Value::ArrayIndex j = 0;
+      size_t helpers = m_batchConcurrency - 1;
+
+      ctx->root = &root;
+      ctx->results.resize(root.size());
+      ctx->next = 0;
+      ctx->running = 0;
+      ctx->refs = 1;
+      ctx->closed = false;
+
+      if(helpers > root.size() - 1)
+      {
+        helpers = root.size() - 1;
+      }
+
+      for(size_t i = 0 ; i < helpers ; i++)
+      {
+        system_util::ThreadArg* task = new system_util::ThreadArgImpl<Handler>(
+            *this, &Handler::RunBatch, ctx);
+
+        ctx->mutex.Lock();
+        ctx->refs++;
+        ctx->mutex.Unlock();
+
+        /* do not wait for a free thread, the caller works meanwhile */
+        if(!m_batchPool->Push(task, false))
+        {
+          delete task;
+          ctx->mutex.Lock();
+          ctx->refs--;
+          ctx->mutex.Unlock();
+          break;
+        }
+      }
+
+      RunBatchElements(ctx);
+
+      /* all elements are taken, helpers not started yet will do nothing,
+       * wait for the others to finish
+       */
+      ctx->mutex.Lock();
+      ctx->closed = true;
+      while(ctx->running > 0)
+      {
+        ctx->done.Wait(ctx->mutex);
+      }
+      ctx->mutex.Unlock();
+
+      for(size_t i = 0 ; i < ctx->results.size() ; i++)
+      {
+        if(ctx->results[i] != Json::Value::null)
+        {
+          /* it is not a notification, add to array of responses */
+          response[j].swap(ctx->results[i]);
+          j++;
+        }
+      }
+
+      ReleaseBatch(ctx);
+    }
+
+    void Handler::RunBatchElements(BatchContext* ctx)
+    {
+      for(;;)
+      {
+        Json::Value::ArrayIndex i = 0;
+
+        ctx->mutex.Lock();
+        i = ctx->next;
+        if(i < ctx->results.size())
+        {
+          ctx->next++;
+        }
+        ctx->mutex.Unlock();
+
+        if(i >= ctx->results.size())
+        {
+          break;
+        }
+
+        ProcessRequest((*ctx->root)[i], ctx->results[i]);
+      }
+    }
+
+    void* Handler::RunBatch(void* arg)
+    {
+      BatchContext* ctx = static_cast<BatchContext*>(arg);
+      bool closed = false;
+
+      ctx->mutex.Lock();
+      closed = ctx->closed;
+      if(!closed)
+      {
+        ctx->running++;
+      }
+      ctx->mutex.Unlock();
+
+      if(!closed)
+      {
+        RunBatchElements(ctx);
+
+        ctx->mutex.Lock();
+        ctx->running--;
+        if(ctx->running == 0)
+        {
+          ctx->done.Signal();
+        }
+        ctx->mutex.Unlock();
+      }
+
+      ReleaseBatch(ctx);
+      return NULL;
+    }
+
+    void Handler::ReleaseBatch(BatchContext* ctx)
+    {
+      bool last = false;
+
+      ctx->mutex.Lock();
+      ctx->refs--;
+      last = (ctx->refs == 0);
+      ctx->mutex.Unlock();
+
+      if(last)
+      {
+        delete ctx;
+      }
+    }
+
+    bool Handler::Process(const Json::Value& root, Json::Value& response)
+    {
+      if(root.isArray() && m_batchPool && root.size() > 1 &&
+          root.size() >= m_batchThreshold)
+      {
+        /* batched call executed in parallel */
+        ProcessBatch(root, response);
+        return true;
+      }
+      else if(root.isArray())
       {
         /* batched call */
         Json::Value::ArrayIndex i = 0;
@@ -208,12 +753,14 @@ namespace Json
         for(i = 0 ; i < root.size() ; i++)
         {
           Json::Value ret;
-          Process(root[i], ret);
+          ProcessRequest(root[i], ret);
           
           if(ret != Json::Value::null)
           {
-            /* it is not a notification, add to array of responses */
-            response[j] = ret;
+            /* it is not a notification, move it to the array of responses
+             * (swap avoids a deep copy)
+             */
+            response[j].swap(ret);
             j++;
           }
         }
@@ -221,8 +768,76 @@ namespace Json
       }
       else
       {
+        return ProcessRequest(root, response);
+      }
+    }
+
+    bool Handler::Process(const Json::Value& root, Json::Value& response,
+        std::string& serialized)
+    {
+      const MethodEntry* rpc = NULL;
+      std::string method;
+      uint64_t start = 0;
+
+      serialized.clear();
+
+      if(root.isArray())
+      {
+        /* errors in a batched call are part of the response array */
         return Process(root, response);
       }
+
+      if(!IsValid(root))
+      {
+        serialized.append(m_invalidRequest);
+        return false;
+      }
+
+      method = root["method"].asString();
+
+      if(method != "" && (rpc = Lookup(method)) != NULL)
+      {
+        if(rpc->method != m_describeMethod)
+        {
+          return Call(*rpc, root, response);
+        }
+
+        if(m_stats)
+        {
+          start = system_util::monotonicTimeNs();
+        }
+
+        /* cached system.describe, only the id changes */
+        m_describeMutex.Lock();
+        UpdateDescribe();
+        serialized.append(m_describePrefix);
+        AppendId(serialized, root.isMember("id") ? root["id"] : Json::Value::null);
+        serialized.append(m_describeSuffix);
+        m_describeMutex.Unlock();
+
+        if(m_stats)
+        {
+          Record(rpc->stats, system_util::monotonicTimeNs() - start, false);
+        }
+        return true;
+      }
+
+      serialized.append(m_notFoundPrefix);
+      AppendId(serialized, root.isMember("id") ? root["id"] : Json::Value::null);
+      serialized.append(m_notFoundSuffix);
+      return false;
+    }
+
+    bool Handler::Process(const std::string& msg, Json::Value& response)
+    {
+      Json::Value root;
+
+      if(!Parse(msg, root, response))
+      {
+        return false;
+      }
+
+      return Process(root, response);
     }
 
     bool Handler::Process(const char* msg, Json::Value& response)
@@ -232,17 +847,138 @@ namespace Json
       return Process(str, response);
     }
 
-    CallbackMethod* Handler::Lookup(const std::string& name) const
+    size_t Handler::Hash(const std::string& name)
+    {
+      /* 32-bit FNV-1a, good enough for short identifiers */
+      uint32_t hash = 2166136261U;
+
+      for(size_t i = 0 ; i < name.length() ; i++)
+      {
+        hash ^= (unsigned char)name[i];
+        hash *= 16777619U;
+      }
+
+      return hash;
+    }
+
+    size_t Handler::FindSlot(const std::string& name, size_t hash) const
+    {
+      size_t mask = m_slots.size() - 1;
+      size_t i = 0;
+
+      if(m_slots.empty())
+      {
+        return m_slots.size();
+      }
+
+      for(i = hash & mask ; m_slots[i].state != SLOT_EMPTY ; i = (i + 1) & mask)
+      {
+        if(m_slots[i].state == SLOT_USED && m_slots[i].hash == hash &&
+            m_slots[i].entry->name == name)
+        {
+          return i;
+        }
+      }
+
+      return m_slots.size();
+    }
+
+    void Handler::InsertSlot(std::list<MethodEntry>::iterator entry)
+    {
+      size_t mask = m_slots.size() - 1;
+      size_t i = 0;
+      size_t pos = m_slots.size();
+
+      /* walk the whole probe sequence: a tombstone can only be reused if no
+       * method with the same name comes after it, otherwise the new method
+       * would shadow the one registered first
+       */
+      for(i = entry->hash & mask ; m_slots[i].state != SLOT_EMPTY ; i = (i + 1) & mask)
+      {
+        if(m_slots[i].state == SLOT_DELETED)
+        {
+          if(pos == m_slots.size())
+          {
+            pos = i;
+          }
+        }
+        else if(m_slots[i].hash == entry->hash &&
+            m_slots[i].entry->name == entry->name)
+        {
+          pos = m_slots.size();
+        }
+      }
+
+      if(pos == m_slots.size())
+      {
+        pos = i;
+      }
+      else
+      {
+        m_tombstones--;
+      }
+
+      m_slots[pos].entry = entry;
+      m_slots[pos].hash = entry->hash;
+      m_slots[pos].state = SLOT_USED;
+    }
+
+    void Handler::Rehash(size_t size)
+    {
+      MethodSlot empty;
+
+      empty.entry = m_methods.end();
+      empty.hash = 0;
+      empty.state = SLOT_EMPTY;
+
+      m_slots.assign(size, empty);
+      m_tombstones = 0;
+
+      /* registration order is preserved for methods with the same name */
+      for(std::list<MethodEntry>::iterator it = m_methods.begin() ; it != m_methods.end() ; it++)
+      {
+        InsertSlot(it);
+      }
+    }
+
+    const Handler::MethodEntry* Handler::Lookup(const std::string& name) const
+    {
+      size_t i = FindSlot(name, Hash(name));
+
+      return (i != m_slots.size()) ? &(*m_slots[i].entry) : 0;
+    }
+
+    enum ExecutionHint Handler::GetRequestHint(const Json::Value& root) const
+    {
+      size_t i = 0;
+
+      /* invalid requests only produce an error response */
+      if(!root.isObject() || !root["method"].isString())
+      {
+        return EXECUTE_INLINE;
+      }
+
+      const std::string& name = root["method"].asString();
+      i = FindSlot(name, Hash(name));
+
+      return (i != m_slots.size()) ? m_slots[i].entry->hint : EXECUTE_INLINE;
+    }
+
+    enum ExecutionHint Handler::GetExecutionHint(const Json::Value& root) const
     {
-      for(std::list<CallbackMethod*>::const_iterator it = m_methods.begin() ; it != m_methods.end() ; it++)
+      if(root.isArray())
       {
-        if((*it)->GetName() == name)
+        for(Json::Value::ArrayIndex i = 0 ; i < root.size() ; i++)
         {
-          return (*it);
+          if(GetRequestHint(root[i]) == EXECUTE_POOLED)
+          {
+            return EXECUTE_POOLED;
+          }
         }
+        return EXECUTE_INLINE;
       }
 
-      return 0;
+      return GetRequestHint(root);
     }
   } /* namespace Rpc */
 } /* namespace Json */
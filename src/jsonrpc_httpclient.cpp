@@ -22,7 +22,7 @@
  * \author Brian Panneton
  */
 
-#ifdef CURL_ENABLED_H
+#ifdef CURL_ENABLED
 
 #include <sstream>
 
@@ -33,6 +33,151 @@ namespace Json
 {
   namespace Rpc
   {
+    /**
+     * \var DEFAULT_MAX_CONNECTIONS
+     * \brief Default maximum number of connections of the concurrent
+     * requests.
+     */
+    static const long DEFAULT_MAX_CONNECTIONS = 8;
+
+    /**
+     * \var POLL_TIMEOUT_MS
+     * \brief Maximum time the transfer thread waits for network activity,
+     * it is woken up earlier by new requests when libcurl supports it.
+     */
+#if LIBCURL_VERSION_NUM >= 0x074400
+    static const int POLL_TIMEOUT_MS = 1000;
+#else
+    static const int POLL_TIMEOUT_MS = 10;
+#endif
+
+    /**
+     * \var MAX_FREE_BUFFERS
+     * \brief Maximum number of response buffers kept for the next responses.
+     */
+    static const size_t MAX_FREE_BUFFERS = 8;
+
+    /**
+     * \var MAX_RESERVE_SIZE
+     * \brief Maximum size reserved from the Content-Length of a response,
+     * larger bodies grow as they arrive.
+     */
+    static const size_t MAX_RESERVE_SIZE = 16 * 1024 * 1024;
+
+    /**
+     * \brief Reserve a response buffer for the body size announced by the
+     * server, so that it is not reallocated as the body arrives.
+     * \param handle easy handle of the response
+     * \param body response buffer
+     */
+    static void reserveBody(CURL* handle, std::string& body)
+    {
+#if LIBCURL_VERSION_NUM >= 0x073700
+      curl_off_t length = -1;
+
+      if(curl_easy_getinfo(handle, CURLINFO_CONTENT_LENGTH_DOWNLOAD_T,
+            &length) != CURLE_OK)
+#else
+      double length = -1;
+
+      if(curl_easy_getinfo(handle, CURLINFO_CONTENT_LENGTH_DOWNLOAD,
+            &length) != CURLE_OK)
+#endif
+      {
+        return;
+      }
+
+      /* -1 if unknown (chunked response) */
+      if(length > 0 && length <= (double)MAX_RESERVE_SIZE)
+      {
+        body.reserve((size_t)length);
+      }
+    }
+
+    HttpTransfer::HttpTransfer()
+    {
+      m_handle = NULL;
+      m_ready = false;
+      m_error = CURLE_OK;
+      m_status = 0;
+    }
+
+    HttpTransfer::~HttpTransfer()
+    {
+    }
+
+    ssize_t HttpTransfer::Wait(std::string& data)
+    {
+      m_mutex.Lock();
+      while(!m_ready)
+      {
+        m_cond.Wait(m_mutex);
+      }
+      m_mutex.Unlock();
+
+      /* not modified anymore until Reset() */
+      if(m_error != CURLE_OK)
+      {
+        return -1;
+      }
+
+      data = m_response;
+      return data.size();
+    }
+
+    bool HttpTransfer::IsReady()
+    {
+      bool ret = false;
+
+      m_mutex.Lock();
+      ret = m_ready;
+      m_mutex.Unlock();
+
+      return ret;
+    }
+
+    CURLcode HttpTransfer::GetError()
+    {
+      CURLcode ret = CURLE_OK;
+
+      m_mutex.Lock();
+      ret = m_error;
+      m_mutex.Unlock();
+
+      return ret;
+    }
+
+    long HttpTransfer::GetStatus()
+    {
+      long ret = 0;
+
+      m_mutex.Lock();
+      ret = m_status;
+      m_mutex.Unlock();
+
+      return ret;
+    }
+
+    void HttpTransfer::Reset()
+    {
+      m_mutex.Lock();
+      m_ready = false;
+      m_error = CURLE_OK;
+      m_status = 0;
+      m_response.clear();
+      m_mutex.Unlock();
+    }
+
+    void HttpTransfer::Done(CURLcode error, long status)
+    {
+      m_mutex.Lock();
+      m_error = error;
+      m_status = status;
+      m_ready = true;
+      m_cond.Broadcast();
+      m_mutex.Unlock();
+    }
+
     HttpClient::HttpClient()
     {
       this->Initialize();
@@ -53,9 +198,16 @@ namespace Json
 
     void HttpClient::Initialize()
     {
+      /* concurrent requests */
+      m_pending = 0;
+      m_maxConnections = DEFAULT_MAX_CONNECTIONS;
+      m_transferThread = NULL;
+      m_stop = false;
+
       /* Init all necessary curl stuff (in windows it will do winsock) */
       curl_global_init(CURL_GLOBAL_ALL);
       m_curlHandle = curl_easy_init();
+      m_multiHandle = curl_multi_init();
 
       /* Set up curl to catch the servers response */
       curl_easy_setopt(m_curlHandle, CURLOPT_WRITEFUNCTION,
@@ -78,7 +230,7 @@ namespace Json
 
       /* Force curl to use POST */
       if((error = (size_t)curl_easy_setopt(m_curlHandle, CURLOPT_POST, 
-              1)) != 0)
+              1L)) != 0)
       {
         std::cerr << curl_easy_strerror((CURLcode)error);
         // TODO maybe throw exception here
@@ -86,7 +238,7 @@ namespace Json
       }
 
       // test if mutex is valid
-      if(m_mutex.Lock())
+      if(!m_mutex.Lock())
       {
         std::cerr << "Can't create mutex for receive list.\n";
         // TODO maybe throw exception here
@@ -102,7 +254,26 @@ namespace Json
 
     HttpClient::~HttpClient()
     {
+      /* the transfer thread aborts the requests not yet ended */
+      m_queueMutex.Lock();
+      m_stop = true;
+      m_queueMutex.Unlock();
+      this->Wakeup();
+
+      if(m_transferThread)
+      {
+        m_transferThread->Join();
+        delete m_transferThread;
+      }
+
+      for(size_t i = 0 ; i < m_handles.size() ; i++)
+      {
+        curl_easy_cleanup(m_handles[i]);
+      }
+      curl_multi_cleanup(m_multiHandle);
+
       /* Clean up after we are done */
+      curl_easy_cleanup(m_curlHandle);
       curl_slist_free_all(m_headers);
       curl_global_cleanup();
     }
@@ -155,70 +326,377 @@ namespace Json
 
       /* Tell curl what data to send */
       if((error = (size_t)curl_easy_setopt(m_curlHandle, CURLOPT_POSTFIELDS, 
-              data.c_str())) != 0)
+              rep.c_str())) != 0)
       {
         std::cerr << curl_easy_strerror((CURLcode)error);
         return error;
       }
       if((error = (size_t)curl_easy_setopt(m_curlHandle, 
               CURLOPT_POSTFIELDSIZE,
-              data.length())) != 0)
+              (long)rep.length())) != 0)
       {
         std::cerr << curl_easy_strerror((CURLcode)error);
         return error;
       }
 
-      /* Send the data */
+      /* Send the data, the response is assembled in m_body */
+      m_body.clear();
       if((error = (size_t)curl_easy_perform(m_curlHandle)) != 0)
       { 
         std::cerr << curl_easy_strerror((CURLcode)error);
         return error;
       }
+
+      /* one message per response */
+      if(!m_body.empty())
+      {
+        this->StoreRecv(m_body);
+      }
       return 0;
     }
 
+    bool HttpClient::SendAsync(const std::string& data,
+        HttpTransfer& transfer)
+    {
+      if(this->GetAddress() == "" || m_multiHandle == NULL)
+      {
+        return false;
+      }
+
+      transfer.Reset();
+
+      /* encoding if any */
+      if(GetEncapsulatedFormat() == Json::Rpc::NETSTRING)
+      {
+        transfer.m_request = netstring::encode(data);
+      }
+      else
+      {
+        transfer.m_request = data;
+      }
+
+      m_queueMutex.Lock();
+      if(m_transferThread == NULL)
+      {
+        /* the idle connections are kept for the next requests */
+        curl_multi_setopt(m_multiHandle, CURLMOPT_MAX_HOST_CONNECTIONS,
+            m_maxConnections);
+        curl_multi_setopt(m_multiHandle, CURLMOPT_MAXCONNECTS,
+            m_maxConnections);
+
+        m_transferThread = new system_util::Thread(
+            new system_util::ThreadArgImpl<HttpClient>(*this, &HttpClient::Run,
+              NULL));
+
+        if(!m_transferThread->Start(false))
+        {
+          delete m_transferThread;
+          m_transferThread = NULL;
+          m_queueMutex.Unlock();
+          std::cerr << "Can't start the transfer thread.\n";
+          return false;
+        }
+      }
+
+      m_queue.push_back(&transfer);
+      m_pending++;
+      m_queueMutex.Unlock();
+
+      this->Wakeup();
+      return true;
+    }
+
+    void HttpClient::SetMaxConnections(long max)
+    {
+      if(max < 0)
+      {
+        max = 0;
+      }
+      m_maxConnections = max;
+    }
+
+    long HttpClient::GetMaxConnections() const
+    {
+      return m_maxConnections;
+    }
+
+    size_t HttpClient::GetPendingCount()
+    {
+      size_t ret = 0;
+
+      m_queueMutex.Lock();
+      ret = m_pending;
+      m_queueMutex.Unlock();
+
+      return ret;
+    }
+
+    CURL* HttpClient::PrepareHandle(HttpTransfer* transfer)
+    {
+      CURL* handle = NULL;
+
+      if(!m_freeHandles.empty())
+      {
+        handle = m_freeHandles.back();
+        m_freeHandles.pop_back();
+      }
+      else
+      {
+        handle = curl_easy_init();
+
+        if(handle == NULL)
+        {
+          return NULL;
+        }
+
+        m_handles.push_back(handle);
+
+        /* settings common to all requests */
+        curl_easy_setopt(handle, CURLOPT_WRITEFUNCTION,
+            HttpClient::StaticTransferRecv);
+        curl_easy_setopt(handle, CURLOPT_HTTPHEADER, m_headers);
+        curl_easy_setopt(handle, CURLOPT_POST, 1L);
+        curl_easy_setopt(handle, CURLOPT_NOSIGNAL, 1L);
+      }
+
+      curl_easy_setopt(handle, CURLOPT_URL, this->GetAddress().c_str());
+
+      if(this->GetPort() != 0)
+      {
+        curl_easy_setopt(handle, CURLOPT_PORT, (long)this->GetPort());
+      }
+
+      curl_easy_setopt(handle, CURLOPT_POSTFIELDS, transfer->m_request.data());
+      curl_easy_setopt(handle, CURLOPT_POSTFIELDSIZE,
+          (long)transfer->m_request.size());
+      curl_easy_setopt(handle, CURLOPT_WRITEDATA, transfer);
+      curl_easy_setopt(handle, CURLOPT_PRIVATE, transfer);
+      transfer->m_handle = handle;
+
+      return handle;
+    }
+
+    void HttpClient::Finish(HttpTransfer* transfer, CURLcode error,
+        long status)
+    {
+      m_queueMutex.Lock();
+      m_pending--;
+      m_queueMutex.Unlock();
+
+      transfer->Done(error, status);
+    }
+
+    void HttpClient::Wakeup()
+    {
+#if LIBCURL_VERSION_NUM >= 0x074400
+      if(m_multiHandle)
+      {
+        curl_multi_wakeup(m_multiHandle);
+      }
+#endif
+    }
+
+    void* HttpClient::Run(void* arg)
+    {
+      std::list<HttpTransfer*> queue;
+      bool stop = false;
+
+      (void)arg;
+
+      while(!stop)
+      {
+        CURLMsg* msg = NULL;
+        int running = 0;
+        int left = 0;
+
+        m_queueMutex.Lock();
+        stop = m_stop;
+        queue.swap(m_queue);
+        m_queueMutex.Unlock();
+
+        for(std::list<HttpTransfer*>::iterator it = queue.begin() ;
+            !stop && it != queue.end() ; it++)
+        {
+          CURL* handle = PrepareHandle(*it);
+
+          if(handle == NULL)
+          {
+            Finish(*it, CURLE_OUT_OF_MEMORY, 0);
+          }
+          else if(curl_multi_add_handle(m_multiHandle, handle) != CURLM_OK)
+          {
+            m_freeHandles.push_back(handle);
+            Finish(*it, CURLE_FAILED_INIT, 0);
+          }
+        }
+
+        if(stop)
+        {
+          break;
+        }
+        queue.clear();
+
+        curl_multi_perform(m_multiHandle, &running);
+
+        while((msg = curl_multi_info_read(m_multiHandle, &left)) != NULL)
+        {
+          CURL* handle = msg->easy_handle;
+          CURLcode result = msg->data.result;
+          char* priv = NULL;
+          long status = 0;
+
+          if(msg->msg != CURLMSG_DONE)
+          {
+            continue;
+          }
+
+          curl_easy_getinfo(handle, CURLINFO_PRIVATE, &priv);
+          curl_easy_getinfo(handle, CURLINFO_RESPONSE_CODE, &status);
+
+          /* msg is not valid anymore, the connection stays in the cache of
+           * m_multiHandle for the next requests
+           */
+          curl_multi_remove_handle(m_multiHandle, handle);
+          curl_easy_setopt(handle, CURLOPT_PRIVATE, (void*)NULL);
+          m_freeHandles.push_back(handle);
+
+          Finish(reinterpret_cast<HttpTransfer*>(priv), result, status);
+        }
+
+#if LIBCURL_VERSION_NUM >= 0x074400
+        curl_multi_poll(m_multiHandle, NULL, 0, POLL_TIMEOUT_MS, NULL);
+#else
+        curl_multi_wait(m_multiHandle, NULL, 0, POLL_TIMEOUT_MS, NULL);
+
+        if(running == 0)
+        {
+          /* curl_multi_wait() does not wait without transfers */
+          system_util::msleep(POLL_TIMEOUT_MS);
+        }
+#endif
+      }
+
+      /* abort the requests in flight, then the queued ones */
+      for(size_t i = 0 ; i < m_handles.size() ; i++)
+      {
+        char* priv = NULL;
+
+        curl_easy_getinfo(m_handles[i], CURLINFO_PRIVATE, &priv);
+
+        if(priv)
+        {
+          curl_multi_remove_handle(m_multiHandle, m_handles[i]);
+          curl_easy_setopt(m_handles[i], CURLOPT_PRIVATE, (void*)NULL);
+          Finish(reinterpret_cast<HttpTransfer*>(priv),
+              CURLE_ABORTED_BY_CALLBACK, 0);
+        }
+      }
+
+      for(std::list<HttpTransfer*>::iterator it = queue.begin() ;
+          it != queue.end() ; it++)
+      {
+        Finish(*it, CURLE_ABORTED_BY_CALLBACK, 0);
+      }
+
+      return NULL;
+    }
+
+    size_t HttpClient::StaticTransferRecv(void* buffer, size_t size,
+        size_t nmemb, void* f)
+    {
+      HttpTransfer* transfer = static_cast<HttpTransfer*>(f);
+
+      /* headers are known when the first chunk comes */
+      if(transfer->m_response.empty())
+      {
+        reserveBody(transfer->m_handle, transfer->m_response);
+      }
+
+      /* the body is not split in several messages */
+      transfer->m_response.append(static_cast<char*>(buffer), size * nmemb);
+
+      return size * nmemb;
+    }
+
     size_t HttpClient::StaticRecv(void *buffer, size_t size, size_t nmemb, 
         void*f)
     {
-      /* Get the data without the null term char */
-      std::string data;
-      data.assign((char*)buffer, (size_t)0, size*nmemb);
+      HttpClient* client = static_cast<HttpClient*>(f);
 
-      /* Send our data to the current class instance */
-      static_cast<HttpClient*>(f)->StoreRecv(data);
+      /* headers are known when the first chunk comes */
+      if(client->m_body.empty())
+      {
+        reserveBody(client->m_curlHandle, client->m_body);
+      }
+
+      /* Get the data without the null term char */
+      client->m_body.append(static_cast<char*>(buffer), size*nmemb);
 
       /* return the size of data received */
       return size*nmemb;
     }
 
-    void HttpClient::StoreRecv(const std::string &data)
+    void HttpClient::StoreRecv(std::string &data)
     {
       m_mutex.Lock();
-      this->m_lastReceivedList.push_back(data);
-      if(m_lastReceivedListSize == -1)
+
+      /* reuse a list node and the buffer in it */
+      if(m_freeBuffers.empty())
       {
-        m_mutex.Unlock();
-        return;
+        this->m_lastReceivedList.push_back(std::string());
       }
+      else
+      {
+        this->m_lastReceivedList.splice(m_lastReceivedList.end(),
+            m_freeBuffers, m_freeBuffers.begin());
+      }
+      this->m_lastReceivedList.back().swap(data);
+      data.clear();
 
-      if(m_lastReceivedList.size() > (unsigned int)m_lastReceivedListSize)
+      if(m_lastReceivedListSize != -1 &&
+          m_lastReceivedList.size() > (unsigned int)m_lastReceivedListSize)
       {
-        m_lastReceivedList.pop_front();
+        this->RecycleFront();
       }
+
+      /* wake up the threads in WaitRecv() */
+      m_recvCond.Broadcast();
       m_mutex.Unlock();
     }
 
-    ssize_t HttpClient::Recv(std::string &data)
+    ssize_t HttpClient::PopRecv(std::string &data)
     {
       if(m_lastReceivedList.empty())
       {
         return 0;
       }
 
+      /* the previous buffer of the caller is recycled */
+      data.swap(this->m_lastReceivedList.front());
+      this->RecycleFront();
+
+      return data.size();
+    }
+
+    void HttpClient::RecycleFront()
+    {
+      if(m_freeBuffers.size() < MAX_FREE_BUFFERS)
+      {
+        m_freeBuffers.splice(m_freeBuffers.end(), m_lastReceivedList,
+            m_lastReceivedList.begin());
+      }
+      else
+      {
+        m_lastReceivedList.pop_front();
+      }
+    }
+
+    ssize_t HttpClient::Recv(std::string &data)
+    {
+      ssize_t length = 0;
+
       m_mutex.Lock();
-      data = this->m_lastReceivedList.front();
-      ssize_t length = this->m_lastReceivedList.front().length();
-      this->m_lastReceivedList.pop_front();
+      length = this->PopRecv(data);
       m_mutex.Unlock();
 
       return length;
@@ -226,22 +704,48 @@ namespace Json
 
     ssize_t HttpClient::WaitRecv(std::string &data)
     {
-      while(data.size() == 0)
+      ssize_t length = 0;
+
+      m_mutex.Lock();
+      while(m_lastReceivedList.empty())
       {
-        this->Recv(data);
+        m_recvCond.Wait(m_mutex);
       }
-      return data.size();
+      length = this->PopRecv(data);
+      m_mutex.Unlock();
+
+      return length;
     }
 
     ssize_t HttpClient::WaitRecv(std::string &data, unsigned int timeout)
     {
-      time_t cur_time = time(NULL);
-      while(data.size() == 0 && 
-          static_cast<time_t>(cur_time + timeout) > time(NULL))
+      return this->WaitRecvMs(data, (unsigned long)timeout * 1000);
+    }
+
+    ssize_t HttpClient::WaitRecvMs(std::string &data, unsigned long timeout)
+    {
+      uint64_t deadline = system_util::monotonicTime() +
+        (uint64_t)timeout * 1000;
+      ssize_t length = 0;
+
+      m_mutex.Lock();
+      while(m_lastReceivedList.empty())
       {
-        this->Recv(data);
+        uint64_t now = system_util::monotonicTime();
+
+        if(now >= deadline)
+        {
+          break;
+        }
+
+        /* rounded up so that it does not wake up just before the deadline */
+        m_recvCond.TimedWait(m_mutex,
+            (unsigned long)((deadline - now + 999) / 1000));
       }
-      return data.size();
+      length = this->PopRecv(data);
+      m_mutex.Unlock();
+
+      return length;
     }
 
     void HttpClient::SetRecvListSize(int size)
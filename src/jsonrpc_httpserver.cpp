@@ -0,0 +1,48 @@
+/*
+ *  JsonRpc-Cpp - JSON-RPC implementation.
+ *  Copyright (C) 2008-2011 Sebastien Vincent <sebastien.vincent@cppextrem.com>
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**
+ * \file jsonrpc_httpserver.cpp
+ * \brief JSON-RPC HTTP server.
+ * \author Sebastien Vincent
+ */
+
+#include "jsonrpc_httpserver.h"
+
+namespace Json
+{
+  namespace Rpc
+  {
+    HttpServer::HttpServer(const std::string& address, uint16_t port,
+        enum EventBackend backend) : TcpServer(address, port, backend)
+    {
+      SetEncapsulatedFormat(HTTP_POST);
+    }
+
+    HttpServer::HttpServer(const std::string& address, uint16_t port,
+        Handler& handler, enum EventBackend backend)
+      : TcpServer(address, port, handler, backend)
+    {
+      SetEncapsulatedFormat(HTTP_POST);
+    }
+
+    HttpServer::~HttpServer()
+    {
+    }
+  } /* namespace Rpc */
+} /* namespace Json */
@@ -0,0 +1,391 @@
+/*
+ *  JsonRpc-Cpp - JSON-RPC implementation.
+ *  Copyright (C) 2008-2011 Sebastien Vincent <sebastien.vincent@cppextrem.com>
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+/**
+ * \file jsonrpc_metrics.cpp
+ * \brief Server metrics in Prometheus text format.
+ * \author Sebastien Vincent
+ */
+
+#include <cstdio>
+
+#include "jsonrpc_metrics.h"
+
+namespace Json
+{
+  namespace Rpc
+  {
+    /**
+     * \struct MetricInfo
+     * \brief Exposition of a Metric.
+     */
+    struct MetricInfo
+    {
+      const char* name; /**< Name of the metric. */
+      const char* type; /**< Prometheus type. */
+      const char* help; /**< Description. */
+    };
+
+    /**
+     * \var METRIC_INFOS
+     * \brief Exposition of the metrics, in the order of enum Metric.
+     */
+    static const MetricInfo METRIC_INFOS[METRIC_COUNT] =
+    {
+      {"jsonrpc_connections_accepted_total", "counter",
+        "Connections accepted."},
+      {"jsonrpc_connections_closed_total", "counter",
+        "Connections closed."},
+      {"jsonrpc_received_bytes_total", "counter", "Bytes received."},
+      {"jsonrpc_sent_bytes_total", "counter", "Bytes sent."},
+      {"jsonrpc_messages_total", "counter", "Messages received."},
+      {"jsonrpc_parse_errors_total", "counter",
+        "Messages which are not valid JSON."},
+      {"jsonrpc_framing_errors_total", "counter",
+        "Invalid netstring or HTTP framing, or message too big."},
+      {"jsonrpc_output_queue_bytes", "gauge",
+        "Bytes of responses waiting to be sent."},
+      {"jsonrpc_job_queue_depth", "gauge",
+        "Requests waiting for a worker thread."}
+    };
+
+    /**
+     * \struct LatencyBound
+     * \brief Bucket of the exposed method durations.
+     */
+    struct LatencyBound
+    {
+      uint64_t ns; /**< Upper bound in nanoseconds. */
+      const char* le; /**< Upper bound in seconds, as exposed. */
+    };
+
+    /**
+     * \var LATENCY_BOUNDS
+     * \brief Buckets of the exposed method durations (the LatencyHistogram
+     * buckets are too many to be exposed, they are summed into these).
+     */
+    static const LatencyBound LATENCY_BOUNDS[] =
+    {
+      {1000ULL, "0.000001"}, {2500ULL, "0.0000025"}, {5000ULL, "0.000005"},
+      {10000ULL, "0.00001"}, {25000ULL, "0.000025"}, {50000ULL, "0.00005"},
+      {100000ULL, "0.0001"}, {250000ULL, "0.00025"}, {500000ULL, "0.0005"},
+      {1000000ULL, "0.001"}, {2500000ULL, "0.0025"}, {5000000ULL, "0.005"},
+      {10000000ULL, "0.01"}, {25000000ULL, "0.025"}, {50000000ULL, "0.05"},
+      {100000000ULL, "0.1"}, {250000000ULL, "0.25"}, {500000000ULL, "0.5"},
+      {1000000000ULL, "1"}, {2500000000ULL, "2.5"}, {5000000000ULL, "5"},
+      {10000000000ULL, "10"}
+    };
+
+    Metrics::Metrics()
+    {
+    }
+
+    Metrics::~Metrics()
+    {
+      for(size_t i = 0 ; i < m_shards.size() ; i++)
+      {
+        delete m_shards[i];
+      }
+    }
+
+    size_t Metrics::AddServer(const std::string& name, Handler& handler)
+    {
+      size_t server = 0;
+      bool found = false;
+
+      m_mutex.Lock();
+
+      /* servers with the same name (a ReactorGroup for example) share
+       * their metrics
+       */
+      for(server = 0 ; server < m_servers.size() ; server++)
+      {
+        if(m_servers[server] == name)
+        {
+          break;
+        }
+      }
+
+      if(server == m_servers.size())
+      {
+        m_servers.push_back(name);
+      }
+
+      for(size_t i = 0 ; i < m_handlers.size() ; i++)
+      {
+        found = found || m_handlers[i].handler == &handler;
+      }
+
+      if(!found)
+      {
+        HandlerEntry entry;
+
+        entry.handler = &handler;
+        entry.server = server;
+        m_handlers.push_back(entry);
+      }
+      m_mutex.Unlock();
+
+      handler.EnableStats(false);
+      return server;
+    }
+
+    void Metrics::AddMethod(Handler& handler)
+    {
+      Json::Value root;
+
+      root["description"] = "Get the metrics in Prometheus text format";
+      root["parameters"] = Json::Value::null;
+      root["returns"] = "String";
+
+      RpcMethod<Metrics>* method = new RpcMethod<Metrics>(*this,
+          &Metrics::SystemMetrics, std::string("system.metrics"), root);
+      method->SetExecutionHint(EXECUTE_INLINE);
+      handler.AddMethod(method);
+    }
+
+    void Metrics::Add(size_t server, enum Metric metric, int64_t value)
+    {
+      Shard* shard = static_cast<Shard*>(m_shard.Get());
+      size_t index = server * METRIC_COUNT + metric;
+
+      /* only the first update of a server by a thread takes the lock */
+      if(shard == NULL || index >= shard->values.size())
+      {
+        shard = AddShard();
+      }
+
+      /* gauges are decreased by adding the two's complement */
+      system_util::counterAdd(&shard->values[index], (uint64_t)value);
+    }
+
+    int64_t Metrics::Get(size_t server, enum Metric metric)
+    {
+      size_t index = server * METRIC_COUNT + metric;
+      uint64_t value = 0;
+
+      m_mutex.Lock();
+      for(size_t i = 0 ; i < m_shards.size() ; i++)
+      {
+        if(index < m_shards[i]->values.size())
+        {
+          value += system_util::counterRead(&m_shards[i]->values[index]);
+        }
+      }
+      m_mutex.Unlock();
+
+      return (int64_t)value;
+    }
+
+    Metrics::Shard* Metrics::AddShard()
+    {
+      Shard* shard = static_cast<Shard*>(m_shard.Get());
+
+      m_mutex.Lock();
+      if(shard == NULL)
+      {
+        shard = new Shard();
+        m_shards.push_back(shard);
+        m_shard.Set(shard);
+      }
+
+      /* Get() and Render() read the vector with the mutex locked */
+      shard->values.resize(m_servers.size() * METRIC_COUNT, 0);
+      m_mutex.Unlock();
+
+      return shard;
+    }
+
+    void Metrics::AppendLabel(std::string& out, const std::string& value)
+    {
+      out += '"';
+
+      for(size_t i = 0 ; i < value.length() ; i++)
+      {
+        switch(value[i])
+        {
+          case '\\':
+            out.append("\\\\");
+            break;
+          case '"':
+            out.append("\\\"");
+            break;
+          case '\n':
+            out.append("\\n");
+            break;
+          default:
+            out += value[i];
+            break;
+        }
+      }
+
+      out += '"';
+    }
+
+    void Metrics::RenderMethods(std::string& out, const std::string& server,
+        const std::vector<MethodStats>& stats, int metric)
+    {
+      char buf[64];
+
+      for(size_t i = 0 ; i < stats.size() ; i++)
+      {
+        const LatencyHistogram& latency = stats[i].latency;
+        std::string labels("{server=");
+        size_t bucket = 0;
+        uint64_t count = 0;
+
+        AppendLabel(labels, server);
+        labels.append(",method=");
+        AppendLabel(labels, stats[i].name);
+
+        if(metric < 2)
+        {
+          sprintf(buf, "} %llu\n", (unsigned long long)(
+                metric == 0 ? stats[i].calls : stats[i].errors));
+          out.append(metric == 0 ? "jsonrpc_method_calls_total" :
+              "jsonrpc_method_errors_total");
+          out.append(labels);
+          out.append(buf);
+          continue;
+        }
+
+        /* a histogram bucket is counted in the first bound above all its
+         * values
+         */
+        for(size_t j = 0 ; j < sizeof(LATENCY_BOUNDS) /
+            sizeof(LATENCY_BOUNDS[0]) ; j++)
+        {
+          for( ; bucket < LATENCY_BUCKETS &&
+              LatencyHistogram::GetUpperBound(bucket) <=
+              LATENCY_BOUNDS[j].ns ; bucket++)
+          {
+            count += latency.GetBucketCount(bucket);
+          }
+
+          sprintf(buf, "\"} %llu\n", (unsigned long long)count);
+          out.append("jsonrpc_method_duration_seconds_bucket");
+          out.append(labels);
+          out.append(",le=\"");
+          out.append(LATENCY_BOUNDS[j].le);
+          out.append(buf);
+        }
+
+        sprintf(buf, ",le=\"+Inf\"} %llu\n",
+            (unsigned long long)latency.GetCount());
+        out.append("jsonrpc_method_duration_seconds_bucket");
+        out.append(labels);
+        out.append(buf);
+
+        sprintf(buf, "} %.9f\n",
+            (double)latency.GetTotal() / 1000000000.0);
+        out.append("jsonrpc_method_duration_seconds_sum");
+        out.append(labels);
+        out.append(buf);
+
+        sprintf(buf, "} %llu\n",
+            (unsigned long long)latency.GetCount());
+        out.append("jsonrpc_method_duration_seconds_count");
+        out.append(labels);
+        out.append(buf);
+      }
+    }
+
+    void Metrics::Render(std::string& out)
+    {
+      static const char* methodMetrics[3][3] =
+      {
+        {"jsonrpc_method_calls_total", "counter", "Calls of the method."},
+        {"jsonrpc_method_errors_total", "counter",
+          "Calls which failed or answered an error."},
+        {"jsonrpc_method_duration_seconds", "histogram",
+          "Duration of the calls."}
+      };
+      std::vector<std::vector<MethodStats> > stats;
+      std::vector<HandlerEntry> handlers;
+      std::vector<std::string> servers;
+      char buf[64];
+
+      m_mutex.Lock();
+      for(size_t metric = 0 ; metric < METRIC_COUNT ; metric++)
+      {
+        const MetricInfo& info = METRIC_INFOS[metric];
+
+        out.append("# HELP ").append(info.name).append(" ");
+        out.append(info.help).append("\n");
+        out.append("# TYPE ").append(info.name).append(" ");
+        out.append(info.type).append("\n");
+
+        for(size_t server = 0 ; server < m_servers.size() ; server++)
+        {
+          size_t index = server * METRIC_COUNT + metric;
+          uint64_t value = 0;
+
+          for(size_t i = 0 ; i < m_shards.size() ; i++)
+          {
+            if(index < m_shards[i]->values.size())
+            {
+              value += system_util::counterRead(&m_shards[i]->values[index]);
+            }
+          }
+
+          out.append(info.name).append("{server=");
+          AppendLabel(out, m_servers[server]);
+          sprintf(buf, "} %lld\n", (long long)(int64_t)value);
+          out.append(buf);
+        }
+      }
+      handlers = m_handlers;
+      servers = m_servers;
+      m_mutex.Unlock();
+
+      /* the handlers have their own lock */
+      stats.resize(handlers.size());
+      for(size_t i = 0 ; i < handlers.size() ; i++)
+      {
+        handlers[i].handler->GetStats(stats[i]);
+      }
+
+      for(int metric = 0 ; metric < 3 ; metric++)
+      {
+        out.append("# HELP ").append(methodMetrics[metric][0]).append(" ");
+        out.append(methodMetrics[metric][2]).append("\n");
+        out.append("# TYPE ").append(methodMetrics[metric][0]).append(" ");
+        out.append(methodMetrics[metric][1]).append("\n");
+
+        for(size_t i = 0 ; i < handlers.size() ; i++)
+        {
+          RenderMethods(out, servers[handlers[i].server], stats[i], metric);
+        }
+      }
+    }
+
+    bool Metrics::SystemMetrics(const Json::Value& msg, Json::Value& response)
+    {
+      std::string text;
+
+      Render(text);
+
+      response["jsonrpc"] = "2.0";
+      response["id"] = msg["id"];
+      response["result"] = text;
+      return true;
+    }
+  } /* namespace Rpc */
+} /* namespace Json */
+
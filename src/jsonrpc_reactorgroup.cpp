@@ -0,0 +1,208 @@
+/*
+ *  JsonRpc-Cpp - JSON-RPC implementation.
+ *  Copyright (C) 2008-2011 Sebastien Vincent <sebastien.vincent@cppextrem.com>
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**
+ * \file jsonrpc_reactorgroup.cpp
+ * \brief JSON-RPC multi-reactor server.
+ * \author Sebastien Vincent
+ */
+
+#include <iostream>
+
+#include "jsonrpc_reactorgroup.h"
+#include "jsonrpc_tcpserver.h"
+#include "jsonrpc_udpserver.h"
+
+namespace Json
+{
+  namespace Rpc
+  {
+    /**
+     * \var REACTOR_WAIT_MS
+     * \brief Maximum time a reactor waits before checking if it has to stop.
+     */
+    static const uint32_t REACTOR_WAIT_MS = 100;
+
+    ReactorGroup::ReactorGroup(const std::string& address, uint16_t port,
+        enum networking::TransportProtocol protocol, size_t reactors,
+        enum EventBackend backend)
+    {
+      m_protocol = protocol;
+      m_stop = false;
+
+      for(size_t i = 0 ; i < reactors ; i++)
+      {
+        if(protocol == networking::TCP)
+        {
+          m_servers.push_back(new TcpServer(address, port, m_handler,
+                backend));
+        }
+        else
+        {
+          m_servers.push_back(new UdpServer(address, port, m_handler));
+        }
+      }
+    }
+
+    ReactorGroup::~ReactorGroup()
+    {
+      Stop();
+
+      for(size_t i = 0 ; i < m_servers.size() ; i++)
+      {
+        delete m_servers[i];
+      }
+    }
+
+    bool ReactorGroup::Start()
+    {
+      if(!m_threads.empty() || m_servers.empty())
+      {
+        return false;
+      }
+
+      /* Bind() would leak the sockets still open */
+      for(size_t i = 0 ; i < m_servers.size() ; i++)
+      {
+        if(m_servers[i]->GetSocket() != -1)
+        {
+          std::cerr << "Reactor " << i << " is still bound" << std::endl;
+          return false;
+        }
+      }
+
+      for(size_t i = 0 ; i < m_servers.size() ; i++)
+      {
+        Server* server = m_servers[i];
+
+        server->SetReusePort(true);
+
+        if(!server->Bind() || (m_protocol == networking::TCP &&
+              !static_cast<TcpServer*>(server)->Listen()))
+        {
+          std::cerr << "Cannot bind reactor " << i << std::endl;
+
+          for(size_t j = 0 ; j <= i ; j++)
+          {
+            if(m_servers[j]->GetSocket() != -1)
+            {
+              m_servers[j]->Close();
+            }
+          }
+          return false;
+        }
+      }
+
+      m_mutex.Lock();
+      m_stop = false;
+      m_mutex.Unlock();
+
+      for(size_t i = 0 ; i < m_servers.size() ; i++)
+      {
+        system_util::Thread* th = new system_util::Thread(
+            new system_util::ThreadArgImpl<ReactorGroup>(*this,
+              &ReactorGroup::Run, m_servers[i]));
+
+        if(!th->Start(false))
+        {
+          delete th;
+          Stop();
+          return false;
+        }
+
+        m_threads.push_back(th);
+      }
+
+      return true;
+    }
+
+    void ReactorGroup::Stop()
+    {
+      m_mutex.Lock();
+      m_stop = true;
+      m_mutex.Unlock();
+
+      for(size_t i = 0 ; i < m_threads.size() ; i++)
+      {
+        m_threads[i]->Join();
+        delete m_threads[i];
+      }
+      m_threads.clear();
+
+      for(size_t i = 0 ; i < m_servers.size() ; i++)
+      {
+        if(m_servers[i]->GetSocket() != -1)
+        {
+          m_servers[i]->Close();
+        }
+      }
+    }
+
+    void ReactorGroup::SetEncapsulatedFormat(enum EncapsulatedFormat format)
+    {
+      for(size_t i = 0 ; i < m_servers.size() ; i++)
+      {
+        m_servers[i]->SetEncapsulatedFormat(format);
+      }
+    }
+
+    void ReactorGroup::AddMethod(CallbackMethod* method)
+    {
+      m_handler.AddMethod(method);
+    }
+
+    void ReactorGroup::DeleteMethod(const std::string& method)
+    {
+      m_handler.DeleteMethod(method);
+    }
+
+    size_t ReactorGroup::GetReactorCount() const
+    {
+      return m_servers.size();
+    }
+
+    Server* ReactorGroup::GetServer(size_t index) const
+    {
+      return index < m_servers.size() ? m_servers[index] : NULL;
+    }
+
+    void* ReactorGroup::Run(void* arg)
+    {
+      Server* server = static_cast<Server*>(arg);
+
+      while(!IsStopped())
+      {
+        server->WaitMessage(REACTOR_WAIT_MS);
+      }
+
+      return NULL;
+    }
+
+    bool ReactorGroup::IsStopped()
+    {
+      bool ret = false;
+
+      m_mutex.Lock();
+      ret = m_stop;
+      m_mutex.Unlock();
+
+      return ret;
+    }
+  } /* namespace Rpc */
+} /* namespace Json */
+
@@ -29,10 +29,29 @@ namespace Json
   namespace Rpc
   {
     Server::Server(const std::string& address, uint16_t port)
+      : m_jsonHandler(*new Handler())
     {
+      m_handler = &m_jsonHandler;
       m_sock = -1;
+      m_metrics = NULL;
+      m_metricsServer = 0;
       m_address = address;
       m_port = port;
+      m_reusePort = false;
+      SetEncapsulatedFormat(Json::Rpc::RAW);
+    }
+
+    Server::Server(const std::string& address, uint16_t port,
+        Handler& handler) : m_jsonHandler(handler)
+    {
+      /* the shared handler is used by all the servers, none is built */
+      m_handler = NULL;
+      m_sock = -1;
+      m_metrics = NULL;
+      m_metricsServer = 0;
+      m_address = address;
+      m_port = port;
+      m_reusePort = false;
       SetEncapsulatedFormat(Json::Rpc::RAW);
     }
 
@@ -42,6 +61,8 @@ namespace Json
       {
         Close();
       }
+
+      delete m_handler;
     }
 
     void Server::SetEncapsulatedFormat(enum EncapsulatedFormat format)
@@ -71,10 +92,21 @@ namespace Json
 
     bool Server::Bind()
     {
-      m_sock = networking::bind(m_protocol, m_address, m_port, NULL, NULL);
+      m_sock = networking::bind(m_protocol, m_address, m_port, NULL, NULL,
+          m_reusePort);
 
       return (m_sock != -1) ? true : false;
     }
+
+    void Server::SetReusePort(bool reuse)
+    {
+      m_reusePort = reuse;
+    }
+
+    bool Server::GetReusePort() const
+    {
+      return m_reusePort;
+    }
     
     void Server::Close()
     {
@@ -91,6 +123,26 @@ namespace Json
     {
       m_jsonHandler.DeleteMethod(method);
     }
+
+    void Server::SetMetrics(Metrics& metrics, const std::string& name,
+        bool method)
+    {
+      m_metrics = &metrics;
+      m_metricsServer = metrics.AddServer(name, m_jsonHandler);
+
+      if(method)
+      {
+        metrics.AddMethod(m_jsonHandler);
+      }
+    }
+
+    void Server::Count(enum Metric metric, int64_t value)
+    {
+      if(m_metrics)
+      {
+        m_metrics->Add(m_metricsServer, metric, value);
+      }
+    }
   } /* namespace Rpc */
 } /* namespace Json */
 
@@ -0,0 +1,226 @@
+/*
+ *  JsonRpc-Cpp - JSON-RPC implementation.
+ *  Copyright (C) 2008-2011 Sebastien Vincent <sebastien.vincent@cppextrem.com>
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**
+ * \file jsonrpc_shmclient.cpp
+ * \brief JSON-RPC shared-memory client.
+ * \author Sebastien Vincent
+ */
+
+#include <iostream>
+
+#include <cerrno>
+
+#include <poll.h>
+
+#include "jsonrpc_shmclient.h"
+#include "netstring.h"
+
+namespace Json
+{
+  namespace Rpc
+  {
+    ShmClient::ShmClient(const std::string& path, size_t ringSize)
+      : Client(path, 0)
+    {
+      m_protocol = networking::UNIX_STREAM;
+      m_ringSize = ringSize;
+    }
+
+    ShmClient::~ShmClient()
+    {
+      m_channel.Close();
+    }
+
+    bool ShmClient::Connect()
+    {
+      if(!Client::Connect())
+      {
+        return false;
+      }
+
+      if(!m_channel.Create(m_ringSize) || !m_channel.Send(m_sock))
+      {
+        std::cerr << "Cannot share segment with server" << std::endl;
+        Close();
+        return false;
+      }
+
+      return true;
+    }
+
+    ssize_t ShmClient::Send(const std::string& data)
+    {
+      char header[netstring::MAX_HEADER_SIZE];
+      const char* parts[3];
+      size_t sizes[3];
+      size_t count = 0;
+      size_t len = 0;
+
+      if(!m_channel.IsOpen())
+      {
+        return -1;
+      }
+
+      if(GetEncapsulatedFormat() == Json::Rpc::NETSTRING)
+      {
+        parts[count] = header;
+        sizes[count++] = netstring::encodeHeader(data.length(), header);
+      }
+
+      parts[count] = data.data();
+      sizes[count++] = data.length();
+
+      if(GetEncapsulatedFormat() == Json::Rpc::NETSTRING)
+      {
+        parts[count] = &netstring::TRAILER;
+        sizes[count++] = 1;
+      }
+
+      for(size_t i = 0 ; i < count ; i++)
+      {
+        size_t offset = 0;
+
+        /* a message bigger than the ring is written as the server reads */
+        while(offset < sizes[i])
+        {
+          size_t nb = m_channel.Write(parts[i] + offset, sizes[i] - offset);
+
+          if(nb == 0 && !Wait(true))
+          {
+            return -1;
+          }
+
+          offset += nb;
+        }
+
+        len += sizes[i];
+      }
+
+      return len;
+    }
+
+    ssize_t ShmClient::Recv(std::string& data)
+    {
+      const char* msg = NULL;
+      size_t size = 0;
+      int ret = 0;
+
+      if(!m_channel.IsOpen())
+      {
+        return -1;
+      }
+
+      if(m_framer.GetEncapsulatedFormat() != GetEncapsulatedFormat())
+      {
+        m_framer.SetEncapsulatedFormat(GetEncapsulatedFormat());
+      }
+
+      /* a previous read may already contain the message */
+      while((ret = m_framer.Next(msg, size)) == 0)
+      {
+        size_t nb = m_channel.GetReadable();
+
+        if(nb == 0)
+        {
+          if(!Wait(false))
+          {
+            return 0;
+          }
+
+          nb = m_channel.GetReadable();
+        }
+
+        m_framer.Commit(m_channel.Read(m_framer.Prepare(nb), nb));
+      }
+
+      if(ret == -1)
+      {
+        /* error parsing Netstring or message too big */
+        std::cerr << "Invalid message received" << std::endl;
+        m_framer.Reset();
+        return -1;
+      }
+
+      data.assign(msg, size);
+      return size;
+    }
+
+    void ShmClient::Close()
+    {
+      m_channel.Close();
+      Client::Close();
+      m_framer.Reset();
+    }
+
+    std::string ShmClient::GetPath() const
+    {
+      return GetAddress();
+    }
+
+    bool ShmClient::Wait(bool room)
+    {
+      struct pollfd pfds[2];
+      unsigned int spinCount = shm::getSpinCount();
+
+      for(unsigned int i = 0 ; i < spinCount ; i++)
+      {
+        if(room ? m_channel.GetWritable() > 0 : m_channel.GetReadable() > 0)
+        {
+          return true;
+        }
+      }
+
+      pfds[0].fd = m_channel.GetEvent();
+      pfds[0].events = POLLIN;
+      pfds[1].fd = m_sock;
+      pfds[1].events = POLLIN;
+
+      for(;;)
+      {
+        /* the server may have written or read before it saw the flag */
+        m_channel.SetSleeping(true);
+
+        if(room ? m_channel.GetWritable() > 0 : m_channel.GetReadable() > 0)
+        {
+          m_channel.SetSleeping(false);
+          return true;
+        }
+
+        pfds[0].revents = 0;
+        pfds[1].revents = 0;
+
+        if(poll(pfds, 2, -1) == -1 && errno != EINTR)
+        {
+          m_channel.SetSleeping(false);
+          return false;
+        }
+
+        m_channel.SetSleeping(false);
+        m_channel.ClearEvent();
+
+        /* the socket is only readable when the server closes it */
+        if(pfds[1].revents && !(room ? m_channel.GetWritable() > 0 :
+              m_channel.GetReadable() > 0))
+        {
+          return false;
+        }
+      }
+    }
+  } /* namespace Rpc */
+} /* namespace Json */
@@ -0,0 +1,405 @@
+/*
+ *  JsonRpc-Cpp - JSON-RPC implementation.
+ *  Copyright (C) 2008-2011 Sebastien Vincent <sebastien.vincent@cppextrem.com>
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**
+ * \file jsonrpc_shmserver.cpp
+ * \brief JSON-RPC shared-memory server.
+ * \author Sebastien Vincent
+ */
+
+#include <iostream>
+
+#include <cerrno>
+
+#include "jsonrpc_shmserver.h"
+#include "netstring.h"
+
+namespace Json
+{
+  namespace Rpc
+  {
+    /**
+     * \var HANDSHAKE_TIMEOUT_MS
+     * \brief Time given to a new client to pass its shared segment.
+     */
+    static const int HANDSHAKE_TIMEOUT_MS = 1000;
+
+    ShmServer::ShmServer(const std::string& path) : Server(path, 0)
+    {
+      m_protocol = networking::UNIX_STREAM;
+    }
+
+    ShmServer::ShmServer(const std::string& path, Handler& handler)
+      : Server(path, 0, handler)
+    {
+      m_protocol = networking::UNIX_STREAM;
+    }
+
+    ShmServer::~ShmServer()
+    {
+      std::string path = GetPath();
+
+      if(m_sock != -1)
+      {
+        Close();
+
+        /* an abstract name goes with the socket */
+        if(!path.empty() && path[0] != '@')
+        {
+          unlink(path.c_str());
+        }
+      }
+    }
+
+    bool ShmServer::Listen() const
+    {
+      if(m_sock == -1 || GetEncapsulatedFormat() == HTTP_POST)
+      {
+        return false;
+      }
+
+      return listen(m_sock, 5) != -1;
+    }
+
+    bool ShmServer::Accept()
+    {
+      Connection* conn = NULL;
+      struct pollfd pfd;
+      int client = -1;
+
+      if(m_sock == -1)
+      {
+        return false;
+      }
+
+      client = accept(m_sock, NULL, NULL);
+
+      if(client == -1)
+      {
+        return false;
+      }
+
+      /* the client sends its segment right after connecting */
+      pfd.fd = client;
+      pfd.events = POLLIN;
+      pfd.revents = 0;
+      conn = new Connection();
+
+      if(poll(&pfd, 1, HANDSHAKE_TIMEOUT_MS) != 1 ||
+          !conn->channel.Receive(client))
+      {
+        std::cerr << "No shared segment received from client" << std::endl;
+        delete conn;
+        ::close(client);
+        return false;
+      }
+
+      conn->framer.SetEncapsulatedFormat(GetEncapsulatedFormat());
+      conn->outputOffset = 0;
+      m_connections[client] = conn;
+      Count(METRIC_ACCEPTED, 1);
+
+      /* requests written before the server slept have not woken it up */
+      Recv(client);
+      return true;
+    }
+
+    void ShmServer::WaitMessage(uint32_t ms)
+    {
+      struct pollfd pfd;
+
+      pfd.events = POLLIN;
+      pfd.revents = 0;
+      m_pollfds.clear();
+
+      pfd.fd = m_sock;
+      m_pollfds.push_back(pfd);
+
+      for(std::map<int, Connection*>::iterator it = m_connections.begin() ;
+          it != m_connections.end() ; it++)
+      {
+        pfd.fd = it->first;
+        m_pollfds.push_back(pfd);
+        pfd.fd = it->second->channel.GetEvent();
+        m_pollfds.push_back(pfd);
+      }
+
+      if(poll(&m_pollfds[0], m_pollfds.size(), ms) > 0)
+      {
+        for(size_t i = 1 ; i < m_pollfds.size() ; i += 2)
+        {
+          if(m_pollfds[i].revents)
+          {
+            char c = 0;
+
+            /* nothing is sent on the socket after the handshake, it can
+             * only be closed
+             */
+            if(recv(m_pollfds[i].fd, &c, 1, MSG_DONTWAIT) != -1 ||
+                (errno != EAGAIN && errno != EWOULDBLOCK))
+            {
+              m_purge.push_back(m_pollfds[i].fd);
+              continue;
+            }
+          }
+
+          if(m_pollfds[i + 1].revents & POLLIN)
+          {
+            Recv(m_pollfds[i].fd);
+          }
+        }
+
+        if(m_pollfds[0].revents & POLLIN)
+        {
+          Accept();
+        }
+      }
+
+      for(std::list<int>::iterator it = m_purge.begin() ;
+          it != m_purge.end() ; it++)
+      {
+        RemoveClient((*it));
+      }
+
+      m_purge.clear();
+    }
+
+    bool ShmServer::Recv(int fd)
+    {
+      std::map<int, Connection*>::iterator it = m_connections.find(fd);
+      Connection* conn = NULL;
+      unsigned int spinCount = shm::getSpinCount();
+      bool idle = false;
+
+      if(it == m_connections.end())
+      {
+        return false;
+      }
+
+      conn = it->second;
+      conn->channel.ClearEvent();
+
+      while(!idle)
+      {
+        unsigned int spin = 0;
+
+        conn->channel.SetSleeping(false);
+
+        /* requests stay in the ring while responses wait for room */
+        while(Flush(conn))
+        {
+          size_t size = conn->channel.GetReadable();
+
+          if(size == 0)
+          {
+            if(++spin > spinCount)
+            {
+              break;
+            }
+            continue;
+          }
+
+          spin = 0;
+          conn->framer.Commit(conn->channel.Read(
+                conn->framer.Prepare(size), size));
+          Count(METRIC_RECEIVED_BYTES, size);
+
+          if(!ProcessMessages(conn))
+          {
+            m_purge.push_back(fd);
+            return false;
+          }
+        }
+
+        /* the client may have written or read before it saw the flag */
+        conn->channel.SetSleeping(true);
+
+        if(conn->output.length() == conn->outputOffset)
+        {
+          idle = conn->channel.GetReadable() == 0;
+        }
+        else
+        {
+          idle = conn->channel.GetWritable() == 0;
+        }
+      }
+
+      return true;
+    }
+
+    bool ShmServer::ProcessMessages(Connection* conn)
+    {
+      const char* msg = NULL;
+      size_t msgSize = 0;
+      int ret = 0;
+
+      while((ret = conn->framer.Next(msg, msgSize)) == 1)
+      {
+        Json::Value root;
+        Json::Value response;
+
+        Count(METRIC_MESSAGES, 1);
+
+        if(m_jsonHandler.Parse(m_reader, msg, msgSize, root, m_serialized))
+        {
+          m_jsonHandler.Process(root, response, m_serialized);
+        }
+        else
+        {
+          Count(METRIC_PARSE_ERRORS, 1);
+        }
+
+        if(!m_serialized.empty())
+        {
+          /* protocol error or cached response */
+          SendResponse(conn, m_serialized);
+        }
+        /* in case of notification message received, the response could be Json::Value::null */
+        else if(response != Json::Value::null)
+        {
+          SendResponse(conn, m_writer.write(response));
+        }
+      }
+
+      if(ret == -1)
+      {
+        /* error parsing Netstring or message too big */
+        std::cerr << "Invalid message stream, close connection" << std::endl;
+        Count(METRIC_FRAMING_ERRORS, 1);
+        return false;
+      }
+
+      return true;
+    }
+
+    void ShmServer::SendResponse(Connection* conn, const std::string& data)
+    {
+      char header[netstring::MAX_HEADER_SIZE];
+      const char* parts[3];
+      size_t sizes[3];
+      size_t count = 0;
+
+      if(GetEncapsulatedFormat() == Json::Rpc::NETSTRING)
+      {
+        parts[count] = header;
+        sizes[count++] = netstring::encodeHeader(data.length(), header);
+      }
+
+      parts[count] = data.data();
+      sizes[count++] = data.length();
+
+      if(GetEncapsulatedFormat() == Json::Rpc::NETSTRING)
+      {
+        parts[count] = &netstring::TRAILER;
+        sizes[count++] = 1;
+      }
+
+      for(size_t i = 0 ; i < count ; i++)
+      {
+        size_t nb = 0;
+
+        /* written in order: nothing is written while some is queued */
+        if(conn->output.length() == conn->outputOffset)
+        {
+          nb = conn->channel.Write(parts[i], sizes[i]);
+          Count(METRIC_SENT_BYTES, nb);
+        }
+
+        conn->output.append(parts[i] + nb, sizes[i] - nb);
+        Count(METRIC_OUTPUT_QUEUE, sizes[i] - nb);
+      }
+    }
+
+    bool ShmServer::Flush(Connection* conn)
+    {
+      size_t size = conn->output.length() - conn->outputOffset;
+
+      if(size > 0)
+      {
+        size_t nb = conn->channel.Write(conn->output.data() +
+            conn->outputOffset, size);
+
+        conn->outputOffset += nb;
+        Count(METRIC_SENT_BYTES, nb);
+        Count(METRIC_OUTPUT_QUEUE, -(int64_t)nb);
+
+        if(conn->output.length() != conn->outputOffset)
+        {
+          return false;
+        }
+
+        conn->output.clear();
+        conn->outputOffset = 0;
+      }
+
+      return true;
+    }
+
+    void ShmServer::RemoveClient(int fd)
+    {
+      std::map<int, Connection*>::iterator it = m_connections.find(fd);
+
+      if(it == m_connections.end())
+      {
+        return;
+      }
+
+      Count(METRIC_CLOSED, 1);
+      Count(METRIC_OUTPUT_QUEUE, -(int64_t)(it->second->output.length() -
+            it->second->outputOffset));
+      delete it->second;
+      m_connections.erase(it);
+      ::close(fd);
+    }
+
+    void ShmServer::Close()
+    {
+      for(std::map<int, Connection*>::iterator it = m_connections.begin() ;
+          it != m_connections.end() ; it++)
+      {
+        Count(METRIC_CLOSED, 1);
+        Count(METRIC_OUTPUT_QUEUE, -(int64_t)(it->second->output.length() -
+              it->second->outputOffset));
+        delete it->second;
+        ::close(it->first);
+      }
+
+      m_connections.clear();
+      m_purge.clear();
+      Server::Close();
+    }
+
+    const std::list<int> ShmServer::GetClients() const
+    {
+      std::list<int> clients;
+
+      for(std::map<int, Connection*>::const_iterator it =
+          m_connections.begin() ; it != m_connections.end() ; it++)
+      {
+        clients.push_back(it->first);
+      }
+
+      return clients;
+    }
+
+    std::string ShmServer::GetPath() const
+    {
+      return GetAddress();
+    }
+  } /* namespace Rpc */
+} /* namespace Json */
@@ -0,0 +1,156 @@
+/*
+ *  JsonRpc-Cpp - JSON-RPC implementation.
+ *  Copyright (C) 2008-2011 Sebastien Vincent <sebastien.vincent@cppextrem.com>
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+/**
+ * \file jsonrpc_stats.cpp
+ * \brief JSON-RPC method statistics.
+ * \author Sebastien Vincent
+ */
+
+#include <cstring>
+
+#include "jsonrpc_stats.h"
+
+namespace Json
+{
+  namespace Rpc
+  {
+    LatencyHistogram::LatencyHistogram()
+    {
+      memset(m_buckets, 0x00, sizeof(m_buckets));
+      m_count = 0;
+      m_total = 0;
+    }
+
+    size_t LatencyHistogram::GetBucket(uint64_t ns)
+    {
+      size_t exponent = 0;
+
+      if(ns < LATENCY_SUB_BUCKETS)
+      {
+        return (size_t)ns;
+      }
+
+      /* position of the highest bit set */
+#if defined(__GNUC__)
+      exponent = 63 - __builtin_clzll(ns);
+#else
+      for(uint64_t v = ns ; v > 1 ; v >>= 1)
+      {
+        exponent++;
+      }
+#endif
+
+      if(exponent >= LATENCY_MAX_EXPONENT)
+      {
+        return LATENCY_BUCKETS - 1;
+      }
+
+      /* the three bits after the highest one select the sub-bucket */
+      return (exponent - 2) * LATENCY_SUB_BUCKETS +
+        (size_t)((ns >> (exponent - 3)) & (LATENCY_SUB_BUCKETS - 1));
+    }
+
+    uint64_t LatencyHistogram::GetUpperBound(size_t bucket)
+    {
+      size_t exponent = bucket / LATENCY_SUB_BUCKETS + 2;
+      uint64_t sub = bucket % LATENCY_SUB_BUCKETS;
+
+      if(bucket < LATENCY_SUB_BUCKETS)
+      {
+        return bucket;
+      }
+
+      return ((LATENCY_SUB_BUCKETS + sub + 1) << (exponent - 3)) - 1;
+    }
+
+    void LatencyHistogram::Add(uint64_t ns)
+    {
+      m_buckets[GetBucket(ns)]++;
+      m_count++;
+      m_total += ns;
+    }
+
+    void LatencyHistogram::Add(size_t bucket, uint64_t count)
+    {
+      m_buckets[bucket] += count;
+      m_count += count;
+    }
+
+    void LatencyHistogram::AddTotal(uint64_t ns)
+    {
+      m_total += ns;
+    }
+
+    void LatencyHistogram::Merge(const LatencyHistogram& histogram)
+    {
+      for(size_t i = 0 ; i < LATENCY_BUCKETS ; i++)
+      {
+        m_buckets[i] += histogram.m_buckets[i];
+      }
+
+      m_count += histogram.m_count;
+      m_total += histogram.m_total;
+    }
+
+    uint64_t LatencyHistogram::GetBucketCount(size_t bucket) const
+    {
+      return m_buckets[bucket];
+    }
+
+    uint64_t LatencyHistogram::GetCount() const
+    {
+      return m_count;
+    }
+
+    uint64_t LatencyHistogram::GetTotal() const
+    {
+      return m_total;
+    }
+
+    uint64_t LatencyHistogram::GetPercentile(double percent) const
+    {
+      uint64_t rank = (uint64_t)((double)m_count * percent / 100.0 + 0.5);
+      uint64_t seen = 0;
+
+      if(m_count == 0)
+      {
+        return 0;
+      }
+
+      if(rank == 0)
+      {
+        rank = 1;
+      }
+
+      for(size_t i = 0 ; i < LATENCY_BUCKETS ; i++)
+      {
+        seen += m_buckets[i];
+
+        if(seen >= rank)
+        {
+          return GetUpperBound(i);
+        }
+      }
+
+      return GetUpperBound(LATENCY_BUCKETS - 1);
+    }
+  } /* namespace Rpc */
+} /* namespace Json */
+
@@ -25,11 +25,71 @@
 #include "jsonrpc_tcpclient.h"
 
 #include "netstring.h"
+#include "http.h"
 
 namespace Json
 {
   namespace Rpc
   {
+    /**
+     * \var RECV_SIZE
+     * \brief Number of bytes read at once.
+     */
+    static const size_t RECV_SIZE = 1500;
+
+    /**
+     * \brief Send several buffers in records of at most
+     * networking::MAX_RECORD_SIZE bytes (UNIX_SEQPACKET).
+     * \param sock socket descriptor
+     * \param parts buffers to send in order
+     * \param sizes size of each buffer
+     * \param count number of buffers (at most networking::MAX_SEND_PARTS)
+     * \return true if all the bytes have been sent, false otherwise
+     */
+    static bool sendRecords(int sock, const char* const* parts,
+        const size_t* sizes, size_t count)
+    {
+      const char* chunkParts[networking::MAX_SEND_PARTS];
+      size_t chunkSizes[networking::MAX_SEND_PARTS];
+      size_t part = 0;
+      size_t offset = 0;
+
+      while(part < count)
+      {
+        size_t room = networking::MAX_RECORD_SIZE;
+        size_t nb = 0;
+
+        /* fill a record with what is left of the buffers */
+        while(part < count && room > 0)
+        {
+          size_t size = sizes[part] - offset;
+
+          if(size > room)
+          {
+            size = room;
+          }
+
+          chunkParts[nb] = parts[part] + offset;
+          chunkSizes[nb++] = size;
+          room -= size;
+          offset += size;
+
+          if(offset == sizes[part])
+          {
+            part++;
+            offset = 0;
+          }
+        }
+
+        if(!networking::sendv(sock, chunkParts, chunkSizes, nb))
+        {
+          return false;
+        }
+      }
+
+      return true;
+    }
+
     TcpClient::TcpClient(const std::string& address, uint16_t port) : Client(address, port)
     {
       m_protocol = networking::TCP;
@@ -41,44 +101,131 @@ namespace Json
 
     ssize_t TcpClient::Send(const std::string& data)
     {
-      std::string rep = data;
+      char header[netstring::MAX_HEADER_SIZE];
+      std::string request;
+      const char* parts[3];
+      size_t sizes[3];
+      size_t count = 0;
+      size_t len = 0;
+
+      /* encoding if any, header and trailer are sent around the payload
+       * so that it is not copied
+       */
+      if(GetEncapsulatedFormat() == Json::Rpc::NETSTRING)
+      {
+        parts[count] = header;
+        sizes[count++] = netstring::encodeHeader(data.length(), header);
+      }
+      else if(GetEncapsulatedFormat() == Json::Rpc::HTTP_POST)
+      {
+        request = http::encodeRequestHeader(GetAddress(), data.length());
+        parts[count] = request.data();
+        sizes[count++] = request.length();
+      }
+
+      parts[count] = data.data();
+      sizes[count++] = data.length();
 
-      /* encoding if any */
       if(GetEncapsulatedFormat() == Json::Rpc::NETSTRING)
       {
-        rep = netstring::encode(rep);
+        parts[count] = &netstring::TRAILER;
+        sizes[count++] = 1;
       }
 
-      return ::send(m_sock, rep.c_str(), rep.length(), 0);
+      /* a record has to fit in the socket buffer, the server reassembles
+       * them like a stream
+       */
+      if(m_protocol == networking::UNIX_SEQPACKET)
+      {
+        if(!sendRecords(m_sock, parts, sizes, count))
+        {
+          return -1;
+        }
+      }
+      else if(!networking::sendv(m_sock, parts, sizes, count))
+      {
+        return -1;
+      }
+
+      for(size_t i = 0 ; i < count ; i++)
+      {
+        len += sizes[i];
+      }
+
+      return len;
     }
 
     ssize_t TcpClient::Recv(std::string& data)
     {
-      char buf[1500];
-      ssize_t nb = -1;
+      const char* msg = NULL;
+      size_t size = 0;
+      int ret = 0;
 
-      if((nb = ::recv(m_sock, buf, sizeof(buf), 0)) == -1)
+      if(m_framer.GetEncapsulatedFormat() != GetEncapsulatedFormat())
       {
-        std::cerr << "Error while receiving" << std::endl;
-        return -1;
+        m_framer.SetEncapsulatedFormat(GetEncapsulatedFormat());
       }
 
-      data = std::string(buf, nb);
-
-      /* decoding if any */
-      if(GetEncapsulatedFormat() == Json::Rpc::NETSTRING)
+      /* a previous segment may already contain the message, HTTP
+       * responses to notifications have no body and are skipped
+       */
+      while((ret = m_framer.Next(msg, size)) == 0 ||
+          (ret == 1 && size == 0 && GetEncapsulatedFormat() == HTTP_POST))
       {
-        try
+        size_t recvSize = RECV_SIZE;
+        ssize_t nb = 0;
+
+        if(ret == 1)
         {
-          data = netstring::decode(data);
+          continue;
         }
-        catch(const netstring::NetstringException& e)
+
+#ifdef MSG_TRUNC
+        if(m_protocol == networking::UNIX_SEQPACKET)
         {
-          std::cerr << e.what() << std::endl;
+          /* a record is read at once, what does not fit is lost, wait for
+           * the next one to know its size
+           */
+          nb = ::recv(m_sock, NULL, 0, MSG_PEEK | MSG_TRUNC);
+
+          if(nb > 0 && (size_t)nb > recvSize)
+          {
+            recvSize = nb;
+          }
         }
+#endif
+
+        nb = ::recv(m_sock, m_framer.Prepare(recvSize), recvSize, 0);
+
+        if(nb == -1)
+        {
+          std::cerr << "Error while receiving" << std::endl;
+          return -1;
+        }
+        else if(nb == 0)
+        {
+          return 0;
+        }
+
+        m_framer.Commit(nb);
       }
 
-      return nb;
+      if(ret == -1)
+      {
+        /* error parsing Netstring or message too big */
+        std::cerr << "Invalid message received" << std::endl;
+        m_framer.Reset();
+        return -1;
+      }
+
+      data.assign(msg, size);
+      return size;
+    }
+
+    void TcpClient::Close()
+    {
+      Client::Close();
+      m_framer.Reset();
     }
   } /* namespace Rpc */
 } /* namespace Json */
@@ -28,168 +28,1281 @@
 #include <cstring>
 #include <cerrno>
 
+#include <fcntl.h>
+
 #include "jsonrpc_tcpserver.h"
 #include "netstring.h"
+#include "http.h"
+
+#ifdef _WIN32
+/* poll is not defined on Windows but there is WSAPoll */
+#define poll WSAPoll
+#else
+#include <poll.h>
+#include <netinet/tcp.h>
+#endif
+
+#ifdef __linux__
+#include <sys/epoll.h>
+#endif
+
+namespace Json 
+{
+  namespace Rpc
+  {
+    /**
+     * \var MIN_RECV_SIZE
+     * \brief Minimum size of a read on a client socket.
+     */
+    static const size_t MIN_RECV_SIZE = 4096;
+
+    /**
+     * \var FIRST_CLIENT_POLLFD
+     * \brief Position of the first client in TcpServer::m_pollfds.
+     */
+    static const size_t FIRST_CLIENT_POLLFD = 2;
+
+    /**
+     * \var DEFAULT_LOW_WATERMARK
+     * \brief Default output queue size under which reading resumes.
+     */
+    static const size_t DEFAULT_LOW_WATERMARK = 256 * 1024;
+
+    /**
+     * \var DEFAULT_HIGH_WATERMARK
+     * \brief Default output queue size at which reading stops.
+     */
+    static const size_t DEFAULT_HIGH_WATERMARK = 1024 * 1024;
+
+    /**
+     * \var MAX_IDLE_OUTPUT_SIZE
+     * \brief Output queue bigger than this is released once it is sent.
+     */
+    static const size_t MAX_IDLE_OUTPUT_SIZE = 64 * 1024;
+
+    /**
+     * \var URING_ENTRIES
+     * \brief Size of the io_uring submission queue.
+     */
+    static const unsigned int URING_ENTRIES = 256;
+
+    /**
+     * \var URING_BUFFERS
+     * \brief Number of io_uring provided receive buffers (of MIN_RECV_SIZE
+     * bytes), shared by all the connections.
+     */
+    static const unsigned int URING_BUFFERS = 256;
+
+    /**
+     * \var URING_CLOSE_WAITS
+     * \brief Number of 100 ms waits in Close() for the io_uring requests of
+     * the closed connections.
+     */
+    static const int URING_CLOSE_WAITS = 10;
+
+    /**
+     * \enum UringRequest
+     * \brief Kind of an io_uring request, in the low bits of its data (the
+     * other bits are the Connection pointer, if any).
+     */
+    enum UringRequest
+    {
+      URING_ACCEPT, /**< Multishot accept on the listen socket. */
+      URING_WAKEUP, /**< Multishot poll of the worker wake up pipe. */
+      URING_RECV, /**< Multishot receive on a client socket. */
+      URING_SEND, /**< Send on a client socket. */
+      URING_CANCEL, /**< Cancellation of a receive. */
+      URING_STOP, /**< Cancellation of the accept. */
+      URING_REQUEST_MASK = 7 /**< Mask of the kind. */
+    };
+
+    /**
+     * \brief Make a descriptor non-blocking.
+     * \param fd socket or pipe descriptor
+     */
+    static void setNonBlocking(int fd)
+    {
+#ifdef _WIN32
+      u_long nonBlocking = 1;
+
+      ioctlsocket(fd, FIONBIO, &nonBlocking);
+#else
+      fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+#endif
+    }
+
+    /**
+     * \brief Open the non-blocking wake up channel of the worker pool.
+     * \param fds read end then write end
+     * \return true if success, false otherwise (fds are -1)
+     */
+    static bool openWakeup(int fds[2])
+    {
+#ifdef _WIN32
+      /* there is no pipe to poll on Windows, a loopback UDP socket
+       * connected to another one is used instead
+       */
+      struct sockaddr_in addr;
+      socklen_t addrLen = sizeof(addr);
+
+      memset(&addr, 0x00, sizeof(addr));
+      addr.sin_family = AF_INET;
+      addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+      addr.sin_port = 0;
+
+      fds[0] = socket(AF_INET, SOCK_DGRAM, 0);
+      fds[1] = socket(AF_INET, SOCK_DGRAM, 0);
+
+      if(fds[0] == -1 || fds[1] == -1 ||
+          bind(fds[0], (struct sockaddr*)&addr, addrLen) == -1 ||
+          getsockname(fds[0], (struct sockaddr*)&addr, &addrLen) == -1 ||
+          connect(fds[1], (struct sockaddr*)&addr, addrLen) == -1)
+      {
+        for(int i = 0 ; i < 2 ; i++)
+        {
+          if(fds[i] != -1)
+          {
+            ::close(fds[i]);
+          }
+          fds[i] = -1;
+        }
+        return false;
+      }
+#else
+      if(pipe(fds) == -1)
+      {
+        fds[0] = -1;
+        fds[1] = -1;
+        return false;
+      }
+#endif
+
+      setNonBlocking(fds[0]);
+      setNonBlocking(fds[1]);
+      return true;
+    }
+
+    /**
+     * \brief Wake up the thread polling the read end of the wake up
+     * channel.
+     * \param fd write end
+     */
+    static void signalWakeup(int fd)
+    {
+      char c = 0;
+
+#ifdef _WIN32
+      if(send(fd, &c, 1, 0) == -1)
+#else
+      if(write(fd, &c, 1) == -1)
+#endif
+      {
+        /* channel is full, the reader will wake up anyway */
+      }
+    }
+
+    /**
+     * \brief Empty the wake up channel.
+     * \param fd read end
+     */
+    static void drainWakeup(int fd)
+    {
+      char buf[64];
+
+#ifdef _WIN32
+      while(recv(fd, buf, sizeof(buf), 0) > 0)
+#else
+      while(read(fd, buf, sizeof(buf)) > 0)
+#endif
+      {
+      }
+    }
+
+    TcpServer::TcpServer(const std::string& address, uint16_t port,
+        enum EventBackend backend) : Server(address, port)
+    {
+      Init(backend);
+    }
+
+    TcpServer::TcpServer(const std::string& address, uint16_t port,
+        Handler& handler, enum EventBackend backend)
+      : Server(address, port, handler)
+    {
+      Init(backend);
+    }
+
+    void TcpServer::Init(enum EventBackend backend)
+    {
+      struct pollfd pfd;
+
+      m_protocol = networking::TCP;
+      m_backend = BACKEND_POLL;
+      m_epoll = -1;
+      m_uring = NULL;
+      m_acceptStopping = false;
+      m_maxMessageSize = Framer().GetMaxMessageSize();
+      m_lowWatermark = DEFAULT_LOW_WATERMARK;
+      m_highWatermark = DEFAULT_HIGH_WATERMARK;
+      m_nextConnectionId = 0;
+      m_pool = NULL;
+      m_wakeup[0] = -1;
+      m_wakeup[1] = -1;
+
+      if(backend == BACKEND_IO_URING)
+      {
+        m_uring = new uring::Ring();
+
+        if(m_uring->Init(URING_ENTRIES, URING_BUFFERS, MIN_RECV_SIZE))
+        {
+          m_backend = BACKEND_IO_URING;
+        }
+        else
+        {
+          /* kernel too old or io_uring disabled */
+          delete m_uring;
+          m_uring = NULL;
+          backend = BACKEND_EPOLL;
+        }
+      }
+
+#ifdef __linux__
+      if(backend == BACKEND_EPOLL)
+      {
+        m_epoll = epoll_create(64);
+
+        if(m_epoll != -1)
+        {
+          m_backend = BACKEND_EPOLL;
+        }
+      }
+#else
+      (void)backend;
+#endif
+
+      /* slot 0 is for the listen socket, slot 1 for the wake up pipe
+       * (negative descriptors are ignored by poll)
+       */
+      pfd.fd = -1;
+      pfd.events = POLLIN;
+      pfd.revents = 0;
+      m_pollfds.push_back(pfd);
+      m_pollfds.push_back(pfd);
+    }
+
+    TcpServer::~TcpServer()
+    {
+      if(m_sock != -1)
+      {
+        Close();
+      }
+
+      StopWorkerPool();
+      delete m_pool;
+
+      if(m_wakeup[0] != -1)
+      {
+        ::close(m_wakeup[0]);
+        ::close(m_wakeup[1]);
+      }
+
+      if(m_epoll != -1)
+      {
+        ::close(m_epoll);
+      }
+
+      /* cancels what is still in flight */
+      delete m_uring;
+    }
+
+    bool TcpServer::SetWorkerPool(size_t threads, size_t queueDepth)
+    {
+      StopWorkerPool();
+      delete m_pool;
+      m_pool = NULL;
+
+      if(threads == 0)
+      {
+        return true;
+      }
+
+      if(m_wakeup[0] == -1)
+      {
+        if(!openWakeup(m_wakeup))
+        {
+          return false;
+        }
+
+        m_pollfds[1].fd = m_wakeup[0];
+
+        if(m_backend == BACKEND_IO_URING)
+        {
+          m_uring->Poll(m_wakeup[0], URING_WAKEUP);
+        }
+
+#ifdef __linux__
+        if(m_backend == BACKEND_EPOLL)
+        {
+          struct epoll_event ev;
+
+          memset(&ev, 0x00, sizeof(ev));
+          ev.events = EPOLLIN;
+          ev.data.fd = m_wakeup[0];
+          epoll_ctl(m_epoll, EPOLL_CTL_ADD, m_wakeup[0], &ev);
+        }
+#endif
+      }
+
+      m_pool = new system_util::ThreadPool(threads, queueDepth);
+
+      if(!m_pool->Start())
+      {
+        delete m_pool;
+        m_pool = NULL;
+        return false;
+      }
+
+      return true;
+    }
+
+    void TcpServer::StopWorkerPool()
+    {
+      if(m_pool == NULL)
+      {
+        return;
+      }
+
+      /* pending requests are executed before the workers exit */
+      m_pool->Stop();
+      SendCompleted();
+    }
+
+    void* TcpServer::ProcessJob(void* arg)
+    {
+      Job* job = static_cast<Job*>(arg);
+      Json::Value response;
+      Json::FastWriter writer;
+      bool wakeup = false;
+
+      Count(METRIC_JOB_QUEUE, -1);
+      m_jsonHandler.Process(job->request, response, job->response);
+
+      if(job->response.empty())
+      {
+        /* in case of notification message received, the response could be Json::Value::null */
+        if(response == Json::Value::null)
+        {
+          delete job;
+          return NULL;
+        }
+
+        job->response = writer.write(response);
+      }
+
+      job->request = Json::Value::null;
+
+      m_completedMutex.Lock();
+      wakeup = m_completed.empty();
+      m_completed.push_back(job);
+      m_completedMutex.Unlock();
+
+      /* WaitMessage() empties the pipe before it takes the responses so
+       * one byte is enough until then
+       */
+      if(wakeup)
+      {
+        signalWakeup(m_wakeup[1]);
+      }
+
+      return NULL;
+    }
+
+    void TcpServer::SendCompleted()
+    {
+      std::list<Job*> jobs;
+
+      drainWakeup(m_wakeup[0]);
+
+      m_completedMutex.Lock();
+      jobs.swap(m_completed);
+      m_completedMutex.Unlock();
+
+      for(std::list<Job*>::iterator it = jobs.begin() ; it != jobs.end() ; it++)
+      {
+        Connection* conn = GetConnection((*it)->fd);
+
+        /* client may have disconnected and its descriptor reused */
+        if(conn && conn->id == (*it)->id)
+        {
+          SendResponse((*it)->fd, (*it)->response);
+        }
+
+        delete (*it);
+      }
+    }
+
+    enum EventBackend TcpServer::GetBackend() const
+    {
+      return m_backend;
+    }
+
+    void TcpServer::SetMaxMessageSize(size_t size)
+    {
+      m_maxMessageSize = size;
+
+      for(std::vector<int>::iterator it = m_clients.begin() ; it != m_clients.end() ; it++)
+      {
+        m_connections[(*it)]->framer.SetMaxMessageSize(size);
+      }
+    }
+
+    size_t TcpServer::GetMaxMessageSize() const
+    {
+      return m_maxMessageSize;
+    }
+
+    bool TcpServer::SetWatermarks(size_t low, size_t high)
+    {
+      if(high && low > high)
+      {
+        return false;
+      }
+
+      m_lowWatermark = low;
+      m_highWatermark = high;
+      return true;
+    }
+
+    size_t TcpServer::GetLowWatermark() const
+    {
+      return m_lowWatermark;
+    }
+
+    size_t TcpServer::GetHighWatermark() const
+    {
+      return m_highWatermark;
+    }
+
+    size_t TcpServer::GetOutputQueueSize(int fd) const
+    {
+      Connection* conn = GetConnection(fd);
+
+      return conn ? GetQueuedSize(conn) : 0;
+    }
+
+    size_t TcpServer::GetQueuedSize(const Connection* conn) const
+    {
+      return conn->output.length() - conn->outputOffset +
+        conn->inflight.length() - conn->inflightOffset;
+    }
+
+    TcpServer::Connection* TcpServer::GetConnection(int fd) const
+    {
+      if(fd < 0 || (size_t)fd >= m_connections.size())
+      {
+        return NULL;
+      }
+
+      return m_connections[fd];
+    }
+    
+    ssize_t TcpServer::Send(int fd, const std::string& data)
+    {
+      Connection* conn = GetConnection(fd);
+      char header[http::MAX_HEADER_SIZE];
+      size_t len = data.length();
+
+      if(!SendResponse(fd, data))
+      {
+        return -1;
+      }
+
+      if(GetEncapsulatedFormat() == Json::Rpc::NETSTRING)
+      {
+        len += netstring::encodeHeader(data.length(), header) + 1;
+      }
+      else if(GetEncapsulatedFormat() == Json::Rpc::HTTP_POST)
+      {
+        len += http::encodeResponseHeader(data.empty() ? 204 : 200,
+            data.length(), !conn->closing, header);
+      }
+
+      return len;
+    }
+
+    bool TcpServer::SendResponse(int fd, const std::string& data, int status)
+    {
+      Connection* conn = GetConnection(fd);
+      char header[http::MAX_HEADER_SIZE]; /* bigger than netstring one */
+      const char* parts[3];
+      size_t sizes[3];
+      size_t count = 0;
+      ssize_t nb = 0;
+
+      if(conn == NULL)
+      {
+        return false;
+      }
+
+      /* encoding, header and trailer are sent around the payload so that
+       * it is not copied
+       */
+      if(GetEncapsulatedFormat() == Json::Rpc::NETSTRING)
+      {
+        parts[count] = header;
+        sizes[count++] = netstring::encodeHeader(data.length(), header);
+      }
+      else if(GetEncapsulatedFormat() == Json::Rpc::HTTP_POST)
+      {
+        /* only notifications have an empty response */
+        if(data.empty() && status == 200)
+        {
+          status = 204;
+        }
+
+        parts[count] = header;
+        sizes[count++] = http::encodeResponseHeader(status, data.length(),
+            !conn->closing, header);
+      }
+
+      parts[count] = data.data();
+      sizes[count++] = data.length();
+
+      if(GetEncapsulatedFormat() == Json::Rpc::NETSTRING)
+      {
+        parts[count] = &netstring::TRAILER;
+        sizes[count++] = 1;
+      }
+
+      /* responses are sent in order, do not overtake the queued ones,
+       * io_uring sends the queue in the next WaitMessage()
+       */
+      if(conn->output.length() == conn->outputOffset &&
+          m_backend != BACKEND_IO_URING)
+      {
+        size_t chunks[3];
+        size_t room = networking::MAX_RECORD_SIZE;
+
+        for(size_t i = 0 ; i < count ; i++)
+        {
+          chunks[i] = sizes[i];
+
+          /* one record at most, Flush() sends the rest in other records */
+          if(m_protocol == networking::UNIX_SEQPACKET)
+          {
+            chunks[i] = sizes[i] < room ? sizes[i] : room;
+            room -= chunks[i];
+          }
+        }
+
+        nb = networking::trySendv(fd, parts, chunks, count);
+
+        if(nb == -1)
+        {
+          /* error */
+          std::cerr << "Error while sending data: "
+                    << strerror(errno) << std::endl;
+          m_purge.push_back(fd);
+          return false;
+        }
+
+        Count(METRIC_SENT_BYTES, nb);
+      }
+
+      /* queue what the socket has not taken */
+      for(size_t i = 0 ; i < count ; i++)
+      {
+        if((size_t)nb >= sizes[i])
+        {
+          nb -= sizes[i];
+          continue;
+        }
+
+        conn->output.append(parts[i] + nb, sizes[i] - nb);
+        nb = 0;
+      }
+      CountQueued(conn);
+
+      if(conn->closing && GetQueuedSize(conn) == 0)
+      {
+        /* last response of the connection is sent */
+        m_purge.push_back(fd);
+        return true;
+      }
+
+      if(m_highWatermark && GetQueuedSize(conn) >= m_highWatermark)
+      {
+        /* slow client, stop reading its requests */
+        conn->reading = false;
+      }
+
+      UpdateEvents(fd, conn);
+      return true;
+    }
+
+    bool TcpServer::Flush(int fd)
+    {
+      Connection* conn = GetConnection(fd);
+      const char* data = NULL;
+      size_t size = 0;
+      ssize_t nb = 0;
+
+      if(conn == NULL)
+      {
+        return false;
+      }
+
+      data = conn->output.data() + conn->outputOffset;
+      size = conn->output.length() - conn->outputOffset;
+
+      if(size > 0)
+      {
+        /* queued responses are sent in several records if needed, the
+         * receiver reassembles them like a stream
+         */
+        size_t chunk = size;
+
+        if(m_protocol == networking::UNIX_SEQPACKET &&
+            chunk > networking::MAX_RECORD_SIZE)
+        {
+          chunk = networking::MAX_RECORD_SIZE;
+        }
+
+        nb = networking::trySendv(fd, &data, &chunk, 1);
+
+        if(nb == -1)
+        {
+          /* error */
+          std::cerr << "Error while sending data: "
+                    << strerror(errno) << std::endl;
+          m_purge.push_back(fd);
+          return false;
+        }
+
+        conn->outputOffset += nb;
+        size -= nb;
+        Count(METRIC_SENT_BYTES, nb);
+        CountQueued(conn);
+      }
+
+      if(size == 0)
+      {
+        conn->outputOffset = 0;
+
+        if(conn->output.capacity() > MAX_IDLE_OUTPUT_SIZE)
+        {
+          std::string().swap(conn->output);
+        }
+        else
+        {
+          conn->output.clear();
+        }
+
+        if(conn->closing)
+        {
+          /* last response of the connection is sent */
+          m_purge.push_back(fd);
+          return true;
+        }
+      }
+      else if(conn->outputOffset >= size)
+      {
+        /* drop the bytes sent when they are more than the bytes left */
+        conn->output.erase(0, conn->outputOffset);
+        conn->outputOffset = 0;
+      }
+
+      if(!conn->reading && !conn->closing && size <= m_lowWatermark)
+      {
+        conn->reading = true;
+        UpdateEvents(fd, conn);
+
+        /* requests already received have not been processed */
+        return ProcessMessages(fd, conn);
+      }
+
+      UpdateEvents(fd, conn);
+      return true;
+    }
+
+    void TcpServer::UpdateEvents(int fd, Connection* conn)
+    {
+      short events = 0;
+
+      if(m_backend == BACKEND_IO_URING)
+      {
+        uint64_t data = (uint64_t)(uintptr_t)conn;
+
+        /* a multishot receive is stopped, not just ignored, so that the
+         * kernel keeps the data while the client is too slow
+         */
+        if(conn->reading && !conn->receiving &&
+            m_uring->Recv(fd, data | URING_RECV))
+        {
+          conn->receiving = true;
+          conn->pendingOps++;
+        }
+        else if(!conn->reading && conn->receiving && !conn->cancelling &&
+            m_uring->Cancel(data | URING_RECV, data | URING_CANCEL))
+        {
+          conn->cancelling = true;
+          conn->pendingOps++;
+        }
+
+        SubmitSend(conn);
+        return;
+      }
+
+      if(conn->reading)
+      {
+        events |= POLLIN;
+      }
+
+      if(conn->output.length() != conn->outputOffset)
+      {
+        events |= POLLOUT;
+      }
+
+      if(events == conn->events)
+      {
+        return;
+      }
+
+      conn->events = events;
+
+      if(m_backend == BACKEND_POLL)
+      {
+        m_pollfds[conn->index + FIRST_CLIENT_POLLFD].events = events;
+      }
+#ifdef __linux__
+      else
+      {
+        struct epoll_event ev;
+
+        memset(&ev, 0x00, sizeof(ev));
+        ev.data.fd = fd;
+
+        if(events & POLLIN)
+        {
+          ev.events |= EPOLLIN;
+        }
+
+        if(events & POLLOUT)
+        {
+          ev.events |= EPOLLOUT;
+        }
+
+        epoll_ctl(m_epoll, EPOLL_CTL_MOD, fd, &ev);
+      }
+#else
+      (void)fd;
+#endif
+    }
+
+    bool TcpServer::Recv(int fd)
+    {
+      Connection* conn = GetConnection(fd);
+      ssize_t nb = -1;
+      size_t size = 0;
+
+      if(conn == NULL)
+      {
+        return false;
+      }
+
+      if(conn->framer.GetEncapsulatedFormat() != GetEncapsulatedFormat())
+      {
+        conn->framer.SetEncapsulatedFormat(GetEncapsulatedFormat());
+      }
+
+      /* read more as the pending message grows */
+      size = conn->framer.GetBufferedSize();
+      if(size < MIN_RECV_SIZE)
+      {
+        size = MIN_RECV_SIZE;
+      }
+
+#ifdef MSG_TRUNC
+      if(m_protocol == networking::UNIX_SEQPACKET)
+      {
+        /* a record is read at once, what does not fit is lost */
+        nb = recv(fd, NULL, 0, MSG_PEEK | MSG_TRUNC);
+
+        if(nb > 0 && (size_t)nb > size)
+        {
+          size = nb;
+        }
+      }
+#endif
+
+      nb = recv(fd, conn->framer.Prepare(size), size, 0);
+
+      if(nb == -1 && (errno == EAGAIN || errno == EWOULDBLOCK ||
+            errno == EINTR))
+      {
+        /* socket is non-blocking, nothing to read after all */
+        return true;
+      }
+
+      if(nb <= 0)
+      {
+        m_purge.push_back(fd);
+        return false;
+      }
+
+      conn->framer.Commit(nb);
+      Count(METRIC_RECEIVED_BYTES, nb);
+
+      return ProcessMessages(fd, conn);
+    }
+
+    bool TcpServer::ProcessMessages(int fd, Connection* conn)
+    {
+      const char* msg = NULL;
+      size_t msgSize = 0;
+      int ret = 0;
+      bool httpFormat = GetEncapsulatedFormat() == Json::Rpc::HTTP_POST;
+
+      /* give the messages to JsonHandler, they are parsed in place, until
+       * the client does not read its responses fast enough
+       */
+      while(conn->reading && (ret = conn->framer.Next(msg, msgSize)) == 1)
+      {
+        Json::Value root;
+        Json::Value response;
+
+        Count(METRIC_MESSAGES, 1);
+
+        if(!m_jsonHandler.Parse(m_reader, msg, msgSize, root, m_serialized))
+        {
+          Count(METRIC_PARSE_ERRORS, 1);
+        }
+        else
+        {
+          /* HTTP responses have to be sent in the order of the requests */
+          if(m_pool && !httpFormat &&
+              m_jsonHandler.GetExecutionHint(root) == EXECUTE_POOLED)
+          {
+            Job* job = new Job();
+            system_util::ThreadArg* task =
+              new system_util::ThreadArgImpl<TcpServer>(*this,
+                  &TcpServer::ProcessJob, job);
+
+            job->fd = fd;
+            job->id = conn->id;
+            job->request.swap(root);
+
+            /* counted before, the job can start before Push() returns */
+            Count(METRIC_JOB_QUEUE, 1);
+
+            /* never waits for a free place, the other connections would
+             * not be served meanwhile
+             */
+            if(m_pool->Push(task, false))
+            {
+              continue;
+            }
+
+            Count(METRIC_JOB_QUEUE, -1);
+
+            /* queue is full or pool is stopped, the request is executed
+             * here, which also slows down the reading
+             */
+            root.swap(job->request);
+            delete task;
+            delete job;
+          }
+
+          m_jsonHandler.Process(root, response, m_serialized);
+        }
+
+        if(httpFormat && !conn->framer.IsKeepAlive())
+        {
+          /* last request of the connection, closed once answered */
+          conn->closing = true;
+          conn->reading = false;
+        }
+
+        if(!m_serialized.empty())
+        {
+          /* protocol error or cached response, already serialized by the
+           * handler
+           */
+          if(!SendResponse(fd, m_serialized))
+          {
+            return false;
+          }
+        }
+        /* in case of notification message received, the response could be Json::Value::null */
+        else if(response != Json::Value::null)
+        {
+          if(!SendResponse(fd, m_writer.write(response)))
+          {
+            return false;
+          }
+        }
+        else if(httpFormat)
+        {
+          /* each HTTP request has a response, even a notification */
+          if(!SendResponse(fd, std::string()))
+          {
+            return false;
+          }
+        }
+      }
 
-#ifdef _WIN32
-/* poll is not defined on Windows but there is WSAPoll */
-#define poll WSAPoll
-#else
-#include <poll.h>
-#endif
+      if(ret == 0 && conn->framer.TakeContinue())
+      {
+        /* client waits for it before sending the body */
+        return SendResponse(fd, std::string(), 100);
+      }
 
-namespace Json 
-{
-  namespace Rpc
-  {
-    TcpServer::TcpServer(const std::string& address, uint16_t port) : Server(address, port)
-    {
-      m_protocol = networking::TCP;
+      if(ret == -1)
+      {
+        /* error parsing Netstring or HTTP, or message too big */
+        std::cerr << "Invalid message stream, close connection" << std::endl;
+        Count(METRIC_FRAMING_ERRORS, 1);
+
+        if(httpFormat && !conn->closing)
+        {
+          /* tell the client before closing */
+          conn->closing = true;
+          conn->reading = false;
+          SendResponse(fd, std::string(), 400);
+          return false;
+        }
+
+        m_purge.push_back(fd);
+        return false;
+      }
+
+      return true;
     }
 
-    TcpServer::~TcpServer()
+    void TcpServer::WaitMessage(uint32_t ms)
     {
-      if(m_sock != -1)
+      if(m_backend == BACKEND_IO_URING)
       {
-        Close();
+        WaitUring(ms);
+      }
+      else if(m_backend == BACKEND_EPOLL)
+      {
+        WaitEpoll(ms);
+      }
+      else
+      {
+        WaitPoll(ms);
       }
-    }
-    
-    ssize_t TcpServer::Send(int fd, const std::string& data)
-    {
-      std::string rep = data;
 
-      /* encoding if any */
-      if(GetEncapsulatedFormat() == Json::Rpc::NETSTRING)
+      /* remove disconnect socket descriptor */
+      for(std::list<int>::iterator it = m_purge.begin() ; it != m_purge.end() ; it++)
       {
-        rep = netstring::encode(rep);
+        RemoveClient((*it));
       }
 
-      return ::send(fd, rep.c_str(), rep.length(), 0);
+      /* purge disconnected list */
+      m_purge.erase(m_purge.begin(), m_purge.end());
     }
 
-    bool TcpServer::Recv(int fd)
+    void TcpServer::WaitPoll(uint32_t ms)
     {
-      Json::Value response;
-      ssize_t nb = -1;
-      char buf[1500];
+      size_t nb = m_pollfds.size();
 
-      nb = recv(fd, buf, sizeof(buf), 0);
+      m_pollfds[0].fd = m_sock;
 
-      /* give the message to JsonHandler */
-      if(nb > 0)
+      if(poll(&m_pollfds[0], nb, ms) > 0)
       {
-        std::string msg = std::string(buf, nb);
+        if(m_pollfds[1].revents & POLLIN)
+        {
+          SendCompleted();
+        }
 
-        if(GetEncapsulatedFormat() == Json::Rpc::NETSTRING)
+        /* a client accepted below is only polled on next call */
+        for(size_t i = FIRST_CLIENT_POLLFD ; i < nb ; i++)
         {
-          try
+          /* Flush() may resume reading, so it goes first */
+          if(m_pollfds[i].revents & POLLOUT)
           {
-            msg = netstring::decode(msg);
+            Flush(m_pollfds[i].fd);
           }
-          catch(const netstring::NetstringException& e)
+
+          if(m_pollfds[i].revents & (POLLIN | POLLHUP | POLLERR))
           {
-            /* error parsing Netstring */
-            std::cerr << e.what() << std::endl;
-            return false;
+            Recv(m_pollfds[i].fd);
           }
         }
 
-        m_jsonHandler.Process(msg, response);
-
-        /* in case of notification message received, the response could be Json::Value::null */
-        if(response != Json::Value::null)
+        if(m_pollfds[0].revents & POLLIN)
         {
-          std::string rep = m_jsonHandler.GetString(response);
+          Accept();
+        }
+      }
+      else
+      {
+        /* error */
+      }
+    }
+
+    void TcpServer::WaitEpoll(uint32_t ms)
+    {
+#ifdef __linux__
+      struct epoll_event events[64];
+      int nb = epoll_wait(m_epoll, events, sizeof(events) / sizeof(events[0]),
+          ms);
 
-          /* encoding */
-          if(GetEncapsulatedFormat() == Json::Rpc::NETSTRING)
+      for(int i = 0 ; i < nb ; i++)
+      {
+        if(events[i].data.fd == m_sock)
+        {
+          Accept();
+        }
+        else if(events[i].data.fd == m_wakeup[0])
+        {
+          SendCompleted();
+        }
+        else
+        {
+          if(events[i].events & EPOLLOUT)
           {
-            rep = netstring::encode(rep);
+            Flush(events[i].data.fd);
           }
 
-          size_t bytesToSend = rep.length();
-          const char* ptrBuffer = rep.c_str();
-          do
+          if(events[i].events & (EPOLLIN | EPOLLHUP | EPOLLERR))
           {
-            int retVal = send(fd, ptrBuffer, bytesToSend, 0);
-            if(retVal == -1)
-            {
-              /* error */
-              std::cerr << "Error while sending data: " 
-                        << strerror(errno) << std::endl;
-              return false;
-            }
-            bytesToSend -= retVal;
-            ptrBuffer += retVal;
-          }while(bytesToSend > 0);
+            Recv(events[i].data.fd);
+          }
         }
+      }
+#else
+      (void)ms;
+#endif
+    }
 
-        return true;
+    void TcpServer::WaitUring(uint32_t ms)
+    {
+      uring::Completion completion;
+
+      if(!m_uring->Wait(ms))
+      {
+        return;
       }
-      else
+
+      while(m_uring->Next(completion))
       {
-        m_purge.push_back(fd);
-        return false;
+        Connection* conn = reinterpret_cast<Connection*>(
+            (uintptr_t)(completion.data & ~(uint64_t)URING_REQUEST_MASK));
+
+        switch(completion.data & URING_REQUEST_MASK)
+        {
+          case URING_ACCEPT:
+            if(completion.res >= 0 && m_acceptStopping)
+            {
+              /* accepted while Close() runs */
+              ::close(completion.res);
+            }
+            else if(completion.res >= 0)
+            {
+              AddClient(completion.res);
+            }
+
+            if(completion.more)
+            {
+              break;
+            }
+
+            /* stopped on error (too many descriptors for example) */
+            if(!m_acceptStopping && m_sock != -1)
+            {
+              m_uring->Accept(m_sock, URING_ACCEPT);
+            }
+            m_acceptStopping = false;
+            break;
+          case URING_STOP:
+            /* no accept in flight */
+            if(completion.res < 0)
+            {
+              m_acceptStopping = false;
+            }
+            break;
+          case URING_WAKEUP:
+            SendCompleted();
+
+            if(!completion.more)
+            {
+              m_uring->Poll(m_wakeup[0], URING_WAKEUP);
+            }
+            break;
+          case URING_RECV:
+            CompleteRecv(conn, completion);
+            break;
+          case URING_SEND:
+            CompleteSend(conn, completion.res);
+            break;
+          case URING_CANCEL:
+            conn->pendingOps--;
+            break;
+          default:
+            break;
+        }
+
+        /* last request of a removed connection */
+        if(conn && conn->pendingOps == 0 && m_orphans.erase(conn))
+        {
+          ::close(conn->fd);
+          delete conn;
+        }
       }
     }
 
-    void TcpServer::WaitMessage(uint32_t ms)
+    void TcpServer::CompleteRecv(Connection* conn,
+        const uring::Completion& completion)
     {
-      struct pollfd* pfd = NULL;
-      size_t i = 0;
+      bool removed = GetConnection(conn->fd) != conn;
+
+      if(completion.buffer != -1)
+      {
+        if(!removed && completion.res > 0)
+        {
+          conn->framer.Feed(m_uring->GetBuffer(completion.buffer),
+              completion.res);
+        }
 
-      pfd = new pollfd[1 + m_clients.size()];
+        m_uring->ReleaseBuffer(completion.buffer);
+      }
 
-      pfd[i].fd = m_sock;
-      pfd[i].events = POLLIN;
-      i++;
+      if(!completion.more)
+      {
+        conn->receiving = false;
+        conn->cancelling = false;
+        conn->pendingOps--;
+      }
 
-      for(std::list<int>::iterator it = m_clients.begin() ; it != m_clients.end() ; it++)
+      if(removed)
       {
-        pfd[i].fd = (*it);
-        pfd[i].events = POLLIN;
-        i++;
+        return;
       }
 
-      if(poll(pfd, i, ms) > 0)
+      if(completion.res > 0)
       {
-        if(pfd[0].revents & POLLIN)
+        Count(METRIC_RECEIVED_BYTES, completion.res);
+
+        if(!ProcessMessages(conn->fd, conn))
         {
-          Accept();
+          return;
         }
+      }
+      else if(completion.res != -ENOBUFS && completion.res != -ECANCELED)
+      {
+        /* closed by the client or error */
+        m_purge.push_back(conn->fd);
+        return;
+      }
+
+      /* receive again if it has stopped (no buffer left) */
+      if(!completion.more)
+      {
+        UpdateEvents(conn->fd, conn);
+      }
+    }
+
+    void TcpServer::CompleteSend(Connection* conn, int res)
+    {
+      size_t size = 0;
+
+      conn->sending = false;
+      conn->pendingOps--;
 
-        i = 1;
+      if(res > 0)
+      {
+        conn->inflightOffset += res;
+        Count(METRIC_SENT_BYTES, res);
+      }
+
+      if(conn->inflightOffset == conn->inflight.length())
+      {
+        conn->inflightOffset = 0;
 
-        for(std::list<int>::iterator it = m_clients.begin() ; it != m_clients.end() ; it++)
+        if(conn->inflight.capacity() > MAX_IDLE_OUTPUT_SIZE)
         {
-          if(pfd[i].revents & POLLIN)
-          {
-            Recv((*it));
-          }
-          i++;
+          std::string().swap(conn->inflight);
         }
-
-        /* remove disconnect socket descriptor */
-        for(std::list<int>::iterator it = m_purge.begin() ; it != m_purge.end() ; it++)
+        else
         {
-          int s = (*it);
-          if(s > 0)
-          {
-            close(s);
-          }
-          m_clients.remove(s);
+          conn->inflight.clear();
         }
+      }
 
-        /* purge disconnected list */
-        m_purge.erase(m_purge.begin(), m_purge.end());
+      if(GetConnection(conn->fd) != conn)
+      {
+        return;
       }
-      else
+
+      CountQueued(conn);
+
+      if(res < 0)
       {
         /* error */
+        std::cerr << "Error while sending data: " << strerror(-res)
+                  << std::endl;
+        m_purge.push_back(conn->fd);
+        return;
+      }
+
+      size = GetQueuedSize(conn);
+
+      if(size == 0 && conn->closing)
+      {
+        /* last response of the connection is sent */
+        m_purge.push_back(conn->fd);
+        return;
+      }
+
+      if(!conn->reading && !conn->closing && size <= m_lowWatermark)
+      {
+        conn->reading = true;
+        UpdateEvents(conn->fd, conn);
+
+        /* requests already received have not been processed */
+        ProcessMessages(conn->fd, conn);
+        return;
+      }
+
+      /* rest of a partial send, or responses queued meanwhile */
+      SubmitSend(conn);
+    }
+
+    void TcpServer::SubmitSend(Connection* conn)
+    {
+      if(conn->sending)
+      {
+        return;
+      }
+
+      /* responses queued while a send is in flight go in the next one, a
+       * short send in a chain of linked sends would break the stream
+       */
+      if(conn->inflightOffset == conn->inflight.length())
+      {
+        if(conn->output.length() == conn->outputOffset)
+        {
+          return;
+        }
+
+        conn->inflight.swap(conn->output);
+        conn->inflightOffset = conn->outputOffset;
+        conn->output.clear();
+        conn->outputOffset = 0;
+      }
+
+      if(!m_uring->Send(conn->fd, conn->inflight.data() + conn->inflightOffset,
+            conn->inflight.length() - conn->inflightOffset,
+            (uint64_t)(uintptr_t)conn | URING_SEND))
+      {
+        m_purge.push_back(conn->fd);
+        return;
       }
-      
-      delete[] pfd;
+
+      conn->sending = true;
+      conn->pendingOps++;
     }
 
     bool TcpServer::Listen() const
@@ -204,6 +1317,30 @@ namespace Json
         return false;
       }
 
+      /* one request accepts all the clients */
+      if(m_backend == BACKEND_IO_URING &&
+          !m_uring->Accept(m_sock, URING_ACCEPT))
+      {
+        return false;
+      }
+
+#ifdef __linux__
+      if(m_backend == BACKEND_EPOLL)
+      {
+        struct epoll_event ev;
+
+        memset(&ev, 0x00, sizeof(ev));
+        ev.events = EPOLLIN;
+        ev.data.fd = m_sock;
+
+        if(epoll_ctl(m_epoll, EPOLL_CTL_ADD, m_sock, &ev) == -1 &&
+            errno != EEXIST)
+        {
+          return false;
+        }
+      }
+#endif
+
       return true;
     }
 
@@ -224,26 +1361,232 @@ namespace Json
         return false;
       }
 
-      m_clients.push_back(client);
+      AddClient(client);
       return true;
     }
 
+    void TcpServer::AddClient(int fd)
+    {
+      Connection* conn = NULL;
+      struct pollfd pfd;
+      int on = 1;
+
+      if((size_t)fd >= m_connections.size())
+      {
+        m_connections.resize(fd + 1, NULL);
+      }
+
+      /* a client which does not read its responses must not block the
+       * others
+       */
+      setNonBlocking(fd);
+
+      /* responses are complete messages, the ones to pipelined requests
+       * must not wait for the acknowledgement of the previous one
+       */
+      if(m_protocol == networking::TCP)
+      {
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, (const char*)&on, sizeof(on));
+      }
+
+#ifdef __linux__
+      if(m_backend == BACKEND_EPOLL)
+      {
+        struct epoll_event ev;
+
+        memset(&ev, 0x00, sizeof(ev));
+        ev.events = EPOLLIN;
+        ev.data.fd = fd;
+
+        if(epoll_ctl(m_epoll, EPOLL_CTL_ADD, fd, &ev) == -1)
+        {
+          ::close(fd);
+          return;
+        }
+      }
+#endif
+
+      conn = new Connection();
+      conn->index = m_clients.size();
+      conn->id = m_nextConnectionId++;
+      conn->framer.SetEncapsulatedFormat(GetEncapsulatedFormat());
+      conn->framer.SetMaxMessageSize(m_maxMessageSize);
+      conn->outputOffset = 0;
+      conn->reading = true;
+      conn->closing = false;
+      conn->events = POLLIN;
+      conn->fd = fd;
+      conn->inflightOffset = 0;
+      conn->sending = false;
+      conn->receiving = false;
+      conn->cancelling = false;
+      conn->pendingOps = 0;
+      conn->queued = 0;
+      m_connections[fd] = conn;
+      m_clients.push_back(fd);
+      Count(METRIC_ACCEPTED, 1);
+
+      if(m_backend == BACKEND_POLL)
+      {
+        pfd.fd = fd;
+        pfd.events = POLLIN;
+        pfd.revents = 0;
+        m_pollfds.push_back(pfd);
+      }
+      else if(m_backend == BACKEND_IO_URING)
+      {
+        /* starts the multishot receive */
+        UpdateEvents(fd, conn);
+      }
+    }
+
+    void TcpServer::RemoveClient(int fd)
+    {
+      Connection* conn = GetConnection(fd);
+      size_t index = 0;
+
+      if(conn == NULL)
+      {
+        return;
+      }
+
+      /* move the last client in the hole */
+      index = conn->index;
+      m_clients[index] = m_clients.back();
+      m_connections[m_clients[index]]->index = index;
+      m_clients.pop_back();
+      m_connections[fd] = NULL;
+      CountQueued(conn, true);
+
+      if(m_backend == BACKEND_POLL)
+      {
+        m_pollfds[index + FIRST_CLIENT_POLLFD] = m_pollfds.back();
+        m_pollfds.pop_back();
+      }
+
+      if(conn->pendingOps > 0)
+      {
+        /* the kernel still uses the buffers: end the requests and keep
+         * the descriptor until they complete so that it is not reused
+         */
+#ifdef _WIN32
+        shutdown(fd, SD_BOTH);
+#else
+        shutdown(fd, SHUT_RDWR);
+#endif
+        m_orphans.insert(conn);
+        return;
+      }
+
+      delete conn;
+
+      /* closing the socket also removes it from the epoll set */
+      ::close(fd);
+    }
+
     void TcpServer::Close()
     {
-      /* close all client sockets */
-      for(std::list<int>::iterator it = m_clients.begin() ; it != m_clients.end() ; it++)
+      /* no new client from now on */
+      if(m_uring)
+      {
+        StopAccept();
+      }
+
+      /* answer requests being processed before closing connections */
+      StopWorkerPool();
+
+      /* close all client sockets, last chance for the queued responses */
+      for(std::vector<int>::iterator it = m_clients.begin() ; it != m_clients.end() ; it++)
       {
+        Connection* conn = m_connections[(*it)];
+        const char* data = conn->output.data() + conn->outputOffset;
+        size_t size = conn->output.length() - conn->outputOffset;
+
+        /* not behind a send in flight */
+        if(size > 0 && !conn->sending)
+        {
+          networking::trySendv((*it), &data, &size, 1);
+        }
+
+        m_connections[(*it)] = NULL;
+        CountQueued(conn, true);
+
+        if(conn->pendingOps > 0)
+        {
+#ifdef _WIN32
+          shutdown((*it), SD_BOTH);
+#else
+          shutdown((*it), SHUT_RDWR);
+#endif
+          m_orphans.insert(conn);
+          continue;
+        }
+
         ::close((*it));
+        delete conn;
       }
       m_clients.erase(m_clients.begin(), m_clients.end());
-      
-      /* listen socket should be closed in Server destructor */
+      m_pollfds.resize(FIRST_CLIENT_POLLFD);
+
+      /* the requests of the shut down sockets complete quickly */
+      for(int i = 0 ; i < URING_CLOSE_WAITS && !m_orphans.empty() ; i++)
+      {
+        WaitUring(100);
+      }
+
+      for(std::set<Connection*>::iterator it = m_orphans.begin() ;
+          it != m_orphans.end() ; it++)
+      {
+        ::close((*it)->fd);
+        delete (*it);
+      }
+      m_orphans.clear();
+
+      /* the listen socket too, a server stopped must not leave connections
+       * waiting in its queue (also removes it from the epoll set)
+       */
+      if(m_sock != -1)
+      {
+        Server::Close();
+      }
+    }
+
+    void TcpServer::CountQueued(Connection* conn, bool closed)
+    {
+      size_t size = closed ? 0 : GetQueuedSize(conn);
+
+      if(closed)
+      {
+        Count(METRIC_CLOSED, 1);
+      }
+
+      if(size != conn->queued)
+      {
+        Count(METRIC_OUTPUT_QUEUE, (int64_t)size - (int64_t)conn->queued);
+        conn->queued = size;
+      }
+    }
+
+    void TcpServer::StopAccept()
+    {
+      if(!m_uring->Cancel(URING_ACCEPT, URING_STOP))
+      {
+        return;
+      }
+
+      /* the clients are still served until the accept ends */
+      m_acceptStopping = true;
+
+      for(int i = 0 ; i < URING_CLOSE_WAITS && m_acceptStopping ; i++)
+      {
+        WaitUring(100);
+      }
+      m_acceptStopping = false;
     }
 
     const std::list<int> TcpServer::GetClients() const
     {
-      return m_clients;
+      return std::list<int>(m_clients.begin(), m_clients.end());
     }
   } /* namespace Rpc */
 } /* namespace Json */
-
@@ -24,28 +24,150 @@
 
 #include <iostream>
 #include <stdexcept>
+#include <vector>
+
+#include <cstring>
+#include <cerrno>
 
 #include "jsonrpc_udpserver.h"
 
 #include "netstring.h"
 
+#ifdef __linux__
+#include <sys/uio.h>
+#endif
+
 namespace Json 
 {
   namespace Rpc
   {
+    /**
+     * \var MAX_DATAGRAM_SIZE
+     * \brief Maximum size of a received datagram.
+     */
+    static const size_t MAX_DATAGRAM_SIZE = 1500;
+
+#ifdef __linux__
+    struct UdpServer::BatchRing
+    {
+      /**
+       * \brief Receive buffers, MAX_DATAGRAM_SIZE bytes per datagram.
+       */
+      std::vector<char> buffers;
+
+      /**
+       * \brief recvmmsg() headers.
+       */
+      std::vector<struct mmsghdr> recvHeaders;
+
+      /**
+       * \brief recvmmsg() vectors, one per receive buffer.
+       */
+      std::vector<struct iovec> recvVectors;
+
+      /**
+       * \brief Source address of each received datagram.
+       */
+      std::vector<struct sockaddr_storage> addrs;
+
+      /**
+       * \brief sendmmsg() headers.
+       */
+      std::vector<struct mmsghdr> sendHeaders;
+
+      /**
+       * \brief sendmmsg() vectors, one per response.
+       */
+      std::vector<struct iovec> sendVectors;
+
+      /**
+       * \brief Responses, reused from a batch to another.
+       */
+      std::vector<std::string> replies;
+    };
+#else
+    struct UdpServer::BatchRing
+    {
+    };
+#endif
+
     UdpServer::UdpServer(const std::string& address, uint16_t port) : Server(address, port)
     {
       m_protocol = networking::UDP;
+      m_batch = NULL;
+    }
+
+    UdpServer::UdpServer(const std::string& address, uint16_t port,
+        Handler& handler) : Server(address, port, handler)
+    {
+      m_protocol = networking::UDP;
+      m_batch = NULL;
     }
 
     UdpServer::~UdpServer()
     {
+      delete m_batch;
+    }
+
+    bool UdpServer::SetBatchSize(size_t size)
+    {
+      if(size <= 1)
+      {
+        delete m_batch;
+        m_batch = NULL;
+        return true;
+      }
+
+#ifdef __linux__
+      BatchRing* batch = new BatchRing();
+
+      batch->buffers.resize(size * MAX_DATAGRAM_SIZE);
+      batch->recvHeaders.resize(size);
+      batch->recvVectors.resize(size);
+      batch->addrs.resize(size);
+      batch->sendHeaders.resize(size);
+      batch->sendVectors.resize(size);
+      batch->replies.resize(size);
+
+      for(size_t i = 0 ; i < size ; i++)
+      {
+        struct msghdr* hdr = &batch->recvHeaders[i].msg_hdr;
+
+        batch->recvVectors[i].iov_base = &batch->buffers[i * MAX_DATAGRAM_SIZE];
+        batch->recvVectors[i].iov_len = MAX_DATAGRAM_SIZE;
+
+        memset(hdr, 0x00, sizeof(struct msghdr));
+        hdr->msg_iov = &batch->recvVectors[i];
+        hdr->msg_iovlen = 1;
+        hdr->msg_name = &batch->addrs[i];
+
+        memset(&batch->sendHeaders[i].msg_hdr, 0x00, sizeof(struct msghdr));
+        batch->sendHeaders[i].msg_hdr.msg_iov = &batch->sendVectors[i];
+        batch->sendHeaders[i].msg_hdr.msg_iovlen = 1;
+      }
+
+      delete m_batch;
+      m_batch = batch;
+      return true;
+#else
+      return false;
+#endif
+    }
+
+    size_t UdpServer::GetBatchSize() const
+    {
+#ifdef __linux__
+      return m_batch ? m_batch->recvHeaders.size() : 1;
+#else
+      return 1;
+#endif
     }
 
     ssize_t UdpServer::Send(const std::string& data, const struct sockaddr* addr,
         socklen_t addrlen)
     {
       std::string rep = data;
+      ssize_t nb = -1;
 
       /* encoding if any */
       if(GetEncapsulatedFormat() == Json::Rpc::NETSTRING)
@@ -53,63 +175,183 @@ namespace Json
         rep = netstring::encode(rep);
       }
 
-      return ::sendto(m_sock, rep.c_str(), rep.length(), 0, (struct sockaddr*)addr, addrlen);
+      nb = ::sendto(m_sock, rep.c_str(), rep.length(), 0, (struct sockaddr*)addr, addrlen);
+
+      if(nb > 0)
+      {
+        Count(METRIC_SENT_BYTES, nb);
+      }
+
+      return nb;
     }
 
-    bool UdpServer::Recv(int fd)
+    bool UdpServer::ProcessDatagram(const char* buf, size_t len,
+        std::string& rep)
     {
+      Json::Value root;
       Json::Value response;
+
+      m_message.assign(buf, len);
+      rep.clear();
+      Count(METRIC_RECEIVED_BYTES, len);
+
+      if(GetEncapsulatedFormat() == Json::Rpc::NETSTRING)
+      {
+        try
+        {
+          m_message = netstring::decode(m_message);
+        }
+        catch(const netstring::NetstringException& e)
+        {
+          /* error parsing NetString */
+          std::cerr << e.what() << std::endl;
+          Count(METRIC_FRAMING_ERRORS, 1);
+          return false;
+        }
+      }
+
+      Count(METRIC_MESSAGES, 1);
+
+      /* give the message to JsonHandler, protocol errors and cached
+       * responses come back already serialized in rep
+       */
+      if(m_jsonHandler.Parse(m_reader, m_message, root, rep))
+      {
+        m_jsonHandler.Process(root, response, rep);
+      }
+      else
+      {
+        Count(METRIC_PARSE_ERRORS, 1);
+      }
+
+      /* in case of notification message received, the response could be Json::Value::null */
+      if(rep.empty() && response != Json::Value::null)
+      {
+        rep = m_writer.write(response);
+      }
+
+      if(!rep.empty())
+      {
+        /* encoding */
+        if(GetEncapsulatedFormat() == Json::Rpc::NETSTRING)
+        {
+          rep = netstring::encode(rep);
+        }
+      }
+
+      return true;
+    }
+
+    bool UdpServer::Recv(int fd)
+    {
       ssize_t nb = -1;
-      char buf[1500];
+      char buf[MAX_DATAGRAM_SIZE];
       struct sockaddr_storage addr;
       socklen_t addrlen = sizeof(struct sockaddr_storage);
+      std::string rep;
+
+      if(m_batch)
+      {
+        return RecvBatch(fd);
+      }
 
       nb = ::recvfrom(fd, buf, sizeof(buf), 0, (struct sockaddr*)&addr, &addrlen);
 
       if(nb > 0)
       {
-        std::string msg = std::string(buf, nb);
+        if(!ProcessDatagram(buf, nb, rep))
+        {
+          return false;
+        }
 
-        if(GetEncapsulatedFormat() == Json::Rpc::NETSTRING)
+        if(rep.length() > 0)
         {
-          try
-          {
-            msg = netstring::decode(msg);
-          }
-          catch(const netstring::NetstringException& e)
+          if(::sendto(fd, rep.c_str(), rep.length(), 0, (struct sockaddr*)&addr, addrlen) == -1)
           {
-            /* error parsing NetString */
-            std::cerr << e.what() << std::endl;
+            /* error */
+            std::cerr << "Error while sending"  << std::endl;
             return false;
           }
+
+          Count(METRIC_SENT_BYTES, rep.length());
         }
 
-        /* give the message to JsonHandler */
-        m_jsonHandler.Process(msg, response);
+        return true;
+      }
+
+      return false;
+    }
+
+    bool UdpServer::RecvBatch(int fd)
+    {
+#ifdef __linux__
+      BatchRing* batch = m_batch;
+      unsigned int size = batch->recvHeaders.size();
+      unsigned int nb = 0;
+      unsigned int sent = 0;
+      int ret = -1;
+
+      for(unsigned int i = 0 ; i < size ; i++)
+      {
+        batch->recvHeaders[i].msg_hdr.msg_namelen = sizeof(struct sockaddr_storage);
+      }
+
+      /* block until the first datagram then take what is already queued */
+      ret = ::recvmmsg(fd, &batch->recvHeaders[0], size, MSG_WAITFORONE, NULL);
 
-        /* in case of notification message received, the response could be Json::Value::null */
-        if(response != Json::Value::null)
+      if(ret <= 0)
+      {
+        return false;
+      }
+
+      for(unsigned int i = 0 ; i < (unsigned int)ret ; i++)
+      {
+        std::string& rep = batch->replies[nb];
+
+        if(!ProcessDatagram(&batch->buffers[i * MAX_DATAGRAM_SIZE],
+              batch->recvHeaders[i].msg_len, rep) || rep.length() == 0)
         {
-          std::string rep = m_jsonHandler.GetString(response);
+          continue;
+        }
 
-          /* encoding */
-          if(GetEncapsulatedFormat() == Json::Rpc::NETSTRING)
-          {
-            rep = netstring::encode(rep);
-          }
+        batch->sendVectors[nb].iov_base = const_cast<char*>(rep.data());
+        batch->sendVectors[nb].iov_len = rep.length();
+        batch->sendHeaders[nb].msg_hdr.msg_name = &batch->addrs[i];
+        batch->sendHeaders[nb].msg_hdr.msg_namelen =
+          batch->recvHeaders[i].msg_hdr.msg_namelen;
+        nb++;
+      }
 
-          if(::sendto(fd, rep.c_str(), rep.length(), 0, (struct sockaddr*)&addr, addrlen) == -1)
+      while(sent < nb)
+      {
+        ret = ::sendmmsg(fd, &batch->sendHeaders[sent], nb - sent, 0);
+
+        if(ret == -1)
+        {
+          if(errno == EINTR)
           {
-            /* error */
-            std::cerr << "Error while sending"  << std::endl;
-            return false;
+            continue;
           }
+
+          /* error, drop this reply but send the next ones */
+          std::cerr << "Error while sending"  << std::endl;
+          sent++;
+          continue;
         }
 
-        return true;
+        for(int i = 0 ; i < ret ; i++)
+        {
+          Count(METRIC_SENT_BYTES, batch->sendHeaders[sent + i].msg_len);
+        }
+
+        sent += ret;
       }
 
+      return true;
+#else
+      (void)fd;
       return false;
+#endif
     }
 
     void UdpServer::WaitMessage(uint32_t ms)
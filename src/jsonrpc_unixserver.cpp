@@ -0,0 +1,105 @@
+/*
+ *  JsonRpc-Cpp - JSON-RPC implementation.
+ *  Copyright (C) 2008-2011 Sebastien Vincent <sebastien.vincent@cppextrem.com>
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+/**
+ * \file jsonrpc_unixserver.cpp
+ * \brief JSON-RPC Unix domain socket server.
+ * \author Sebastien Vincent
+ */
+
+#include "jsonrpc_unixserver.h"
+
+namespace Json
+{
+  namespace Rpc
+  {
+    /**
+     * \brief Get the backend usable with a protocol.
+     * \param protocol UNIX_STREAM or UNIX_SEQPACKET
+     * \param backend backend requested
+     * \return backend
+     */
+    static enum EventBackend usableBackend(
+        enum networking::TransportProtocol protocol, enum EventBackend backend)
+    {
+      /* io_uring receives in fixed size buffers, a bigger record would be
+       * truncated
+       */
+      if(protocol == networking::UNIX_SEQPACKET && backend == BACKEND_IO_URING)
+      {
+        return BACKEND_EPOLL;
+      }
+
+      return backend;
+    }
+
+    UnixServer::UnixServer(const std::string& path,
+        enum networking::TransportProtocol protocol, enum EventBackend backend)
+      : TcpServer(path, 0, usableBackend(protocol, backend))
+    {
+      m_protocol = protocol;
+      m_created = false;
+    }
+
+    UnixServer::UnixServer(const std::string& path, Handler& handler,
+        enum networking::TransportProtocol protocol, enum EventBackend backend)
+      : TcpServer(path, 0, handler, usableBackend(protocol, backend))
+    {
+      m_protocol = protocol;
+      m_created = false;
+    }
+
+    UnixServer::~UnixServer()
+    {
+      /* the file of a server already closed is already removed */
+      if(m_sock != -1)
+      {
+        Close();
+      }
+    }
+
+    bool UnixServer::Bind()
+    {
+      std::string path = GetPath();
+
+      if(!TcpServer::Bind())
+      {
+        return false;
+      }
+
+      /* an abstract name goes with the socket */
+      m_created = !path.empty() && path[0] != '@';
+      return true;
+    }
+
+    void UnixServer::Close()
+    {
+      TcpServer::Close();
+
+      if(m_created)
+      {
+        unlink(GetPath().c_str());
+        m_created = false;
+      }
+    }
+
+    std::string UnixServer::GetPath() const
+    {
+      return GetAddress();
+    }
+  } /* namespace Rpc */
+} /* namespace Json */
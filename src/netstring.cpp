@@ -25,73 +25,234 @@
 #include "netstring.h"
 
 #include <cstdio>
+#include <cstring>
+#include <cctype>
 
 #include <iostream>
 #include <stdexcept>
 
 namespace netstring
 {
+  /**
+   * \var MAX_LENGTH_DIGITS
+   * \brief Maximum number of digits of a length (fits in 64-bit).
+   */
+  static const size_t MAX_LENGTH_DIGITS = 18;
+
+  /**
+   * \var MAX_IDLE_BUFFER_SIZE
+   * \brief Decoder buffer bigger than this is released once it is empty.
+   */
+  static const size_t MAX_IDLE_BUFFER_SIZE = 64 * 1024;
+
   std::string encode(const std::string& str)
   {
-    unsigned long len = str.length();
-    char strLen[32];
+    char header[MAX_HEADER_SIZE];
+    size_t headerLen = encodeHeader(str.length(), header);
     std::string ret;
-    
+
     /* format of a netstring is [len]:[string], */
-    sprintf(strLen, "%lu:", len);
-    ret.append(strLen);
+    ret.reserve(headerLen + str.length() + 1);
+    ret.append(header, headerLen);
     ret.append(str);
-    ret.append(",");
+    ret.append(1, TRAILER);
 
     return ret;
   }
 
+  size_t encodeHeader(size_t len, char* header)
+  {
+    return sprintf(header, "%lu:", (unsigned long)len);
+  }
+
   std::string decode(const std::string& str) throw(netstring::NetstringException) 
   {
     unsigned long len = 0;
     size_t index = 0; /* position of ":" */
-    size_t index2 = 0; /* position of "," */
-    size_t i = 0;
     const char* data = str.data();
-    std::string ret;
 
-    index = str.find_first_of(":");
-    if(index == std::string::npos)
+    for(index = 0 ; index < str.length() && data[index] != ':' ; index++)
+    {
+      if(isdigit((unsigned char)data[index]) && index < MAX_LENGTH_DIGITS)
+      {
+        len = len * 10 + (data[index] - (char)0x30);
+      }
+      else
+      {
+        /* error */
+        throw NetstringException("netstring: parsing error");
+      }
+    }
+
+    if(index == str.length())
     {
       /* error */
       throw NetstringException("netstring: missing ':' character");
     }
-    
-    index2 = str.find_last_of(",");
-    if(index2 == std::string::npos)
+
+    if(index == 0 || len != (str.length() - index - 2))
+    {
+      /* error */
+      throw NetstringException("netstring: size mismatch");
+    }
+
+    if(data[str.length() - 1] != ',')
     {
       /* error */
       throw NetstringException("netstring: missing ',' character");
     }
 
-    for(i = 0 ; i < index ; i++)
+    return std::string(data + index + 1, len);
+  }
+
+  Decoder::Decoder(size_t maxSize)
+  {
+    m_maxSize = maxSize;
+    m_begin = 0;
+    m_end = 0;
+    Reset();
+  }
+
+  Decoder::~Decoder()
+  {
+  }
+
+  void Decoder::SetMaxSize(size_t maxSize)
+  {
+    m_maxSize = maxSize;
+  }
+
+  size_t Decoder::GetMaxSize() const
+  {
+    return m_maxSize;
+  }
+
+  char* Decoder::Prepare(size_t size)
+  {
+    if(m_begin == m_end && m_begin > 0)
     {
-      if(isdigit(data[i]))
+      /* everything is consumed, payloads given by Next() can go */
+      m_scan -= m_begin;
+      m_begin = 0;
+      m_end = 0;
+
+      if(m_buffer.size() > MAX_IDLE_BUFFER_SIZE)
       {
-        len = len * 10 + (data[i] - (char)0x30);
+        std::vector<char>().swap(m_buffer);
+      }
+    }
+
+    if(m_buffer.size() - m_end < size && m_begin > 0)
+    {
+      /* move the incomplete netstring at the beginning of the buffer */
+      memmove(&m_buffer[0], &m_buffer[m_begin], m_end - m_begin);
+      m_end -= m_begin;
+      m_scan -= m_begin;
+      m_begin = 0;
+    }
+
+    if(m_buffer.size() - m_end < size)
+    {
+      size_t newSize = m_buffer.size() ? m_buffer.size() : 4096;
+
+      while(newSize - m_end < size)
+      {
+        newSize *= 2;
+      }
+      m_buffer.resize(newSize);
+    }
+
+    return &m_buffer[m_end];
+  }
+
+  void Decoder::Commit(size_t size)
+  {
+    m_end += size;
+  }
+
+  void Decoder::Feed(const char* data, size_t size)
+  {
+    if(size == 0)
+    {
+      return;
+    }
+
+    memcpy(Prepare(size), data, size);
+    Commit(size);
+  }
+
+  bool Decoder::Next(const char*& data, size_t& size) throw(netstring::NetstringException)
+  {
+    const char* buf = m_buffer.empty() ? NULL : &m_buffer[0];
+
+    /* format of a netstring is [len]:[string], */
+    for( ; !m_hasLength && m_scan < m_end ; m_scan++)
+    {
+      char c = buf[m_scan];
+
+      if(c == ':' && m_digits > 0)
+      {
+        m_hasLength = true;
+      }
+      else if(!isdigit((unsigned char)c))
+      {
+        throw NetstringException(c == ':' ? "netstring: missing length" :
+            "netstring: parsing error");
       }
       else
       {
-        /* error */
-        throw NetstringException("netstring: parsing error");
+        m_length = m_length * 10 + (c - '0');
+
+        /* reject before the payload is received */
+        if(++m_digits > MAX_LENGTH_DIGITS || (m_maxSize && m_length > m_maxSize))
+        {
+          throw NetstringException("netstring: length too big");
+        }
       }
     }
 
-    if(len != (str.length() - index - 2))
+    /* payload and trailing ',' */
+    if(!m_hasLength || m_end - m_scan < m_length + 1)
     {
-      /* error */
-      throw NetstringException("netstring: size mismatch");
+      return false;
     }
 
-    ret.assign(str, index + 1, len);
-    return ret;
+    if(buf[m_scan + m_length] != ',')
+    {
+      throw NetstringException("netstring: missing ',' character");
+    }
+
+    data = buf + m_scan;
+    size = m_length;
+
+    m_begin = m_scan + m_length + 1;
+    m_scan = m_begin;
+    m_length = 0;
+    m_digits = 0;
+    m_hasLength = false;
+    return true;
+  }
+
+  size_t Decoder::GetBufferedSize() const
+  {
+    return m_end - m_begin;
   }
-  
+
+  void Decoder::Reset()
+  {
+    m_begin = 0;
+    m_end = 0;
+    m_scan = 0;
+    m_length = 0;
+    m_digits = 0;
+    m_hasLength = false;
+
+    if(m_buffer.size() > MAX_IDLE_BUFFER_SIZE)
+    {
+      std::vector<char>().swap(m_buffer);
+    }
+  }
+
   NetstringException::NetstringException(const std::string& msg) throw()
   {
     m_msg = msg;
@@ -24,9 +24,18 @@
 
 #include <cstdio>
 #include <cstring>
+#include <cerrno>
 
 #include "networking.h"
 
+#ifndef _WIN32
+#include <sys/uio.h>
+#include <sys/un.h>
+#include <sys/stat.h>
+
+#include <cstddef>
+#endif
+
 namespace networking
 {
 #ifdef _WIN32
@@ -59,6 +68,109 @@ namespace networking
 #endif
   }
 
+#ifndef _WIN32
+  /**
+   * \brief Fill a Unix domain socket address.
+   * \param path path of the socket, a leading '@' means the abstract
+   * namespace
+   * \param addr address to fill
+   * \param addrlen if function succeed, length of addr
+   * \return true if success, false if path is empty or too long
+   */
+  static bool unixAddress(const std::string& path, struct sockaddr_un* addr,
+      socklen_t* addrlen)
+  {
+    bool abstract = !path.empty() && path[0] == '@';
+
+    memset(addr, 0x00, sizeof(struct sockaddr_un));
+    addr->sun_family = AF_UNIX;
+
+    /* abstract name is not NULL-terminated, a path is */
+    if(path.length() <= (abstract ? 1 : 0) ||
+        path.length() + (abstract ? 0 : 1) > sizeof(addr->sun_path))
+    {
+      return false;
+    }
+
+    memcpy(addr->sun_path, path.data(), path.length());
+
+    if(abstract)
+    {
+#ifdef __linux__
+      addr->sun_path[0] = 0x00;
+      *addrlen = offsetof(struct sockaddr_un, sun_path) + path.length();
+#else
+      return false;
+#endif
+    }
+    else
+    {
+      *addrlen = sizeof(struct sockaddr_un);
+    }
+
+    return true;
+  }
+
+  /**
+   * \brief Create a Unix domain socket and bind or connect it.
+   * \param protocol UNIX_STREAM or UNIX_SEQPACKET
+   * \param path path of the socket
+   * \param listening bind if true, connect otherwise
+   * \param sockaddr if function succeed, sockaddr representation of path
+   * \param addrlen if function succeed, length of sockaddr
+   * \return socket descriptor if success, -1 otherwise
+   */
+  static int unixSocket(enum TransportProtocol protocol,
+      const std::string& path, bool listening,
+      struct sockaddr_storage* sockaddr,
+      socklen_t* addrlen)
+  {
+    struct sockaddr_un addr;
+    socklen_t len = 0;
+    struct stat st;
+    int sock = -1;
+
+    if(!unixAddress(path, &addr, &len))
+    {
+      return -1;
+    }
+
+    sock = socket(AF_UNIX, protocol == UNIX_SEQPACKET ? SOCK_SEQPACKET :
+        SOCK_STREAM, 0);
+
+    if(sock == -1)
+    {
+      return -1;
+    }
+
+    /* a socket file stays after its server has gone */
+    if(listening && path[0] != '@' && stat(path.c_str(), &st) == 0 &&
+        S_ISSOCK(st.st_mode))
+    {
+      unlink(path.c_str());
+    }
+
+    if((listening && ::bind(sock, (struct sockaddr*)&addr, len) == -1) ||
+        (!listening && ::connect(sock, (struct sockaddr*)&addr, len) == -1))
+    {
+      ::close(sock);
+      return -1;
+    }
+
+    if(sockaddr)
+    {
+      memcpy(sockaddr, &addr, len);
+    }
+
+    if(addrlen)
+    {
+      *addrlen = len;
+    }
+
+    return sock;
+  }
+#endif
+
   int connect(enum TransportProtocol protocol, const std::string& address,
       uint16_t port, struct sockaddr_storage* sockaddr, socklen_t* addrlen)
   {
@@ -68,6 +180,15 @@ namespace networking
     char service[8];
     int sock = -1;
 
+    if(isUnix(protocol))
+    {
+#ifndef _WIN32
+      return unixSocket(protocol, address, false, sockaddr, addrlen);
+#else
+      return -1;
+#endif
+    }
+
     if(!port || address == "")
     {
       return -1;
@@ -125,7 +246,8 @@ namespace networking
   }
 
   int bind(enum TransportProtocol protocol, const std::string& address,
-      uint16_t port, struct sockaddr_storage* sockaddr, socklen_t* addrlen)
+      uint16_t port, struct sockaddr_storage* sockaddr, socklen_t* addrlen,
+      bool reusePort)
   {
     struct addrinfo hints;
     struct addrinfo* res = NULL;
@@ -133,6 +255,17 @@ namespace networking
     char service[8];
     int sock = -1;
 
+    if(isUnix(protocol))
+    {
+#ifndef _WIN32
+      /* one server per path */
+      return reusePort ? -1 : unixSocket(protocol, address, true, sockaddr,
+          addrlen);
+#else
+      return -1;
+#endif
+    }
+
     if(!port || address == "")
     {
       return -1;
@@ -173,6 +306,19 @@ namespace networking
       (void)on;
 #endif
 
+      if(reusePort)
+      {
+#ifdef SO_REUSEPORT
+        on = 1;
+        if(setsockopt(sock, SOL_SOCKET, SO_REUSEPORT, &on, sizeof(on)) == -1)
+#endif
+        {
+          ::close(sock);
+          sock = -1;
+          continue;
+        }
+      }
+
       if(::bind(sock, p->ai_addr, p->ai_addrlen) == -1)
       {
         ::close(sock);
@@ -199,5 +345,148 @@ namespace networking
 
     return sock;
   }
+
+  bool sendv(int sock, const char* const* parts, const size_t* sizes,
+      size_t count)
+  {
+    if(count > MAX_SEND_PARTS)
+    {
+      return false;
+    }
+
+#ifndef _WIN32
+    struct iovec vec[MAX_SEND_PARTS];
+    struct msghdr msg;
+    size_t first = 0;
+    int flags = 0;
+
+    for(size_t i = 0 ; i < count ; i++)
+    {
+      vec[i].iov_base = const_cast<char*>(parts[i]);
+      vec[i].iov_len = sizes[i];
+    }
+
+    memset(&msg, 0x00, sizeof(struct msghdr));
+
+#ifdef MSG_NOSIGNAL
+    /* a peer which has gone is reported by EPIPE, not SIGPIPE */
+    flags = MSG_NOSIGNAL;
+#endif
+
+    while(first < count)
+    {
+      ssize_t nb = -1;
+
+      msg.msg_iov = &vec[first];
+      msg.msg_iovlen = count - first;
+
+      nb = ::sendmsg(sock, &msg, flags);
+
+      if(nb == -1)
+      {
+        if(errno == EINTR)
+        {
+          continue;
+        }
+        return false;
+      }
+
+      /* skip what has been sent, the last buffer could be partially sent */
+      while(first < count && (size_t)nb >= vec[first].iov_len)
+      {
+        nb -= vec[first].iov_len;
+        first++;
+      }
+
+      if(first < count)
+      {
+        vec[first].iov_base = (char*)vec[first].iov_base + nb;
+        vec[first].iov_len -= nb;
+      }
+    }
+#else
+    for(size_t i = 0 ; i < count ; i++)
+    {
+      const char* ptr = parts[i];
+      size_t size = sizes[i];
+
+      while(size > 0)
+      {
+        int nb = ::send(sock, ptr, (int)size, 0);
+
+        if(nb == -1)
+        {
+          return false;
+        }
+
+        ptr += nb;
+        size -= nb;
+      }
+    }
+#endif
+
+    return true;
+  }
+
+  ssize_t trySendv(int sock, const char* const* parts, const size_t* sizes,
+      size_t count)
+  {
+    ssize_t ret = 0;
+
+    if(count > MAX_SEND_PARTS)
+    {
+      return -1;
+    }
+
+#ifndef _WIN32
+    struct iovec vec[MAX_SEND_PARTS];
+    struct msghdr msg;
+    int flags = 0;
+
+    for(size_t i = 0 ; i < count ; i++)
+    {
+      vec[i].iov_base = const_cast<char*>(parts[i]);
+      vec[i].iov_len = sizes[i];
+    }
+
+    memset(&msg, 0x00, sizeof(struct msghdr));
+    msg.msg_iov = vec;
+    msg.msg_iovlen = count;
+
+#ifdef MSG_NOSIGNAL
+    /* a peer which has gone is reported by EPIPE, not SIGPIPE */
+    flags = MSG_NOSIGNAL;
+#endif
+
+    do
+    {
+      ret = ::sendmsg(sock, &msg, flags);
+    }while(ret == -1 && errno == EINTR);
+
+    if(ret == -1 && (errno == EAGAIN || errno == EWOULDBLOCK))
+    {
+      ret = 0;
+    }
+#else
+    for(size_t i = 0 ; i < count ; i++)
+    {
+      int nb = ::send(sock, parts[i], (int)sizes[i], 0);
+
+      if(nb == -1)
+      {
+        return WSAGetLastError() == WSAEWOULDBLOCK ? ret : -1;
+      }
+
+      ret += nb;
+
+      if((size_t)nb < sizes[i])
+      {
+        break;
+      }
+    }
+#endif
+
+    return ret;
+  }
 } /* namespace networking */
 
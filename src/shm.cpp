@@ -0,0 +1,487 @@
+/*
+ *  JsonRpc-Cpp - JSON-RPC implementation.
+ *  Copyright (C) 2008-2011 Sebastien Vincent <sebastien.vincent@cppextrem.com>
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**
+ * \file shm.cpp
+ * \brief Shared-memory ring buffers between two processes.
+ * \author Sebastien Vincent
+ */
+
+#include "shm.h"
+
+#include <cstring>
+
+#ifdef __linux__
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include <sys/eventfd.h>
+#endif
+
+namespace shm
+{
+  /**
+   * \var SEGMENT_MAGIC
+   * \brief Identifies a segment of this version.
+   */
+  static const uint32_t SEGMENT_MAGIC = 0x4a534d31;
+
+  /**
+   * \var MIN_RING_SIZE
+   * \brief Minimum size of a ring.
+   */
+  static const size_t MIN_RING_SIZE = 4096;
+
+  /**
+   * \var MAX_RING_SIZE
+   * \brief Maximum size of a ring (indexes are 32-bit counters).
+   */
+  static const size_t MAX_RING_SIZE = 1 << 30;
+
+  /**
+   * \var DESCRIPTOR_COUNT
+   * \brief Number of descriptors passed to the server: segment and events.
+   */
+  static const size_t DESCRIPTOR_COUNT = 3;
+
+  unsigned int getSpinCount()
+  {
+#ifdef __linux__
+    static const long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+
+    return cpus > 1 ? SPIN_COUNT : 0;
+#else
+    return 0;
+#endif
+  }
+
+  Channel::Channel()
+  {
+    m_segment = -1;
+    m_events[0] = -1;
+    m_events[1] = -1;
+    m_header = NULL;
+    m_size = 0;
+    m_out = 0;
+    m_in = 1;
+    m_mask = 0;
+    m_outData = NULL;
+    m_inData = NULL;
+  }
+
+  Channel::~Channel()
+  {
+    Close();
+  }
+
+  bool Channel::Create(size_t ringSize)
+  {
+#ifdef __linux__
+    SegmentHeader header;
+    size_t size = MIN_RING_SIZE;
+
+    if(IsOpen() || ringSize > MAX_RING_SIZE)
+    {
+      return false;
+    }
+
+    while(size < ringSize)
+    {
+      size <<= 1;
+    }
+
+    m_segment = syscall(SYS_memfd_create, "jsonrpc-shm", 1 /* MFD_CLOEXEC */);
+    m_events[0] = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    m_events[1] = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+
+    memset(&header, 0x00, sizeof(SegmentHeader));
+    header.magic = SEGMENT_MAGIC;
+    header.ringSize = size;
+
+    if(m_segment == -1 || m_events[0] == -1 || m_events[1] == -1 ||
+        ftruncate(m_segment, sizeof(SegmentHeader) + 2 * size) == -1 ||
+        pwrite(m_segment, &header, sizeof(SegmentHeader), 0) !=
+        (ssize_t)sizeof(SegmentHeader) || !Map(false))
+    {
+      Close();
+      return false;
+    }
+
+    return true;
+#else
+    (void)ringSize;
+    return false;
+#endif
+  }
+
+  bool Channel::Send(int sock) const
+  {
+#ifdef __linux__
+    char control[CMSG_SPACE(DESCRIPTOR_COUNT * sizeof(int))];
+    int fds[DESCRIPTOR_COUNT];
+    struct msghdr msg;
+    struct cmsghdr* cmsg = NULL;
+    struct iovec iov;
+    char c = 0;
+
+    if(!IsOpen())
+    {
+      return false;
+    }
+
+    fds[0] = m_segment;
+    fds[1] = m_events[0];
+    fds[2] = m_events[1];
+
+    /* at least one byte has to be sent with the descriptors */
+    iov.iov_base = &c;
+    iov.iov_len = 1;
+
+    memset(&msg, 0x00, sizeof(struct msghdr));
+    memset(control, 0x00, sizeof(control));
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control;
+    msg.msg_controllen = sizeof(control);
+
+    cmsg = CMSG_FIRSTHDR(&msg);
+    cmsg->cmsg_level = SOL_SOCKET;
+    cmsg->cmsg_type = SCM_RIGHTS;
+    cmsg->cmsg_len = CMSG_LEN(sizeof(fds));
+    memcpy(CMSG_DATA(cmsg), fds, sizeof(fds));
+
+    return sendmsg(sock, &msg, MSG_NOSIGNAL) == 1;
+#else
+    (void)sock;
+    return false;
+#endif
+  }
+
+  bool Channel::Receive(int sock)
+  {
+#ifdef __linux__
+    char control[CMSG_SPACE(DESCRIPTOR_COUNT * sizeof(int))];
+    struct msghdr msg;
+    struct cmsghdr* cmsg = NULL;
+    struct iovec iov;
+    char c = 0;
+    size_t count = 0;
+
+    if(IsOpen())
+    {
+      return false;
+    }
+
+    iov.iov_base = &c;
+    iov.iov_len = 1;
+
+    memset(&msg, 0x00, sizeof(struct msghdr));
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control;
+    msg.msg_controllen = sizeof(control);
+
+    if(recvmsg(sock, &msg, MSG_CMSG_CLOEXEC) != 1)
+    {
+      return false;
+    }
+
+    for(cmsg = CMSG_FIRSTHDR(&msg) ; cmsg ; cmsg = CMSG_NXTHDR(&msg, cmsg))
+    {
+      if(cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SCM_RIGHTS)
+      {
+        int fds[DESCRIPTOR_COUNT];
+        size_t nb = (cmsg->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+
+        /* anything unexpected is closed, not leaked */
+        for(size_t i = 0 ; i < nb ; i++)
+        {
+          int fd = -1;
+
+          memcpy(&fd, CMSG_DATA(cmsg) + i * sizeof(int), sizeof(int));
+
+          if(count < DESCRIPTOR_COUNT)
+          {
+            fds[count] = fd;
+          }
+          else
+          {
+            ::close(fd);
+          }
+          count++;
+        }
+
+        if(count <= DESCRIPTOR_COUNT)
+        {
+          for(size_t i = 0 ; i < count ; i++)
+          {
+            if(i == 0)
+            {
+              m_segment = fds[i];
+            }
+            else
+            {
+              m_events[i - 1] = fds[i];
+            }
+          }
+        }
+      }
+    }
+
+    if(count != DESCRIPTOR_COUNT || (msg.msg_flags & MSG_CTRUNC) ||
+        !Map(true))
+    {
+      Close();
+      return false;
+    }
+
+    return true;
+#else
+    (void)sock;
+    return false;
+#endif
+  }
+
+  void Channel::Close()
+  {
+#ifdef __linux__
+    if(m_header)
+    {
+      munmap(m_header, m_size);
+    }
+
+    if(m_segment != -1)
+    {
+      ::close(m_segment);
+    }
+
+    for(size_t i = 0 ; i < 2 ; i++)
+    {
+      if(m_events[i] != -1)
+      {
+        ::close(m_events[i]);
+      }
+    }
+#endif
+
+    m_segment = -1;
+    m_events[0] = -1;
+    m_events[1] = -1;
+    m_header = NULL;
+    m_size = 0;
+    m_mask = 0;
+    m_outData = NULL;
+    m_inData = NULL;
+  }
+
+  bool Channel::IsOpen() const
+  {
+    return m_header != NULL;
+  }
+
+  size_t Channel::Write(const char* data, size_t size)
+  {
+    uint32_t head = m_header->heads[m_out].value;
+    uint32_t tail = m_header->tails[m_out].value;
+    size_t room = 0;
+    size_t pos = 0;
+    size_t first = 0;
+
+    /* the consumer has finished with the bytes before the tail */
+    __sync_synchronize();
+
+    room = m_mask + 1 - (uint32_t)(head - tail);
+
+    if(size > room)
+    {
+      size = room;
+    }
+
+    if(size == 0)
+    {
+      return 0;
+    }
+
+    pos = head & m_mask;
+    first = m_mask + 1 - pos;
+
+    if(first > size)
+    {
+      first = size;
+    }
+
+    memcpy(m_outData + pos, data, first);
+    memcpy(m_outData, data + first, size - first);
+
+    /* bytes are visible before the head which publishes them */
+    __sync_synchronize();
+    m_header->heads[m_out].value = head + size;
+
+    Notify();
+    return size;
+  }
+
+  size_t Channel::Read(char* data, size_t size)
+  {
+    uint32_t head = m_header->heads[m_in].value;
+    uint32_t tail = m_header->tails[m_in].value;
+    size_t available = 0;
+    size_t pos = 0;
+    size_t first = 0;
+
+    /* bytes before the head are not read before the head */
+    __sync_synchronize();
+
+    available = (uint32_t)(head - tail);
+
+    if(size > available)
+    {
+      size = available;
+    }
+
+    if(size == 0)
+    {
+      return 0;
+    }
+
+    pos = tail & m_mask;
+    first = m_mask + 1 - pos;
+
+    if(first > size)
+    {
+      first = size;
+    }
+
+    memcpy(data, m_inData + pos, first);
+    memcpy(data + first, m_inData, size - first);
+
+    /* bytes are copied before the producer can overwrite them */
+    __sync_synchronize();
+    m_header->tails[m_in].value = tail + size;
+
+    Notify();
+    return size;
+  }
+
+  size_t Channel::GetReadable() const
+  {
+    return (uint32_t)(m_header->heads[m_in].value -
+        m_header->tails[m_in].value);
+  }
+
+  size_t Channel::GetWritable() const
+  {
+    return m_mask + 1 - (uint32_t)(m_header->heads[m_out].value -
+        m_header->tails[m_out].value);
+  }
+
+  void Channel::SetSleeping(bool sleeping)
+  {
+    m_header->sleeping[m_in].value = sleeping ? 1 : 0;
+
+    /* the flag is visible before the rings are checked again, the peer
+     * checks the flag after changing a ring: one of them sees the other
+     */
+    __sync_synchronize();
+  }
+
+  void Channel::ClearEvent()
+  {
+#ifdef __linux__
+    uint64_t value = 0;
+
+    if(read(m_events[m_in], &value, sizeof(value)) == -1)
+    {
+      /* nothing pending (non-blocking) */
+    }
+#endif
+  }
+
+  int Channel::GetEvent() const
+  {
+    return m_events[m_in];
+  }
+
+  bool Channel::Map(bool server)
+  {
+#ifdef __linux__
+    struct stat st;
+    void* addr = NULL;
+    char* data = NULL;
+    size_t ringSize = 0;
+
+    if(fstat(m_segment, &st) == -1 ||
+        (size_t)st.st_size < sizeof(SegmentHeader))
+    {
+      return false;
+    }
+
+    addr = mmap(NULL, st.st_size, PROT_READ | PROT_WRITE, MAP_SHARED,
+        m_segment, 0);
+
+    if(addr == MAP_FAILED)
+    {
+      return false;
+    }
+
+    m_header = static_cast<SegmentHeader*>(addr);
+    m_size = st.st_size;
+    ringSize = m_header->ringSize;
+
+    /* the segment comes from another process */
+    if(m_header->magic != SEGMENT_MAGIC || ringSize < MIN_RING_SIZE ||
+        ringSize > MAX_RING_SIZE || (ringSize & (ringSize - 1)) != 0 ||
+        m_size < sizeof(SegmentHeader) + 2 * ringSize)
+    {
+      return false;
+    }
+
+    data = reinterpret_cast<char*>(m_header) + sizeof(SegmentHeader);
+    m_mask = ringSize - 1;
+    m_out = server ? 1 : 0;
+    m_in = server ? 0 : 1;
+    m_outData = data + m_out * ringSize;
+    m_inData = data + m_in * ringSize;
+
+    return true;
+#else
+    (void)server;
+    return false;
+#endif
+  }
+
+  void Channel::Notify()
+  {
+#ifdef __linux__
+    volatile uint32_t* sleeping = &m_header->sleeping[m_out].value;
+    uint64_t value = 1;
+
+    /* the ring index is visible before the flag is read */
+    __sync_synchronize();
+
+    /* a burst of writes wakes up the peer once */
+    if(*sleeping && __sync_bool_compare_and_swap(sleeping, 1, 0) &&
+        write(m_events[m_out], &value, sizeof(value)) == -1)
+    {
+      /* counter cannot overflow with one write per sleep */
+    }
+#endif
+  }
+} /* namespace shm */
@@ -41,6 +41,36 @@ namespace system_util
 #endif
   }
 
+  uint64_t monotonicTime()
+  {
+#ifdef _WIN32
+    return (uint64_t)GetTickCount64() * 1000;
+#else
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+#endif
+  }
+
+  uint64_t monotonicTimeNs()
+  {
+#ifdef _WIN32
+    LARGE_INTEGER counter;
+    LARGE_INTEGER frequency;
+
+    QueryPerformanceCounter(&counter);
+    QueryPerformanceFrequency(&frequency);
+    return (uint64_t)((double)counter.QuadPart * 1000000000.0 /
+        (double)frequency.QuadPart);
+#else
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+#endif
+  }
+
   ThreadArg::~ThreadArg()
   {
   }
@@ -131,6 +161,75 @@ namespace system_util
     return !pthread_mutex_unlock(&m_mutex);
   }
 
+  ThreadLocal::ThreadLocal()
+  {
+    pthread_key_create(&m_key, NULL);
+  }
+
+  ThreadLocal::~ThreadLocal()
+  {
+    pthread_key_delete(m_key);
+  }
+
+  void* ThreadLocal::Get() const
+  {
+    return pthread_getspecific(m_key);
+  }
+
+  bool ThreadLocal::Set(void* value)
+  {
+    return !pthread_setspecific(m_key, value);
+  }
+
+  Condition::Condition()
+  {
+    pthread_condattr_t attr;
+
+    /* timeouts of TimedWait() are on the monotonic clock */
+    pthread_condattr_init(&attr);
+    pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+    pthread_cond_init(&m_cond, &attr);
+    pthread_condattr_destroy(&attr);
+  }
+
+  Condition::~Condition()
+  {
+    pthread_cond_destroy(&m_cond);
+  }
+
+  bool Condition::Wait(Mutex& mutex)
+  {
+    return !pthread_cond_wait(&m_cond, &mutex.m_mutex);
+  }
+
+  bool Condition::TimedWait(Mutex& mutex, unsigned long ms)
+  {
+    struct timespec ts;
+
+    /* absolute deadline */
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    ts.tv_sec += ms / 1000;
+    ts.tv_nsec += (ms % 1000) * 1000000;
+
+    if(ts.tv_nsec >= 1000000000)
+    {
+      ts.tv_sec++;
+      ts.tv_nsec -= 1000000000;
+    }
+
+    return !pthread_cond_timedwait(&m_cond, &mutex.m_mutex, &ts);
+  }
+
+  bool Condition::Signal()
+  {
+    return !pthread_cond_signal(&m_cond);
+  }
+
+  bool Condition::Broadcast()
+  {
+    return !pthread_cond_broadcast(&m_cond);
+  }
+
 #else
 
   /* Windows specific part for thread and mutex */
@@ -171,7 +270,11 @@ namespace system_util
     GetExitCodeThread(m_id, &val);
     CloseHandle(m_id);
     m_id = NULL;
-    *ret = (void*)val;
+
+    if(ret)
+    {
+      *ret = (void*)(uintptr_t)val;
+    }
     return true;
   }
 
@@ -222,6 +325,288 @@ namespace system_util
 
     return ReleaseMutex(m_mutex); 
   }
+
+  ThreadLocal::ThreadLocal()
+  {
+    m_key = TlsAlloc();
+  }
+
+  ThreadLocal::~ThreadLocal()
+  {
+    if(m_key != TLS_OUT_OF_INDEXES)
+    {
+      TlsFree(m_key);
+    }
+  }
+
+  void* ThreadLocal::Get() const
+  {
+    return TlsGetValue(m_key);
+  }
+
+  bool ThreadLocal::Set(void* value)
+  {
+    return TlsSetValue(m_key, value) != 0;
+  }
+
+  Condition::Condition()
+  {
+    InitializeCriticalSection(&m_lock);
+    m_event = CreateEvent(NULL,  /* no security attribute */
+                          TRUE,  /* manual reset */
+                          FALSE, /* not signaled */
+                          NULL); /* no name */
+    m_waiters = 0;
+    m_release = 0;
+    m_generation = 0;
+  }
+
+  Condition::~Condition()
+  {
+    if(m_event)
+    {
+      CloseHandle(m_event);
+    }
+    DeleteCriticalSection(&m_lock);
+  }
+
+  bool Condition::Wait(Mutex& mutex)
+  {
+    return TimedWait(mutex, INFINITE);
+  }
+
+  bool Condition::TimedWait(Mutex& mutex, unsigned long ms)
+  {
+    ULONGLONG deadline = GetTickCount64() + ms;
+    unsigned long generation = 0;
+    bool released = false;
+    bool last = false;
+
+    EnterCriticalSection(&m_lock);
+    m_waiters++;
+    generation = m_generation;
+    LeaveCriticalSection(&m_lock);
+
+    ReleaseMutex(mutex.m_mutex);
+
+    for(;;)
+    {
+      DWORD timeout = INFINITE;
+      DWORD ret = 0;
+
+      if(ms != INFINITE)
+      {
+        ULONGLONG now = GetTickCount64();
+        timeout = now < deadline ? (DWORD)(deadline - now) : 0;
+      }
+
+      ret = WaitForSingleObject(m_event, timeout);
+
+      EnterCriticalSection(&m_lock);
+      /* the event may still be set for the waiters of a previous call */
+      released = m_release > 0 && m_generation != generation;
+
+      if(released || ret != WAIT_OBJECT_0)
+      {
+        m_waiters--;
+
+        if(released)
+        {
+          last = (--m_release == 0);
+        }
+        LeaveCriticalSection(&m_lock);
+        break;
+      }
+      LeaveCriticalSection(&m_lock);
+    }
+
+    if(last)
+    {
+      ResetEvent(m_event);
+    }
+
+    WaitForSingleObject(mutex.m_mutex, INFINITE);
+    return released;
+  }
+
+  bool Condition::Signal()
+  {
+    bool ret = true;
+
+    EnterCriticalSection(&m_lock);
+    if(m_waiters > m_release)
+    {
+      ret = SetEvent(m_event) != 0;
+      m_release++;
+      m_generation++;
+    }
+    LeaveCriticalSection(&m_lock);
+
+    return ret;
+  }
+
+  bool Condition::Broadcast()
+  {
+    bool ret = true;
+
+    EnterCriticalSection(&m_lock);
+    if(m_waiters > 0)
+    {
+      ret = SetEvent(m_event) != 0;
+      m_release = m_waiters;
+      m_generation++;
+    }
+    LeaveCriticalSection(&m_lock);
+
+    return ret;
+  }
 #endif
+
+  /* common part, built on Thread, Mutex and Condition */
+
+  ThreadPool::ThreadPool(size_t threads, size_t queueDepth)
+  {
+    m_threadCount = threads;
+    m_queueDepth = queueDepth;
+    m_stop = true;
+  }
+
+  ThreadPool::~ThreadPool()
+  {
+    Stop();
+  }
+
+  bool ThreadPool::Start()
+  {
+    m_mutex.Lock();
+    if(!m_threads.empty())
+    {
+      m_mutex.Unlock();
+      return false;
+    }
+    m_stop = false;
+    m_mutex.Unlock();
+
+    for(size_t i = 0 ; i < m_threadCount ; i++)
+    {
+      Thread* th = new Thread(new ThreadArgImpl<ThreadPool>(*this,
+            &ThreadPool::Run, NULL));
+
+      if(!th->Start(false))
+      {
+        delete th;
+        Stop();
+        return false;
+      }
+      m_threads.push_back(th);
+    }
+
+    return true;
+  }
+
+  void ThreadPool::Stop()
+  {
+    m_mutex.Lock();
+    m_stop = true;
+    m_notEmpty.Broadcast();
+    m_notFull.Broadcast();
+    m_mutex.Unlock();
+
+    for(std::vector<Thread*>::iterator it = m_threads.begin() ; it != m_threads.end() ; it++)
+    {
+      (*it)->Join();
+      delete (*it);
+    }
+    m_threads.clear();
+
+    /* no thread was running */
+    for(std::deque<ThreadArg*>::iterator it = m_tasks.begin() ; it != m_tasks.end() ; it++)
+    {
+      (*it)->Call();
+      delete (*it);
+    }
+    m_tasks.clear();
+  }
+
+  bool ThreadPool::Push(ThreadArg* task, bool wait)
+  {
+    m_mutex.Lock();
+
+    while(!m_stop && m_queueDepth && m_tasks.size() >= m_queueDepth)
+    {
+      if(!wait)
+      {
+        m_mutex.Unlock();
+        return false;
+      }
+      m_notFull.Wait(m_mutex);
+    }
+
+    if(m_stop)
+    {
+      m_mutex.Unlock();
+      return false;
+    }
+
+    m_tasks.push_back(task);
+    m_notEmpty.Signal();
+    m_mutex.Unlock();
+    return true;
+  }
+
+  size_t ThreadPool::GetThreadCount() const
+  {
+    return m_threadCount;
+  }
+
+  size_t ThreadPool::GetQueueDepth() const
+  {
+    return m_queueDepth;
+  }
+
+  size_t ThreadPool::GetPendingCount()
+  {
+    size_t ret = 0;
+
+    m_mutex.Lock();
+    ret = m_tasks.size();
+    m_mutex.Unlock();
+    return ret;
+  }
+
+  void* ThreadPool::Run(void* arg)
+  {
+    (void)arg;
+
+    m_mutex.Lock();
+    for(;;)
+    {
+      ThreadArg* task = NULL;
+
+      while(!m_stop && m_tasks.empty())
+      {
+        m_notEmpty.Wait(m_mutex);
+      }
+
+      /* pending tasks are executed even if pool is stopping */
+      if(m_tasks.empty())
+      {
+        break;
+      }
+
+      task = m_tasks.front();
+      m_tasks.pop_front();
+      m_notFull.Signal();
+      m_mutex.Unlock();
+
+      task->Call();
+      delete task;
+
+      m_mutex.Lock();
+    }
+    m_mutex.Unlock();
+
+    return NULL;
+  }
 } /* namespace system */
 
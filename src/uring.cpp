@@ -0,0 +1,577 @@
+/*
+ *  JsonRpc-Cpp - JSON-RPC implementation.
+ *  Copyright (C) 2008-2011 Sebastien Vincent <sebastien.vincent@cppextrem.com>
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**
+ * \file uring.cpp
+ * \brief Minimal io_uring interface (Linux).
+ * \author Sebastien Vincent
+ */
+
+#include "uring.h"
+
+#include <cstring>
+#include <cerrno>
+
+#if defined(__linux__) && defined(__has_include)
+#if __has_include(<linux/io_uring.h>)
+#include <unistd.h>
+#include <poll.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include <linux/io_uring.h>
+#endif
+#endif
+
+/* multishot receive is the most recent feature used */
+#if defined(IORING_RECV_MULTISHOT) && defined(IORING_ACCEPT_MULTISHOT) && \
+  defined(__NR_io_uring_setup)
+#define URING_AVAILABLE
+#endif
+
+namespace uring
+{
+#ifdef URING_AVAILABLE
+  /**
+   * \var BUFFER_GROUP
+   * \brief Identifier of the provided buffer ring.
+   */
+  static const unsigned short BUFFER_GROUP = 0;
+
+  /**
+   * \var CQ_FACTOR
+   * \brief Size of the completion queue relative to the submission queue,
+   * multishot requests give many completions each.
+   */
+  static const unsigned int CQ_FACTOR = 16;
+
+  /**
+   * \brief Check that the kernel knows the requests used.
+   * \param fd io_uring descriptor
+   * \return true if all of them are supported, false otherwise
+   */
+  static bool probe(int fd)
+  {
+    /* IORING_OP_SEND_ZC came with multishot receive (Linux 6.0) */
+    static const int ops[] = {IORING_OP_ACCEPT, IORING_OP_RECV,
+      IORING_OP_SEND, IORING_OP_POLL_ADD, IORING_OP_ASYNC_CANCEL,
+      IORING_OP_SEND_ZC};
+    const size_t size = sizeof(struct io_uring_probe) +
+      256 * sizeof(struct io_uring_probe_op);
+    struct io_uring_probe* p = static_cast<struct io_uring_probe*>(
+        operator new(size));
+    bool ret = true;
+
+    memset(p, 0x00, size);
+
+    if(syscall(__NR_io_uring_register, fd, IORING_REGISTER_PROBE, p, 256) < 0)
+    {
+      ret = false;
+    }
+
+    for(size_t i = 0 ; ret && i < sizeof(ops) / sizeof(ops[0]) ; i++)
+    {
+      ret = ops[i] <= p->last_op &&
+        (p->ops[ops[i]].flags & IO_URING_OP_SUPPORTED);
+    }
+
+    operator delete(p);
+    return ret;
+  }
+#endif
+
+  Ring::Ring()
+  {
+    m_fd = -1;
+    m_sqMap = NULL;
+    m_sqMapSize = 0;
+    m_cqMap = NULL;
+    m_cqMapSize = 0;
+    m_sqes = NULL;
+    m_sqEntries = 0;
+    m_sqHead = NULL;
+    m_sqTail = NULL;
+    m_sqArray = NULL;
+    m_sqMask = 0;
+    m_queued = 0;
+    m_cqHead = NULL;
+    m_cqTail = NULL;
+    m_cqMask = 0;
+    m_cqes = NULL;
+    m_bufRing = NULL;
+    m_bufRingSize = 0;
+    m_buffers = NULL;
+    m_bufferCount = 0;
+    m_bufferSize = 0;
+    m_enters = 0;
+  }
+
+  Ring::~Ring()
+  {
+    Close();
+  }
+
+  bool Ring::Init(unsigned int entries, unsigned int buffers,
+      size_t bufferSize)
+  {
+#ifdef URING_AVAILABLE
+    struct io_uring_params params;
+    struct io_uring_buf_reg reg;
+    char* sq = NULL;
+    char* cq = NULL;
+
+    if(IsOpen() || buffers == 0 || (buffers & (buffers - 1)) != 0 ||
+        buffers > 32768)
+    {
+      return false;
+    }
+
+    memset(&params, 0x00, sizeof(params));
+    params.flags = IORING_SETUP_CQSIZE;
+    params.cq_entries = entries * CQ_FACTOR;
+
+    m_fd = syscall(__NR_io_uring_setup, entries, &params);
+
+    /* no EXT_ARG: no timeout, no NODROP: completions can be lost */
+    if(m_fd < 0 || !(params.features & IORING_FEAT_EXT_ARG) ||
+        !(params.features & IORING_FEAT_NODROP) || !probe(m_fd))
+    {
+      Close();
+      return false;
+    }
+
+    m_sqMapSize = params.sq_off.array + params.sq_entries * sizeof(unsigned int);
+    m_cqMapSize = params.cq_off.cqes +
+      params.cq_entries * sizeof(struct io_uring_cqe);
+
+    if(params.features & IORING_FEAT_SINGLE_MMAP)
+    {
+      if(m_cqMapSize > m_sqMapSize)
+      {
+        m_sqMapSize = m_cqMapSize;
+      }
+      m_cqMapSize = 0;
+    }
+
+    m_sqMap = mmap(NULL, m_sqMapSize, PROT_READ | PROT_WRITE,
+        MAP_SHARED | MAP_POPULATE, m_fd, IORING_OFF_SQ_RING);
+
+    if(m_sqMap == MAP_FAILED)
+    {
+      m_sqMap = NULL;
+      Close();
+      return false;
+    }
+
+    if(m_cqMapSize)
+    {
+      m_cqMap = mmap(NULL, m_cqMapSize, PROT_READ | PROT_WRITE,
+          MAP_SHARED | MAP_POPULATE, m_fd, IORING_OFF_CQ_RING);
+
+      if(m_cqMap == MAP_FAILED)
+      {
+        m_cqMap = NULL;
+        Close();
+        return false;
+      }
+    }
+    else
+    {
+      m_cqMap = m_sqMap;
+    }
+
+    m_sqEntries = params.sq_entries;
+    m_sqes = mmap(NULL, m_sqEntries * sizeof(struct io_uring_sqe),
+        PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, m_fd,
+        IORING_OFF_SQES);
+
+    if(m_sqes == MAP_FAILED)
+    {
+      m_sqes = NULL;
+      Close();
+      return false;
+    }
+
+    sq = static_cast<char*>(m_sqMap);
+    cq = static_cast<char*>(m_cqMap);
+    m_sqHead = reinterpret_cast<unsigned int*>(sq + params.sq_off.head);
+    m_sqTail = reinterpret_cast<unsigned int*>(sq + params.sq_off.tail);
+    m_sqArray = reinterpret_cast<unsigned int*>(sq + params.sq_off.array);
+    m_sqMask = *reinterpret_cast<unsigned int*>(sq + params.sq_off.ring_mask);
+    m_cqHead = reinterpret_cast<unsigned int*>(cq + params.cq_off.head);
+    m_cqTail = reinterpret_cast<unsigned int*>(cq + params.cq_off.tail);
+    m_cqMask = *reinterpret_cast<unsigned int*>(cq + params.cq_off.ring_mask);
+    m_cqes = cq + params.cq_off.cqes;
+
+    /* provided buffers, the ring of buffer descriptors is shared with the
+     * kernel which picks one for each receive
+     */
+    m_bufferCount = buffers;
+    m_bufferSize = bufferSize;
+    m_bufRingSize = buffers * sizeof(struct io_uring_buf);
+    m_bufRing = mmap(NULL, m_bufRingSize, PROT_READ | PROT_WRITE,
+        MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    m_buffers = static_cast<char*>(mmap(NULL, buffers * bufferSize,
+          PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0));
+
+    if(m_bufRing == MAP_FAILED || m_buffers == MAP_FAILED)
+    {
+      m_bufRing = m_bufRing == MAP_FAILED ? NULL : m_bufRing;
+      m_buffers = m_buffers == MAP_FAILED ? NULL : m_buffers;
+      Close();
+      return false;
+    }
+
+    memset(&reg, 0x00, sizeof(reg));
+    reg.ring_addr = (uint64_t)(uintptr_t)m_bufRing;
+    reg.ring_entries = buffers;
+    reg.bgid = BUFFER_GROUP;
+
+    if(syscall(__NR_io_uring_register, m_fd, IORING_REGISTER_PBUF_RING, &reg,
+          1) < 0)
+    {
+      Close();
+      return false;
+    }
+
+    for(unsigned int i = 0 ; i < buffers ; i++)
+    {
+      ReleaseBuffer(i);
+    }
+
+    return true;
+#else
+    (void)entries;
+    (void)buffers;
+    (void)bufferSize;
+    return false;
+#endif
+  }
+
+  void Ring::Close()
+  {
+#ifdef URING_AVAILABLE
+    /* closing the descriptor cancels the requests in flight */
+    if(m_fd != -1)
+    {
+      ::close(m_fd);
+    }
+
+    if(m_sqes)
+    {
+      munmap(m_sqes, m_sqEntries * sizeof(struct io_uring_sqe));
+    }
+
+    if(m_cqMap && m_cqMap != m_sqMap)
+    {
+      munmap(m_cqMap, m_cqMapSize);
+    }
+
+    if(m_sqMap)
+    {
+      munmap(m_sqMap, m_sqMapSize);
+    }
+
+    if(m_bufRing)
+    {
+      munmap(m_bufRing, m_bufRingSize);
+    }
+
+    if(m_buffers)
+    {
+      munmap(m_buffers, m_bufferCount * m_bufferSize);
+    }
+#endif
+
+    m_fd = -1;
+    m_sqMap = NULL;
+    m_cqMap = NULL;
+    m_sqes = NULL;
+    m_bufRing = NULL;
+    m_buffers = NULL;
+    m_queued = 0;
+  }
+
+  bool Ring::IsOpen() const
+  {
+    return m_fd != -1;
+  }
+
+  bool Ring::Accept(int fd, uint64_t data)
+  {
+#ifdef URING_AVAILABLE
+    struct io_uring_sqe* sqe = static_cast<struct io_uring_sqe*>(GetEntry());
+
+    if(sqe == NULL)
+    {
+      return false;
+    }
+
+    sqe->opcode = IORING_OP_ACCEPT;
+    sqe->fd = fd;
+    sqe->ioprio = IORING_ACCEPT_MULTISHOT;
+    sqe->user_data = data;
+    Queue();
+    return true;
+#else
+    (void)fd;
+    (void)data;
+    return false;
+#endif
+  }
+
+  bool Ring::Recv(int fd, uint64_t data)
+  {
+#ifdef URING_AVAILABLE
+    struct io_uring_sqe* sqe = static_cast<struct io_uring_sqe*>(GetEntry());
+
+    if(sqe == NULL)
+    {
+      return false;
+    }
+
+    sqe->opcode = IORING_OP_RECV;
+    sqe->fd = fd;
+    sqe->ioprio = IORING_RECV_MULTISHOT;
+    sqe->flags = IOSQE_BUFFER_SELECT;
+    sqe->buf_group = BUFFER_GROUP;
+    sqe->user_data = data;
+    Queue();
+    return true;
+#else
+    (void)fd;
+    (void)data;
+    return false;
+#endif
+  }
+
+  bool Ring::Send(int fd, const char* buf, size_t size, uint64_t data)
+  {
+#ifdef URING_AVAILABLE
+    struct io_uring_sqe* sqe = static_cast<struct io_uring_sqe*>(GetEntry());
+
+    if(sqe == NULL)
+    {
+      return false;
+    }
+
+    sqe->opcode = IORING_OP_SEND;
+    sqe->fd = fd;
+    sqe->addr = (uint64_t)(uintptr_t)buf;
+    sqe->len = size;
+    sqe->msg_flags = MSG_NOSIGNAL;
+    sqe->user_data = data;
+    Queue();
+    return true;
+#else
+    (void)fd;
+    (void)buf;
+    (void)size;
+    (void)data;
+    return false;
+#endif
+  }
+
+  bool Ring::Poll(int fd, uint64_t data)
+  {
+#ifdef URING_AVAILABLE
+    struct io_uring_sqe* sqe = static_cast<struct io_uring_sqe*>(GetEntry());
+
+    if(sqe == NULL)
+    {
+      return false;
+    }
+
+    sqe->opcode = IORING_OP_POLL_ADD;
+    sqe->fd = fd;
+    sqe->poll32_events = POLLIN;
+    sqe->len = IORING_POLL_ADD_MULTI;
+    sqe->user_data = data;
+    Queue();
+    return true;
+#else
+    (void)fd;
+    (void)data;
+    return false;
+#endif
+  }
+
+  bool Ring::Cancel(uint64_t target, uint64_t data)
+  {
+#ifdef URING_AVAILABLE
+    struct io_uring_sqe* sqe = static_cast<struct io_uring_sqe*>(GetEntry());
+
+    if(sqe == NULL)
+    {
+      return false;
+    }
+
+    sqe->opcode = IORING_OP_ASYNC_CANCEL;
+    sqe->fd = -1;
+    sqe->addr = target;
+    sqe->user_data = data;
+    Queue();
+    return true;
+#else
+    (void)target;
+    (void)data;
+    return false;
+#endif
+  }
+
+  bool Ring::Wait(uint32_t ms)
+  {
+#ifdef URING_AVAILABLE
+    /* completions already there are taken without waiting */
+    if(*m_cqHead != __atomic_load_n(m_cqTail, __ATOMIC_ACQUIRE))
+    {
+      return m_queued == 0 || Enter(0, 0);
+    }
+
+    return Enter(1, ms);
+#else
+    (void)ms;
+    return false;
+#endif
+  }
+
+  bool Ring::Next(Completion& completion)
+  {
+#ifdef URING_AVAILABLE
+    unsigned int head = *m_cqHead;
+    struct io_uring_cqe* cqe = NULL;
+
+    if(head == __atomic_load_n(m_cqTail, __ATOMIC_ACQUIRE))
+    {
+      return false;
+    }
+
+    cqe = static_cast<struct io_uring_cqe*>(m_cqes) + (head & m_cqMask);
+    completion.data = cqe->user_data;
+    completion.res = cqe->res;
+    completion.more = (cqe->flags & IORING_CQE_F_MORE) != 0;
+    completion.buffer = (cqe->flags & IORING_CQE_F_BUFFER) ?
+      (int)(cqe->flags >> IORING_CQE_BUFFER_SHIFT) : -1;
+
+    /* entry can be reused by the kernel once it is read */
+    __atomic_store_n(m_cqHead, head + 1, __ATOMIC_RELEASE);
+    return true;
+#else
+    (void)completion;
+    return false;
+#endif
+  }
+
+  const char* Ring::GetBuffer(int id) const
+  {
+    return m_buffers + id * m_bufferSize;
+  }
+
+  void Ring::ReleaseBuffer(int id)
+  {
+#ifdef URING_AVAILABLE
+    struct io_uring_buf* bufs = static_cast<struct io_uring_buf*>(m_bufRing);
+    /* the tail overlays the reserved field of the first descriptor */
+    unsigned short tail = bufs[0].resv;
+    struct io_uring_buf* buf = &bufs[tail & (m_bufferCount - 1)];
+
+    buf->addr = (uint64_t)(uintptr_t)(m_buffers + id * m_bufferSize);
+    buf->len = m_bufferSize;
+    buf->bid = id;
+
+    /* descriptor is written before the kernel can see it */
+    __atomic_store_n(&bufs[0].resv, (unsigned short)(tail + 1),
+        __ATOMIC_RELEASE);
+#else
+    (void)id;
+#endif
+  }
+
+  uint64_t Ring::GetEnterCount() const
+  {
+    return m_enters;
+  }
+
+  void* Ring::GetEntry()
+  {
+#ifdef URING_AVAILABLE
+    unsigned int tail = *m_sqTail;
+    struct io_uring_sqe* sqe = NULL;
+
+    if(tail - __atomic_load_n(m_sqHead, __ATOMIC_ACQUIRE) >= m_sqEntries &&
+        (!Enter(0, 0) ||
+         tail - __atomic_load_n(m_sqHead, __ATOMIC_ACQUIRE) >= m_sqEntries))
+    {
+      return NULL;
+    }
+
+    sqe = static_cast<struct io_uring_sqe*>(m_sqes) + (tail & m_sqMask);
+    memset(sqe, 0x00, sizeof(struct io_uring_sqe));
+    return sqe;
+#else
+    return NULL;
+#endif
+  }
+
+  void Ring::Queue()
+  {
+#ifdef URING_AVAILABLE
+    unsigned int tail = *m_sqTail;
+
+    m_sqArray[tail & m_sqMask] = tail & m_sqMask;
+
+    /* entry is written before the kernel can see it */
+    __atomic_store_n(m_sqTail, tail + 1, __ATOMIC_RELEASE);
+    m_queued++;
+#endif
+  }
+
+  bool Ring::Enter(unsigned int wait, uint32_t ms)
+  {
+#ifdef URING_AVAILABLE
+    struct io_uring_getevents_arg arg;
+    struct __kernel_timespec ts;
+    unsigned int flags = wait ? IORING_ENTER_GETEVENTS : 0;
+    int ret = 0;
+
+    memset(&arg, 0x00, sizeof(arg));
+
+    if(wait && ms)
+    {
+      ts.tv_sec = ms / 1000;
+      ts.tv_nsec = (ms % 1000) * 1000000;
+      arg.ts = (uint64_t)(uintptr_t)&ts;
+      flags |= IORING_ENTER_EXT_ARG;
+    }
+
+    ret = syscall(__NR_io_uring_enter, m_fd, m_queued, wait, flags,
+        (flags & IORING_ENTER_EXT_ARG) ? &arg : NULL,
+        (flags & IORING_ENTER_EXT_ARG) ? sizeof(arg) : 0);
+    m_enters++;
+
+    /* entries are submitted even if the wait times out */
+    m_queued = *m_sqTail - __atomic_load_n(m_sqHead, __ATOMIC_ACQUIRE);
+
+    return ret >= 0 || errno == ETIME || errno == EINTR || errno == EBUSY;
+#else
+    (void)wait;
+    (void)ms;
+    return false;
+#endif
+  }
+} /* namespace uring */
@@ -0,0 +1,374 @@
+/*
+ *  JsonRpc-Cpp - JSON-RPC implementation.
+ *  Copyright (C) 2008-2011 Sebastien Vincent <sebastien.vincent@cppextrem.com>
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+/**
+ * \file test-asyncclient.cpp
+ * \brief AsyncClient unit tests.
+ * \author Sebastien Vincent
+ */
+
+#include <poll.h>
+
+#include <cppunit/extensions/HelperMacros.h>
+
+#include "jsonrpc.h"
+
+namespace Json
+{
+  namespace Rpc
+  {
+    /**
+     * \var TEST_ASYNC_PORT
+     * \brief Port of the test server, run by the test itself.
+     */
+    static const uint16_t TEST_ASYNC_PORT = 8097;
+
+    /**
+     * \class TestAsyncCounter
+     * \brief Callback which counts its calls.
+     */
+    class TestAsyncCounter : public AsyncCallback
+    {
+      public:
+        /**
+         * \brief Constructor.
+         */
+        TestAsyncCounter()
+        {
+          m_count = 0;
+        }
+
+        /**
+         * \brief Called with the response.
+         * \param response JSON-RPC response
+         */
+        virtual void Done(Json::Value& response)
+        {
+          m_mutex.Lock();
+          m_count++;
+          m_response = response;
+          m_mutex.Unlock();
+        }
+
+        /**
+         * \brief Get the number of calls of Done().
+         * \return number of calls
+         */
+        int GetCount()
+        {
+          int ret = 0;
+
+          m_mutex.Lock();
+          ret = m_count;
+          m_mutex.Unlock();
+
+          return ret;
+        }
+
+        /**
+         * \brief Get if the last response is the error given when the
+         * connection is closed.
+         * \return true if connection closed error, false otherwise
+         */
+        bool IsClosed()
+        {
+          bool ret = false;
+
+          m_mutex.Lock();
+          ret = m_response.isMember("error") &&
+            m_response["error"]["code"] == CONNECTION_CLOSED;
+          m_mutex.Unlock();
+
+          return ret;
+        }
+
+      private:
+        /**
+         * \brief Number of calls of Done().
+         */
+        int m_count;
+
+        /**
+         * \brief Last response.
+         */
+        Json::Value m_response;
+
+        /**
+         * \brief Mutex to protect m_count and m_response.
+         */
+        system_util::Mutex m_mutex;
+    };
+
+    /**
+     * \class TestAsyncClient
+     * \brief Unit tests for AsyncClient.
+     *
+     * The server side is a plain socket handled by the test so that it can
+     * answer in any order or close the connection at any time.
+     */
+    class TestAsyncClient : public CppUnit::TestFixture
+    {
+      CPPUNIT_TEST_SUITE(Json::Rpc::TestAsyncClient);
+      CPPUNIT_TEST(testOutOfOrder);
+      CPPUNIT_TEST(testClose);
+      CPPUNIT_TEST(testPeerClose);
+      CPPUNIT_TEST(testSendFailure);
+      CPPUNIT_TEST_SUITE_END();
+
+      public:
+        /**
+         * \brief Initialize data before launching test.
+         */
+        void setUp()
+        {
+          m_sock = networking::bind(networking::TCP, "127.0.0.1",
+              TEST_ASYNC_PORT, NULL, NULL);
+          CPPUNIT_ASSERT(m_sock != -1 && listen(m_sock, 5) == 0);
+        }
+
+        /**
+         * \brief Cleanup data after test finished.
+         */
+        void tearDown()
+        {
+          ::close(m_sock);
+        }
+
+        /**
+         * \brief Test that responses sent in the reverse order of the
+         * requests reach the callback of their call.
+         */
+        void testOutOfOrder()
+        {
+          static const int count = 3;
+          AsyncClient client("127.0.0.1", TEST_ASYNC_PORT);
+          AsyncResult results[count];
+          std::vector<Json::Value> requests;
+          Json::FastWriter writer;
+          std::string data;
+          int fd = -1;
+
+          CPPUNIT_ASSERT(client.Connect());
+          CPPUNIT_ASSERT((fd = Accept()) != -1);
+
+          for(int i = 0 ; i < count ; i++)
+          {
+            CPPUNIT_ASSERT(client.Call("echo", i, results[i]));
+          }
+
+          CPPUNIT_ASSERT(ReadRequests(fd, count, requests));
+
+          for(int i = count - 1 ; i >= 0 ; i--)
+          {
+            Json::Value response;
+
+            response["jsonrpc"] = "2.0";
+            response["id"] = requests[i]["id"];
+            response["result"] = requests[i]["params"];
+            data += writer.write(response);
+          }
+          CPPUNIT_ASSERT(::send(fd, data.data(), data.length(), 0) ==
+              (ssize_t)data.length());
+
+          for(int i = 0 ; i < count ; i++)
+          {
+            CPPUNIT_ASSERT(results[i].Wait()["result"] == i);
+          }
+          CPPUNIT_ASSERT(client.GetPendingCount() == 0);
+
+          client.Close();
+          ::close(fd);
+        }
+
+        /**
+         * \brief Test that Close() fails each pending call once.
+         */
+        void testClose()
+        {
+          AsyncClient client("127.0.0.1", TEST_ASYNC_PORT);
+          TestAsyncCounter counter;
+          TestAsyncCounter counter2;
+          int fd = -1;
+
+          CPPUNIT_ASSERT(client.Connect());
+          CPPUNIT_ASSERT((fd = Accept()) != -1);
+          CPPUNIT_ASSERT(client.Call("echo", 1, counter));
+          CPPUNIT_ASSERT(client.Call("echo", 2, counter2));
+
+          client.Close();
+          CPPUNIT_ASSERT(counter.GetCount() == 1 && counter.IsClosed());
+          CPPUNIT_ASSERT(counter2.GetCount() == 1 && counter2.IsClosed());
+          CPPUNIT_ASSERT(!client.IsConnected());
+          CPPUNIT_ASSERT(client.GetPendingCount() == 0);
+
+          /* nothing left to fail */
+          client.Close();
+          CPPUNIT_ASSERT(counter.GetCount() == 1);
+          CPPUNIT_ASSERT(counter2.GetCount() == 1);
+          CPPUNIT_ASSERT(!client.Call("echo", 3, counter));
+
+          ::close(fd);
+        }
+
+        /**
+         * \brief Test that a connection closed by the server fails each
+         * pending call once, before and after Close().
+         */
+        void testPeerClose()
+        {
+          AsyncClient client("127.0.0.1", TEST_ASYNC_PORT);
+          TestAsyncCounter counter;
+          TestAsyncCounter counter2;
+          std::vector<Json::Value> requests;
+          int fd = -1;
+
+          CPPUNIT_ASSERT(client.Connect());
+          CPPUNIT_ASSERT((fd = Accept()) != -1);
+          CPPUNIT_ASSERT(client.Call("echo", 1, counter));
+          CPPUNIT_ASSERT(client.Call("echo", 2, counter2));
+          CPPUNIT_ASSERT(ReadRequests(fd, 2, requests));
+          ::close(fd);
+
+          for(int i = 0 ; i < 100 && client.IsConnected() ; i++)
+          {
+            system_util::msleep(10);
+          }
+          CPPUNIT_ASSERT(!client.IsConnected());
+          CPPUNIT_ASSERT(counter.GetCount() == 1 && counter.IsClosed());
+          CPPUNIT_ASSERT(counter2.GetCount() == 1 && counter2.IsClosed());
+
+          client.Close();
+          CPPUNIT_ASSERT(counter.GetCount() == 1);
+          CPPUNIT_ASSERT(counter2.GetCount() == 1);
+        }
+
+        /**
+         * \brief Test calls sent while the reader sees the end of the
+         * connection: a call which returns true gets one response, a call
+         * which returns false gets none.
+         */
+        void testSendFailure()
+        {
+          static const int count = 50;
+          AsyncClient client("127.0.0.1", TEST_ASYNC_PORT);
+          TestAsyncCounter counters[count];
+          bool sent[count];
+          bool once = true;
+          int fd = -1;
+
+          CPPUNIT_ASSERT(client.Connect());
+          CPPUNIT_ASSERT((fd = Accept()) != -1);
+          ::close(fd);
+
+          for(int i = 0 ; i < count ; i++)
+          {
+            sent[i] = client.Call("echo", i, counters[i]);
+          }
+
+          /* the failed sends or the reader have ended the connection */
+          for(int i = 0 ; i < 100 && client.IsConnected() ; i++)
+          {
+            system_util::msleep(10);
+          }
+          CPPUNIT_ASSERT(!client.IsConnected());
+          client.Close();
+
+          for(int i = 0 ; i < count ; i++)
+          {
+            once = once && counters[i].GetCount() == (sent[i] ? 1 : 0);
+          }
+          CPPUNIT_ASSERT(once);
+          CPPUNIT_ASSERT(client.GetPendingCount() == 0);
+        }
+
+      private:
+        /**
+         * \brief Accept the connection of the client.
+         * \return socket descriptor or -1 if none
+         */
+        int Accept()
+        {
+          struct pollfd pfd;
+
+          pfd.fd = m_sock;
+          pfd.events = POLLIN;
+
+          if(poll(&pfd, 1, 1000) != 1)
+          {
+            return -1;
+          }
+
+          return ::accept(m_sock, NULL, NULL);
+        }
+
+        /**
+         * \brief Read requests from the client.
+         * \param fd socket descriptor
+         * \param count number of requests
+         * \param requests requests read
+         * \return true if success, false otherwise
+         */
+        bool ReadRequests(int fd, size_t count,
+            std::vector<Json::Value>& requests)
+        {
+          Framer framer(RAW);
+          Json::Reader reader;
+          struct pollfd pfd;
+          char buf[1024];
+          std::string msg;
+
+          pfd.fd = fd;
+          pfd.events = POLLIN;
+
+          while(requests.size() < count)
+          {
+            Json::Value request;
+            ssize_t nb = -1;
+
+            if(framer.Next(msg) == 1)
+            {
+              if(!reader.parse(msg, request))
+              {
+                return false;
+              }
+
+              requests.push_back(request);
+              continue;
+            }
+
+            if(poll(&pfd, 1, 1000) != 1 ||
+                (nb = ::recv(fd, buf, sizeof(buf), 0)) <= 0)
+            {
+              return false;
+            }
+
+            framer.Feed(buf, nb);
+          }
+
+          return true;
+        }
+
+        /**
+         * \brief Listen socket of the test server.
+         */
+        int m_sock;
+    };
+  } /* namespace Rpc */
+} /* namespace Json */
+
+/* add the test suite in the global registry */
+CPPUNIT_TEST_SUITE_REGISTRATION(Json::Rpc::TestAsyncClient);
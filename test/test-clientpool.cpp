@@ -0,0 +1,445 @@
+/*
+ *  JsonRpc-Cpp - JSON-RPC implementation.
+ *  Copyright (C) 2008-2011 Sebastien Vincent <sebastien.vincent@cppextrem.com>
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+/**
+ * \file test-clientpool.cpp
+ * \brief ClientPool unit tests.
+ * \author Sebastien Vincent
+ */
+
+#include <sys/socket.h>
+
+#include <cppunit/extensions/HelperMacros.h>
+
+#include "jsonrpc.h"
+
+namespace Json
+{
+  namespace Rpc
+  {
+    /**
+     * \var TEST_POOL_PORT
+     * \brief Port of the TcpServer used by the tests.
+     */
+    static const uint16_t TEST_POOL_PORT = 8095;
+
+    /**
+     * \var TEST_POOL_CLOSED_PORT
+     * \brief Port without server.
+     */
+    static const uint16_t TEST_POOL_CLOSED_PORT = 8096;
+
+    /**
+     * \class TestPoolRpc
+     * \brief RPC methods called through the pool.
+     */
+    class TestPoolRpc
+    {
+      public:
+        /**
+         * \brief Reply with the parameters.
+         * \param root JSON-RPC request
+         * \param response JSON-RPC response
+         * \return true
+         */
+        bool Echo(const Json::Value& root, Json::Value& response)
+        {
+          response["jsonrpc"] = "2.0";
+          response["id"] = root["id"];
+          response["result"] = root["params"];
+          return true;
+        }
+    };
+
+    /**
+     * \class TestPoolCaller
+     * \brief Call through a pool from another thread.
+     */
+    class TestPoolCaller
+    {
+      public:
+        /**
+         * \brief Constructor.
+         * \param pool pool
+         * \param params parameters of the echo call
+         */
+        TestPoolCaller(ClientPool& pool, const Json::Value& params)
+          : m_pool(pool), m_params(params)
+        {
+          m_ret = false;
+          m_done = false;
+        }
+
+        /**
+         * \brief Send the call.
+         * \param arg unused
+         * \return NULL
+         */
+        void* Run(void* arg)
+        {
+          bool ret = false;
+
+          (void)arg;
+
+          ret = m_pool.Call("echo", m_params, m_result);
+
+          m_mutex.Lock();
+          m_ret = ret;
+          m_done = true;
+          m_mutex.Unlock();
+
+          return NULL;
+        }
+
+        /**
+         * \brief Get if Run() has returned.
+         * \return true if returned, false otherwise
+         */
+        bool IsDone()
+        {
+          bool ret = false;
+
+          m_mutex.Lock();
+          ret = m_done;
+          m_mutex.Unlock();
+
+          return ret;
+        }
+
+        /**
+         * \brief Get if the call has been sent (once Run() has returned).
+         * \return true if sent, false otherwise
+         */
+        bool IsSent()
+        {
+          bool ret = false;
+
+          m_mutex.Lock();
+          ret = m_ret;
+          m_mutex.Unlock();
+
+          return ret;
+        }
+
+      private:
+        /**
+         * \brief Pool.
+         */
+        ClientPool& m_pool;
+
+        /**
+         * \brief Parameters of the call.
+         */
+        const Json::Value& m_params;
+
+        /**
+         * \brief Response of the call.
+         */
+        AsyncResult m_result;
+
+        /**
+         * \brief Return value of the call.
+         */
+        bool m_ret;
+
+        /**
+         * \brief If Run() has returned.
+         */
+        bool m_done;
+
+        /**
+         * \brief Mutex to protect m_ret and m_done.
+         */
+        system_util::Mutex m_mutex;
+    };
+
+    /**
+     * \class TestPoolStopper
+     * \brief Stop a pool from another thread.
+     */
+    class TestPoolStopper
+    {
+      public:
+        /**
+         * \brief Constructor.
+         * \param pool pool
+         */
+        TestPoolStopper(ClientPool& pool) : m_pool(pool)
+        {
+        }
+
+        /**
+         * \brief Stop the pool.
+         * \param arg unused
+         * \return NULL
+         */
+        void* Run(void* arg)
+        {
+          (void)arg;
+
+          m_pool.Stop();
+          return NULL;
+        }
+
+      private:
+        /**
+         * \brief Pool.
+         */
+        ClientPool& m_pool;
+    };
+
+    /**
+     * \class TestClientPool
+     * \brief Unit tests for ClientPool with a loopback TcpServer.
+     *
+     * The server is run by the test thread, between the calls.
+     */
+    class TestClientPool : public CppUnit::TestFixture
+    {
+      CPPUNIT_TEST_SUITE(Json::Rpc::TestClientPool);
+      CPPUNIT_TEST(testLeastLoaded);
+      CPPUNIT_TEST(testMiss);
+      CPPUNIT_TEST(testReplace);
+      CPPUNIT_TEST(testStop);
+      CPPUNIT_TEST_SUITE_END();
+
+      public:
+        /**
+         * \brief Initialize data before launching test.
+         */
+        void setUp()
+        {
+          m_server = new TcpServer("127.0.0.1", TEST_POOL_PORT);
+          m_server->AddMethod(new RpcMethod<TestPoolRpc>(m_obj,
+                &TestPoolRpc::Echo, std::string("echo")));
+          CPPUNIT_ASSERT(m_server->Bind() && m_server->Listen());
+        }
+
+        /**
+         * \brief Cleanup data after test finished.
+         */
+        void tearDown()
+        {
+          delete m_server;
+          m_server = NULL;
+        }
+
+        /**
+         * \brief Test that calls go on the connection with the fewest
+         * calls pending and are counted as hits.
+         */
+        void testLeastLoaded()
+        {
+          ClientPool pool("127.0.0.1", TEST_POOL_PORT, 2);
+          AsyncResult result;
+          AsyncResult result2;
+          int closed = 0;
+
+          CPPUNIT_ASSERT(pool.Start());
+          CPPUNIT_ASSERT(Accept(2));
+
+          /* not answered yet, each call keeps its connection loaded */
+          CPPUNIT_ASSERT(pool.Call("echo", 1, result));
+          CPPUNIT_ASSERT(pool.Call("echo", 2, result2));
+          CPPUNIT_ASSERT(pool.GetHitCount() == 2);
+          CPPUNIT_ASSERT(pool.GetMissCount() == 0);
+
+          /* only the call sent on this connection fails */
+          shutdown(m_server->GetClients().front(), SHUT_RDWR);
+          CPPUNIT_ASSERT(Serve(result) && Serve(result2));
+
+          closed += IsClosed(result.Wait()) ? 1 : 0;
+          closed += IsClosed(result2.Wait()) ? 1 : 0;
+          CPPUNIT_ASSERT(closed == 1);
+          CPPUNIT_ASSERT(IsClosed(result.Wait()) ||
+              result.Wait()["result"] == 1);
+          CPPUNIT_ASSERT(IsClosed(result2.Wait()) ||
+              result2.Wait()["result"] == 2);
+        }
+
+        /**
+         * \brief Test that a call which cannot open a connection fails and
+         * is counted as a miss.
+         */
+        void testMiss()
+        {
+          ClientPool pool("127.0.0.1", TEST_POOL_CLOSED_PORT, 1);
+          AsyncResult result;
+
+          CPPUNIT_ASSERT(!pool.Start());
+          CPPUNIT_ASSERT(!pool.Call("echo", 1, result));
+          CPPUNIT_ASSERT(pool.GetHitCount() == 0);
+          CPPUNIT_ASSERT(pool.GetMissCount() == 1);
+        }
+
+        /**
+         * \brief Test that the connections closed by the server are
+         * replaced and used again.
+         */
+        void testReplace()
+        {
+          ClientPool pool("127.0.0.1", TEST_POOL_PORT, 2);
+          AsyncResult result;
+          AsyncResult result2;
+          std::list<int> clients;
+
+          CPPUNIT_ASSERT(pool.Start());
+          CPPUNIT_ASSERT(Accept(2));
+
+          clients = m_server->GetClients();
+          for(std::list<int>::iterator it = clients.begin() ;
+              it != clients.end() ; it++)
+          {
+            shutdown((*it), SHUT_RDWR);
+          }
+
+          /* done by the maintenance thread */
+          for(int i = 0 ; i < 200 && pool.GetReconnectCount() < 2 ; i++)
+          {
+            m_server->WaitMessage(10);
+          }
+          CPPUNIT_ASSERT(pool.GetReconnectCount() >= 2);
+
+          CPPUNIT_ASSERT(pool.Call("echo", 1, result));
+          CPPUNIT_ASSERT(pool.Call("echo", 2, result2));
+          CPPUNIT_ASSERT(Serve(result) && Serve(result2));
+          CPPUNIT_ASSERT(result.Wait()["result"] == 1);
+          CPPUNIT_ASSERT(result2.Wait()["result"] == 2);
+        }
+
+        /**
+         * \brief Test that Stop() wakes a call waiting for a connection.
+         *
+         * The only connection is closed by the server while a call is
+         * blocked sending to it (the server does not read), the next call
+         * has to wait for it.
+         */
+        void testStop()
+        {
+          ClientPool pool("127.0.0.1", TEST_POOL_PORT, 1);
+          Json::Value big(std::string(12 * 1024 * 1024, 'a'));
+          Json::Value small(1);
+          TestPoolCaller sender(pool, big);
+          TestPoolCaller waiter(pool, small);
+          TestPoolStopper stopper(pool);
+          system_util::Thread senderThread(
+              new system_util::ThreadArgImpl<TestPoolCaller>(sender,
+                &TestPoolCaller::Run, NULL));
+          system_util::Thread waiterThread(
+              new system_util::ThreadArgImpl<TestPoolCaller>(waiter,
+                &TestPoolCaller::Run, NULL));
+          system_util::Thread stopThread(
+              new system_util::ThreadArgImpl<TestPoolStopper>(stopper,
+                &TestPoolStopper::Run, NULL));
+          bool waiting = false;
+          bool woken = false;
+
+          CPPUNIT_ASSERT(pool.Start());
+          CPPUNIT_ASSERT(Accept(1));
+          CPPUNIT_ASSERT(senderThread.Start(false));
+          system_util::msleep(200);
+
+          /* the reader sees the end of the connection, the sender still
+           * holds it
+           */
+          shutdown(m_server->GetClients().front(), SHUT_WR);
+          system_util::msleep(200);
+
+          CPPUNIT_ASSERT(waiterThread.Start(false));
+          system_util::msleep(200);
+          waiting = !waiter.IsDone();
+
+          CPPUNIT_ASSERT(stopThread.Start(false));
+          for(int i = 0 ; i < 100 && !waiter.IsDone() ; i++)
+          {
+            system_util::msleep(10);
+          }
+          woken = waiter.IsDone() && !waiter.IsSent();
+
+          /* the server reads, the sender returns and Stop() ends */
+          for(int i = 0 ; i < 500 && !sender.IsDone() ; i++)
+          {
+            m_server->WaitMessage(10);
+          }
+
+          senderThread.Join();
+          waiterThread.Join();
+          stopThread.Join();
+
+          CPPUNIT_ASSERT(waiting);
+          CPPUNIT_ASSERT(woken);
+        }
+
+      private:
+        /**
+         * \brief Accept the connections of the pool.
+         * \param count number of connections
+         * \return true if accepted, false otherwise
+         */
+        bool Accept(size_t count)
+        {
+          for(int i = 0 ; i < 20 && m_server->GetClients().size() < count ;
+              i++)
+          {
+            m_server->WaitMessage(100);
+          }
+
+          return m_server->GetClients().size() == count;
+        }
+
+        /**
+         * \brief Run the server until a result is ready.
+         * \param result result of the call
+         * \return true if ready, false otherwise
+         */
+        bool Serve(AsyncResult& result)
+        {
+          for(int i = 0 ; i < 200 && !result.IsReady() ; i++)
+          {
+            m_server->WaitMessage(10);
+          }
+
+          return result.IsReady();
+        }
+
+        /**
+         * \brief Get if a response is the error given when the connection
+         * is closed.
+         * \param response response
+         * \return true if connection closed error, false otherwise
+         */
+        bool IsClosed(const Json::Value& response)
+        {
+          return response.isMember("error") &&
+            response["error"]["code"] == CONNECTION_CLOSED;
+        }
+
+        /**
+         * \brief Server.
+         */
+        TcpServer* m_server;
+
+        /**
+         * \brief RPC methods.
+         */
+        TestPoolRpc m_obj;
+    };
+  } /* namespace Rpc */
+} /* namespace Json */
+
+/* add the test suite in the global registry */
+CPPUNIT_TEST_SUITE_REGISTRATION(Json::Rpc::TestClientPool);
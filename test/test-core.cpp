@@ -63,6 +63,36 @@ namespace Json
           response = Json::Value::null;
           return true;
         }
+
+        /**
+         * \brief Reply with an error.
+         * \param root JSON-RPC request
+         * \param response JSON-RPC response
+         * \return true if correctly processed, false otherwise
+         */
+        bool Fail(const Json::Value& root, Json::Value& response)
+        {
+          response["jsonrpc"] = "2.0";
+          response["id"] = root["id"];
+          response["error"]["code"] = INTERNAL_ERROR;
+          response["error"]["message"] = "failure";
+          return true;
+        }
+
+        /**
+         * \brief Reply with the id after 50 ms.
+         * \param root JSON-RPC request
+         * \param response JSON-RPC response
+         * \return true if correctly processed, false otherwise
+         */
+        bool Slow(const Json::Value& root, Json::Value& response)
+        {
+          system_util::msleep(50);
+          response["jsonrpc"] = "2.0";
+          response["id"] = root["id"];
+          response["result"] = root["id"];
+          return true;
+        }
     };
 
     /**
@@ -73,11 +103,18 @@ namespace Json
     {
       CPPUNIT_TEST_SUITE(Json::Rpc::TestCore);
       CPPUNIT_TEST(testMethod);
+      CPPUNIT_TEST(testMethodRegistry);
+      CPPUNIT_TEST(testExecutionHint);
+      CPPUNIT_TEST(testCannedErrors);
+      CPPUNIT_TEST(testDescribeCache);
       CPPUNIT_TEST(testBatchedCall);
+      CPPUNIT_TEST(testParallelBatchedCall);
       CPPUNIT_TEST(testBatchedCallParsing);
       CPPUNIT_TEST(testJsonRpcParsing);
       CPPUNIT_TEST(testJsonRpcId);
       CPPUNIT_TEST(testJsonRpcVersion);
+      CPPUNIT_TEST(testLatencyHistogram);
+      CPPUNIT_TEST(testStats);
       CPPUNIT_TEST_SUITE_END();
        
       public:
@@ -118,6 +155,174 @@ namespace Json
           CPPUNIT_ASSERT(m_handler->Process(str, response) == false);
         }
 
+        /**
+         * \brief Test lookup with a lot of methods, duplicates and removal.
+         */
+        void testMethodRegistry()
+        {
+          TestRpc obj;
+          Json::Value response;
+          char name[32];
+          size_t i = 0;
+
+          for(i = 0 ; i < 1000 ; i++)
+          {
+            snprintf(name, sizeof(name), "method%lu", (unsigned long)i);
+            m_handler->AddMethod(new Json::Rpc::RpcMethod<TestRpc>(obj,
+                  &TestRpc::Print, std::string(name)));
+          }
+
+          /* remove one method out of two */
+          for(i = 0 ; i < 1000 ; i += 2)
+          {
+            snprintf(name, sizeof(name), "method%lu", (unsigned long)i);
+            m_handler->DeleteMethod(std::string(name));
+          }
+
+          CPPUNIT_ASSERT(m_handler->Process(std::string("{\"id\":1, \"jsonrpc\":\"2.0\", \"method\":\"method998\"}"), response) == false);
+          CPPUNIT_ASSERT(m_handler->Process(std::string("{\"id\":1, \"jsonrpc\":\"2.0\", \"method\":\"method999\"}"), response) == true);
+          CPPUNIT_ASSERT(m_handler->Process(std::string("{\"id\":1, \"jsonrpc\":\"2.0\", \"method\":\"system.describe\"}"), response) == true);
+          CPPUNIT_ASSERT(response["result"].size() == 501);
+
+          /* the first method registered with a name is called first */
+          m_handler->AddMethod(new Json::Rpc::RpcMethod<TestRpc>(obj,
+                &TestRpc::Notify, std::string("method0")));
+          m_handler->AddMethod(new Json::Rpc::RpcMethod<TestRpc>(obj,
+                &TestRpc::Print, std::string("method0")));
+
+          response = Json::Value::null;
+          CPPUNIT_ASSERT(m_handler->Process(std::string("{\"id\":1, \"jsonrpc\":\"2.0\", \"method\":\"method0\"}"), response) == true);
+          CPPUNIT_ASSERT(response == Json::Value::null);
+
+          m_handler->DeleteMethod(std::string("method0"));
+          CPPUNIT_ASSERT(m_handler->Process(std::string("{\"id\":1, \"jsonrpc\":\"2.0\", \"method\":\"method0\"}"), response) == true);
+          CPPUNIT_ASSERT(response["result"] == "success");
+        }
+
+        /**
+         * \brief Test that pre-serialized errors are the same as the
+         * serialization of the errors built as Json::Value.
+         */
+        void testCannedErrors()
+        {
+          const char* requests[] = {
+            "{\"jsonrpc\":\"2.0\", \"method\":\"unknown\", \"id\":42}",
+            "{\"jsonrpc\":\"2.0\", \"method\":\"unknown\", \"id\":-7}",
+            "{\"jsonrpc\":\"2.0\", \"method\":\"unknown\", \"id\":\"a\\\"b\"}",
+            "{\"jsonrpc\":\"2.0\", \"method\":\"unknown\", \"id\":\"a\\u0000b\"}",
+            "{\"jsonrpc\":\"2.0\", \"method\":\"unknown\", \"id\":null}",
+            "{\"jsonrpc\":\"2.0\", \"method\":\"unknown\"}",
+            "{\"jsonrpc\":\"2.0\", \"method\":\"\", \"id\":1}",
+            "{\"jsonrpc\":\"1.0\", \"method\":\"print\", \"id\":1}",
+            "{\"jsonrpc\":\"2.0\", \"id\":1}"
+          };
+          Json::Reader reader;
+          Json::FastWriter writer;
+          std::string error;
+          Json::Value root;
+          Json::Value response;
+
+          CPPUNIT_ASSERT(m_handler->Parse(reader, "{\"jsonrpc\":", root, error) == false);
+          CPPUNIT_ASSERT(m_handler->Parse(reader, "{\"jsonrpc\":", root, response) == false);
+          CPPUNIT_ASSERT(error == writer.write(response));
+          CPPUNIT_ASSERT(error == m_handler->GetErrorString(PARSING_ERROR));
+
+          for(size_t i = 0 ; i < sizeof(requests) / sizeof(requests[0]) ; i++)
+          {
+            Json::Value expected;
+
+            CPPUNIT_ASSERT(m_handler->Parse(reader, requests[i], root, error));
+            CPPUNIT_ASSERT(error.empty());
+            CPPUNIT_ASSERT(m_handler->Process(root, expected) == false);
+            response = Json::Value::null;
+            CPPUNIT_ASSERT(m_handler->Process(root, response, error) == false);
+            CPPUNIT_ASSERT(response == Json::Value::null);
+            CPPUNIT_ASSERT(error == writer.write(expected));
+          }
+
+          CPPUNIT_ASSERT(error == m_handler->GetErrorString(INVALID_REQUEST));
+
+          /* valid request and batched call are not serialized */
+          CPPUNIT_ASSERT(m_handler->Parse(reader, "[{\"jsonrpc\":\"2.0\", \"method\":\"unknown\", \"id\":1}]", root, error));
+          CPPUNIT_ASSERT(m_handler->Process(root, response, error));
+          CPPUNIT_ASSERT(error.empty());
+          CPPUNIT_ASSERT(response[0u]["error"]["code"] == METHOD_NOT_FOUND);
+        }
+
+        /**
+         * \brief Test that cached system.describe follows the methods added
+         * and deleted.
+         */
+        void testDescribeCache()
+        {
+          const std::string str = "{\"jsonrpc\":\"2.0\", \"method\":\"system.describe\", \"id\":\"d\"}";
+          TestRpc obj;
+          Json::Reader reader;
+          Json::FastWriter writer;
+          std::string serialized;
+          Json::Value root;
+          Json::Value response;
+
+          CPPUNIT_ASSERT(reader.parse(str, root));
+          CPPUNIT_ASSERT(m_handler->Process(root, response));
+          CPPUNIT_ASSERT(response["result"].size() == 1);
+          CPPUNIT_ASSERT(m_handler->Process(root, response, serialized));
+          CPPUNIT_ASSERT(serialized == writer.write(response));
+
+          m_handler->AddMethod(new Json::Rpc::RpcMethod<TestRpc>(obj,
+                &TestRpc::Print, std::string("print")));
+
+          response = Json::Value::null;
+          CPPUNIT_ASSERT(m_handler->Process(root, response, serialized));
+          CPPUNIT_ASSERT(response == Json::Value::null);
+          CPPUNIT_ASSERT(reader.parse(serialized, response));
+          CPPUNIT_ASSERT(response["id"] == "d");
+          CPPUNIT_ASSERT(response["result"].size() == 2);
+          CPPUNIT_ASSERT(response["result"].isMember("print"));
+
+          m_handler->DeleteMethod("print");
+          response = Json::Value::null;
+          CPPUNIT_ASSERT(m_handler->Process(root, response));
+          CPPUNIT_ASSERT(response["result"].size() == 1);
+          CPPUNIT_ASSERT(m_handler->Process(root, response, serialized));
+          CPPUNIT_ASSERT(serialized == writer.write(response));
+        }
+
+        /**
+         * \brief Test execution hint of requests and batched calls.
+         */
+        void testExecutionHint()
+        {
+          TestRpc obj;
+          Json::Value root;
+          Json::Value response;
+          RpcMethod<TestRpc>* method = new Json::Rpc::RpcMethod<TestRpc>(obj,
+              &TestRpc::Notify, std::string("notify"));
+
+          method->SetExecutionHint(EXECUTE_INLINE);
+          m_handler->AddMethod(method);
+          m_handler->AddMethod(new Json::Rpc::RpcMethod<TestRpc>(obj,
+                &TestRpc::Print, std::string("print")));
+
+          CPPUNIT_ASSERT(m_handler->Parse("{\"jsonrpc\":\"2.0\", \"method\":\"notify\"}", root, response));
+          CPPUNIT_ASSERT(m_handler->GetExecutionHint(root) == EXECUTE_INLINE);
+
+          CPPUNIT_ASSERT(m_handler->Parse("{\"jsonrpc\":\"2.0\", \"method\":\"print\"}", root, response));
+          CPPUNIT_ASSERT(m_handler->GetExecutionHint(root) == EXECUTE_POOLED);
+
+          CPPUNIT_ASSERT(m_handler->Parse("[{\"jsonrpc\":\"2.0\", \"method\":\"notify\"}, {\"jsonrpc\":\"2.0\", \"method\":\"system.describe\"}]", root, response));
+          CPPUNIT_ASSERT(m_handler->GetExecutionHint(root) == EXECUTE_INLINE);
+
+          CPPUNIT_ASSERT(m_handler->Parse("[{\"jsonrpc\":\"2.0\", \"method\":\"notify\"}, {\"jsonrpc\":\"2.0\", \"method\":\"print\"}]", root, response));
+          CPPUNIT_ASSERT(m_handler->GetExecutionHint(root) == EXECUTE_POOLED);
+          CPPUNIT_ASSERT(m_handler->Process(root, response) == true);
+          CPPUNIT_ASSERT(response.size() == 1);
+
+          response = Json::Value::null;
+          CPPUNIT_ASSERT(m_handler->Parse("{\"jsonrpc\":", root, response) == false);
+          CPPUNIT_ASSERT(response["error"]["code"] == PARSING_ERROR);
+        }
+
         /**
          * \brief Test batched call.
          */
@@ -141,6 +346,60 @@ namespace Json
           CPPUNIT_ASSERT(response.size() == 1);
         }
 
+        /**
+         * \brief Test batched call executed by the batch pool.
+         */
+        void testParallelBatchedCall()
+        {
+          TestRpc obj;
+          Json::Value root;
+          Json::Value response;
+          struct timeval start;
+          struct timeval end;
+          long ms = 0;
+
+          m_handler->AddMethod(new Json::Rpc::RpcMethod<TestRpc>(obj,
+                &TestRpc::Slow, std::string("slow")));
+          m_handler->AddMethod(new Json::Rpc::RpcMethod<TestRpc>(obj,
+                &TestRpc::Notify, std::string("notify")));
+          CPPUNIT_ASSERT(m_handler->SetBatchPool(3, 0, 4));
+
+          /* 8 requests and 2 notifications, 4 at a time */
+          for(int i = 0 ; i < 10 ; i++)
+          {
+            root[i]["jsonrpc"] = "2.0";
+            root[i]["method"] = (i == 3 || i == 7) ? "notify" : "slow";
+            if(i != 3 && i != 7)
+            {
+              root[i]["id"] = i;
+            }
+          }
+
+          gettimeofday(&start, NULL);
+          CPPUNIT_ASSERT(m_handler->Process(root, response) == true);
+          gettimeofday(&end, NULL);
+          ms = (end.tv_sec - start.tv_sec) * 1000 + (end.tv_usec - start.tv_usec) / 1000;
+
+          CPPUNIT_ASSERT(ms < 300);
+          CPPUNIT_ASSERT(response.size() == 8);
+          for(Json::Value::ArrayIndex i = 0, id = 0 ; i < response.size() ; i++, id++)
+          {
+            id += (id == 3 || id == 7) ? 1 : 0;
+            CPPUNIT_ASSERT(response[i]["result"].asUInt() == id);
+          }
+
+          /* below the threshold, batch stays sequential */
+          root.resize(3);
+          response = Json::Value::null;
+          gettimeofday(&start, NULL);
+          CPPUNIT_ASSERT(m_handler->Process(root, response) == true);
+          gettimeofday(&end, NULL);
+          ms = (end.tv_sec - start.tv_sec) * 1000 + (end.tv_usec - start.tv_usec) / 1000;
+
+          CPPUNIT_ASSERT(ms >= 140);
+          CPPUNIT_ASSERT(response.size() == 3);
+        }
+
         /**
          * \brief Test batched call parsing.
          */
@@ -223,6 +482,106 @@ namespace Json
          * \brief Handler for JSON-RPC query.
          */
         Handler* m_handler;
+
+        /**
+         * \brief Test the buckets and percentiles of the latency histogram.
+         */
+        void testLatencyHistogram()
+        {
+          LatencyHistogram histogram;
+          LatencyHistogram other;
+          uint64_t previous = 0;
+
+          /* exact up to 15, then within 1/8 */
+          CPPUNIT_ASSERT(LatencyHistogram::GetBucket(0) == 0);
+          CPPUNIT_ASSERT(LatencyHistogram::GetUpperBound(
+                LatencyHistogram::GetBucket(15)) == 15);
+          CPPUNIT_ASSERT(LatencyHistogram::GetUpperBound(
+                LatencyHistogram::GetBucket(1000)) == 1023);
+          CPPUNIT_ASSERT(LatencyHistogram::GetBucket(~(uint64_t)0) ==
+              LATENCY_BUCKETS - 1);
+
+          for(size_t i = 0 ; i < LATENCY_BUCKETS ; i++)
+          {
+            uint64_t bound = LatencyHistogram::GetUpperBound(i);
+
+            CPPUNIT_ASSERT(i == 0 || bound > previous);
+            CPPUNIT_ASSERT(LatencyHistogram::GetBucket(bound) == i);
+            CPPUNIT_ASSERT(LatencyHistogram::GetBucket(bound + 1) ==
+                (i + 1 < LATENCY_BUCKETS ? i + 1 : i));
+            previous = bound;
+          }
+
+          CPPUNIT_ASSERT(histogram.GetPercentile(50.0) == 0);
+
+          for(uint64_t i = 1 ; i <= 100 ; i++)
+          {
+            histogram.Add(i * 1000);
+          }
+          other.Add(1000000);
+          histogram.Merge(other);
+
+          CPPUNIT_ASSERT(histogram.GetCount() == 101);
+          CPPUNIT_ASSERT(histogram.GetTotal() == 5050000 + 1000000);
+          CPPUNIT_ASSERT(histogram.GetPercentile(50.0) >= 50000);
+          CPPUNIT_ASSERT(histogram.GetPercentile(50.0) < 50000 * 9 / 8);
+          CPPUNIT_ASSERT(histogram.GetPercentile(100.0) >= 1000000);
+        }
+
+        /**
+         * \brief Test the statistics recorded by several threads and
+         * system.stats.
+         */
+        void testStats()
+        {
+          TestRpc obj;
+          Json::Value root;
+          Json::Value response;
+          std::vector<MethodStats> stats;
+
+          m_handler->GetStats(stats);
+          CPPUNIT_ASSERT(stats.empty());
+
+          m_handler->AddMethod(new Json::Rpc::RpcMethod<TestRpc>(obj,
+                &TestRpc::Slow, std::string("slow")));
+          m_handler->AddMethod(new Json::Rpc::RpcMethod<TestRpc>(obj,
+                &TestRpc::Fail, std::string("fail")));
+          m_handler->EnableStats();
+          CPPUNIT_ASSERT(m_handler->SetBatchPool(3, 0, 4));
+
+          /* executed by 4 threads */
+          for(int i = 0 ; i < 8 ; i++)
+          {
+            root[i]["jsonrpc"] = "2.0";
+            root[i]["method"] = (i % 4 == 3) ? "fail" : "slow";
+            root[i]["id"] = i;
+          }
+          CPPUNIT_ASSERT(m_handler->Process(root, response));
+
+          m_handler->DeleteMethod("system.stats");
+          m_handler->GetStats(stats);
+          CPPUNIT_ASSERT(stats.size() == 4);
+          CPPUNIT_ASSERT(stats[1].name == "slow");
+          CPPUNIT_ASSERT(stats[1].calls == 6);
+          CPPUNIT_ASSERT(stats[1].errors == 0);
+          CPPUNIT_ASSERT(stats[1].latency.GetCount() == 6);
+          CPPUNIT_ASSERT(stats[1].latency.GetPercentile(50.0) >= 50000000);
+          CPPUNIT_ASSERT(stats[2].name == "fail");
+          CPPUNIT_ASSERT(stats[2].calls == 2);
+          CPPUNIT_ASSERT(stats[2].errors == 2);
+
+          root = Json::Value::null;
+          response = Json::Value::null;
+          CPPUNIT_ASSERT(m_handler->Parse("{\"jsonrpc\":\"2.0\", \"method\":\"system.stats\", \"id\":1}", root, response));
+          CPPUNIT_ASSERT(m_handler->GetExecutionHint(root) == EXECUTE_INLINE);
+          CPPUNIT_ASSERT(m_handler->Process(root, response));
+          CPPUNIT_ASSERT(response["result"]["slow"]["calls"].asLargestUInt() == 6);
+          CPPUNIT_ASSERT(response["result"]["fail"]["errors"].asLargestUInt() == 2);
+          CPPUNIT_ASSERT(response["result"]["slow"]["p99_ns"].asLargestUInt() >=
+              response["result"]["slow"]["p50_ns"].asLargestUInt());
+          CPPUNIT_ASSERT(response["result"]["system.describe"]["calls"].asLargestUInt() ==
+              0);
+        }
     };
   } /* namespace Rpc */
 } /* namespace Json */
@@ -0,0 +1,236 @@
+/*
+ *  JsonRpc-Cpp - JSON-RPC implementation.
+ *  Copyright (C) 2008-2011 Sebastien Vincent <sebastien.vincent@cppextrem.com>
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**
+ * \file test-framer.cpp
+ * \brief Stream framer unit tests.
+ * \author Sebastien Vincent
+ */
+
+#include <cppunit/extensions/HelperMacros.h>
+
+#include "jsonrpc_framer.h"
+
+namespace Json
+{
+  namespace Rpc
+  {
+    /**
+     * \class TestFramer
+     * \brief Unit tests for Framer.
+     */
+    class TestFramer : public CppUnit::TestFixture
+    {
+      CPPUNIT_TEST_SUITE(Json::Rpc::TestFramer);
+      CPPUNIT_TEST(testRawPipelined);
+      CPPUNIT_TEST(testRawPartial);
+      CPPUNIT_TEST(testRawStrings);
+      CPPUNIT_TEST(testRawInvalid);
+      CPPUNIT_TEST(testNetstringPipelined);
+      CPPUNIT_TEST(testNetstringPartial);
+      CPPUNIT_TEST(testNetstringInvalid);
+      CPPUNIT_TEST(testMaxMessageSize);
+      CPPUNIT_TEST_SUITE_END();
+
+      public:
+        /**
+         * \brief Initialize data before launching test.
+         */
+        void setUp()
+        {
+        }
+
+        /**
+         * \brief Cleanup data after test finished.
+         */
+        void tearDown()
+        {
+        }
+
+        /**
+         * \brief Test several RAW messages received in one read.
+         */
+        void testRawPipelined()
+        {
+          const std::string str = "{\"id\":1}\n[{\"id\":2},{\"id\":3}] {\"id\":4}";
+          Framer framer(RAW);
+          std::string msg;
+
+          framer.Feed(str.c_str(), str.length());
+          CPPUNIT_ASSERT(framer.Next(msg) == 1);
+          CPPUNIT_ASSERT(msg == "{\"id\":1}");
+          CPPUNIT_ASSERT(framer.Next(msg) == 1);
+          CPPUNIT_ASSERT(msg == "[{\"id\":2},{\"id\":3}]");
+          CPPUNIT_ASSERT(framer.Next(msg) == 1);
+          CPPUNIT_ASSERT(msg == "{\"id\":4}");
+          CPPUNIT_ASSERT(framer.Next(msg) == 0);
+          CPPUNIT_ASSERT(framer.GetBufferedSize() == 0);
+        }
+
+        /**
+         * \brief Test a RAW message received byte per byte.
+         */
+        void testRawPartial()
+        {
+          const std::string str = "{\"method\":\"print\",\"params\":[1,{\"a\":2}]}{\"id\"";
+          Framer framer(RAW);
+          std::string msg;
+          size_t nb = 0;
+
+          for(size_t i = 0 ; i < str.length() ; i++)
+          {
+            framer.Feed(str.c_str() + i, 1);
+
+            while(framer.Next(msg) == 1)
+            {
+              nb++;
+              CPPUNIT_ASSERT(msg == str.substr(0, str.length() - 5));
+            }
+          }
+
+          CPPUNIT_ASSERT(nb == 1);
+          CPPUNIT_ASSERT(framer.GetBufferedSize() == 5);
+
+          framer.Feed(":5}", 3);
+          CPPUNIT_ASSERT(framer.Next(msg) == 1);
+          CPPUNIT_ASSERT(msg == "{\"id\":5}");
+        }
+
+        /**
+         * \brief Test that braces and quotes inside JSON strings are ignored.
+         */
+        void testRawStrings()
+        {
+          const std::string str = "{\"a\":\"}]{\\\"\\\\\"}{\"b\":\"\\\\\"}";
+          Framer framer(RAW);
+          std::string msg;
+
+          framer.Feed(str.c_str(), str.length());
+          CPPUNIT_ASSERT(framer.Next(msg) == 1);
+          CPPUNIT_ASSERT(msg == "{\"a\":\"}]{\\\"\\\\\"}");
+          CPPUNIT_ASSERT(framer.Next(msg) == 1);
+          CPPUNIT_ASSERT(msg == "{\"b\":\"\\\\\"}");
+        }
+
+        /**
+         * \brief Test that non JSON data is passed through (to get a
+         * parse error response).
+         */
+        void testRawInvalid()
+        {
+          const std::string str = "jsonrpc blabla\n{\"id\":1}";
+          Framer framer(RAW);
+          std::string msg;
+
+          framer.Feed(str.c_str(), str.length());
+          CPPUNIT_ASSERT(framer.Next(msg) == 1);
+          CPPUNIT_ASSERT(msg == "jsonrpc blabla\n");
+          CPPUNIT_ASSERT(framer.Next(msg) == 1);
+          CPPUNIT_ASSERT(msg == "{\"id\":1}");
+        }
+
+        /**
+         * \brief Test several netstrings received in one read.
+         */
+        void testNetstringPipelined()
+        {
+          const std::string str = "12:Hello World!,0:,3:abc,";
+          Framer framer(NETSTRING);
+          std::string msg;
+
+          framer.Feed(str.c_str(), str.length());
+          CPPUNIT_ASSERT(framer.Next(msg) == 1);
+          CPPUNIT_ASSERT(msg == "Hello World!");
+          CPPUNIT_ASSERT(framer.Next(msg) == 1);
+          CPPUNIT_ASSERT(msg == "");
+          CPPUNIT_ASSERT(framer.Next(msg) == 1);
+          CPPUNIT_ASSERT(msg == "abc");
+          CPPUNIT_ASSERT(framer.Next(msg) == 0);
+        }
+
+        /**
+         * \brief Test a netstring received in several reads.
+         */
+        void testNetstringPartial()
+        {
+          Framer framer(NETSTRING);
+          std::string msg;
+
+          framer.Feed("1", 1);
+          CPPUNIT_ASSERT(framer.Next(msg) == 0);
+          framer.Feed("2:Hello", 7);
+          CPPUNIT_ASSERT(framer.Next(msg) == 0);
+          framer.Feed(" World!", 7);
+          CPPUNIT_ASSERT(framer.Next(msg) == 0);
+          framer.Feed(",3", 2);
+          CPPUNIT_ASSERT(framer.Next(msg) == 1);
+          CPPUNIT_ASSERT(msg == "Hello World!");
+          CPPUNIT_ASSERT(framer.Next(msg) == 0);
+          CPPUNIT_ASSERT(framer.GetBufferedSize() == 1);
+        }
+
+        /**
+         * \brief Test invalid netstrings.
+         */
+        void testNetstringInvalid()
+        {
+          Framer framer(NETSTRING);
+          std::string msg;
+
+          /* missing ',' */
+          framer.Feed("12:Hello World!!", 16);
+          CPPUNIT_ASSERT(framer.Next(msg) == -1);
+
+          /* missing ':' */
+          framer.Reset();
+          framer.Feed("12Hello World!,", 15);
+          CPPUNIT_ASSERT(framer.Next(msg) == -1);
+
+          /* missing length */
+          framer.Reset();
+          framer.Feed(":Hello,", 7);
+          CPPUNIT_ASSERT(framer.Next(msg) == -1);
+        }
+
+        /**
+         * \brief Test that a too big message is rejected before it is
+         * completely received.
+         */
+        void testMaxMessageSize()
+        {
+          Framer framer(RAW);
+          Framer framer2(NETSTRING);
+          std::string msg;
+
+          framer.SetMaxMessageSize(8);
+          framer.Feed("{\"a\":\"", 6);
+          CPPUNIT_ASSERT(framer.Next(msg) == 0);
+          framer.Feed("abcdef", 6);
+          CPPUNIT_ASSERT(framer.Next(msg) == -1);
+
+          framer2.SetMaxMessageSize(8);
+          framer2.Feed("9", 1);
+          CPPUNIT_ASSERT(framer2.Next(msg) == -1);
+        }
+    };
+  } /* namespace Rpc */
+} /* namespace Json */
+
+/* add the test suite in the global registry */
+CPPUNIT_TEST_SUITE_REGISTRATION(Json::Rpc::TestFramer);
+
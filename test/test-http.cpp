@@ -0,0 +1,386 @@
+/*
+ *  JsonRpc-Cpp - JSON-RPC implementation.
+ *  Copyright (C) 2008-2011 Sebastien Vincent <sebastien.vincent@cppextrem.com>
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**
+ * \file test-http.cpp
+ * \brief HTTP framing and HttpServer unit tests.
+ * \author Sebastien Vincent
+ */
+
+#include <cstring>
+
+#include <cppunit/extensions/HelperMacros.h>
+
+#include "jsonrpc.h"
+#include "http.h"
+
+namespace http
+{
+  /**
+   * \var TEST_HTTP_SERVER_PORT
+   * \brief Port of the HttpServer used by the tests.
+   */
+  static const uint16_t TEST_HTTP_SERVER_PORT = 8088;
+
+  /**
+   * \class TestHttpRpc
+   * \brief RPC methods called through the HttpServer.
+   */
+  class TestHttpRpc
+  {
+    public:
+      /**
+       * \brief Reply with the id.
+       * \param root JSON-RPC request
+       * \param response JSON-RPC response
+       * \return true
+       */
+      bool Print(const Json::Value& root, Json::Value& response)
+      {
+        response["jsonrpc"] = "2.0";
+        response["id"] = root["id"];
+        response["result"] = root["id"];
+        return true;
+      }
+
+      /**
+       * \brief Notification.
+       * \param root JSON-RPC request
+       * \param response JSON-RPC response
+       * \return true
+       */
+      bool Notify(const Json::Value& root, Json::Value& response)
+      {
+        (void)root;
+        response = Json::Value::null;
+        return true;
+      }
+  };
+
+  /**
+   * \class TestHttp
+   * \brief Unit tests for HTTP framing and HttpServer.
+   */
+  class TestHttp : public CppUnit::TestFixture
+  {
+    CPPUNIT_TEST_SUITE(http::TestHttp);
+    CPPUNIT_TEST(testEncodingResponseHeader);
+    CPPUNIT_TEST(testDecoderPipelined);
+    CPPUNIT_TEST(testDecoderPartial);
+    CPPUNIT_TEST(testDecoderChunked);
+    CPPUNIT_TEST(testDecoderKeepAlive);
+    CPPUNIT_TEST(testDecoderContinue);
+    CPPUNIT_TEST_EXCEPTION(testDecoderTooBig, http::HttpException);
+    CPPUNIT_TEST_EXCEPTION(testDecoderInvalid, http::HttpException);
+    CPPUNIT_TEST(testServer);
+    CPPUNIT_TEST_SUITE_END();
+
+    public:
+      /**
+       * \brief Initialize data before launching test.
+       */
+      void setUp()
+      {
+      }
+
+      /**
+       * \brief Cleanup data after test finished.
+       */
+      void tearDown()
+      {
+      }
+
+      /**
+       * \brief Test if response headers are encoded as expected.
+       */
+      void testEncodingResponseHeader()
+      {
+        char header[http::MAX_HEADER_SIZE];
+        size_t len = 0;
+
+        len = http::encodeResponseHeader(200, 12, true, header);
+        CPPUNIT_ASSERT(std::string(header, len) == "HTTP/1.1 200 OK\r\n"
+            "Content-Type: application/json\r\nContent-Length: 12\r\n\r\n");
+
+        len = http::encodeResponseHeader(204, 0, false, header);
+        CPPUNIT_ASSERT(std::string(header, len) ==
+            "HTTP/1.1 204 No Content\r\nConnection: close\r\n\r\n");
+
+        len = http::encodeResponseHeader(100, 0, false, header);
+        CPPUNIT_ASSERT(std::string(header, len) ==
+            "HTTP/1.1 100 Continue\r\n\r\n");
+
+        /* longest header */
+        len = http::encodeResponseHeader(500, (size_t)-1, false, header);
+        CPPUNIT_ASSERT(len < http::MAX_HEADER_SIZE);
+      }
+
+      /**
+       * \brief Test if the decoder extracts several messages received at
+       * once, requests and responses.
+       */
+      void testDecoderPipelined()
+      {
+        const std::string stream = http::encodeRequestHeader("localhost", 5) +
+          "Hello\r\nPOST /rpc HTTP/1.1\r\ncontent-length:  0 \r\n\r\n" +
+          "HTTP/1.1 200 OK\r\nContent-Length: 6\r\n\r\nWorld!";
+        http::Decoder decoder;
+        const char* data = NULL;
+        size_t size = 0;
+
+        decoder.Feed(stream.data(), stream.length());
+
+        CPPUNIT_ASSERT(decoder.Next(data, size));
+        CPPUNIT_ASSERT(std::string(data, size) == "Hello");
+        CPPUNIT_ASSERT(decoder.IsKeepAlive());
+        CPPUNIT_ASSERT(decoder.Next(data, size));
+        CPPUNIT_ASSERT(size == 0);
+        CPPUNIT_ASSERT(decoder.Next(data, size));
+        CPPUNIT_ASSERT(std::string(data, size) == "World!");
+        CPPUNIT_ASSERT(!decoder.Next(data, size));
+        CPPUNIT_ASSERT(decoder.GetBufferedSize() == 0);
+      }
+
+      /**
+       * \brief Test if the decoder waits for a message received byte per
+       * byte.
+       */
+      void testDecoderPartial()
+      {
+        const std::string stream = http::encodeRequestHeader("localhost", 12) +
+          "Hello World!";
+        http::Decoder decoder;
+        const char* data = NULL;
+        size_t size = 0;
+
+        for(size_t i = 0 ; i < stream.length() - 1 ; i++)
+        {
+          decoder.Feed(stream.data() + i, 1);
+          CPPUNIT_ASSERT(!decoder.Next(data, size));
+        }
+
+        decoder.Feed(stream.data() + stream.length() - 1, 1);
+        CPPUNIT_ASSERT(decoder.Next(data, size));
+        CPPUNIT_ASSERT(std::string(data, size) == "Hello World!");
+      }
+
+      /**
+       * \brief Test if a chunked body is reassembled, at once and byte per
+       * byte.
+       */
+      void testDecoderChunked()
+      {
+        const std::string stream = "POST / HTTP/1.1\r\n"
+          "Transfer-Encoding: chunked\r\n\r\n"
+          "5;ext=1\r\nHello\r\n1\r\n \r\nA\r\n0123456789\r\n0\r\n"
+          "Trailer: ignored\r\n\r\n";
+        http::Decoder decoder;
+        http::Decoder partial;
+        const char* data = NULL;
+        size_t size = 0;
+
+        decoder.Feed(stream.data(), stream.length());
+        CPPUNIT_ASSERT(decoder.Next(data, size));
+        CPPUNIT_ASSERT(std::string(data, size) == "Hello 0123456789");
+        CPPUNIT_ASSERT(decoder.GetBufferedSize() == 0);
+
+        for(size_t i = 0 ; i < stream.length() - 1 ; i++)
+        {
+          partial.Feed(stream.data() + i, 1);
+          CPPUNIT_ASSERT(!partial.Next(data, size));
+        }
+
+        partial.Feed(stream.data() + stream.length() - 1, 1);
+        CPPUNIT_ASSERT(partial.Next(data, size));
+        CPPUNIT_ASSERT(std::string(data, size) == "Hello 0123456789");
+      }
+
+      /**
+       * \brief Test if the connection persistence of each message is
+       * found.
+       */
+      void testDecoderKeepAlive()
+      {
+        const std::string stream = "POST / HTTP/1.0\r\n\r\n"
+          "POST / HTTP/1.0\r\nConnection: Keep-Alive\r\n\r\n"
+          "POST / HTTP/1.1\r\nConnection: close\r\n\r\n";
+        http::Decoder decoder;
+        const char* data = NULL;
+        size_t size = 0;
+
+        decoder.Feed(stream.data(), stream.length());
+
+        CPPUNIT_ASSERT(decoder.Next(data, size));
+        CPPUNIT_ASSERT(!decoder.IsKeepAlive());
+        CPPUNIT_ASSERT(decoder.Next(data, size));
+        CPPUNIT_ASSERT(decoder.IsKeepAlive());
+        CPPUNIT_ASSERT(decoder.Next(data, size));
+        CPPUNIT_ASSERT(!decoder.IsKeepAlive());
+      }
+
+      /**
+       * \brief Test if "Expect: 100-continue" is reported once, until the
+       * body comes.
+       */
+      void testDecoderContinue()
+      {
+        const std::string headers = "POST / HTTP/1.1\r\nContent-Length: 2\r\n"
+          "Expect: 100-continue\r\n\r\n";
+        http::Decoder decoder;
+        const char* data = NULL;
+        size_t size = 0;
+
+        decoder.Feed(headers.data(), headers.length());
+        CPPUNIT_ASSERT(!decoder.Next(data, size));
+        CPPUNIT_ASSERT(decoder.TakeContinue());
+        CPPUNIT_ASSERT(!decoder.TakeContinue());
+
+        decoder.Feed("{}", 2);
+        CPPUNIT_ASSERT(decoder.Next(data, size));
+        CPPUNIT_ASSERT(std::string(data, size) == "{}");
+
+        /* body already there, no need to wait */
+        decoder.Feed(headers.data(), headers.length());
+        decoder.Feed("[]", 2);
+        CPPUNIT_ASSERT(decoder.Next(data, size));
+        CPPUNIT_ASSERT(!decoder.TakeContinue());
+      }
+
+      /**
+       * \brief Test if the decoder rejects a body bigger than the maximum
+       * size as soon as the headers are received.
+       */
+      void testDecoderTooBig()
+      {
+        const std::string stream = http::encodeRequestHeader("localhost",
+            1000);
+        http::Decoder decoder(100);
+        const char* data = NULL;
+        size_t size = 0;
+
+        decoder.Feed(stream.data(), stream.length());
+        decoder.Next(data, size);
+      }
+
+      /**
+       * \brief Test if the decoder rejects a chunk which is missing CRLF.
+       */
+      void testDecoderInvalid()
+      {
+        const std::string stream = "POST / HTTP/1.1\r\n"
+          "Transfer-Encoding: chunked\r\n\r\n5\r\nHello!\r\n";
+        http::Decoder decoder;
+        const char* data = NULL;
+        size_t size = 0;
+
+        decoder.Feed(stream.data(), stream.length());
+        decoder.Next(data, size);
+      }
+
+      /**
+       * \brief Test if HttpServer answers pipelined requests in order, with
+       * 204 for a notification, and closes the connection after
+       * "Connection: close".
+       */
+      void testServer()
+      {
+        const std::string call1 = "{\"jsonrpc\":\"2.0\",\"method\":\"print\",\"id\":1}";
+        const std::string call2 = "{\"jsonrpc\":\"2.0\",\"method\":\"print\",\"id\":2}";
+        const std::string notify = "{\"jsonrpc\":\"2.0\",\"method\":\"notify\"}";
+        char header[32];
+        std::string stream;
+        std::string expected;
+        std::string received;
+        Json::Rpc::HttpServer server(std::string("127.0.0.1"),
+            TEST_HTTP_SERVER_PORT);
+        TestHttpRpc obj;
+        Json::Reader reader;
+        Json::Value response;
+        http::Decoder decoder;
+        const char* data = NULL;
+        size_t size = 0;
+        char buf[1024];
+        ssize_t nb = 0;
+        int sock = -1;
+
+        server.AddMethod(new Json::Rpc::RpcMethod<TestHttpRpc>(obj,
+              &TestHttpRpc::Print, std::string("print")));
+        server.AddMethod(new Json::Rpc::RpcMethod<TestHttpRpc>(obj,
+              &TestHttpRpc::Notify, std::string("notify")));
+        CPPUNIT_ASSERT(server.Bind() && server.Listen());
+
+        sock = networking::connect(networking::TCP, "127.0.0.1",
+            TEST_HTTP_SERVER_PORT, NULL, NULL);
+        CPPUNIT_ASSERT(sock != -1);
+
+        /* second call is chunked, last one closes the connection */
+        sprintf(header, "%lx\r\n", (unsigned long)call2.length());
+        stream = http::encodeRequestHeader("127.0.0.1", call1.length()) + call1;
+        stream += "POST / HTTP/1.1\r\nTransfer-Encoding: chunked\r\n\r\n";
+        stream += header + call2 + "\r\n0\r\n\r\n";
+        stream += http::encodeRequestHeader("127.0.0.1", notify.length());
+        stream += notify;
+        stream += "POST / HTTP/1.1\r\nConnection: close\r\nContent-Length: ";
+        sprintf(header, "%lu\r\n\r\n", (unsigned long)call1.length());
+        stream += header + call1;
+        CPPUNIT_ASSERT(::send(sock, stream.data(), stream.length(), 0) ==
+            (ssize_t)stream.length());
+
+        /* accept then process everything, the server closes the socket */
+        server.WaitMessage(100);
+        CPPUNIT_ASSERT(server.GetClients().size() == 1);
+
+        for(int i = 0 ; i < 10 && server.GetClients().size() != 0 ; i++)
+        {
+          server.WaitMessage(100);
+        }
+
+        while((nb = ::recv(sock, buf, sizeof(buf), 0)) > 0)
+        {
+          received.append(buf, nb);
+        }
+        ::close(sock);
+        server.Close();
+
+        CPPUNIT_ASSERT(server.GetClients().size() == 0);
+        decoder.Feed(received.data(), received.length());
+
+        for(int id = 1 ; id <= 2 ; id++)
+        {
+          CPPUNIT_ASSERT(decoder.Next(data, size));
+          CPPUNIT_ASSERT(reader.parse(data, data + size, response));
+          CPPUNIT_ASSERT(response["result"] == id);
+          CPPUNIT_ASSERT(decoder.IsKeepAlive());
+        }
+
+        CPPUNIT_ASSERT(received.find("HTTP/1.1 204 No Content\r\n\r\n") !=
+            std::string::npos);
+        CPPUNIT_ASSERT(decoder.Next(data, size));
+        CPPUNIT_ASSERT(size == 0);
+
+        CPPUNIT_ASSERT(decoder.Next(data, size));
+        CPPUNIT_ASSERT(reader.parse(data, data + size, response));
+        CPPUNIT_ASSERT(response["result"] == 1);
+        CPPUNIT_ASSERT(!decoder.IsKeepAlive());
+        CPPUNIT_ASSERT(decoder.GetBufferedSize() == 0);
+      }
+  };
+} /* namespace http */
+
+/* add the test suite in the global registry */
+CPPUNIT_TEST_SUITE_REGISTRATION(http::TestHttp);
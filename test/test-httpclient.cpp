@@ -0,0 +1,486 @@
+/*
+ *  JsonRpc-Cpp - JSON-RPC implementation.
+ *  Copyright (C) 2008-2011 Sebastien Vincent <sebastien.vincent@cppextrem.com>
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**
+ * \file test-httpclient.cpp
+ * \brief HttpClient unit tests.
+ * \author Sebastien Vincent
+ */
+
+#ifdef CURL_ENABLED
+
+#include <cstdlib>
+#include <cstring>
+#include <sstream>
+#include <vector>
+
+#include <cppunit/extensions/HelperMacros.h>
+
+#include "jsonrpc_httpclient.h"
+#include "networking.h"
+#include "system.h"
+
+namespace Json
+{
+  namespace Rpc
+  {
+    /**
+     * \var TEST_HTTP_PORT
+     * \brief Port of the test HTTP server.
+     */
+    static const uint16_t TEST_HTTP_PORT = 8087;
+
+    /**
+     * \var TEST_HTTP_DELAY
+     * \brief Time the test HTTP server takes to answer a request (ms).
+     */
+    static const unsigned long TEST_HTTP_DELAY = 50;
+
+    /**
+     * \class TestHttpServer
+     * \brief Minimal HTTP/1.1 keep-alive server which echoes the body of
+     * each POST request after TEST_HTTP_DELAY, one thread per connection.
+     */
+    class TestHttpServer
+    {
+      public:
+        /**
+         * \brief Constructor.
+         */
+        TestHttpServer()
+        {
+          m_sock = -1;
+          m_acceptThread = NULL;
+          m_connections = 0;
+        }
+
+        /**
+         * \brief Destructor.
+         */
+        ~TestHttpServer()
+        {
+          Stop();
+        }
+
+        /**
+         * \brief Listen on loopback and start accepting connections.
+         * \param port TCP port
+         * \return true if success, false otherwise
+         */
+        bool Start(uint16_t port)
+        {
+          m_sock = networking::bind(networking::TCP, "127.0.0.1", port, NULL,
+              NULL);
+
+          if(m_sock == -1 || listen(m_sock, 16) == -1)
+          {
+            return false;
+          }
+
+          m_acceptThread = new system_util::Thread(
+              new system_util::ThreadArgImpl<TestHttpServer>(*this,
+                &TestHttpServer::Accept, NULL));
+          return m_acceptThread->Start(false);
+        }
+
+        /**
+         * \brief Close all the connections and stop the threads.
+         */
+        void Stop()
+        {
+          if(m_acceptThread == NULL)
+          {
+            return;
+          }
+
+          /* wake up accept() and recv() */
+          shutdown(m_sock, SHUT_RDWR);
+          m_acceptThread->Join();
+          delete m_acceptThread;
+          m_acceptThread = NULL;
+          ::close(m_sock);
+          m_sock = -1;
+
+          m_mutex.Lock();
+          for(size_t i = 0 ; i < m_clients.size() ; i++)
+          {
+            shutdown(m_clients[i], SHUT_RDWR);
+          }
+          m_mutex.Unlock();
+
+          for(size_t i = 0 ; i < m_threads.size() ; i++)
+          {
+            m_threads[i]->Join();
+            delete m_threads[i];
+          }
+          m_threads.clear();
+        }
+
+        /**
+         * \brief Get the number of connections accepted.
+         * \return number of connections
+         */
+        size_t GetConnectionCount()
+        {
+          size_t ret = 0;
+
+          m_mutex.Lock();
+          ret = m_connections;
+          m_mutex.Unlock();
+
+          return ret;
+        }
+
+      private:
+        /**
+         * \brief Accept the connections.
+         * \param arg unused
+         * \return NULL
+         */
+        void* Accept(void* arg)
+        {
+          int client = -1;
+
+          (void)arg;
+
+          while((client = accept(m_sock, NULL, NULL)) != -1)
+          {
+            system_util::Thread* thread = new system_util::Thread(
+                new system_util::ThreadArgImpl<TestHttpServer>(*this,
+                  &TestHttpServer::Serve, (void*)(intptr_t)client));
+
+            m_mutex.Lock();
+            m_connections++;
+            m_clients.push_back(client);
+            m_mutex.Unlock();
+
+            thread->Start(false);
+            m_threads.push_back(thread);
+          }
+
+          return NULL;
+        }
+
+        /**
+         * \brief Answer the requests of a connection.
+         * \param arg socket descriptor
+         * \return NULL
+         */
+        void* Serve(void* arg)
+        {
+          int sock = (int)(intptr_t)arg;
+          std::string buffer;
+          char buf[1500];
+          ssize_t nb = 0;
+
+          while((nb = recv(sock, buf, sizeof(buf), 0)) > 0)
+          {
+            size_t headerEnd = 0;
+
+            buffer.append(buf, nb);
+
+            /* pipelined requests are answered in order */
+            while((headerEnd = buffer.find("\r\n\r\n")) != std::string::npos)
+            {
+              size_t pos = buffer.find("Content-Length:");
+              size_t length = 0;
+              std::ostringstream response;
+              std::string body;
+
+              if(pos != std::string::npos && pos < headerEnd)
+              {
+                length = strtoul(buffer.c_str() + pos + 15, NULL, 10);
+              }
+
+              if(buffer.size() < headerEnd + 4 + length)
+              {
+                break;
+              }
+
+              body = buffer.substr(headerEnd + 4, length);
+              buffer.erase(0, headerEnd + 4 + length);
+
+              system_util::msleep(TEST_HTTP_DELAY);
+
+              response << "HTTP/1.1 200 OK\r\n"
+                << "Content-Type: application/json-rpc\r\n"
+                << "Content-Length: " << body.size() << "\r\n\r\n" << body;
+              send(sock, response.str().data(), response.str().size(),
+                  MSG_NOSIGNAL);
+            }
+          }
+
+          ::close(sock);
+          return NULL;
+        }
+
+        /**
+         * \brief Listen socket.
+         */
+        int m_sock;
+
+        /**
+         * \brief Thread accepting the connections.
+         */
+        system_util::Thread* m_acceptThread;
+
+        /**
+         * \brief Threads answering the connections.
+         */
+        std::vector<system_util::Thread*> m_threads;
+
+        /**
+         * \brief Sockets of the connections.
+         */
+        std::vector<int> m_clients;
+
+        /**
+         * \brief Number of connections accepted.
+         */
+        size_t m_connections;
+
+        /**
+         * \brief Mutex to protect m_clients and m_connections.
+         */
+        system_util::Mutex m_mutex;
+    };
+
+    /**
+     * \class TestHttpSender
+     * \brief Send a request from another thread.
+     */
+    class TestHttpSender
+    {
+      public:
+        /**
+         * \brief Constructor.
+         * \param client client used to send
+         */
+        TestHttpSender(HttpClient& client)
+          : m_client(client)
+        {
+        }
+
+        /**
+         * \brief Method called by the thread.
+         * \param arg unused
+         * \return NULL
+         */
+        void* Send(void* arg)
+        {
+          (void)arg;
+
+          m_client.Send("{\"id\":2}");
+          return NULL;
+        }
+
+      private:
+        /**
+         * \brief Client used to send.
+         */
+        HttpClient& m_client;
+    };
+
+    /**
+     * \class TestHttpClient
+     * \brief Unit tests for HttpClient.
+     */
+    class TestHttpClient : public CppUnit::TestFixture
+    {
+      CPPUNIT_TEST_SUITE(Json::Rpc::TestHttpClient);
+      CPPUNIT_TEST(testConcurrentRequests);
+      CPPUNIT_TEST(testAbortedRequests);
+      CPPUNIT_TEST(testWaitRecv);
+      CPPUNIT_TEST(testLargeResponse);
+      CPPUNIT_TEST_SUITE_END();
+
+      public:
+        /**
+         * \brief Initialize the test HTTP server.
+         */
+        void setUp()
+        {
+          m_server = new TestHttpServer();
+          CPPUNIT_ASSERT(m_server->Start(TEST_HTTP_PORT));
+        }
+
+        /**
+         * \brief Stop the test HTTP server.
+         */
+        void tearDown()
+        {
+          delete m_server;
+        }
+
+        /**
+         * \brief Test that concurrent requests are answered in their own
+         * slot, faster than sequential ones and on reused connections.
+         */
+        void testConcurrentRequests()
+        {
+          static const size_t nb = 8;
+          std::ostringstream url;
+          HttpTransfer transfers[nb];
+          std::string data;
+          uint64_t sequential = 0;
+          uint64_t concurrent = 0;
+          size_t connections = 0;
+
+          url << "http://127.0.0.1:" << TEST_HTTP_PORT << "/";
+          HttpClient client(url.str());
+
+          sequential = system_util::monotonicTime();
+          for(size_t i = 0 ; i < nb ; i++)
+          {
+            CPPUNIT_ASSERT(client.Send("{\"id\":1}") == 0);
+            CPPUNIT_ASSERT(client.Recv(data) > 0);
+          }
+          sequential = system_util::monotonicTime() - sequential;
+          CPPUNIT_ASSERT(sequential >= nb * TEST_HTTP_DELAY * 1000);
+
+          for(int batch = 0 ; batch < 2 ; batch++)
+          {
+            concurrent = system_util::monotonicTime();
+            for(size_t i = 0 ; i < nb ; i++)
+            {
+              std::ostringstream request;
+
+              request << "{\"id\":" << i << "}";
+              CPPUNIT_ASSERT(client.SendAsync(request.str(), transfers[i]));
+            }
+
+            for(size_t i = 0 ; i < nb ; i++)
+            {
+              std::ostringstream request;
+
+              request << "{\"id\":" << i << "}";
+              CPPUNIT_ASSERT(transfers[i].Wait(data) > 0);
+              CPPUNIT_ASSERT(data == request.str());
+              CPPUNIT_ASSERT(transfers[i].GetStatus() == 200);
+            }
+            concurrent = system_util::monotonicTime() - concurrent;
+
+            CPPUNIT_ASSERT(concurrent * 2 < sequential);
+            CPPUNIT_ASSERT(client.GetPendingCount() == 0);
+
+            if(batch == 0)
+            {
+              connections = m_server->GetConnectionCount();
+            }
+          }
+
+          /* keep-alive: the second batch opens no connection */
+          CPPUNIT_ASSERT(m_server->GetConnectionCount() == connections);
+          CPPUNIT_ASSERT(connections <= 1 + nb);
+        }
+
+        /**
+         * \brief Test that the requests in flight are aborted when the
+         * client is destroyed.
+         */
+        void testAbortedRequests()
+        {
+          std::ostringstream url;
+          HttpTransfer transfer;
+          std::string data;
+
+          url << "http://127.0.0.1:" << TEST_HTTP_PORT << "/";
+
+          {
+            HttpClient client(url.str());
+
+            CPPUNIT_ASSERT(client.SendAsync("{\"id\":1}", transfer));
+            CPPUNIT_ASSERT(client.GetPendingCount() == 1);
+          }
+
+          CPPUNIT_ASSERT(transfer.IsReady());
+          CPPUNIT_ASSERT(transfer.GetError() == CURLE_ABORTED_BY_CALLBACK);
+          CPPUNIT_ASSERT(transfer.Wait(data) == -1);
+        }
+
+        /**
+         * \brief Test that WaitRecv() sleeps until a response is stored or
+         * the timeout expires.
+         */
+        void testWaitRecv()
+        {
+          std::ostringstream url;
+          std::string data;
+          uint64_t start = 0;
+
+          url << "http://127.0.0.1:" << TEST_HTTP_PORT << "/";
+          HttpClient client(url.str());
+          TestHttpSender sender(client);
+          system_util::Thread th(new system_util::ThreadArgImpl<TestHttpSender>(
+                sender, &TestHttpSender::Send, NULL));
+
+          start = system_util::monotonicTime();
+          CPPUNIT_ASSERT(client.WaitRecvMs(data, 30) == 0);
+          CPPUNIT_ASSERT(system_util::monotonicTime() - start >= 30000);
+          CPPUNIT_ASSERT(data.empty());
+
+          CPPUNIT_ASSERT(th.Start(false));
+          CPPUNIT_ASSERT(client.WaitRecv(data) > 0);
+          CPPUNIT_ASSERT(data == "{\"id\":2}");
+          th.Join();
+        }
+
+        /**
+         * \brief Test that a response received in several chunks is stored
+         * as one message.
+         */
+        void testLargeResponse()
+        {
+          std::ostringstream url;
+          std::string request = "{\"id\":3,\"params\":\"";
+          std::string data;
+          HttpTransfer transfer;
+
+          request.append(200000, 'a');
+          request.append("\"}");
+
+          url << "http://127.0.0.1:" << TEST_HTTP_PORT << "/";
+          HttpClient client(url.str());
+
+          for(int i = 0 ; i < 2 ; i++)
+          {
+            CPPUNIT_ASSERT(client.Send(request) == 0);
+            CPPUNIT_ASSERT(client.Recv(data) == (ssize_t)request.size());
+            CPPUNIT_ASSERT(data == request);
+            CPPUNIT_ASSERT(client.Recv(data) == 0);
+          }
+
+          CPPUNIT_ASSERT(client.SendAsync(request, transfer));
+          CPPUNIT_ASSERT(transfer.Wait(data) == (ssize_t)request.size());
+          CPPUNIT_ASSERT(data == request);
+        }
+
+      private:
+        /**
+         * \brief Test HTTP server.
+         */
+        TestHttpServer* m_server;
+    };
+  } /* namespace Rpc */
+} /* namespace Json */
+
+/* add the test suite in the global registry */
+CPPUNIT_TEST_SUITE_REGISTRATION(Json::Rpc::TestHttpClient);
+
+#endif /* CURL_ENABLED */
+
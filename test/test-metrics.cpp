@@ -0,0 +1,282 @@
+/*
+ *  JsonRpc-Cpp - JSON-RPC implementation.
+ *  Copyright (C) 2008-2011 Sebastien Vincent <sebastien.vincent@cppextrem.com>
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+/**
+ * \file test-metrics.cpp
+ * \brief Server metrics unit tests.
+ * \author Sebastien Vincent
+ */
+
+#include <cppunit/extensions/HelperMacros.h>
+
+#include "jsonrpc.h"
+
+namespace Json
+{
+  namespace Rpc
+  {
+    /**
+     * \var TEST_METRICS_PORT
+     * \brief Port of the TcpServer used by the tests.
+     */
+    static const uint16_t TEST_METRICS_PORT = 8092;
+
+    /**
+     * \class TestMetricsRpc
+     * \brief RPC methods called through the TcpServer.
+     */
+    class TestMetricsRpc
+    {
+      public:
+        /**
+         * \brief Reply with the parameters.
+         * \param root JSON-RPC request
+         * \param response JSON-RPC response
+         * \return true
+         */
+        bool Echo(const Json::Value& root, Json::Value& response)
+        {
+          response["jsonrpc"] = "2.0";
+          response["id"] = root["id"];
+          response["result"] = root["params"];
+          return true;
+        }
+    };
+
+    /**
+     * \class TestMetricsUser
+     * \brief Update the metrics from another thread.
+     */
+    class TestMetricsUser
+    {
+      public:
+        /**
+         * \brief Constructor.
+         * \param metrics metrics
+         */
+        TestMetricsUser(Metrics& metrics) : m_metrics(metrics)
+        {
+        }
+
+        /**
+         * \brief Count messages of the two servers and change a gauge.
+         * \param arg unused
+         * \return NULL
+         */
+        void* Run(void* arg)
+        {
+          (void)arg;
+
+          for(int i = 0 ; i < 10000 ; i++)
+          {
+            m_metrics.Add(0, METRIC_MESSAGES, 1);
+            m_metrics.Add(1, METRIC_MESSAGES, 2);
+            m_metrics.Add(0, METRIC_OUTPUT_QUEUE, 10);
+            m_metrics.Add(0, METRIC_OUTPUT_QUEUE, -10);
+          }
+
+          return NULL;
+        }
+
+      private:
+        /**
+         * \brief Metrics.
+         */
+        Metrics& m_metrics;
+    };
+
+    /**
+     * \class TestMetrics
+     * \brief Unit tests for Metrics.
+     */
+    class TestMetrics : public CppUnit::TestFixture
+    {
+      CPPUNIT_TEST_SUITE(Json::Rpc::TestMetrics);
+      CPPUNIT_TEST(testCounters);
+      CPPUNIT_TEST(testRender);
+      CPPUNIT_TEST(testServer);
+      CPPUNIT_TEST_SUITE_END();
+
+      public:
+        /**
+         * \brief Initialize data before launching test.
+         */
+        void setUp()
+        {
+        }
+
+        /**
+         * \brief Cleanup data after test finished.
+         */
+        void tearDown()
+        {
+        }
+
+        /**
+         * \brief Test the counters and gauges updated by several threads.
+         */
+        void testCounters()
+        {
+          Metrics metrics;
+          Handler handler;
+          Handler handler2;
+          TestMetricsUser user(metrics);
+          system_util::Thread thread(
+              new system_util::ThreadArgImpl<TestMetricsUser>(user,
+                &TestMetricsUser::Run, NULL));
+          system_util::Thread thread2(
+              new system_util::ThreadArgImpl<TestMetricsUser>(user,
+                &TestMetricsUser::Run, NULL));
+
+          CPPUNIT_ASSERT(metrics.AddServer("a", handler) == 0);
+          CPPUNIT_ASSERT(metrics.AddServer("b", handler2) == 1);
+          /* same name, same metrics */
+          CPPUNIT_ASSERT(metrics.AddServer("a", handler2) == 0);
+
+          CPPUNIT_ASSERT(thread.Start(false) && thread2.Start(false));
+          user.Run(NULL);
+          thread.Join();
+          thread2.Join();
+
+          CPPUNIT_ASSERT(metrics.Get(0, METRIC_MESSAGES) == 30000);
+          CPPUNIT_ASSERT(metrics.Get(1, METRIC_MESSAGES) == 60000);
+          CPPUNIT_ASSERT(metrics.Get(0, METRIC_OUTPUT_QUEUE) == 0);
+          CPPUNIT_ASSERT(metrics.Get(1, METRIC_ACCEPTED) == 0);
+
+          metrics.Add(1, METRIC_JOB_QUEUE, -3);
+          CPPUNIT_ASSERT(metrics.Get(1, METRIC_JOB_QUEUE) == -3);
+        }
+
+        /**
+         * \brief Test the text format.
+         */
+        void testRender()
+        {
+          Metrics metrics;
+          Handler handler;
+          Json::Value request;
+          Json::Value response;
+          std::string text;
+
+          metrics.AddServer("a\"b\\c", handler);
+          handler.AddMethod(new RpcMethod<TestMetricsRpc>(m_obj,
+                &TestMetricsRpc::Echo, std::string("echo")));
+          metrics.Add(0, METRIC_ACCEPTED, 2);
+          metrics.Add(0, METRIC_OUTPUT_QUEUE, -1);
+
+          request["jsonrpc"] = "2.0";
+          request["method"] = "echo";
+          request["id"] = 1;
+          handler.Process(request, response);
+
+          metrics.Render(text);
+
+          CPPUNIT_ASSERT(text.find(
+                "# TYPE jsonrpc_connections_accepted_total counter\n"
+                "jsonrpc_connections_accepted_total{server=\"a\\\"b\\\\c\"} 2\n")
+              != std::string::npos);
+          CPPUNIT_ASSERT(text.find(
+                "jsonrpc_output_queue_bytes{server=\"a\\\"b\\\\c\"} -1\n")
+              != std::string::npos);
+          CPPUNIT_ASSERT(text.find(
+                "jsonrpc_method_calls_total{server=\"a\\\"b\\\\c\","
+                "method=\"echo\"} 1\n") != std::string::npos);
+          CPPUNIT_ASSERT(text.find(
+                "jsonrpc_method_errors_total{server=\"a\\\"b\\\\c\","
+                "method=\"echo\"} 0\n") != std::string::npos);
+          CPPUNIT_ASSERT(text.find(
+                "jsonrpc_method_duration_seconds_bucket{server=\"a\\\"b\\\\c\","
+                "method=\"echo\",le=\"10\"} 1\n") != std::string::npos);
+          CPPUNIT_ASSERT(text.find(
+                "jsonrpc_method_duration_seconds_bucket{server=\"a\\\"b\\\\c\","
+                "method=\"echo\",le=\"+Inf\"} 1\n") != std::string::npos);
+          CPPUNIT_ASSERT(text.find(
+                "jsonrpc_method_duration_seconds_count{server=\"a\\\"b\\\\c\","
+                "method=\"echo\"} 1\n") != std::string::npos);
+        }
+
+        /**
+         * \brief Test the metrics counted by a TcpServer and the
+         * system.metrics method.
+         */
+        void testServer()
+        {
+          /* outlives the server */
+          Metrics metrics;
+          TcpServer server("127.0.0.1", TEST_METRICS_PORT);
+          TcpClient client("127.0.0.1", TEST_METRICS_PORT);
+          std::string request(
+              "{\"jsonrpc\":\"2.0\",\"method\":\"echo\",\"id\":1}");
+          std::string invalid("{\"jsonrpc\":}");
+          std::string request2(
+              "{\"jsonrpc\":\"2.0\",\"method\":\"system.metrics\",\"id\":2}");
+          std::string msg;
+          std::string msg2;
+          Json::Reader reader;
+          Json::Value response;
+
+          server.AddMethod(new RpcMethod<TestMetricsRpc>(m_obj,
+                &TestMetricsRpc::Echo, std::string("echo")));
+          server.SetMetrics(metrics, "tcp", true);
+          CPPUNIT_ASSERT(server.Bind() && server.Listen());
+
+          CPPUNIT_ASSERT(client.Connect());
+          server.WaitMessage(100);
+          CPPUNIT_ASSERT(metrics.Get(0, METRIC_ACCEPTED) == 1);
+
+          CPPUNIT_ASSERT(client.Send(request) > 0);
+          server.WaitMessage(100);
+          CPPUNIT_ASSERT(client.Recv(msg) > 0);
+          CPPUNIT_ASSERT(client.Send(invalid) > 0);
+          server.WaitMessage(100);
+          CPPUNIT_ASSERT(client.Recv(msg2) > 0);
+
+          CPPUNIT_ASSERT(metrics.Get(0, METRIC_MESSAGES) == 2);
+          CPPUNIT_ASSERT(metrics.Get(0, METRIC_PARSE_ERRORS) == 1);
+          CPPUNIT_ASSERT(metrics.Get(0, METRIC_RECEIVED_BYTES) ==
+              (int64_t)(request.length() + invalid.length()));
+          /* the client removes the newline ending the responses */
+          CPPUNIT_ASSERT(metrics.Get(0, METRIC_SENT_BYTES) ==
+              (int64_t)(msg.length() + msg2.length() + 2));
+          CPPUNIT_ASSERT(metrics.Get(0, METRIC_OUTPUT_QUEUE) == 0);
+
+          CPPUNIT_ASSERT(client.Send(request2) > 0);
+          server.WaitMessage(100);
+          CPPUNIT_ASSERT(client.Recv(msg) > 0);
+          CPPUNIT_ASSERT(reader.parse(msg, response));
+          CPPUNIT_ASSERT(response["result"].asString().find(
+                "jsonrpc_method_calls_total{server=\"tcp\",method=\"echo\"} 1\n")
+              != std::string::npos);
+
+          client.Close();
+          server.WaitMessage(100);
+          CPPUNIT_ASSERT(metrics.Get(0, METRIC_CLOSED) == 1);
+        }
+
+      private:
+        /**
+         * \brief RPC methods.
+         */
+        TestMetricsRpc m_obj;
+    };
+  } /* namespace Rpc */
+} /* namespace Json */
+
+/* add the test suite in the global registry */
+CPPUNIT_TEST_SUITE_REGISTRATION(Json::Rpc::TestMetrics);
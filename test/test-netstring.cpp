@@ -36,12 +36,17 @@ namespace netstring
   {
     CPPUNIT_TEST_SUITE(netstring::TestNetstring);
     CPPUNIT_TEST(testEncoding);
+    CPPUNIT_TEST(testEncodingHeader);
     CPPUNIT_TEST(testDecoding);
     CPPUNIT_TEST_EXCEPTION(testDecodingTooLong, netstring::NetstringException);
     CPPUNIT_TEST_EXCEPTION(testDecodingTooLongString, netstring::NetstringException);
     CPPUNIT_TEST_EXCEPTION(testDecodingTooShort, netstring::NetstringException);
     CPPUNIT_TEST_EXCEPTION(testDecodingMissingComma, netstring::NetstringException);
     CPPUNIT_TEST_EXCEPTION(testDecodingMissingColon, netstring::NetstringException);
+    CPPUNIT_TEST(testDecoderPipelined);
+    CPPUNIT_TEST(testDecoderPartial);
+    CPPUNIT_TEST_EXCEPTION(testDecoderTooBig, netstring::NetstringException);
+    CPPUNIT_TEST_EXCEPTION(testDecoderInvalid, netstring::NetstringException);
     CPPUNIT_TEST_SUITE_END();
 
     public:
@@ -72,6 +77,24 @@ namespace netstring
         CPPUNIT_ASSERT(str == encodedStr);
       }
 
+      /**
+       * \brief Test if header encoding works as expected.
+       */
+      void testEncodingHeader()
+      {
+        const std::string origStr = "Hello World!";
+        char header[netstring::MAX_HEADER_SIZE];
+        size_t len = 0;
+        std::string str;
+
+        len = netstring::encodeHeader(origStr.length(), header);
+        str.append(header, len);
+        str.append(origStr);
+        str.append(1, netstring::TRAILER);
+        CPPUNIT_ASSERT(len == 3);
+        CPPUNIT_ASSERT(str == netstring::encode(origStr));
+      }
+
       /**
        * \brief Test if decoding works as expected.
        */
@@ -144,6 +167,81 @@ namespace netstring
 
         str = netstring::decode(encodedStr);
       }
+
+      /**
+       * \brief Test if the decoder extracts several netstrings received
+       * at once.
+       */
+      void testDecoderPipelined()
+      {
+        const std::string encodedStr = "5:Hello,0:,6:World!,";
+        netstring::Decoder decoder;
+        const char* data = NULL;
+        size_t size = 0;
+
+        decoder.Feed(encodedStr.data(), encodedStr.length());
+
+        CPPUNIT_ASSERT(decoder.Next(data, size));
+        CPPUNIT_ASSERT(std::string(data, size) == "Hello");
+        CPPUNIT_ASSERT(decoder.Next(data, size));
+        CPPUNIT_ASSERT(size == 0);
+        CPPUNIT_ASSERT(decoder.Next(data, size));
+        CPPUNIT_ASSERT(std::string(data, size) == "World!");
+        CPPUNIT_ASSERT(!decoder.Next(data, size));
+        CPPUNIT_ASSERT(decoder.GetBufferedSize() == 0);
+      }
+
+      /**
+       * \brief Test if the decoder waits for a netstring received byte
+       * per byte.
+       */
+      void testDecoderPartial()
+      {
+        const std::string encodedStr = "12:Hello World!,";
+        netstring::Decoder decoder;
+        const char* data = NULL;
+        size_t size = 0;
+
+        for(size_t i = 0 ; i < encodedStr.length() - 1 ; i++)
+        {
+          decoder.Feed(encodedStr.data() + i, 1);
+          CPPUNIT_ASSERT(!decoder.Next(data, size));
+        }
+
+        decoder.Feed(encodedStr.data() + encodedStr.length() - 1, 1);
+        CPPUNIT_ASSERT(decoder.Next(data, size));
+        CPPUNIT_ASSERT(std::string(data, size) == "Hello World!");
+      }
+
+      /**
+       * \brief Test if the decoder rejects a netstring bigger than the
+       * maximum size as soon as its length is known.
+       */
+      void testDecoderTooBig()
+      {
+        const std::string encodedStr = "1000:";
+        netstring::Decoder decoder(100);
+        const char* data = NULL;
+        size_t size = 0;
+
+        decoder.Feed(encodedStr.data(), encodedStr.length());
+        decoder.Next(data, size);
+      }
+
+      /**
+       * \brief Test if the decoder rejects a netstring which is missing
+       * comma.
+       */
+      void testDecoderInvalid()
+      {
+        const std::string encodedStr = "5:Hello!";
+        netstring::Decoder decoder;
+        const char* data = NULL;
+        size_t size = 0;
+
+        decoder.Feed(encodedStr.data(), encodedStr.length());
+        decoder.Next(data, size);
+      }
   };
 } /* namespace netstring */
 
@@ -0,0 +1,297 @@
+/*
+ *  JsonRpc-Cpp - JSON-RPC implementation.
+ *  Copyright (C) 2008-2011 Sebastien Vincent <sebastien.vincent@cppextrem.com>
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+/**
+ * \file test-reactorgroup.cpp
+ * \brief ReactorGroup unit tests.
+ * \author Sebastien Vincent
+ */
+
+#include <cstdio>
+
+#include <poll.h>
+
+#include <cppunit/extensions/HelperMacros.h>
+
+#include "jsonrpc.h"
+
+namespace Json
+{
+  namespace Rpc
+  {
+    /**
+     * \var TEST_REACTOR_PORT
+     * \brief Port of the ReactorGroup used by the tests.
+     */
+    static const uint16_t TEST_REACTOR_PORT = 8098;
+
+    /**
+     * \var TEST_REACTORS
+     * \brief Number of reactors of the group.
+     */
+    static const size_t TEST_REACTORS = 4;
+
+    /**
+     * \var TEST_REACTOR_CLIENTS
+     * \brief Maximum number of clients opened to reach every reactor.
+     */
+    static const int TEST_REACTOR_CLIENTS = 64;
+
+    /**
+     * \class TestReactorRpc
+     * \brief RPC methods called through the ReactorGroup.
+     */
+    class TestReactorRpc
+    {
+      public:
+        /**
+         * \brief Reply with the parameters.
+         * \param root JSON-RPC request
+         * \param response JSON-RPC response
+         * \return true
+         */
+        bool Echo(const Json::Value& root, Json::Value& response)
+        {
+          response["jsonrpc"] = "2.0";
+          response["id"] = root["id"];
+          response["result"] = root["params"];
+          return true;
+        }
+    };
+
+    /**
+     * \class TestReactorGroup
+     * \brief Unit tests for ReactorGroup.
+     */
+    class TestReactorGroup : public CppUnit::TestFixture
+    {
+      CPPUNIT_TEST_SUITE(Json::Rpc::TestReactorGroup);
+      CPPUNIT_TEST(testTcp);
+      CPPUNIT_TEST(testUdp);
+      CPPUNIT_TEST(testRestart);
+      CPPUNIT_TEST_SUITE_END();
+
+      public:
+        /**
+         * \brief Initialize data before launching test.
+         */
+        void setUp()
+        {
+        }
+
+        /**
+         * \brief Cleanup data after test finished.
+         */
+        void tearDown()
+        {
+        }
+
+        /**
+         * \brief Test that every TCP reactor serves requests with the
+         * shared handler and that Stop() closes their connections.
+         */
+        void testTcp()
+        {
+#ifdef __linux__
+          Metrics metrics;
+          ReactorGroup group("127.0.0.1", TEST_REACTOR_PORT, networking::TCP,
+              TEST_REACTORS);
+          std::vector<TcpClient*> clients;
+          bool answered = true;
+          bool closed = true;
+
+          Register(group, metrics);
+          CPPUNIT_ASSERT(group.Start());
+
+          /* the kernel spreads the connections between the reactors */
+          for(int i = 0 ; i < TEST_REACTOR_CLIENTS && answered &&
+              !IsServed(metrics) ; i++)
+          {
+            TcpClient* client = new TcpClient("127.0.0.1", TEST_REACTOR_PORT);
+
+            clients.push_back(client);
+            answered = client->Connect() && Call(*client, i);
+          }
+
+          group.Stop();
+
+          for(size_t i = 0 ; i < clients.size() ; i++)
+          {
+            std::string msg;
+
+            closed = closed && answered && clients[i]->Recv(msg) <= 0;
+            delete clients[i];
+          }
+
+          CPPUNIT_ASSERT(answered);
+          CPPUNIT_ASSERT(IsServed(metrics));
+          CPPUNIT_ASSERT(closed);
+#endif
+        }
+
+        /**
+         * \brief Test that every UDP reactor serves requests with the
+         * shared handler and that Stop() returns.
+         */
+        void testUdp()
+        {
+#ifdef __linux__
+          Metrics metrics;
+          ReactorGroup group("127.0.0.1", TEST_REACTOR_PORT, networking::UDP,
+              TEST_REACTORS);
+          bool answered = true;
+
+          Register(group, metrics);
+          CPPUNIT_ASSERT(group.Start());
+
+          /* the kernel spreads the datagrams by source port */
+          for(int i = 0 ; i < TEST_REACTOR_CLIENTS && answered &&
+              !IsServed(metrics) ; i++)
+          {
+            UdpClient client("127.0.0.1", TEST_REACTOR_PORT);
+
+            answered = client.Connect() && Call(client, i);
+          }
+
+          group.Stop();
+          CPPUNIT_ASSERT(answered);
+          CPPUNIT_ASSERT(IsServed(metrics));
+#endif
+        }
+
+        /**
+         * \brief Test that every call is answered after Stop() and
+         * Start(), no listen socket of the first run is left in the
+         * SO_REUSEPORT group.
+         */
+        void testRestart()
+        {
+#ifdef __linux__
+          static const int count = 40;
+          ReactorGroup group("127.0.0.1", TEST_REACTOR_PORT, networking::TCP,
+              TEST_REACTORS);
+          bool answered = true;
+          bool closed = true;
+
+          group.AddMethod(new RpcMethod<TestReactorRpc>(m_obj,
+                &TestReactorRpc::Echo, std::string("echo")));
+          CPPUNIT_ASSERT(group.Start());
+          CPPUNIT_ASSERT(!group.Start());
+          group.Stop();
+
+          for(size_t i = 0 ; i < group.GetReactorCount() ; i++)
+          {
+            closed = closed && group.GetServer(i)->GetSocket() == -1;
+          }
+          CPPUNIT_ASSERT(closed);
+
+          CPPUNIT_ASSERT(group.Start());
+
+          for(int i = 0 ; i < count && answered ; i++)
+          {
+            TcpClient client("127.0.0.1", TEST_REACTOR_PORT);
+
+            answered = client.Connect() && Call(client, i);
+          }
+
+          group.Stop();
+          CPPUNIT_ASSERT(answered);
+#endif
+        }
+
+      private:
+        /**
+         * \brief Add the echo method and register each reactor in the
+         * metrics, reactor i is server i.
+         * \param group group, not started
+         * \param metrics metrics
+         */
+        void Register(ReactorGroup& group, Metrics& metrics)
+        {
+          group.AddMethod(new RpcMethod<TestReactorRpc>(m_obj,
+                &TestReactorRpc::Echo, std::string("echo")));
+
+          for(size_t i = 0 ; i < group.GetReactorCount() ; i++)
+          {
+            char name[32];
+
+            sprintf(name, "reactor%u", (unsigned int)i);
+            group.GetServer(i)->SetMetrics(metrics, name);
+          }
+        }
+
+        /**
+         * \brief Get if every reactor has processed a request.
+         * \param metrics metrics of the group
+         * \return true if all served, false otherwise
+         */
+        bool IsServed(Metrics& metrics)
+        {
+          for(size_t i = 0 ; i < TEST_REACTORS ; i++)
+          {
+            if(metrics.Get(i, METRIC_MESSAGES) == 0)
+            {
+              return false;
+            }
+          }
+
+          return true;
+        }
+
+        /**
+         * \brief Echo the id through a client.
+         * \param client connected client (TcpClient or UdpClient)
+         * \param id id and parameter of the request
+         * \return true if the response came back, false otherwise
+         */
+        template<class T>
+        bool Call(T& client, int id)
+        {
+          Json::FastWriter writer;
+          Json::Reader reader;
+          Json::Value request;
+          Json::Value response;
+          std::string msg;
+          struct pollfd pfd;
+
+          request["jsonrpc"] = "2.0";
+          request["method"] = "echo";
+          request["id"] = id;
+          request["params"] = id;
+
+          if(client.Send(writer.write(request)) == -1)
+          {
+            return false;
+          }
+
+          pfd.fd = client.GetSocket();
+          pfd.events = POLLIN;
+
+          return poll(&pfd, 1, 1000) == 1 && client.Recv(msg) > 0 &&
+            reader.parse(msg, response) && response["result"] == id;
+        }
+
+        /**
+         * \brief RPC methods.
+         */
+        TestReactorRpc m_obj;
+    };
+  } /* namespace Rpc */
+} /* namespace Json */
+
+/* add the test suite in the global registry */
+CPPUNIT_TEST_SUITE_REGISTRATION(Json::Rpc::TestReactorGroup);
@@ -0,0 +1,318 @@
+/*
+ *  JsonRpc-Cpp - JSON-RPC implementation.
+ *  Copyright (C) 2008-2011 Sebastien Vincent <sebastien.vincent@cppextrem.com>
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**
+ * \file test-shm.cpp
+ * \brief Shared-memory transport unit tests.
+ * \author Sebastien Vincent
+ */
+
+#include <sys/stat.h>
+
+#include <cppunit/extensions/HelperMacros.h>
+
+#include "jsonrpc.h"
+#include "shm.h"
+
+namespace Json
+{
+  namespace Rpc
+  {
+    /**
+     * \var TEST_SHM_PATH
+     * \brief Path of the ShmServer used by the tests.
+     */
+    static const char TEST_SHM_PATH[] = "/tmp/test-jsonrpc-shm.sock";
+
+    /**
+     * \class TestShmRpc
+     * \brief RPC methods called through the ShmServer.
+     */
+    class TestShmRpc
+    {
+      public:
+        /**
+         * \brief Reply with the parameters.
+         * \param root JSON-RPC request
+         * \param response JSON-RPC response
+         * \return true
+         */
+        bool Echo(const Json::Value& root, Json::Value& response)
+        {
+          response["jsonrpc"] = "2.0";
+          response["id"] = root["id"];
+          response["result"] = root["params"];
+          return true;
+        }
+    };
+
+    /**
+     * \class TestShmLoop
+     * \brief Run a server in another thread.
+     */
+    class TestShmLoop
+    {
+      public:
+        /**
+         * \brief Constructor.
+         * \param server server
+         */
+        TestShmLoop(ShmServer& server) : m_server(server)
+        {
+          m_stop = false;
+        }
+
+        /**
+         * \brief Wait for messages until Stop().
+         * \param arg unused
+         * \return NULL
+         */
+        void* Run(void* arg)
+        {
+          (void)arg;
+
+          m_mutex.Lock();
+          while(!m_stop)
+          {
+            m_mutex.Unlock();
+            m_server.WaitMessage(10);
+            m_mutex.Lock();
+          }
+          m_mutex.Unlock();
+
+          return NULL;
+        }
+
+        /**
+         * \brief Stop Run().
+         */
+        void Stop()
+        {
+          m_mutex.Lock();
+          m_stop = true;
+          m_mutex.Unlock();
+        }
+
+      private:
+        /**
+         * \brief Server.
+         */
+        ShmServer& m_server;
+
+        /**
+         * \brief If Run() has to stop.
+         */
+        bool m_stop;
+
+        /**
+         * \brief Mutex to protect m_stop.
+         */
+        system_util::Mutex m_mutex;
+    };
+
+    /**
+     * \class TestShm
+     * \brief Unit tests for shm::Channel, ShmServer and ShmClient.
+     */
+    class TestShm : public CppUnit::TestFixture
+    {
+      CPPUNIT_TEST_SUITE(Json::Rpc::TestShm);
+      CPPUNIT_TEST(testChannel);
+      CPPUNIT_TEST(testCall);
+      CPPUNIT_TEST(testBigMessage);
+      CPPUNIT_TEST(testDisconnect);
+      CPPUNIT_TEST_SUITE_END();
+
+      public:
+        /**
+         * \brief Initialize data before launching test.
+         */
+        void setUp()
+        {
+        }
+
+        /**
+         * \brief Cleanup data after test finished.
+         */
+        void tearDown()
+        {
+        }
+
+        /**
+         * \brief Test the segment passing, the wrap around and the full
+         * ring of a channel.
+         */
+        void testChannel()
+        {
+#ifdef __linux__
+          shm::Channel client;
+          shm::Channel server;
+          std::string data(3000, 'a');
+          char buf[4096];
+          int fds[2];
+
+          CPPUNIT_ASSERT(socketpair(AF_UNIX, SOCK_STREAM, 0, fds) == 0);
+          CPPUNIT_ASSERT(client.Create(100));
+          CPPUNIT_ASSERT(client.Send(fds[0]) && server.Receive(fds[1]));
+          ::close(fds[0]);
+          ::close(fds[1]);
+
+          /* rounded up to the minimum */
+          CPPUNIT_ASSERT(client.GetWritable() == 4096);
+          CPPUNIT_ASSERT(server.GetReadable() == 0);
+
+          /* second write goes around the end of the ring */
+          for(int i = 0 ; i < 2 ; i++)
+          {
+            data[0] = 'b' + i;
+            CPPUNIT_ASSERT(client.Write(data.data(), data.length()) == 3000);
+            CPPUNIT_ASSERT(server.GetReadable() == 3000);
+            CPPUNIT_ASSERT(server.Read(buf, sizeof(buf)) == 3000);
+            CPPUNIT_ASSERT(std::string(buf, 3000) == data);
+          }
+
+          /* full ring */
+          CPPUNIT_ASSERT(server.Write(std::string(5000, 'c').data(),
+                5000) == 4096);
+          CPPUNIT_ASSERT(server.Write("d", 1) == 0);
+          CPPUNIT_ASSERT(client.Read(buf, 10) == 10);
+          CPPUNIT_ASSERT(server.GetWritable() == 10);
+
+          client.Close();
+          CPPUNIT_ASSERT(!client.IsOpen());
+#endif
+        }
+
+        /**
+         * \brief Test a call processed in the thread of the client.
+         */
+        void testCall()
+        {
+#ifdef __linux__
+          ShmServer server(TEST_SHM_PATH);
+          ShmClient client(TEST_SHM_PATH);
+          TestShmRpc obj;
+          Json::FastWriter writer;
+          Json::Reader reader;
+          Json::Value request;
+          Json::Value response;
+          std::string msg;
+
+          server.AddMethod(new RpcMethod<TestShmRpc>(obj, &TestShmRpc::Echo,
+                std::string("echo")));
+
+          CPPUNIT_ASSERT(server.Bind() && server.Listen());
+          CPPUNIT_ASSERT(client.Connect());
+
+          /* accept */
+          server.WaitMessage(100);
+          CPPUNIT_ASSERT(server.GetClients().size() == 1);
+
+          request["jsonrpc"] = "2.0";
+          request["method"] = "echo";
+          request["id"] = 1;
+          request["params"] = "shared";
+
+          for(int i = 0 ; i < 3 ; i++)
+          {
+            CPPUNIT_ASSERT(client.Send(writer.write(request)) > 0);
+            server.WaitMessage(100);
+            CPPUNIT_ASSERT(client.Recv(msg) > 0);
+            CPPUNIT_ASSERT(reader.parse(msg, response));
+            CPPUNIT_ASSERT(response["result"] == "shared");
+          }
+#endif
+        }
+
+        /**
+         * \brief Test messages bigger than the rings, in both directions.
+         */
+        void testBigMessage()
+        {
+#ifdef __linux__
+          ShmServer server(TEST_SHM_PATH);
+          ShmClient client(TEST_SHM_PATH, 4096);
+          TestShmLoop loop(server);
+          system_util::Thread thread(
+              new system_util::ThreadArgImpl<TestShmLoop>(loop,
+                &TestShmLoop::Run, NULL));
+          TestShmRpc obj;
+          Json::FastWriter writer;
+          Json::Reader reader;
+          Json::Value request;
+          Json::Value response;
+          std::string msg;
+          bool ret = false;
+
+          server.AddMethod(new RpcMethod<TestShmRpc>(obj, &TestShmRpc::Echo,
+                std::string("echo")));
+          server.SetEncapsulatedFormat(NETSTRING);
+          client.SetEncapsulatedFormat(NETSTRING);
+
+          CPPUNIT_ASSERT(server.Bind() && server.Listen());
+          CPPUNIT_ASSERT(thread.Start(false));
+
+          request["jsonrpc"] = "2.0";
+          request["method"] = "echo";
+          request["id"] = 1;
+          request["params"] = std::string(100 * 1024, 'a');
+
+          /* the client waits for room while the server reads */
+          ret = client.Connect() && client.Send(writer.write(request)) > 0 &&
+            client.Recv(msg) > 0 && reader.parse(msg, response);
+
+          loop.Stop();
+          thread.Join();
+
+          CPPUNIT_ASSERT(ret);
+          CPPUNIT_ASSERT(response["result"] == request["params"]);
+#endif
+        }
+
+        /**
+         * \brief Test that a client which has gone is removed and that the
+         * socket file is removed with the server.
+         */
+        void testDisconnect()
+        {
+#ifdef __linux__
+          struct stat st;
+
+          {
+            ShmServer server(TEST_SHM_PATH);
+            ShmClient client(TEST_SHM_PATH);
+
+            CPPUNIT_ASSERT(server.Bind() && server.Listen());
+            CPPUNIT_ASSERT(client.Connect());
+            server.WaitMessage(100);
+            CPPUNIT_ASSERT(server.GetClients().size() == 1);
+
+            client.Close();
+            server.WaitMessage(100);
+            CPPUNIT_ASSERT(server.GetClients().size() == 0);
+          }
+
+          CPPUNIT_ASSERT(stat(TEST_SHM_PATH, &st) == -1);
+#endif
+        }
+    };
+  } /* namespace Rpc */
+} /* namespace Json */
+
+/* add the test suite in the global registry */
+CPPUNIT_TEST_SUITE_REGISTRATION(Json::Rpc::TestShm);
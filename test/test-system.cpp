@@ -70,6 +70,130 @@ namespace system_util
       }
   };
 
+  /**
+   * \class Counter
+   * \brief Task example for thread pool.
+   */
+  class Counter
+  {
+    public:
+      /**
+       * \brief Constructor.
+       */
+      Counter()
+      {
+        m_count = 0;
+      }
+
+      /**
+       * \brief Method called by the pool threads.
+       */
+      void* Increment(void* arg)
+      {
+        (void)arg;
+
+        system_util::msleep(1);
+        m_mutex.Lock();
+        m_count++;
+        m_mutex.Unlock();
+        return NULL;
+      }
+
+      /**
+       * \brief Number of calls to Increment.
+       */
+      size_t m_count;
+
+      /**
+       * \brief Mutex to protect m_count.
+       */
+      Mutex m_mutex;
+  };
+
+  /**
+   * \class Notifier
+   * \brief Signal a condition from another thread.
+   */
+  class Notifier
+  {
+    public:
+      /**
+       * \brief Constructor.
+       */
+      Notifier()
+      {
+        m_signaled = false;
+      }
+
+      /**
+       * \brief Method called by the thread.
+       */
+      void* Notify(void* arg)
+      {
+        (void)arg;
+
+        system_util::msleep(10);
+        m_mutex.Lock();
+        m_signaled = true;
+        m_cond.Signal();
+        m_mutex.Unlock();
+        return NULL;
+      }
+
+      /**
+       * \brief If the condition has been signaled.
+       */
+      bool m_signaled;
+
+      /**
+       * \brief Mutex to protect m_signaled.
+       */
+      Mutex m_mutex;
+
+      /**
+       * \brief Condition signaled by Notify().
+       */
+      Condition m_cond;
+  };
+
+  /**
+   * \class LocalUser
+   * \brief Use a ThreadLocal from another thread.
+   */
+  class LocalUser
+  {
+    public:
+      /**
+       * \brief Constructor.
+       */
+      LocalUser()
+      {
+        m_seen = (void*)0x1;
+      }
+
+      /**
+       * \brief Method called by the thread.
+       */
+      void* Use(void* arg)
+      {
+        (void)arg;
+
+        m_seen = m_local.Get();
+        m_local.Set((void*)0xDEAD);
+        return m_local.Get();
+      }
+
+      /**
+       * \brief Value seen by the thread before it set its own.
+       */
+      void* m_seen;
+
+      /**
+       * \brief Thread local value.
+       */
+      ThreadLocal m_local;
+  };
+
   /** 
    * \class TestSystem
    * \brief Unit tests for system objects.
@@ -80,6 +204,10 @@ namespace system_util
     CPPUNIT_TEST(testThreadCreate);
     CPPUNIT_TEST(testThreadCancel);
     CPPUNIT_TEST(testMutex);
+    CPPUNIT_TEST(testThreadPool);
+    CPPUNIT_TEST(testConditionTimedWait);
+    CPPUNIT_TEST(testThreadLocal);
+    CPPUNIT_TEST(testCounter);
     CPPUNIT_TEST_SUITE_END();
 
     public:
@@ -144,6 +272,98 @@ namespace system_util
         CPPUNIT_ASSERT(mutex.Lock());
         CPPUNIT_ASSERT(mutex.Unlock());
       }
+
+      /**
+       * \brief Test that thread pool executes all the tasks, with a queue
+       * smaller than the number of tasks.
+       */
+      void testThreadPool()
+      {
+        Counter obj;
+        ThreadPool pool(4, 8);
+
+        CPPUNIT_ASSERT(pool.Start());
+
+        for(size_t i = 0 ; i < 100 ; i++)
+        {
+          CPPUNIT_ASSERT(pool.Push(new ThreadArgImpl<Counter>(obj,
+                  &Counter::Increment, NULL)));
+        }
+
+        pool.Stop();
+        CPPUNIT_ASSERT(obj.m_count == 100);
+        CPPUNIT_ASSERT(pool.GetPendingCount() == 0);
+
+        /* stopped pool does not accept task */
+        ThreadArg* task = new ThreadArgImpl<Counter>(obj, &Counter::Increment,
+            NULL);
+        CPPUNIT_ASSERT(pool.Push(task) == false);
+        delete task;
+      }
+
+      /**
+       * \brief Test that a timed wait expires when nobody signals and ends
+       * early otherwise.
+       */
+      void testConditionTimedWait()
+      {
+        Notifier obj;
+        Thread th = Thread(new ThreadArgImpl<Notifier>(obj,
+              &Notifier::Notify, NULL));
+        uint64_t start = monotonicTime();
+
+        obj.m_mutex.Lock();
+        CPPUNIT_ASSERT(obj.m_cond.TimedWait(obj.m_mutex, 30) == false);
+        CPPUNIT_ASSERT(monotonicTime() - start >= 30000);
+
+        start = monotonicTime();
+        th.Start(false);
+        while(!obj.m_signaled)
+        {
+          obj.m_cond.TimedWait(obj.m_mutex, 10000);
+        }
+        obj.m_mutex.Unlock();
+        th.Join();
+
+        CPPUNIT_ASSERT(monotonicTime() - start < 5000000);
+      }
+
+      /**
+       * \brief Test that each thread has its own ThreadLocal value.
+       */
+      void testThreadLocal()
+      {
+        LocalUser obj;
+        Thread th = Thread(new ThreadArgImpl<LocalUser>(obj, &LocalUser::Use,
+              NULL));
+        void* ret = NULL;
+
+        CPPUNIT_ASSERT(obj.m_local.Get() == NULL);
+        CPPUNIT_ASSERT(obj.m_local.Set((void*)0xBEEF));
+
+        th.Start(false);
+        th.Join(&ret);
+
+        CPPUNIT_ASSERT(obj.m_seen == NULL);
+        CPPUNIT_ASSERT(ret == (void*)0xDEAD);
+        CPPUNIT_ASSERT(obj.m_local.Get() == (void*)0xBEEF);
+      }
+
+      /**
+       * \brief Test single writer counters and the nanosecond clock.
+       */
+      void testCounter()
+      {
+        uint64_t counter = 0;
+        uint64_t start = monotonicTimeNs();
+
+        counterAdd(&counter, 1);
+        counterAdd(&counter, 0x100000000ULL);
+        CPPUNIT_ASSERT(counterRead(&counter) == 0x100000001ULL);
+
+        msleep(2);
+        CPPUNIT_ASSERT(monotonicTimeNs() - start >= 2000000);
+      }
   };
 
 } /* namespace system */
@@ -0,0 +1,603 @@
+/*
+ *  JsonRpc-Cpp - JSON-RPC implementation.
+ *  Copyright (C) 2008-2011 Sebastien Vincent <sebastien.vincent@cppextrem.com>
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+/**
+ * \file test-tcpserver.cpp
+ * \brief TcpServer unit tests, run with each event backend.
+ * \author Sebastien Vincent
+ */
+
+#include <cppunit/extensions/HelperMacros.h>
+
+#include "jsonrpc.h"
+
+namespace Json
+{
+  namespace Rpc
+  {
+    /**
+     * \var TEST_TCP_PORT
+     * \brief Port of the TcpServer used by the tests.
+     */
+    static const uint16_t TEST_TCP_PORT = 8093;
+
+    /**
+     * \class TestTcpRpc
+     * \brief RPC methods called through the TcpServer.
+     */
+    class TestTcpRpc
+    {
+      public:
+        /**
+         * \brief Reply with the parameters.
+         * \param root JSON-RPC request
+         * \param response JSON-RPC response
+         * \return true
+         */
+        bool Echo(const Json::Value& root, Json::Value& response)
+        {
+          response["jsonrpc"] = "2.0";
+          response["id"] = root["id"];
+          response["result"] = root["params"];
+          return true;
+        }
+
+        /**
+         * \brief Reply with the parameters after 2 ms.
+         * \param root JSON-RPC request
+         * \param response JSON-RPC response
+         * \return true
+         */
+        bool Slow(const Json::Value& root, Json::Value& response)
+        {
+          system_util::msleep(2);
+          return Echo(root, response);
+        }
+    };
+
+    /**
+     * \class TestTcpLoop
+     * \brief Run a server in another thread.
+     */
+    class TestTcpLoop
+    {
+      public:
+        /**
+         * \brief Constructor.
+         * \param server server
+         */
+        TestTcpLoop(TcpServer& server) : m_server(server)
+        {
+          m_stop = false;
+        }
+
+        /**
+         * \brief Wait for messages until Stop().
+         * \param arg unused
+         * \return NULL
+         */
+        void* Run(void* arg)
+        {
+          (void)arg;
+
+          m_mutex.Lock();
+          while(!m_stop)
+          {
+            m_mutex.Unlock();
+            m_server.WaitMessage(10);
+            m_mutex.Lock();
+          }
+          m_mutex.Unlock();
+
+          return NULL;
+        }
+
+        /**
+         * \brief Stop Run().
+         */
+        void Stop()
+        {
+          m_mutex.Lock();
+          m_stop = true;
+          m_mutex.Unlock();
+        }
+
+      private:
+        /**
+         * \brief Server.
+         */
+        TcpServer& m_server;
+
+        /**
+         * \brief If Run() has to stop.
+         */
+        bool m_stop;
+
+        /**
+         * \brief Mutex to protect m_stop.
+         */
+        system_util::Mutex m_mutex;
+    };
+
+    /**
+     * \class TestTcpSender
+     * \brief Send data from another thread, the send blocks while the
+     * server does not read.
+     */
+    class TestTcpSender
+    {
+      public:
+        /**
+         * \brief Constructor.
+         * \param client connected client
+         * \param data data to send
+         */
+        TestTcpSender(TcpClient& client, const std::string& data)
+          : m_client(client), m_data(data)
+        {
+          m_ret = false;
+        }
+
+        /**
+         * \brief Send the data.
+         * \param arg unused
+         * \return NULL
+         */
+        void* Run(void* arg)
+        {
+          (void)arg;
+
+          m_ret = m_client.Send(m_data) > 0;
+          return NULL;
+        }
+
+        /**
+         * \brief Get if the data has been sent (once Run() has returned).
+         * \return true if sent, false otherwise
+         */
+        bool IsSent() const
+        {
+          return m_ret;
+        }
+
+      private:
+        /**
+         * \brief Client.
+         */
+        TcpClient& m_client;
+
+        /**
+         * \brief Data to send.
+         */
+        const std::string& m_data;
+
+        /**
+         * \brief If the data has been sent.
+         */
+        bool m_ret;
+    };
+
+    /**
+     * \class TestTcpServer
+     * \brief Unit tests for TcpServer with the backend given as template
+     * parameter.
+     */
+    template<enum EventBackend backend>
+    class TestTcpServer : public CppUnit::TestFixture
+    {
+      CPPUNIT_TEST_SUITE(TestTcpServer);
+      CPPUNIT_TEST(testBackend);
+      CPPUNIT_TEST(testPipeline);
+      CPPUNIT_TEST(testBigMessage);
+      CPPUNIT_TEST(testDisconnect);
+      CPPUNIT_TEST(testClose);
+      CPPUNIT_TEST(testWatermarks);
+      CPPUNIT_TEST(testWorkerPool);
+      CPPUNIT_TEST_SUITE_END();
+
+      public:
+        /**
+         * \brief Initialize data before launching test.
+         */
+        void setUp()
+        {
+          m_server = new TcpServer("127.0.0.1", TEST_TCP_PORT, backend);
+          m_server->AddMethod(new RpcMethod<TestTcpRpc>(m_obj,
+                &TestTcpRpc::Echo, std::string("echo")));
+          m_server->AddMethod(new RpcMethod<TestTcpRpc>(m_obj,
+                &TestTcpRpc::Slow, std::string("slow")));
+          CPPUNIT_ASSERT(m_server->Bind() && m_server->Listen());
+        }
+
+        /**
+         * \brief Cleanup data after test finished.
+         */
+        void tearDown()
+        {
+          delete m_server;
+          m_server = NULL;
+        }
+
+        /**
+         * \brief Test that the backend asked for is used, or one of its
+         * fallbacks.
+         */
+        void testBackend()
+        {
+          CPPUNIT_ASSERT(m_server->GetBackend() <= backend);
+#ifdef __linux__
+          if(backend != BACKEND_POLL)
+          {
+            CPPUNIT_ASSERT(m_server->GetBackend() != BACKEND_POLL);
+          }
+#endif
+        }
+
+        /**
+         * \brief Test requests sent at once by several clients, the
+         * responses come in order on each connection.
+         */
+        void testPipeline()
+        {
+          TestTcpLoop loop(*m_server);
+          system_util::Thread thread(
+              new system_util::ThreadArgImpl<TestTcpLoop>(loop,
+                &TestTcpLoop::Run, NULL));
+          TcpClient* clients[3];
+          Json::FastWriter writer;
+          Json::Reader reader;
+          bool ret = true;
+
+          CPPUNIT_ASSERT(thread.Start(false));
+
+          for(int i = 0 ; i < 3 ; i++)
+          {
+            std::string batch;
+
+            clients[i] = new TcpClient("127.0.0.1", TEST_TCP_PORT);
+            ret = ret && clients[i]->Connect();
+
+            for(int j = 0 ; j < 100 ; j++)
+            {
+              Json::Value request;
+
+              request["jsonrpc"] = "2.0";
+              request["method"] = "echo";
+              request["id"] = j;
+              request["params"] = i;
+              batch += writer.write(request);
+            }
+
+            ret = ret && clients[i]->Send(batch) > 0;
+          }
+
+          for(int i = 0 ; ret && i < 3 ; i++)
+          {
+            for(int j = 0 ; ret && j < 100 ; j++)
+            {
+              Json::Value response;
+              std::string msg;
+
+              ret = clients[i]->Recv(msg) > 0 && reader.parse(msg, response) &&
+                response["id"] == j && response["result"] == i;
+            }
+          }
+
+          for(int i = 0 ; i < 3 ; i++)
+          {
+            delete clients[i];
+          }
+
+          loop.Stop();
+          thread.Join();
+
+          CPPUNIT_ASSERT(ret);
+        }
+
+        /**
+         * \brief Test a message bigger than the receive buffers with a
+         * response bigger than the high watermark, reading stops and
+         * resumes while it is sent.
+         */
+        void testBigMessage()
+        {
+          TestTcpLoop loop(*m_server);
+          system_util::Thread thread(
+              new system_util::ThreadArgImpl<TestTcpLoop>(loop,
+                &TestTcpLoop::Run, NULL));
+          TcpClient client("127.0.0.1", TEST_TCP_PORT);
+          Json::FastWriter writer;
+          Json::Reader reader;
+          Json::Value request;
+          Json::Value response;
+          std::string msg;
+          bool ret = false;
+
+          m_server->SetEncapsulatedFormat(NETSTRING);
+          client.SetEncapsulatedFormat(NETSTRING);
+          CPPUNIT_ASSERT(m_server->SetWatermarks(4096, 16384));
+          CPPUNIT_ASSERT(thread.Start(false));
+
+          request["jsonrpc"] = "2.0";
+          request["method"] = "echo";
+          request["params"] = std::string(1024 * 1024, 'a');
+
+          ret = client.Connect();
+
+          for(int i = 0 ; ret && i < 2 ; i++)
+          {
+            request["id"] = i;
+            ret = client.Send(writer.write(request)) > 0 &&
+              client.Recv(msg) > 0 && reader.parse(msg, response) &&
+              response["id"] == i &&
+              response["result"] == request["params"];
+          }
+
+          loop.Stop();
+          thread.Join();
+
+          CPPUNIT_ASSERT(ret);
+        }
+
+        /**
+         * \brief Test that a client which has gone is removed, also with a
+         * response waiting to be sent.
+         */
+        void testDisconnect()
+        {
+          TcpClient client("127.0.0.1", TEST_TCP_PORT);
+          TcpClient client2("127.0.0.1", TEST_TCP_PORT);
+
+          CPPUNIT_ASSERT(client.Connect());
+          CPPUNIT_ASSERT(client2.Connect());
+          m_server->WaitMessage(100);
+          m_server->WaitMessage(100);
+          CPPUNIT_ASSERT(m_server->GetClients().size() == 2);
+
+          client.Close();
+          m_server->WaitMessage(100);
+          CPPUNIT_ASSERT(m_server->GetClients().size() == 1);
+
+          /* the server has a call in progress when it is closed */
+          CPPUNIT_ASSERT(client2.Send(
+                "{\"jsonrpc\":\"2.0\",\"method\":\"echo\",\"id\":1}") > 0);
+          m_server->Close();
+          CPPUNIT_ASSERT(m_server->GetClients().size() == 0);
+        }
+
+        /**
+         * \brief Test that a client connecting while the server is closed
+         * is not added after the other connections are torn down.
+         */
+        void testClose()
+        {
+          TcpClient client("127.0.0.1", TEST_TCP_PORT);
+          TcpClient client2("127.0.0.1", TEST_TCP_PORT);
+
+          CPPUNIT_ASSERT(client.Connect());
+          m_server->WaitMessage(100);
+          CPPUNIT_ASSERT(m_server->GetClients().size() == 1);
+
+          /* pending in the listen queue or in the multishot accept */
+          CPPUNIT_ASSERT(client2.Connect());
+          m_server->Close();
+          CPPUNIT_ASSERT(m_server->GetClients().size() == 0);
+
+          /* closing again does not wait for an accept */
+          m_server->Close();
+          CPPUNIT_ASSERT(m_server->GetClients().size() == 0);
+        }
+
+        /**
+         * \brief Test that a client which does not read its responses
+         * stops being read once its output queue passes the high
+         * watermark, that the other clients are still served, and that it
+         * is read again once the queue is below the low watermark.
+         */
+        void testWatermarks()
+        {
+          static const int count = 256;
+          TestTcpLoop loop(*m_server);
+          system_util::Thread thread(
+              new system_util::ThreadArgImpl<TestTcpLoop>(loop,
+                &TestTcpLoop::Run, NULL));
+          TcpClient client("127.0.0.1", TEST_TCP_PORT);
+          TcpClient client2("127.0.0.1", TEST_TCP_PORT);
+          Json::FastWriter writer;
+          Json::Reader reader;
+          Json::Value request;
+          Json::Value response;
+          std::string batch;
+          std::string msg;
+          int64_t messages = -1;
+          int stable = 0;
+          bool stalled = false;
+          bool served = false;
+          bool resumed = true;
+
+          request["jsonrpc"] = "2.0";
+          request["method"] = "echo";
+          request["params"] = std::string(64 * 1024, 'a');
+
+          for(int i = 0 ; i < count ; i++)
+          {
+            request["id"] = i;
+            batch += writer.write(request);
+          }
+
+          m_server->SetMetrics(m_metrics, "tcp");
+          CPPUNIT_ASSERT(m_server->SetWatermarks(64 * 1024, 256 * 1024));
+          CPPUNIT_ASSERT(client.Connect());
+          CPPUNIT_ASSERT(thread.Start(false));
+
+          TestTcpSender sender(client, batch);
+          system_util::Thread senderThread(
+              new system_util::ThreadArgImpl<TestTcpSender>(sender,
+                &TestTcpSender::Run, NULL));
+
+          CPPUNIT_ASSERT(senderThread.Start(false));
+
+          /* wait until the server stops reading the requests */
+          for(int i = 0 ; i < 200 && stable < 5 ; i++)
+          {
+            int64_t current = 0;
+
+            system_util::msleep(20);
+            current = m_metrics.Get(0, METRIC_MESSAGES);
+            stable = (current == messages) ? stable + 1 : 0;
+            messages = current;
+          }
+
+          /* the queue may have been drained a bit below the high watermark
+           * by the time it is read
+           */
+          stalled = stable == 5 && messages < count &&
+            m_metrics.Get(0, METRIC_OUTPUT_QUEUE) > 64 * 1024;
+
+          /* another client is served meanwhile */
+          request["params"] = 1;
+          served = client2.Connect() &&
+            client2.Send(writer.write(request)) > 0 &&
+            client2.Recv(msg) > 0 && reader.parse(msg, response) &&
+            response["result"] == 1 &&
+            m_metrics.Get(0, METRIC_MESSAGES) == messages + 1;
+
+          /* reading resumes as the responses are received */
+          for(int i = 0 ; resumed && i < count ; i++)
+          {
+            resumed = client.Recv(msg) > 0 && reader.parse(msg, response) &&
+              response["id"] == i;
+          }
+
+          if(!resumed)
+          {
+            /* unblock the sender */
+            shutdown(client.GetSocket(), SHUT_RDWR);
+          }
+
+          senderThread.Join();
+          loop.Stop();
+          thread.Join();
+
+          CPPUNIT_ASSERT(stalled);
+          CPPUNIT_ASSERT(served);
+          CPPUNIT_ASSERT(resumed);
+          CPPUNIT_ASSERT(sender.IsSent());
+          CPPUNIT_ASSERT(m_metrics.Get(0, METRIC_MESSAGES) == count + 1);
+          CPPUNIT_ASSERT(m_metrics.Get(0, METRIC_OUTPUT_QUEUE) == 0);
+        }
+
+        /**
+         * \brief Test pipelined requests with a worker pool queue smaller
+         * than the pipeline, the requests which do not fit in the queue are
+         * executed inline and all of them are answered.
+         */
+        void testWorkerPool()
+        {
+          TestTcpLoop loop(*m_server);
+          system_util::Thread thread(
+              new system_util::ThreadArgImpl<TestTcpLoop>(loop,
+                &TestTcpLoop::Run, NULL));
+          TcpClient* clients[2];
+          Json::FastWriter writer;
+          Json::Reader reader;
+          bool ret = true;
+
+          m_server->SetMetrics(m_metrics, "tcp");
+          CPPUNIT_ASSERT(m_server->SetWorkerPool(2, 1));
+          CPPUNIT_ASSERT(thread.Start(false));
+
+          for(int i = 0 ; i < 2 ; i++)
+          {
+            std::string batch;
+
+            clients[i] = new TcpClient("127.0.0.1", TEST_TCP_PORT);
+            ret = ret && clients[i]->Connect();
+
+            for(int j = 0 ; j < 20 ; j++)
+            {
+              Json::Value request;
+
+              request["jsonrpc"] = "2.0";
+              request["method"] = "slow";
+              request["id"] = j;
+              request["params"] = i;
+              batch += writer.write(request);
+            }
+
+            ret = ret && clients[i]->Send(batch) > 0;
+          }
+
+          /* responses of pooled requests can come in any order */
+          for(int i = 0 ; ret && i < 2 ; i++)
+          {
+            std::vector<bool> received(20, false);
+
+            for(int j = 0 ; ret && j < 20 ; j++)
+            {
+              Json::Value response;
+              std::string msg;
+
+              ret = clients[i]->Recv(msg) > 0 && reader.parse(msg, response) &&
+                response["id"].isInt() && response["id"].asInt() >= 0 &&
+                response["id"].asInt() < 20 &&
+                !received[response["id"].asInt()] && response["result"] == i;
+
+              if(ret)
+              {
+                received[response["id"].asInt()] = true;
+              }
+            }
+          }
+
+          for(int i = 0 ; i < 2 ; i++)
+          {
+            delete clients[i];
+          }
+
+          loop.Stop();
+          thread.Join();
+
+          CPPUNIT_ASSERT(ret);
+          CPPUNIT_ASSERT(m_metrics.Get(0, METRIC_JOB_QUEUE) == 0);
+        }
+
+      private:
+        /**
+         * \brief Server.
+         */
+        TcpServer* m_server;
+
+        /**
+         * \brief RPC methods.
+         */
+        TestTcpRpc m_obj;
+
+        /**
+         * \brief Metrics of the server, it outlives the server.
+         */
+        Metrics m_metrics;
+    };
+  } /* namespace Rpc */
+} /* namespace Json */
+
+/* add the test suites in the global registry, one for each backend */
+CPPUNIT_TEST_SUITE_REGISTRATION(Json::Rpc::TestTcpServer<Json::Rpc::BACKEND_POLL>);
+CPPUNIT_TEST_SUITE_REGISTRATION(Json::Rpc::TestTcpServer<Json::Rpc::BACKEND_EPOLL>);
+CPPUNIT_TEST_SUITE_REGISTRATION(Json::Rpc::TestTcpServer<Json::Rpc::BACKEND_IO_URING>);
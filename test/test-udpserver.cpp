@@ -0,0 +1,223 @@
+/*
+ *  JsonRpc-Cpp - JSON-RPC implementation.
+ *  Copyright (C) 2008-2011 Sebastien Vincent <sebastien.vincent@cppextrem.com>
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+/**
+ * \file test-udpserver.cpp
+ * \brief UdpServer unit tests.
+ * \author Sebastien Vincent
+ */
+
+#include <poll.h>
+
+#include <cppunit/extensions/HelperMacros.h>
+
+#include "jsonrpc.h"
+
+namespace Json
+{
+  namespace Rpc
+  {
+    /**
+     * \var TEST_UDP_PORT
+     * \brief Port of the UdpServer used by the tests.
+     */
+    static const uint16_t TEST_UDP_PORT = 8094;
+
+    /**
+     * \class TestUdpRpc
+     * \brief RPC methods called through the UdpServer.
+     */
+    class TestUdpRpc
+    {
+      public:
+        /**
+         * \brief Reply with the parameters.
+         * \param root JSON-RPC request
+         * \param response JSON-RPC response
+         * \return true
+         */
+        bool Echo(const Json::Value& root, Json::Value& response)
+        {
+          response["jsonrpc"] = "2.0";
+          response["id"] = root["id"];
+          response["result"] = root["params"];
+          return true;
+        }
+
+        /**
+         * \brief Reply with a result too big for a datagram.
+         * \param root JSON-RPC request
+         * \param response JSON-RPC response
+         * \return true
+         */
+        bool Big(const Json::Value& root, Json::Value& response)
+        {
+          response["jsonrpc"] = "2.0";
+          response["id"] = root["id"];
+          response["result"] = std::string(70000, 'a');
+          return true;
+        }
+    };
+
+    /**
+     * \class TestUdpServer
+     * \brief Unit tests for UdpServer.
+     */
+    class TestUdpServer : public CppUnit::TestFixture
+    {
+      CPPUNIT_TEST_SUITE(Json::Rpc::TestUdpServer);
+      CPPUNIT_TEST(testSingle);
+      CPPUNIT_TEST(testBatch);
+      CPPUNIT_TEST_SUITE_END();
+
+      public:
+        /**
+         * \brief Initialize data before launching test.
+         */
+        void setUp()
+        {
+          m_server = new UdpServer("127.0.0.1", TEST_UDP_PORT);
+          m_server->AddMethod(new RpcMethod<TestUdpRpc>(m_obj,
+                &TestUdpRpc::Echo, std::string("echo")));
+          m_server->AddMethod(new RpcMethod<TestUdpRpc>(m_obj,
+                &TestUdpRpc::Big, std::string("big")));
+          CPPUNIT_ASSERT(m_server->Bind());
+        }
+
+        /**
+         * \brief Cleanup data after test finished.
+         */
+        void tearDown()
+        {
+          delete m_server;
+        }
+
+        /**
+         * \brief Test a call with one datagram per wakeup.
+         */
+        void testSingle()
+        {
+          UdpClient client("127.0.0.1", TEST_UDP_PORT);
+
+          CPPUNIT_ASSERT(client.Connect());
+          CPPUNIT_ASSERT(client.Send(Request("echo", 1)) > 0);
+          m_server->WaitMessage(100);
+          CPPUNIT_ASSERT(CheckResponse(client, 1));
+        }
+
+        /**
+         * \brief Test that one batch answers the datagrams of several
+         * clients, each to its source, and that a reply which cannot be
+         * sent does not drop the next ones.
+         */
+        void testBatch()
+        {
+#ifdef __linux__
+          static const int count = 4;
+          UdpClient* clients[count];
+          UdpClient big("127.0.0.1", TEST_UDP_PORT);
+          bool answered = true;
+
+          CPPUNIT_ASSERT(m_server->SetBatchSize(16));
+          CPPUNIT_ASSERT(big.Connect());
+
+          for(int i = 0 ; i < count ; i++)
+          {
+            clients[i] = new UdpClient("127.0.0.1", TEST_UDP_PORT);
+            answered = answered && clients[i]->Connect();
+          }
+
+          /* all queued before the server wakes up, the oversized reply
+           * sits in the middle of the batch
+           */
+          for(int i = 0 ; i < count ; i++)
+          {
+            answered = answered && clients[i]->Send(Request("echo", i)) > 0;
+
+            if(i == count / 2)
+            {
+              answered = answered && big.Send(Request("big", count)) > 0;
+            }
+          }
+
+          m_server->WaitMessage(100);
+
+          for(int i = 0 ; i < count ; i++)
+          {
+            answered = answered && CheckResponse(*clients[i], i);
+            delete clients[i];
+          }
+
+          CPPUNIT_ASSERT(answered);
+#endif
+        }
+
+      private:
+        /**
+         * \brief Build a request with the id as parameter.
+         * \param method method name
+         * \param id request id
+         * \return serialized request
+         */
+        std::string Request(const std::string& method, int id)
+        {
+          Json::FastWriter writer;
+          Json::Value request;
+
+          request["jsonrpc"] = "2.0";
+          request["method"] = method;
+          request["id"] = id;
+          request["params"] = id;
+          return writer.write(request);
+        }
+
+        /**
+         * \brief Read the echo response of a client.
+         * \param client client which sent the request
+         * \param id id of the request
+         * \return true if the response is the one of this request
+         */
+        bool CheckResponse(UdpClient& client, int id)
+        {
+          Json::Reader reader;
+          Json::Value response;
+          std::string msg;
+          struct pollfd pfd;
+
+          /* a lost reply does not block the test */
+          pfd.fd = client.GetSocket();
+          pfd.events = POLLIN;
+
+          return poll(&pfd, 1, 1000) == 1 && client.Recv(msg) > 0 && reader.parse(msg, response) &&
+            response["id"] == id && response["result"] == id;
+        }
+
+        /**
+         * \brief Server tested.
+         */
+        UdpServer* m_server;
+
+        /**
+         * \brief RPC methods.
+         */
+        TestUdpRpc m_obj;
+    };
+  } /* namespace Rpc */
+} /* namespace Json */
+
+/* add the test suite in the global registry */
+CPPUNIT_TEST_SUITE_REGISTRATION(Json::Rpc::TestUdpServer);
@@ -0,0 +1,302 @@
+/*
+ *  JsonRpc-Cpp - JSON-RPC implementation.
+ *  Copyright (C) 2008-2011 Sebastien Vincent <sebastien.vincent@cppextrem.com>
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+/**
+ * \file test-unix.cpp
+ * \brief Unix domain socket transport unit tests.
+ * \author Sebastien Vincent
+ */
+
+#include <sys/stat.h>
+
+#include <cppunit/extensions/HelperMacros.h>
+
+#include "jsonrpc.h"
+
+namespace Json
+{
+  namespace Rpc
+  {
+    /**
+     * \var TEST_UNIX_PATH
+     * \brief Path of the UnixServer used by the tests.
+     */
+    static const char TEST_UNIX_PATH[] = "/tmp/test-jsonrpc-unix.sock";
+
+    /**
+     * \class TestUnixRpc
+     * \brief RPC methods called through the UnixServer.
+     */
+    class TestUnixRpc
+    {
+      public:
+        /**
+         * \brief Reply with the parameters.
+         * \param root JSON-RPC request
+         * \param response JSON-RPC response
+         * \return true
+         */
+        bool Echo(const Json::Value& root, Json::Value& response)
+        {
+          response["jsonrpc"] = "2.0";
+          response["id"] = root["id"];
+          response["result"] = root["params"];
+          return true;
+        }
+    };
+
+    /**
+     * \class TestUnixLoop
+     * \brief Run a server in another thread.
+     */
+    class TestUnixLoop
+    {
+      public:
+        /**
+         * \brief Constructor.
+         * \param server server
+         */
+        TestUnixLoop(UnixServer& server) : m_server(server)
+        {
+          m_stop = false;
+        }
+
+        /**
+         * \brief Wait for messages until Stop().
+         * \param arg unused
+         * \return NULL
+         */
+        void* Run(void* arg)
+        {
+          (void)arg;
+
+          m_mutex.Lock();
+          while(!m_stop)
+          {
+            m_mutex.Unlock();
+            m_server.WaitMessage(10);
+            m_mutex.Lock();
+          }
+          m_mutex.Unlock();
+
+          return NULL;
+        }
+
+        /**
+         * \brief Stop Run().
+         */
+        void Stop()
+        {
+          m_mutex.Lock();
+          m_stop = true;
+          m_mutex.Unlock();
+        }
+
+      private:
+        /**
+         * \brief Server.
+         */
+        UnixServer& m_server;
+
+        /**
+         * \brief If Run() has to stop.
+         */
+        bool m_stop;
+
+        /**
+         * \brief Mutex to protect m_stop.
+         */
+        system_util::Mutex m_mutex;
+    };
+
+    /**
+     * \class TestUnix
+     * \brief Unit tests for UnixServer and UnixClient.
+     */
+    class TestUnix : public CppUnit::TestFixture
+    {
+      CPPUNIT_TEST_SUITE(Json::Rpc::TestUnix);
+      CPPUNIT_TEST(testStream);
+      CPPUNIT_TEST(testSeqPacket);
+      CPPUNIT_TEST(testSeqPacketBig);
+      CPPUNIT_TEST(testAbstract);
+      CPPUNIT_TEST(testRebind);
+      CPPUNIT_TEST_SUITE_END();
+
+      public:
+        /**
+         * \brief Initialize data before launching test.
+         */
+        void setUp()
+        {
+        }
+
+        /**
+         * \brief Cleanup data after test finished.
+         */
+        void tearDown()
+        {
+        }
+
+        /**
+         * \brief Test a call on a Unix stream socket and the removal of the
+         * socket file.
+         */
+        void testStream()
+        {
+          struct stat st;
+
+          {
+            UnixServer server(TEST_UNIX_PATH);
+            UnixClient client(TEST_UNIX_PATH);
+
+            CPPUNIT_ASSERT(Call(server, client, 100));
+            CPPUNIT_ASSERT(stat(TEST_UNIX_PATH, &st) == 0 &&
+                S_ISSOCK(st.st_mode));
+          }
+
+          CPPUNIT_ASSERT(stat(TEST_UNIX_PATH, &st) == -1);
+        }
+
+        /**
+         * \brief Test calls on a Unix seqpacket socket with messages bigger
+         * than the default read size.
+         */
+        void testSeqPacket()
+        {
+          UnixServer server(TEST_UNIX_PATH, networking::UNIX_SEQPACKET);
+          UnixClient client(TEST_UNIX_PATH, networking::UNIX_SEQPACKET);
+
+          CPPUNIT_ASSERT(Call(server, client, 100 * 1024));
+        }
+
+        /**
+         * \brief Test calls on a Unix seqpacket socket with requests and
+         * responses bigger than the socket buffer, sent in several records.
+         */
+        void testSeqPacketBig()
+        {
+          static const size_t sizes[] = {300 * 1024, 1024 * 1024};
+
+          for(size_t i = 0 ; i < sizeof(sizes) / sizeof(sizes[0]) ; i++)
+          {
+            UnixServer server(TEST_UNIX_PATH, networking::UNIX_SEQPACKET);
+            UnixClient client(TEST_UNIX_PATH, networking::UNIX_SEQPACKET);
+
+            CPPUNIT_ASSERT(Call(server, client, sizes[i]));
+          }
+        }
+
+        /**
+         * \brief Test a call on a Unix socket in the abstract namespace.
+         */
+        void testAbstract()
+        {
+#ifdef __linux__
+          UnixServer server("@test-jsonrpc-unix");
+          UnixClient client("@test-jsonrpc-unix");
+
+          CPPUNIT_ASSERT(Call(server, client, 100));
+#endif
+        }
+
+        /**
+         * \brief Test that Close() removes the socket file so that the
+         * path can be bound again.
+         */
+        void testRebind()
+        {
+          struct stat st;
+          UnixServer server(TEST_UNIX_PATH);
+
+          CPPUNIT_ASSERT(server.Bind() && server.Listen());
+          server.Close();
+          CPPUNIT_ASSERT(stat(TEST_UNIX_PATH, &st) == -1);
+
+          CPPUNIT_ASSERT(server.Bind() && server.Listen());
+          server.Close();
+
+          {
+            UnixServer server2(TEST_UNIX_PATH);
+            UnixClient client(TEST_UNIX_PATH);
+
+            CPPUNIT_ASSERT(Call(server2, client, 100));
+          }
+
+          CPPUNIT_ASSERT(stat(TEST_UNIX_PATH, &st) == -1);
+        }
+
+      private:
+        /**
+         * \brief Bind the server and echo a parameter through it.
+         * \param server server, not bound yet
+         * \param client client of this server
+         * \param size size of the parameter
+         * \return true if the parameter came back, false otherwise
+         */
+        bool Call(UnixServer& server, UnixClient& client, size_t size)
+        {
+          TestUnixRpc obj;
+          TestUnixLoop loop(server);
+          system_util::Thread thread(
+              new system_util::ThreadArgImpl<TestUnixLoop>(loop,
+                &TestUnixLoop::Run, NULL));
+          Json::FastWriter writer;
+          Json::Reader reader;
+          Json::Value request;
+          Json::Value response;
+          std::string msg;
+          bool ret = false;
+
+          server.AddMethod(new RpcMethod<TestUnixRpc>(obj, &TestUnixRpc::Echo,
+                std::string("echo")));
+
+          if(!server.Bind() || !server.Listen() || !client.Connect())
+          {
+            return false;
+          }
+
+          request["jsonrpc"] = "2.0";
+          request["method"] = "echo";
+          request["id"] = 1;
+          request["params"] = std::string(size, 'a');
+
+          /* served from another thread: on seqpacket a big message is
+           * several records, each one sent once the previous one is read
+           */
+          if(!thread.Start(false))
+          {
+            return false;
+          }
+
+          /* the server purges a connection it cannot write to, the client
+           * then reads the end of the connection rather than block
+           */
+          ret = client.Send(writer.write(request)) != -1 &&
+            client.Recv(msg) > 0 && reader.parse(msg, response) &&
+            response["result"] == request["params"];
+
+          loop.Stop();
+          thread.Join();
+          return ret;
+        }
+    };
+  } /* namespace Rpc */
+} /* namespace Json */
+
+/* add the test suite in the global registry */
+CPPUNIT_TEST_SUITE_REGISTRATION(Json::Rpc::TestUnix);
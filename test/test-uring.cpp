@@ -0,0 +1,99 @@
+/*
+ *  JsonRpc-Cpp - JSON-RPC implementation.
+ *  Copyright (C) 2008-2011 Sebastien Vincent <sebastien.vincent@cppextrem.com>
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**
+ * \file test-uring.cpp
+ * \brief io_uring backend of TcpServer unit tests.
+ * \author Sebastien Vincent
+ */
+
+#include <cppunit/extensions/HelperMacros.h>
+
+#include "jsonrpc.h"
+#include "uring.h"
+
+namespace Json
+{
+  namespace Rpc
+  {
+    /**
+     * \var TEST_URING_PORT
+     * \brief Port of the TcpServer used by the tests.
+     */
+    static const uint16_t TEST_URING_PORT = 8091;
+
+    /**
+     * \class TestUring
+     * \brief Unit tests for uring::Ring and the io_uring backend of
+     * TcpServer (see also test-tcpserver.cpp).
+     */
+    class TestUring : public CppUnit::TestFixture
+    {
+      CPPUNIT_TEST_SUITE(Json::Rpc::TestUring);
+      CPPUNIT_TEST(testBackend);
+      CPPUNIT_TEST_SUITE_END();
+
+      public:
+        /**
+         * \brief Initialize data before launching test.
+         */
+        void setUp()
+        {
+          m_server = new TcpServer("127.0.0.1", TEST_URING_PORT,
+              BACKEND_IO_URING);
+          CPPUNIT_ASSERT(m_server->Bind() && m_server->Listen());
+        }
+
+        /**
+         * \brief Cleanup data after test finished.
+         */
+        void tearDown()
+        {
+          delete m_server;
+          m_server = NULL;
+        }
+
+        /**
+         * \brief Test that the backend is io_uring when the kernel supports
+         * it and epoll otherwise.
+         */
+        void testBackend()
+        {
+#ifdef __linux__
+          uring::Ring ring;
+          bool supported = ring.Init(8, 8, 4096);
+
+          CPPUNIT_ASSERT(m_server->GetBackend() ==
+              (supported ? BACKEND_IO_URING : BACKEND_EPOLL));
+          CPPUNIT_ASSERT(ring.IsOpen() == supported);
+#else
+          CPPUNIT_ASSERT(m_server->GetBackend() == BACKEND_POLL);
+#endif
+        }
+
+      private:
+        /**
+         * \brief Server.
+         */
+        TcpServer* m_server;
+    };
+  } /* namespace Rpc */
+} /* namespace Json */
+
+/* add the test suite in the global registry */
+CPPUNIT_TEST_SUITE_REGISTRATION(Json::Rpc::TestUring);